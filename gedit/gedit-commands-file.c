@@ -64,48 +64,6 @@ _gedit_cmd_file_new (GSimpleAction *action,
 	gedit_window_create_tab (window, TRUE);
 }
 
-static GeditTab *
-get_tab_from_file (GList *docs,
-		   GFile *file)
-{
-	GList *l;
-
-	for (l = docs; l != NULL; l = l->next)
-	{
-		GeditDocument *doc;
-		GtkSourceFile *source_file;
-		GFile *location;
-
-		doc = l->data;
-		source_file = gedit_document_get_file (doc);
-		location = gtk_source_file_get_location (source_file);
-
-		if (location != NULL && g_file_equal (location, file))
-		{
-			return gedit_tab_get_from_document (doc);
-		}
-	}
-
-	return NULL;
-}
-
-static gboolean
-is_duplicated_file (GSList *files,
-		    GFile  *file)
-{
-	GSList *l;
-
-	for (l = files; l != NULL; l = l->next)
-	{
-		if (g_file_equal (l->data, file))
-		{
-			return TRUE;
-		}
-	}
-
-	return FALSE;
-}
-
 /* File loading */
 static GSList *
 load_file_list (GeditWindow             *window,
@@ -115,7 +73,7 @@ load_file_list (GeditWindow             *window,
 		gint                     column_pos,
 		gboolean                 create)
 {
-	GList *win_docs;
+	GHashTable *seen_files;
 	GSList *files_to_load = NULL;
 	GSList *loaded_files = NULL;
 	GeditTab *tab;
@@ -125,7 +83,7 @@ load_file_list (GeditWindow             *window,
 
 	gedit_debug (DEBUG_COMMANDS);
 
-	win_docs = gedit_window_get_documents (window);
+	seen_files = g_hash_table_new (g_file_hash, (GEqualFunc) g_file_equal);
 
 	/* Remove the files corresponding to documents already opened in
 	 * "window" and remove duplicates from the "files" list.
@@ -134,12 +92,12 @@ load_file_list (GeditWindow             *window,
 	{
 		GFile *file = l->data;
 
-		if (is_duplicated_file (files_to_load, file))
+		if (!g_hash_table_add (seen_files, file))
 		{
 			continue;
 		}
 
-		tab = get_tab_from_file (win_docs, file);
+		tab = gedit_window_get_tab_from_location (window, file);
 
 		if (tab == NULL)
 		{
@@ -178,7 +136,7 @@ load_file_list (GeditWindow             *window,
 		}
 	}
 
-	g_list_free (win_docs);
+	g_hash_table_unref (seen_files);
 
 	if (files_to_load == NULL)
 	{
@@ -1012,6 +970,20 @@ gedit_commands_save_document_async (GeditDocument       *document,
 
 	tab = gedit_tab_get_from_document (document);
 
+	/* Only a part of a huge file is in the buffer, see
+	 * _gedit_tab_save_async(). And an operation like Replace All may be
+	 * half done, see _gedit_tab_set_busy().
+	 */
+	if (_gedit_tab_is_huge_file (tab) ||
+	    gedit_tab_get_state (tab) == GEDIT_TAB_STATE_GENERIC_NOT_EDITABLE)
+	{
+		gedit_debug_message (DEBUG_COMMANDS, "Huge file or busy");
+
+		g_task_return_boolean (task, FALSE);
+		g_object_unref (task);
+		return;
+	}
+
 	if (gedit_document_is_untitled (document) ||
 	    gedit_document_get_readonly (document))
 	{
@@ -1300,8 +1272,7 @@ save_documents_list (GeditWindow *window,
 		g_return_if_fail (state != GEDIT_TAB_STATE_CLOSING);
 
 		if (state == GEDIT_TAB_STATE_NORMAL ||
-		    state == GEDIT_TAB_STATE_SHOWING_PRINT_PREVIEW ||
-		    state == GEDIT_TAB_STATE_GENERIC_NOT_EDITABLE)
+		    state == GEDIT_TAB_STATE_SHOWING_PRINT_PREVIEW)
 		{
 			if (_gedit_document_needs_saving (doc))
 			{
@@ -1342,6 +1313,8 @@ save_documents_list (GeditWindow *window,
 			   - GEDIT_TAB_STATE_GENERIC_ERROR: we do not save since the document contains
 			     errors (I don't think this is a very frequent case, we should probably remove
 			     this state)
+			   - GEDIT_TAB_STATE_GENERIC_NOT_EDITABLE: an operation like Replace All is
+			     modifying the document, it is only half done
 			   - GEDIT_TAB_STATE_LOADING_ERROR: there is nothing to save
 			   - GEDIT_TAB_STATE_REVERTING_ERROR: there is nothing to save and saving the current
 			     document will overwrite the copy of the file the user wants to go back to
@@ -1728,6 +1701,8 @@ save_and_close_documents (GList         *docs,
 		   - GEDIT_TAB_STATE_SAVING_ERROR: we do not close since the document contains errors
 		   - GEDIT_TAB_STATE_GENERIC_ERROR: we do not close since the document contains
 		     errors (CHECK: we should problably remove this state)
+		   - GEDIT_TAB_STATE_GENERIC_NOT_EDITABLE: we do not close since an operation
+		     like Replace All is modifying the document
 		   - [*] GEDIT_TAB_STATE_CLOSING: this state is invalid in this case
 		*/
 
@@ -1738,6 +1713,7 @@ save_and_close_documents (GList         *docs,
 
 		if (state != GEDIT_TAB_STATE_SAVING_ERROR &&
 		    state != GEDIT_TAB_STATE_GENERIC_ERROR &&
+		    state != GEDIT_TAB_STATE_GENERIC_NOT_EDITABLE &&
 		    state != GEDIT_TAB_STATE_REVERTING_ERROR)
 		{
 			if (g_list_index (docs, doc) >= 0 &&
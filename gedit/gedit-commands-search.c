@@ -34,6 +34,7 @@
 
 #include "gedit-debug.h"
 #include "gedit-statusbar.h"
+#include "gedit-tab.h"
 #include "gedit-view-frame.h"
 #include "gedit-window.h"
 #include "gedit-window-private.h"
@@ -42,6 +43,7 @@
 
 #define GEDIT_REPLACE_DIALOG_KEY	"gedit-replace-dialog-key"
 #define GEDIT_LAST_SEARCH_DATA_KEY	"gedit-last-search-data-key"
+#define GEDIT_REPLACE_ALL_DATA_KEY	"gedit-replace-all-data-key"
 
 typedef struct _LastSearchData LastSearchData;
 struct _LastSearchData
@@ -390,6 +392,7 @@ static void
 do_replace (GeditReplaceDialog *dialog,
 	    GeditWindow        *window)
 {
+	GeditTab *tab;
 	GeditDocument *doc;
 	GtkSourceSearchContext *search_context;
 	const gchar *replace_entry_text;
@@ -398,13 +401,14 @@ do_replace (GeditReplaceDialog *dialog,
 	GtkTextIter end;
 	GError *error = NULL;
 
-	doc = gedit_window_get_active_document (window);
+	tab = gedit_window_get_active_tab (window);
 
-	if (doc == NULL)
+	if (tab == NULL || gedit_tab_get_state (tab) != GEDIT_TAB_STATE_NORMAL)
 	{
 		return;
 	}
 
+	doc = gedit_tab_get_document (tab);
 	search_context = gedit_document_get_search_context (doc);
 
 	if (search_context == NULL)
@@ -438,24 +442,150 @@ do_replace (GeditReplaceDialog *dialog,
 	do_find (dialog, window);
 }
 
+/* Replace All is done by the tab in small slices of time, see
+ * gedit_tab_replace_all_async(). The dialog keeps the cancellable, to stop
+ * it.
+ */
+typedef struct _ReplaceAllData ReplaceAllData;
+struct _ReplaceAllData
+{
+	GeditWindow *window;
+
+	/* Weak pointer, the dialog can be destroyed before the end. */
+	GeditReplaceDialog *dialog;
+
+	GTimer *timer;
+};
+
+static void
+replace_all_data_free (ReplaceAllData *data)
+{
+	if (data->dialog != NULL)
+	{
+		g_object_remove_weak_pointer (G_OBJECT (data->dialog),
+					      (gpointer *) &data->dialog);
+	}
+
+	g_timer_destroy (data->timer);
+
+	g_slice_free (ReplaceAllData, data);
+}
+
+static void
+cancel_replace_all (GCancellable *cancellable)
+{
+	g_cancellable_cancel (cancellable);
+	g_object_unref (cancellable);
+}
+
+static void
+replace_all_progress_cb (gint            n_replaced,
+			 gdouble         fraction,
+			 ReplaceAllData *data)
+{
+	gchar *text;
+
+	if (data->dialog == NULL)
+	{
+		return;
+	}
+
+	text = g_strdup_printf (ngettext ("%d occurrence replaced",
+					  "%d occurrences replaced",
+					  n_replaced),
+				n_replaced);
+
+	gedit_replace_dialog_set_replace_all_progress (data->dialog, fraction, text);
+	g_free (text);
+}
+
+static void
+replace_all_cb (GeditTab       *tab,
+		GAsyncResult   *result,
+		ReplaceAllData *data)
+{
+	gint n_replaced = 0;
+	gdouble elapsed;
+	gchar *summary;
+	GError *error = NULL;
+
+	gedit_tab_replace_all_finish (tab, result, &n_replaced, &error);
+
+	elapsed = g_timer_elapsed (data->timer, NULL);
+
+	gedit_debug_message (DEBUG_COMMANDS,
+			     "Replaced %d occurrences in %f seconds",
+			     n_replaced,
+			     elapsed);
+
+	/* Stopped by the user, or the tab has been closed. */
+	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+	{
+		g_clear_error (&error);
+	}
+
+	if (data->dialog == NULL)
+	{
+		g_clear_error (&error);
+		replace_all_data_free (data);
+		return;
+	}
+
+	summary = g_strdup_printf (ngettext ("Replaced %d occurrence in %.1f s (%.0f/s)",
+					     "Replaced %d occurrences in %.1f s (%.0f/s)",
+					     n_replaced),
+				   n_replaced,
+				   elapsed,
+				   elapsed > 0.0 ? n_replaced / elapsed : 0.0);
+
+	gedit_replace_dialog_replace_all_finished (data->dialog, summary);
+	g_free (summary);
+
+	if (n_replaced > 0)
+	{
+		text_found (data->window, n_replaced);
+	}
+	else if (error == NULL)
+	{
+		text_not_found (data->window, data->dialog);
+	}
+
+	if (error != NULL)
+	{
+		gedit_replace_dialog_set_replace_error (data->dialog, error->message);
+		g_error_free (error);
+	}
+
+	g_object_set_data (G_OBJECT (data->dialog), GEDIT_REPLACE_ALL_DATA_KEY, NULL);
+
+	replace_all_data_free (data);
+}
+
 static void
 do_replace_all (GeditReplaceDialog *dialog,
 		GeditWindow        *window)
 {
+	GeditTab *tab;
 	GeditDocument *doc;
 	GtkSourceSearchContext *search_context;
 	const gchar *replace_entry_text;
 	gchar *unescaped_replace_text;
-	gint count;
-	GError *error = NULL;
+	GCancellable *cancellable;
+	ReplaceAllData *data;
 
-	doc = gedit_window_get_active_document (window);
+	if (g_object_get_data (G_OBJECT (dialog), GEDIT_REPLACE_ALL_DATA_KEY) != NULL)
+	{
+		return;
+	}
 
-	if (doc == NULL)
+	tab = gedit_window_get_active_tab (window);
+
+	if (tab == NULL)
 	{
 		return;
 	}
 
+	doc = gedit_tab_get_document (tab);
 	search_context = gedit_document_get_search_context (doc);
 
 	if (search_context == NULL)
@@ -469,26 +599,47 @@ do_replace_all (GeditReplaceDialog *dialog,
 
 	unescaped_replace_text = gtk_source_utils_unescape_search_text (replace_entry_text);
 
-	count = gtk_source_search_context_replace_all (search_context,
-						       unescaped_replace_text,
-						       -1,
-						       &error);
+	data = g_slice_new0 (ReplaceAllData);
+	data->window = window;
+	data->dialog = dialog;
+	data->timer = g_timer_new ();
+
+	g_object_add_weak_pointer (G_OBJECT (dialog), (gpointer *) &data->dialog);
+
+	cancellable = g_cancellable_new ();
+
+	/* Destroying the dialog stops Replace All. */
+	g_object_set_data_full (G_OBJECT (dialog),
+				GEDIT_REPLACE_ALL_DATA_KEY,
+				g_object_ref (cancellable),
+				(GDestroyNotify) cancel_replace_all);
+
+	replace_all_progress_cb (0, 0.0, data);
 
+	gedit_tab_replace_all_async (tab,
+				     search_context,
+				     unescaped_replace_text,
+				     cancellable,
+				     (GeditTabReplaceAllProgress) replace_all_progress_cb,
+				     data,
+				     (GAsyncReadyCallback) replace_all_cb,
+				     data);
+
+	g_object_unref (cancellable);
 	g_free (unescaped_replace_text);
+}
 
-	if (count > 0)
-	{
-		text_found (window, count);
-	}
-	else if (error == NULL)
-	{
-		text_not_found (window, dialog);
-	}
+static void
+stop_replace_all (GeditReplaceDialog *dialog)
+{
+	GCancellable *cancellable;
 
-	if (error != NULL)
+	cancellable = g_object_get_data (G_OBJECT (dialog), GEDIT_REPLACE_ALL_DATA_KEY);
+
+	/* replace_all_cb() updates the dialog. */
+	if (cancellable != NULL)
 	{
-		gedit_replace_dialog_set_replace_error (dialog, error->message);
-		g_error_free (error);
+		g_cancellable_cancel (cancellable);
 	}
 }
 
@@ -513,6 +664,10 @@ replace_dialog_response_cb (GeditReplaceDialog *dialog,
 			do_replace_all (dialog, window);
 			break;
 
+		case GEDIT_REPLACE_DIALOG_STOP_REPLACE_ALL_RESPONSE:
+			stop_replace_all (dialog);
+			break;
+
 		default:
 			last_search_data_store_position (dialog);
 			gtk_widget_hide (GTK_WIDGET (dialog));
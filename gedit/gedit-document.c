@@ -48,6 +48,10 @@ static void	gedit_document_loaded_real	(GeditDocument *doc);
 
 static void	gedit_document_saved_real	(GeditDocument *doc);
 
+static void	start_monitoring		(GeditDocument *doc);
+
+static void	stop_monitoring			(GeditDocument *doc);
+
 struct _GeditDocumentPrivate
 {
 	GtkSourceFile *file;
@@ -59,11 +63,32 @@ struct _GeditDocumentPrivate
 
 	GFileInfo   *metadata_info;
 
+	/* The metadata are queried asynchronously when the location changes.
+	 * The tasks of _gedit_document_wait_metadata_async() are completed
+	 * when the query finishes. The metadata set in the meantime are kept
+	 * in metadata_overrides (key -> value, NULL to unset), and applied on
+	 * top of the query result.
+	 */
+	struct _MetadataQuery *metadata_query;
+	GHashTable  *metadata_overrides;
+	GList       *metadata_tasks;
+
 	gchar	    *content_type;
 
 	GTimeVal     mtime;
 	GTimeVal     time_of_last_save_or_load;
 
+	/* Watches the file on disk, to keep the externally modified, deleted
+	 * and read-only states up to date in the background.
+	 */
+	GFileMonitor *monitor;
+	GCancellable *check_cancellable;
+
+	/* The tasks of _gedit_document_check_externally_modified_async()
+	 * waiting for the check in progress.
+	 */
+	GList        *check_tasks;
+
 	/* The search context for the incremental search, or the search and
 	 * replace. They are mutually exclusive.
 	 */
@@ -85,6 +110,17 @@ struct _GeditDocumentPrivate
 	 * when opened from the command line).
 	 */
 	guint create : 1;
+
+	guint check_in_progress : 1;
+	guint check_again : 1;
+
+	/* The buffer only contains a part of the file (the huge file mode of
+	 * the tab). It can't be saved, and the cursor position in the buffer
+	 * is not a position in the file.
+	 */
+	guint partial : 1;
+
+	guint metadata_loaded : 1;
 };
 
 enum
@@ -111,6 +147,34 @@ static guint document_signals[LAST_SIGNAL] = { 0 };
 
 static GHashTable *allocated_untitled_numbers = NULL;
 
+#ifdef ENABLE_GVFS_METADATA
+/* The metadata queries of all the documents go through an application-wide
+ * queue. The queries for the same location are coalesced, and they are
+ * started from an idle with a bounded number in flight, so that opening many
+ * files at once doesn't flood the gvfs metadata daemon.
+ */
+#define MAX_RUNNING_METADATA_QUERIES 4
+
+typedef struct _MetadataQuery MetadataQuery;
+
+struct _MetadataQuery
+{
+	GFile *location;
+
+	/* The documents waiting for the result, with a reference. */
+	GSList *docs;
+};
+
+/* Pending queries, in FIFO order. */
+static GQueue metadata_queries = G_QUEUE_INIT;
+
+/* GFile -> MetadataQuery, for the pending queries only. */
+static GHashTable *metadata_queries_by_location = NULL;
+
+static guint n_running_metadata_queries = 0;
+static guint metadata_queries_idle_id = 0;
+#endif
+
 G_DEFINE_TYPE_WITH_PRIVATE (GeditDocument, gedit_document, GTK_SOURCE_TYPE_BUFFER)
 
 static gint
@@ -166,6 +230,18 @@ save_metadata (GeditDocument *doc)
 		language = get_language_string (doc);
 	}
 
+	if (doc->priv->partial)
+	{
+		if (language != NULL)
+		{
+			gedit_document_set_metadata (doc,
+						     GEDIT_METADATA_ATTRIBUTE_LANGUAGE, language,
+						     NULL);
+		}
+
+		return;
+	}
+
 	gtk_text_buffer_get_iter_at_mark (GTK_TEXT_BUFFER (doc),
 					  &iter,
 					  gtk_text_buffer_get_insert (GTK_TEXT_BUFFER (doc)));
@@ -189,6 +265,72 @@ save_metadata (GeditDocument *doc)
 	g_free (position);
 }
 
+/* Completes a task of _gedit_document_wait_metadata_async(). The task data is
+ * the id of the handler connected to its cancellable. The handler holds its
+ * own reference on the task, released when it is disconnected.
+ */
+static void
+return_metadata_task (GTask *task)
+{
+	gulong handler_id;
+
+	handler_id = GPOINTER_TO_SIZE (g_task_get_task_data (task));
+
+	if (handler_id != 0)
+	{
+		g_cancellable_disconnect (g_task_get_cancellable (task), handler_id);
+	}
+
+	/* Returns a G_IO_ERROR_CANCELLED error if the task was cancelled. */
+	g_task_return_boolean (task, TRUE);
+	g_object_unref (task);
+}
+
+static gboolean
+disconnect_metadata_task_idle_cb (GTask *task)
+{
+	gulong handler_id;
+
+	handler_id = GPOINTER_TO_SIZE (g_task_get_task_data (task));
+
+	if (handler_id != 0)
+	{
+		g_cancellable_disconnect (g_task_get_cancellable (task), handler_id);
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+metadata_task_cancelled_cb (GCancellable *cancellable,
+			    GTask        *task)
+{
+	GeditDocument *doc = g_task_get_source_object (task);
+	GList *link;
+
+	link = g_list_find (doc->priv->metadata_tasks, task);
+
+	if (link == NULL)
+	{
+		return;
+	}
+
+	doc->priv->metadata_tasks = g_list_delete_link (doc->priv->metadata_tasks, link);
+
+	g_task_return_error_if_cancelled (task);
+	g_object_unref (task);
+
+	/* The handler can't be disconnected from the signal emission. Until
+	 * it is, its reference keeps the task valid if the cancellable is
+	 * reset and cancelled again, and the task keeps the cancellable and
+	 * the document alive.
+	 */
+	g_idle_add_full (G_PRIORITY_DEFAULT,
+			 (GSourceFunc) disconnect_metadata_task_idle_cb,
+			 g_object_ref (task),
+			 g_object_unref);
+}
+
 static void
 gedit_document_dispose (GObject *object)
 {
@@ -199,6 +341,8 @@ gedit_document_dispose (GObject *object)
 	/* Metadata must be saved here and not in finalize because the language
 	 * is gone by the time finalize runs.
 	 */
+	stop_monitoring (doc);
+
 	if (doc->priv->file != NULL)
 	{
 		save_metadata (doc);
@@ -211,6 +355,25 @@ gedit_document_dispose (GObject *object)
 	g_clear_object (&doc->priv->metadata_info);
 	g_clear_object (&doc->priv->search_context);
 
+	if (doc->priv->metadata_overrides != NULL)
+	{
+		g_hash_table_destroy (doc->priv->metadata_overrides);
+		doc->priv->metadata_overrides = NULL;
+	}
+
+	/* The tasks hold a reference on the document, so there are waiters
+	 * here only if the document is explicitly disposed. Nothing would
+	 * complete them afterwards.
+	 */
+	while (doc->priv->metadata_tasks != NULL)
+	{
+		GTask *task = doc->priv->metadata_tasks->data;
+
+		doc->priv->metadata_tasks = g_list_delete_link (doc->priv->metadata_tasks,
+								doc->priv->metadata_tasks);
+		return_metadata_task (task);
+	}
+
 	G_OBJECT_CLASS (gedit_document_parent_class)->dispose (object);
 }
 
@@ -662,6 +825,262 @@ get_default_content_type (void)
 	return g_content_type_from_mime_type ("text/plain");
 }
 
+#ifdef ENABLE_GVFS_METADATA
+static void
+complete_metadata_tasks (GeditDocument *doc)
+{
+	GList *tasks;
+	GList *l;
+
+	doc->priv->metadata_loaded = TRUE;
+
+	tasks = doc->priv->metadata_tasks;
+	doc->priv->metadata_tasks = NULL;
+
+	for (l = tasks; l != NULL; l = l->next)
+	{
+		return_metadata_task (l->data);
+	}
+
+	g_list_free (tasks);
+}
+
+static void
+apply_metadata_overrides (GeditDocument *doc)
+{
+	GHashTableIter iter;
+	gpointer key;
+	gpointer value;
+
+	if (doc->priv->metadata_overrides == NULL)
+	{
+		return;
+	}
+
+	if (doc->priv->metadata_info == NULL)
+	{
+		doc->priv->metadata_info = g_file_info_new ();
+	}
+
+	g_hash_table_iter_init (&iter, doc->priv->metadata_overrides);
+
+	while (g_hash_table_iter_next (&iter, &key, &value))
+	{
+		if (value != NULL)
+		{
+			g_file_info_set_attribute_string (doc->priv->metadata_info, key, value);
+		}
+		else
+		{
+			g_file_info_remove_attribute (doc->priv->metadata_info, key);
+		}
+	}
+
+	g_hash_table_destroy (doc->priv->metadata_overrides);
+	doc->priv->metadata_overrides = NULL;
+}
+
+static void
+set_metadata_info (GeditDocument *doc,
+		   GFileInfo     *info)
+{
+	doc->priv->metadata_query = NULL;
+
+	g_clear_object (&doc->priv->metadata_info);
+
+	if (info != NULL)
+	{
+		doc->priv->metadata_info = g_file_info_dup (info);
+	}
+
+	apply_metadata_overrides (doc);
+	complete_metadata_tasks (doc);
+
+	/* The language may have been guessed before the metadata arrived. */
+	if (!doc->priv->language_set_by_user &&
+	    doc->priv->metadata_info != NULL &&
+	    g_file_info_has_attribute (doc->priv->metadata_info,
+				       GEDIT_METADATA_ATTRIBUTE_LANGUAGE))
+	{
+		set_language (doc, guess_language (doc), FALSE);
+	}
+}
+
+static void
+metadata_query_free (MetadataQuery *query)
+{
+	g_object_unref (query->location);
+	g_slist_free (query->docs);
+	g_slice_free (MetadataQuery, query);
+}
+
+static void schedule_metadata_queries (void);
+
+static void
+metadata_query_cb (GFile         *location,
+		   GAsyncResult  *result,
+		   MetadataQuery *query)
+{
+	GFileInfo *info;
+	GSList *l;
+	GError *error = NULL;
+
+	info = g_file_query_info_finish (location, result, &error);
+
+	if (error != NULL)
+	{
+		/* Do not complain about metadata if we are opening a non
+		 * existing file.
+		 */
+		if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_ISDIR) &&
+		    !g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOTDIR) &&
+		    !g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT) &&
+		    !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+		{
+			g_warning ("%s", error->message);
+		}
+
+		g_error_free (error);
+	}
+
+	n_running_metadata_queries--;
+
+	for (l = query->docs; l != NULL; l = l->next)
+	{
+		GeditDocument *doc = l->data;
+
+		set_metadata_info (doc, info);
+
+		/* Async operation finished. */
+		g_object_unref (doc);
+	}
+
+	if (info != NULL)
+	{
+		g_object_unref (info);
+	}
+
+	metadata_query_free (query);
+
+	schedule_metadata_queries ();
+}
+
+static gboolean
+metadata_queries_idle_cb (gpointer user_data)
+{
+	metadata_queries_idle_id = 0;
+
+	while (n_running_metadata_queries < MAX_RUNNING_METADATA_QUERIES &&
+	       !g_queue_is_empty (&metadata_queries))
+	{
+		MetadataQuery *query = g_queue_pop_head (&metadata_queries);
+
+		/* From now on, a new request for the same location gets a new
+		 * query, so that it sees the metadata written in the meantime.
+		 */
+		g_hash_table_remove (metadata_queries_by_location, query->location);
+
+		/* All the documents changed their location in the meantime. */
+		if (query->docs == NULL)
+		{
+			metadata_query_free (query);
+			continue;
+		}
+
+		gedit_debug_message (DEBUG_DOCUMENT,
+				     "Querying metadata for %u documents",
+				     g_slist_length (query->docs));
+
+		n_running_metadata_queries++;
+
+		g_file_query_info_async (query->location,
+					 METADATA_QUERY,
+					 G_FILE_QUERY_INFO_NONE,
+					 G_PRIORITY_DEFAULT,
+					 NULL,
+					 (GAsyncReadyCallback) metadata_query_cb,
+					 query);
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+schedule_metadata_queries (void)
+{
+	if (metadata_queries_idle_id == 0 &&
+	    n_running_metadata_queries < MAX_RUNNING_METADATA_QUERIES &&
+	    !g_queue_is_empty (&metadata_queries))
+	{
+		metadata_queries_idle_id = g_idle_add (metadata_queries_idle_cb, NULL);
+	}
+}
+
+static void
+cancel_metadata_request (GeditDocument *doc)
+{
+	MetadataQuery *query = doc->priv->metadata_query;
+
+	if (query == NULL)
+	{
+		return;
+	}
+
+	/* The query itself can be shared, it is just not reported to @doc. */
+	doc->priv->metadata_query = NULL;
+	query->docs = g_slist_remove (query->docs, doc);
+	g_object_unref (doc);
+}
+
+static void
+request_metadata (GeditDocument *doc,
+		  GFile         *location)
+{
+	MetadataQuery *query;
+
+	cancel_metadata_request (doc);
+
+	if (location == NULL)
+	{
+		complete_metadata_tasks (doc);
+		return;
+	}
+
+	g_clear_object (&doc->priv->metadata_info);
+
+	if (doc->priv->metadata_overrides != NULL)
+	{
+		g_hash_table_destroy (doc->priv->metadata_overrides);
+		doc->priv->metadata_overrides = NULL;
+	}
+
+	doc->priv->metadata_loaded = FALSE;
+
+	if (metadata_queries_by_location == NULL)
+	{
+		metadata_queries_by_location = g_hash_table_new (g_file_hash,
+								 (GEqualFunc) g_file_equal);
+	}
+
+	query = g_hash_table_lookup (metadata_queries_by_location, location);
+
+	if (query == NULL)
+	{
+		query = g_slice_new0 (MetadataQuery);
+		query->location = g_object_ref (location);
+
+		g_queue_push_tail (&metadata_queries, query);
+		g_hash_table_insert (metadata_queries_by_location, query->location, query);
+	}
+
+	/* Keep the document alive until the query finishes. */
+	query->docs = g_slist_prepend (query->docs, g_object_ref (doc));
+	doc->priv->metadata_query = query;
+
+	schedule_metadata_queries ();
+}
+#endif
+
 static void
 on_location_changed (GtkSourceFile *file,
 		     GParamSpec    *pspec,
@@ -673,6 +1092,9 @@ on_location_changed (GtkSourceFile *file,
 
 	location = gtk_source_file_get_location (file);
 
+	/* The monitor is restarted when the document is loaded or saved. */
+	stop_monitoring (doc);
+
 	if (location != NULL &&
 	    doc->priv->untitled_number > 0)
 	{
@@ -686,42 +1108,7 @@ on_location_changed (GtkSourceFile *file,
 	}
 
 #ifdef ENABLE_GVFS_METADATA
-
-	/* load metadata for this location: we load sync since metadata is
-	 * always local so it should be fast and we need the information
-	 * right after the location was set.
-	 */
-	if (location != NULL)
-	{
-		GError *error = NULL;
-
-		if (doc->priv->metadata_info != NULL)
-		{
-			g_object_unref (doc->priv->metadata_info);
-		}
-
-		doc->priv->metadata_info = g_file_query_info (location,
-							      METADATA_QUERY,
-							      G_FILE_QUERY_INFO_NONE,
-							      NULL,
-							      &error);
-
-		if (error != NULL)
-		{
-			/* Do not complain about metadata if we are opening a
-			 * non existing file.
-			 */
-			if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_ISDIR) &&
-			    !g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOTDIR) &&
-			    !g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT) &&
-			    !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
-			{
-				g_warning ("%s", error->message);
-			}
-
-			g_error_free (error);
-		}
-	}
+	request_metadata (doc, location);
 #endif
 }
 
@@ -748,6 +1135,8 @@ gedit_document_init (GeditDocument *doc)
 
 	priv->empty_search = TRUE;
 
+	priv->metadata_loaded = TRUE;
+
 	g_get_current_time (&doc->priv->time_of_last_save_or_load);
 
 	priv->file = gtk_source_file_new ();
@@ -1116,6 +1505,8 @@ loaded_query_info_cb (GFile         *location,
 		g_object_unref (info);
 	}
 
+	start_monitoring (doc);
+
 	/* Async operation finished. */
 	g_object_unref (doc);
 }
@@ -1218,6 +1609,8 @@ saved_query_info_cb (GFile         *location,
 
 	save_encoding_metadata (doc);
 
+	start_monitoring (doc);
+
 	/* Async operation finished. */
 	g_object_unref (doc);
 }
@@ -1277,12 +1670,62 @@ gedit_document_is_local (GeditDocument *doc)
 	return g_file_has_uri_scheme (location, "file");
 }
 
+/* @info is %NULL if the file doesn't exist anymore. */
+static void
+update_file_on_disk_state (GeditDocument *doc,
+			   GFileInfo     *info)
+{
+	if (info == NULL)
+	{
+		doc->priv->deleted = TRUE;
+		return;
+	}
+
+	/* The file can be deleted for a short time while it is saved by
+	 * another program, e.g. by writing a new file and renaming it.
+	 */
+	doc->priv->deleted = FALSE;
+
+	/* While at it also check if permissions changed */
+	if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_ACCESS_CAN_WRITE))
+	{
+		gboolean read_only;
+
+		read_only = !g_file_info_get_attribute_boolean (info, G_FILE_ATTRIBUTE_ACCESS_CAN_WRITE);
+
+		set_readonly (doc, read_only);
+	}
+
+	if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) &&
+	    doc->priv->mtime_set)
+	{
+		GTimeVal timeval;
+
+		g_file_info_get_modification_time (info, &timeval);
+
+		/* Note that mtime can even go backwards if the
+		 * user is copying over a file with an old mtime
+		 */
+		if (timeval.tv_sec != doc->priv->mtime.tv_sec ||
+		    timeval.tv_usec != doc->priv->mtime.tv_usec)
+		{
+			doc->priv->externally_modified = TRUE;
+		}
+	}
+}
+
 static void
 check_file_on_disk (GeditDocument *doc)
 {
 	GFile *location;
 	GFileInfo *info;
 
+	/* The state is kept up to date by the file monitor. */
+	if (doc->priv->monitor != NULL)
+	{
+		return;
+	}
+
 	location = gtk_source_file_get_location (doc->priv->file);
 
 	if (location == NULL)
@@ -1296,54 +1739,237 @@ check_file_on_disk (GeditDocument *doc)
 				  G_FILE_QUERY_INFO_NONE,
 				  NULL, NULL);
 
+	update_file_on_disk_state (doc, info);
+
 	if (info != NULL)
 	{
-		/* While at it also check if permissions changed */
-		if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_ACCESS_CAN_WRITE))
-		{
-			gboolean read_only;
+		g_object_unref (info);
+	}
+}
 
-			read_only = !g_file_info_get_attribute_boolean (info, G_FILE_ATTRIBUTE_ACCESS_CAN_WRITE);
+static void check_file_on_disk_async (GeditDocument *doc);
 
-			set_readonly (doc, read_only);
-		}
+static void
+complete_check_tasks (GeditDocument *doc)
+{
+	GList *tasks;
+	GList *l;
 
-		if (g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) &&
-		    doc->priv->mtime_set)
-		{
-			GTimeVal timeval;
+	tasks = doc->priv->check_tasks;
+	doc->priv->check_tasks = NULL;
 
-			g_file_info_get_modification_time (info, &timeval);
+	for (l = tasks; l != NULL; l = l->next)
+	{
+		GTask *task = l->data;
 
-			/* Note that mtime can even go backwards if the
-			 * user is copying over a file with an old mtime
-			 */
-			if (timeval.tv_sec != doc->priv->mtime.tv_sec ||
-			    timeval.tv_usec != doc->priv->mtime.tv_usec)
-			{
-				doc->priv->externally_modified = TRUE;
-			}
-		}
+		g_task_return_boolean (task, doc->priv->externally_modified);
+		g_object_unref (task);
+	}
 
-		g_object_unref (info);
+	g_list_free (tasks);
+}
+
+static void
+check_query_info_cb (GFile         *location,
+		     GAsyncResult  *result,
+		     GeditDocument *doc)
+{
+	GFileInfo *info;
+	GError *error = NULL;
+
+	info = g_file_query_info_finish (location, result, &error);
+
+	/* The monitoring has been stopped in the meantime. */
+	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED) ||
+	    doc->priv->file == NULL ||
+	    location != gtk_source_file_get_location (doc->priv->file))
+	{
+		goto out;
+	}
+
+	doc->priv->check_in_progress = FALSE;
+
+	if (error == NULL ||
+	    g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+	{
+		update_file_on_disk_state (doc, info);
 	}
 	else
 	{
-		doc->priv->deleted = TRUE;
+		gedit_debug_message (DEBUG_DOCUMENT, "Query info error: %s", error->message);
+	}
+
+	if (doc->priv->check_again)
+	{
+		doc->priv->check_again = FALSE;
+		check_file_on_disk_async (doc);
+	}
+	else
+	{
+		complete_check_tasks (doc);
 	}
+
+out:
+	g_clear_object (&info);
+	g_clear_error (&error);
+
+	/* Async operation finished. */
+	g_object_unref (doc);
 }
 
-gboolean
-_gedit_document_check_externally_modified (GeditDocument *doc)
+static void
+check_file_on_disk_async (GeditDocument *doc)
 {
-	g_return_val_if_fail (GEDIT_IS_DOCUMENT (doc), FALSE);
+	GFile *location;
+
+	location = gtk_source_file_get_location (doc->priv->file);
 
-	if (!doc->priv->externally_modified)
+	if (location == NULL)
 	{
-		check_file_on_disk (doc);
+		return;
+	}
+
+	/* Coalesce the bursts of events received while a file is written. */
+	if (doc->priv->check_in_progress)
+	{
+		doc->priv->check_again = TRUE;
+		return;
+	}
+
+	if (doc->priv->check_cancellable == NULL)
+	{
+		doc->priv->check_cancellable = g_cancellable_new ();
+	}
+
+	doc->priv->check_in_progress = TRUE;
+
+	/* Keep the doc alive during the async operation. */
+	g_object_ref (doc);
+
+	g_file_query_info_async (location,
+				 G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+				 G_FILE_ATTRIBUTE_ACCESS_CAN_WRITE,
+				 G_FILE_QUERY_INFO_NONE,
+				 G_PRIORITY_DEFAULT,
+				 doc->priv->check_cancellable,
+				 (GAsyncReadyCallback) check_query_info_cb,
+				 doc);
+}
+
+static void
+file_changed_cb (GFileMonitor      *monitor,
+		 GFile             *file,
+		 GFile             *other_file,
+		 GFileMonitorEvent  event_type,
+		 GeditDocument     *doc)
+{
+	if (event_type == G_FILE_MONITOR_EVENT_PRE_UNMOUNT ||
+	    event_type == G_FILE_MONITOR_EVENT_UNMOUNTED)
+	{
+		return;
+	}
+
+	check_file_on_disk_async (doc);
+}
+
+static void
+stop_monitoring (GeditDocument *doc)
+{
+	if (doc->priv->monitor != NULL)
+	{
+		g_signal_handlers_disconnect_by_func (doc->priv->monitor,
+						      file_changed_cb,
+						      doc);
+
+		g_file_monitor_cancel (doc->priv->monitor);
+		g_clear_object (&doc->priv->monitor);
+	}
+
+	if (doc->priv->check_cancellable != NULL)
+	{
+		g_cancellable_cancel (doc->priv->check_cancellable);
+		g_clear_object (&doc->priv->check_cancellable);
+	}
+
+	doc->priv->check_in_progress = FALSE;
+	doc->priv->check_again = FALSE;
+
+	/* With the state known so far. */
+	complete_check_tasks (doc);
+}
+
+/* Only local files are monitored, like the checks done on focus-in. */
+static void
+start_monitoring (GeditDocument *doc)
+{
+	GFile *location;
+	GError *error = NULL;
+
+	stop_monitoring (doc);
+
+	if (!gedit_document_is_local (doc))
+	{
+		return;
+	}
+
+	location = gtk_source_file_get_location (doc->priv->file);
+
+	doc->priv->monitor = g_file_monitor_file (location,
+						  G_FILE_MONITOR_NONE,
+						  NULL,
+						  &error);
+
+	if (error != NULL)
+	{
+		gedit_debug_message (DEBUG_DOCUMENT, "File monitor error: %s", error->message);
+		g_error_free (error);
+		return;
 	}
 
-	return doc->priv->externally_modified;
+	g_signal_connect (doc->priv->monitor,
+			  "changed",
+			  G_CALLBACK (file_changed_cb),
+			  doc);
+}
+
+/*
+ * _gedit_document_check_externally_modified_async:
+ *
+ * Finishes at once if the file is monitored, its state is then up to date.
+ * Otherwise the file is checked in the background.
+ */
+void
+_gedit_document_check_externally_modified_async (GeditDocument       *doc,
+						 GAsyncReadyCallback  callback,
+						 gpointer             user_data)
+{
+	GTask *task;
+
+	g_return_if_fail (GEDIT_IS_DOCUMENT (doc));
+
+	task = g_task_new (doc, NULL, callback, user_data);
+
+	if (doc->priv->externally_modified ||
+	    doc->priv->monitor != NULL ||
+	    gtk_source_file_get_location (doc->priv->file) == NULL)
+	{
+		g_task_return_boolean (task, doc->priv->externally_modified);
+		g_object_unref (task);
+		return;
+	}
+
+	doc->priv->check_tasks = g_list_append (doc->priv->check_tasks, task);
+
+	check_file_on_disk_async (doc);
+}
+
+gboolean
+_gedit_document_check_externally_modified_finish (GeditDocument *doc,
+						  GAsyncResult  *result)
+{
+	g_return_val_if_fail (g_task_is_valid (result, doc), FALSE);
+
+	return g_task_propagate_boolean (G_TASK (result), NULL);
 }
 
 gboolean
@@ -1367,6 +1993,12 @@ _gedit_document_needs_saving (GeditDocument *doc)
 {
 	g_return_val_if_fail (GEDIT_IS_DOCUMENT (doc), FALSE);
 
+	/* Saving would truncate the file to the part in the buffer. */
+	if (doc->priv->partial)
+	{
+		return FALSE;
+	}
+
 	if (gtk_text_buffer_get_modified (GTK_TEXT_BUFFER (doc)))
 	{
 		return TRUE;
@@ -1607,9 +2239,17 @@ gchar *
 gedit_document_get_metadata (GeditDocument *doc,
 			     const gchar   *key)
 {
+	gpointer value;
+
 	g_return_val_if_fail (GEDIT_IS_DOCUMENT (doc), NULL);
 	g_return_val_if_fail (key != NULL, NULL);
 
+	if (doc->priv->metadata_overrides != NULL &&
+	    g_hash_table_lookup_extended (doc->priv->metadata_overrides, key, NULL, &value))
+	{
+		return g_strdup (value);
+	}
+
 	if (doc->priv->metadata_info != NULL &&
 	    g_file_info_has_attribute (doc->priv->metadata_info, key))
 	{
@@ -1650,6 +2290,22 @@ gedit_document_set_metadata (GeditDocument *doc,
 	{
 		value = va_arg (var_args, const gchar *);
 
+		/* The query result would not contain it yet. */
+		if (doc->priv->metadata_query != NULL)
+		{
+			if (doc->priv->metadata_overrides == NULL)
+			{
+				doc->priv->metadata_overrides = g_hash_table_new_full (g_str_hash,
+										       g_str_equal,
+										       g_free,
+										       g_free);
+			}
+
+			g_hash_table_replace (doc->priv->metadata_overrides,
+					      g_strdup (key),
+					      g_strdup (value));
+		}
+
 		if (value != NULL)
 		{
 			g_file_info_set_attribute_string (info, key, value);
@@ -1876,4 +2532,90 @@ _gedit_document_get_create (GeditDocument *doc)
 	return doc->priv->create;
 }
 
+void
+_gedit_document_set_partial (GeditDocument *doc,
+			     gboolean       partial)
+{
+	g_return_if_fail (GEDIT_IS_DOCUMENT (doc));
+
+	doc->priv->partial = partial != FALSE;
+}
+
+gboolean
+_gedit_document_get_partial (GeditDocument *doc)
+{
+	g_return_val_if_fail (GEDIT_IS_DOCUMENT (doc), FALSE);
+
+	return doc->priv->partial;
+}
+
+/*
+ * _gedit_document_wait_metadata_async:
+ *
+ * The metadata of a new location are queried asynchronously. Until the query
+ * finishes, gedit_document_get_metadata() returns %NULL, i.e. the callers fall
+ * back to their defaults. The consumers that need the stored values, like the
+ * encoding and the cursor position when loading, wait with this function.
+ * If @cancellable is cancelled, the wait finishes with a %G_IO_ERROR_CANCELLED
+ * error.
+ */
+void
+_gedit_document_wait_metadata_async (GeditDocument       *doc,
+				     GCancellable        *cancellable,
+				     GAsyncReadyCallback  callback,
+				     gpointer             user_data)
+{
+	GTask *task;
+
+	g_return_if_fail (GEDIT_IS_DOCUMENT (doc));
+	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+	task = g_task_new (doc, cancellable, callback, user_data);
+	g_task_set_check_cancellable (task, TRUE);
+
+	if (doc->priv->metadata_loaded)
+	{
+		g_task_return_boolean (task, TRUE);
+		g_object_unref (task);
+		return;
+	}
+
+	if (g_task_return_error_if_cancelled (task))
+	{
+		g_object_unref (task);
+		return;
+	}
+
+	doc->priv->metadata_tasks = g_list_append (doc->priv->metadata_tasks, task);
+
+	if (cancellable != NULL)
+	{
+		gulong handler_id;
+
+		handler_id = g_cancellable_connect (cancellable,
+						    G_CALLBACK (metadata_task_cancelled_cb),
+						    g_object_ref (task),
+						    g_object_unref);
+
+		/* 0 if the cancellable was cancelled in the meantime, in which
+		 * case the task is already completed and the reference of the
+		 * handler already released.
+		 */
+		if (handler_id != 0)
+		{
+			g_task_set_task_data (task, GSIZE_TO_POINTER (handler_id), NULL);
+		}
+	}
+}
+
+gboolean
+_gedit_document_wait_metadata_finish (GeditDocument  *doc,
+				      GAsyncResult   *result,
+				      GError        **error)
+{
+	g_return_val_if_fail (g_task_is_valid (result, doc), FALSE);
+
+	return g_task_propagate_boolean (G_TASK (result), error);
+}
+
 /* ex:set ts=8 noet: */
@@ -158,9 +158,14 @@ GtkSourceSearchContext *
 glong		 _gedit_document_get_seconds_since_last_save_or_load
 						(GeditDocument       *doc);
 
-/* Note: this is a sync stat: use only on local files */
-gboolean	 _gedit_document_check_externally_modified
-						(GeditDocument       *doc);
+void		 _gedit_document_check_externally_modified_async
+						(GeditDocument       *doc,
+						 GAsyncReadyCallback  callback,
+						 gpointer             user_data);
+
+gboolean	 _gedit_document_check_externally_modified_finish
+						(GeditDocument       *doc,
+						 GAsyncResult        *result);
 
 gboolean	 _gedit_document_needs_saving	(GeditDocument       *doc);
 
@@ -172,6 +177,22 @@ void		 _gedit_document_set_create	(GeditDocument       *doc,
 
 gboolean	 _gedit_document_get_create	(GeditDocument       *doc);
 
+void		 _gedit_document_set_partial	(GeditDocument       *doc,
+						 gboolean             partial);
+
+gboolean	 _gedit_document_get_partial	(GeditDocument       *doc);
+
+void		 _gedit_document_wait_metadata_async
+						(GeditDocument       *doc,
+						 GCancellable        *cancellable,
+						 GAsyncReadyCallback  callback,
+						 gpointer             user_data);
+
+gboolean	 _gedit_document_wait_metadata_finish
+						(GeditDocument       *doc,
+						 GAsyncResult        *result,
+						 GError             **error);
+
 G_END_DECLS
 
 #endif /* __GEDIT_DOCUMENT_H__ */
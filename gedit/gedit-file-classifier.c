@@ -0,0 +1,297 @@
+/*
+ * gedit-file-classifier.c
+ * This file is part of gedit
+ *
+ * Copyright (C) 2015 - The gedit Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gedit-file-classifier.h"
+
+#include <string.h>
+
+#include "gedit-debug.h"
+
+/* The beginning of a file is classified before loading it when another
+ * encoding than UTF-8 would be tried first. The file loader accepts the first
+ * candidate encoding that converts the file without errors, and most 8-bit
+ * encodings convert anything: a valid UTF-8 file would be loaded as garbage.
+ *
+ * The bytes are scanned one machine word at a time. A word without any byte
+ * having the high bit set or a NUL byte is skipped at once, the other words
+ * are examined byte per byte.
+ */
+
+/* Number of bytes read at the beginning of the file. */
+#define CLASSIFY_MAX_BYTES (1024 * 1024)
+
+#define ONES		((gsize) -1 / 0xFF)
+#define HIGH_BITS	(ONES * 0x80)
+
+/* Whether one of the bytes of @word is zero. */
+#define HAS_ZERO_BYTE(word)	((((word) - ONES) & ~(word) & HIGH_BITS) != 0)
+
+static gboolean
+is_plain_word (gsize word)
+{
+	return (word & HIGH_BITS) == 0 && !HAS_ZERO_BYTE (word);
+}
+
+/* Returns @length without the last character if it is truncated. */
+static gsize
+trim_truncated_char (const gchar *data,
+		     gsize        length)
+{
+	gsize i;
+
+	for (i = 1; i <= 3 && i <= length; i++)
+	{
+		guchar c = data[length - i];
+		gsize char_length;
+
+		/* Continuation byte. */
+		if ((c & 0xC0) == 0x80)
+		{
+			continue;
+		}
+
+		if (c >= 0xF0)
+		{
+			char_length = 4;
+		}
+		else if (c >= 0xE0)
+		{
+			char_length = 3;
+		}
+		else if (c >= 0xC0)
+		{
+			char_length = 2;
+		}
+		else
+		{
+			char_length = 1;
+		}
+
+		return char_length > i ? length - i : length;
+	}
+
+	return length;
+}
+
+/*
+ * _gedit_file_classify_buffer:
+ * @data: the beginning of a file.
+ * @length: the length of @data.
+ * @complete: whether @data is the whole file.
+ * @classification: (out): the result.
+ *
+ * If @complete is %FALSE, a multi-byte character truncated at the end of @data
+ * doesn't make it invalid UTF-8.
+ */
+void
+_gedit_file_classify_buffer (const gchar             *data,
+			     gsize                    length,
+			     gboolean                 complete,
+			     GeditFileClassification *classification)
+{
+	const gchar *p = data;
+	const gchar *end = data + length;
+	const gchar *first_non_ascii = NULL;
+	gboolean has_nul = FALSE;
+
+	g_return_if_fail (data != NULL || length == 0);
+	g_return_if_fail (classification != NULL);
+
+	memset (classification, 0, sizeof (GeditFileClassification));
+	classification->n_bytes = length;
+	classification->complete = complete != FALSE;
+
+	while (p < end)
+	{
+		guchar c;
+
+		while ((gsize) (end - p) >= sizeof (gsize))
+		{
+			gsize word;
+
+			memcpy (&word, p, sizeof (gsize));
+
+			if (!is_plain_word (word))
+			{
+				break;
+			}
+
+			p += sizeof (gsize);
+		}
+
+		if (p == end)
+		{
+			break;
+		}
+
+		c = *p;
+
+		if (c == '\0')
+		{
+			has_nul = TRUE;
+			break;
+		}
+		else if (c >= 0x80 && first_non_ascii == NULL)
+		{
+			first_non_ascii = p;
+		}
+
+		p++;
+	}
+
+	/* GtkTextBuffer doesn't accept NUL bytes, and they are common in
+	 * UTF-16 files.
+	 */
+	if (has_nul)
+	{
+		classification->file_class = GEDIT_FILE_CLASS_NEEDS_TRIAL;
+	}
+	else if (first_non_ascii == NULL)
+	{
+		classification->file_class = GEDIT_FILE_CLASS_ASCII;
+	}
+	else
+	{
+		gsize remaining = end - first_non_ascii;
+
+		if (!complete)
+		{
+			remaining = trim_truncated_char (first_non_ascii, remaining);
+		}
+
+		if (g_utf8_validate (first_non_ascii, remaining, NULL))
+		{
+			classification->file_class = GEDIT_FILE_CLASS_UTF8;
+		}
+		else
+		{
+			classification->file_class = GEDIT_FILE_CLASS_NEEDS_TRIAL;
+		}
+	}
+}
+
+static void
+classify_thread (GTask        *task,
+		 gpointer      source_object,
+		 gpointer      task_data,
+		 GCancellable *cancellable)
+{
+	GFile *location = source_object;
+	GFileInputStream *stream;
+	GeditFileClassification *classification;
+	gchar *buffer;
+	gsize n_bytes_read = 0;
+	GError *error = NULL;
+
+	stream = g_file_read (location, cancellable, &error);
+
+	if (stream == NULL)
+	{
+		g_task_return_error (task, error);
+		return;
+	}
+
+	buffer = g_malloc (CLASSIFY_MAX_BYTES);
+
+	if (!g_input_stream_read_all (G_INPUT_STREAM (stream),
+				      buffer,
+				      CLASSIFY_MAX_BYTES,
+				      &n_bytes_read,
+				      cancellable,
+				      &error))
+	{
+		g_task_return_error (task, error);
+		goto out;
+	}
+
+	classification = g_new (GeditFileClassification, 1);
+
+	_gedit_file_classify_buffer (buffer,
+				     n_bytes_read,
+				     n_bytes_read < CLASSIFY_MAX_BYTES,
+				     classification);
+
+	gedit_debug_message (DEBUG_LOADER,
+			     "Classified %" G_GSIZE_FORMAT " bytes as %d",
+			     classification->n_bytes,
+			     classification->file_class);
+
+	g_task_return_pointer (task, classification, g_free);
+
+out:
+	g_free (buffer);
+	g_object_unref (stream);
+}
+
+/*
+ * _gedit_file_classify_async:
+ * @location: a #GFile.
+ * @cancellable: (allow-none): optional #GCancellable object, %NULL to ignore.
+ * @callback: (scope async): a #GAsyncReadyCallback to call when the request is
+ *   satisfied.
+ * @user_data: user data to pass to @callback.
+ *
+ * Reads and classifies the beginning of @location in a thread.
+ */
+void
+_gedit_file_classify_async (GFile               *location,
+			    GCancellable        *cancellable,
+			    GAsyncReadyCallback  callback,
+			    gpointer             user_data)
+{
+	GTask *task;
+
+	g_return_if_fail (G_IS_FILE (location));
+	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+	task = g_task_new (location, cancellable, callback, user_data);
+	g_task_run_in_thread (task, classify_thread);
+	g_object_unref (task);
+}
+
+gboolean
+_gedit_file_classify_finish (GFile                    *location,
+			     GAsyncResult             *result,
+			     GeditFileClassification  *classification,
+			     GError                  **error)
+{
+	GeditFileClassification *res;
+
+	g_return_val_if_fail (g_task_is_valid (result, location), FALSE);
+	g_return_val_if_fail (classification != NULL, FALSE);
+
+	res = g_task_propagate_pointer (G_TASK (result), error);
+
+	if (res == NULL)
+	{
+		return FALSE;
+	}
+
+	*classification = *res;
+	g_free (res);
+
+	return TRUE;
+}
+
+/* ex:set ts=8 noet: */
@@ -0,0 +1,67 @@
+/*
+ * gedit-file-classifier.h
+ * This file is part of gedit
+ *
+ * Copyright (C) 2015 - The gedit Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GEDIT_FILE_CLASSIFIER_H__
+#define __GEDIT_FILE_CLASSIFIER_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+	GEDIT_FILE_CLASS_ASCII,
+	GEDIT_FILE_CLASS_UTF8,
+	GEDIT_FILE_CLASS_NEEDS_TRIAL
+} GeditFileClass;
+
+typedef struct _GeditFileClassification GeditFileClassification;
+
+struct _GeditFileClassification
+{
+	GeditFileClass file_class;
+
+	/* Number of bytes classified, at the beginning of the file. */
+	gsize n_bytes;
+
+	/* Whether the whole file has been classified. */
+	guint complete : 1;
+};
+
+void		_gedit_file_classify_buffer	(const gchar             *data,
+						 gsize                    length,
+						 gboolean                 complete,
+						 GeditFileClassification *classification);
+
+void		_gedit_file_classify_async	(GFile                   *location,
+						 GCancellable            *cancellable,
+						 GAsyncReadyCallback      callback,
+						 gpointer                 user_data);
+
+gboolean	_gedit_file_classify_finish	(GFile                   *location,
+						 GAsyncResult            *result,
+						 GeditFileClassification *classification,
+						 GError                 **error);
+
+G_END_DECLS
+
+#endif /* __GEDIT_FILE_CLASSIFIER_H__ */
+
+/* ex:set ts=8 noet: */
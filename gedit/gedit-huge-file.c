@@ -0,0 +1,1158 @@
+/*
+ * gedit-huge-file.c
+ * This file is part of gedit
+ *
+ * Copyright (C) 2015 - The gedit Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gedit-huge-file.h"
+
+#include <string.h>
+#include <glib/gi18n.h>
+
+#include "gedit-debug.h"
+
+/* A huge file is a local file opened read-only, plus a sparse index of line
+ * start offsets. Only one line every LINE_INDEX_STRIDE lines is recorded, the
+ * other ones are found with memchr() from the closest checkpoint, so that the
+ * index stays small even for files with hundreds of millions of lines. A line
+ * is also recorded when it starts CHECKPOINT_BYTES or more after the previous
+ * checkpoint, so that the main thread never reads more than that to find a
+ * line, even in a file made of a few giant lines.
+ *
+ * The contents are never mapped in memory: they are read in bounded buffers
+ * when needed, so that a file truncated by another program only gives short
+ * reads instead of a SIGBUS. The length is the one found while indexing; what
+ * has been written to the file since then is not shown, and the text may be
+ * inconsistent if the file was modified in place.
+ *
+ * Text is handed out line ranges by line ranges, converted to valid UTF-8: an
+ * invalid byte (or a NUL byte, which GtkTextBuffer does not accept) becomes
+ * one U+FFFD REPLACEMENT CHARACTER. The character offsets used by the
+ * conversion functions below follow the same rule, so that they match the
+ * iters of a buffer filled with gedit_huge_file_get_lines().
+ */
+
+#define LINE_INDEX_STRIDE 1024
+#define CHECKPOINT_BYTES (1024 * 1024)
+
+/* Upper bound of the text returned by gedit_huge_file_get_lines(), so that a
+ * file made of a few giant lines doesn't end up entirely in the buffer. The
+ * character offsets are only computed up to that many bytes in a line, the
+ * rest of the line is never in the buffer.
+ */
+#define MAX_LINES_BYTES (8 * 1024 * 1024)
+
+/* The worker threads read the file and check for cancellation every
+ * SCAN_CHUNK_SIZE bytes.
+ */
+#define SCAN_CHUNK_SIZE (4 * 1024 * 1024)
+
+/* Size of the reads done in the main thread, to find a line or a character. */
+#define READ_BUFFER_SIZE (64 * 1024)
+
+#define REPLACEMENT_CHAR "\357\277\275"
+
+struct _GeditHugeFilePrivate
+{
+	GFile *location;
+
+	/* The reads are shared by the main thread and the worker threads, the
+	 * lock makes each seek and read atomic.
+	 */
+	GFileInputStream *stream;
+	GMutex stream_lock;
+
+	gsize length;
+
+	/* Checkpoints sorted by line, and so by offset. */
+	GArray *checkpoints;
+	gint64 n_lines;
+};
+
+typedef struct
+{
+	gint64 line;
+
+	/* The offset of the start of the line. */
+	gsize offset;
+} Checkpoint;
+
+typedef struct
+{
+	gchar *text;
+	gsize text_length;
+	gsize start_at;
+	gsize match_start;
+	guint case_sensitive : 1;
+	guint backward : 1;
+} SearchData;
+
+G_DEFINE_TYPE_WITH_PRIVATE (GeditHugeFile, gedit_huge_file, G_TYPE_OBJECT)
+
+static void
+search_data_free (SearchData *data)
+{
+	if (data != NULL)
+	{
+		g_free (data->text);
+		g_slice_free (SearchData, data);
+	}
+}
+
+static void
+gedit_huge_file_dispose (GObject *object)
+{
+	GeditHugeFilePrivate *priv = GEDIT_HUGE_FILE (object)->priv;
+
+	g_clear_object (&priv->location);
+
+	G_OBJECT_CLASS (gedit_huge_file_parent_class)->dispose (object);
+}
+
+static void
+gedit_huge_file_finalize (GObject *object)
+{
+	GeditHugeFilePrivate *priv = GEDIT_HUGE_FILE (object)->priv;
+
+	g_clear_object (&priv->stream);
+	g_mutex_clear (&priv->stream_lock);
+
+	g_array_unref (priv->checkpoints);
+
+	G_OBJECT_CLASS (gedit_huge_file_parent_class)->finalize (object);
+}
+
+static void
+gedit_huge_file_class_init (GeditHugeFileClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->dispose = gedit_huge_file_dispose;
+	object_class->finalize = gedit_huge_file_finalize;
+}
+
+static void
+gedit_huge_file_init (GeditHugeFile *huge_file)
+{
+	huge_file->priv = gedit_huge_file_get_instance_private (huge_file);
+
+	huge_file->priv->checkpoints = g_array_new (FALSE, FALSE, sizeof (Checkpoint));
+	g_mutex_init (&huge_file->priv->stream_lock);
+}
+
+/* Reads up to @size bytes at @offset. Fewer bytes are returned at the end of
+ * the file, which may have been truncated since it was indexed.
+ *
+ * Returns: the number of bytes read, or -1 on error.
+ */
+static gssize
+read_at (GeditHugeFilePrivate  *priv,
+	 gsize                  offset,
+	 gchar                 *buffer,
+	 gsize                  size,
+	 GError               **error)
+{
+	gsize n_read = 0;
+	gboolean ok;
+
+	g_mutex_lock (&priv->stream_lock);
+
+	ok = (g_seekable_seek (G_SEEKABLE (priv->stream), offset, G_SEEK_SET, NULL, error) &&
+	      g_input_stream_read_all (G_INPUT_STREAM (priv->stream),
+				       buffer,
+				       size,
+				       &n_read,
+				       NULL,
+				       error));
+
+	g_mutex_unlock (&priv->stream_lock);
+
+	return ok ? (gssize) n_read : -1;
+}
+
+/* Returns the number of bytes displayed as one character, see the comment at
+ * the top of the file.
+ */
+static gsize
+get_char_length (const gchar *p,
+		 const gchar *end)
+{
+	gunichar ch;
+
+	if ((guchar) *p < 0x80)
+	{
+		return 1;
+	}
+
+	ch = g_utf8_get_char_validated (p, end - p);
+
+	if (ch == (gunichar) -1 || ch == (gunichar) -2)
+	{
+		return 1;
+	}
+
+	return g_utf8_skip[*(const guchar *) p];
+}
+
+static gboolean
+build_line_index (GeditHugeFile  *huge_file,
+		  GCancellable   *cancellable,
+		  GError        **error)
+{
+	GeditHugeFilePrivate *priv = huge_file->priv;
+	gchar *buffer;
+	gsize offset = 0;
+	Checkpoint checkpoint = { 0, 0 };
+	gsize last_offset = 0;
+
+	g_array_set_size (priv->checkpoints, 0);
+	g_array_append_val (priv->checkpoints, checkpoint);
+
+	buffer = g_malloc (SCAN_CHUNK_SIZE);
+
+	while (offset < priv->length)
+	{
+		const gchar *pos;
+		const gchar *end;
+		gssize n_read;
+
+		if (g_cancellable_set_error_if_cancelled (cancellable, error))
+		{
+			g_free (buffer);
+			return FALSE;
+		}
+
+		n_read = read_at (priv,
+				  offset,
+				  buffer,
+				  MIN (SCAN_CHUNK_SIZE, priv->length - offset),
+				  error);
+
+		if (n_read == -1)
+		{
+			g_free (buffer);
+			return FALSE;
+		}
+
+		/* The file has been truncated. */
+		if (n_read == 0)
+		{
+			priv->length = offset;
+			break;
+		}
+
+		pos = buffer;
+		end = buffer + n_read;
+
+		while ((pos = memchr (pos, '\n', end - pos)) != NULL)
+		{
+			gsize line_start;
+
+			pos++;
+			checkpoint.line++;
+
+			line_start = offset + (pos - buffer);
+
+			if (checkpoint.line % LINE_INDEX_STRIDE == 0 ||
+			    line_start - last_offset >= CHECKPOINT_BYTES)
+			{
+				checkpoint.offset = line_start;
+				g_array_append_val (priv->checkpoints, checkpoint);
+
+				last_offset = line_start;
+			}
+		}
+
+		offset += n_read;
+	}
+
+	g_free (buffer);
+
+	priv->n_lines = checkpoint.line + 1;
+
+	return TRUE;
+}
+
+static void
+load_thread (GTask        *task,
+	     gpointer      source_object,
+	     gpointer      task_data,
+	     GCancellable *cancellable)
+{
+	GeditHugeFile *huge_file = source_object;
+	GeditHugeFilePrivate *priv = huge_file->priv;
+	GFileInfo *info;
+	gchar *path;
+	GError *error = NULL;
+
+	path = g_file_get_path (priv->location);
+
+	if (path == NULL)
+	{
+		g_task_return_new_error (task,
+					 G_IO_ERROR,
+					 G_IO_ERROR_NOT_SUPPORTED,
+					 _("Only local files can be opened in read-only mode."));
+		return;
+	}
+
+	g_free (path);
+
+	priv->stream = g_file_read (priv->location, cancellable, &error);
+
+	if (error != NULL)
+	{
+		g_task_return_error (task, error);
+		return;
+	}
+
+	/* The size of the open file, not of the file now at the location. */
+	info = g_file_input_stream_query_info (priv->stream,
+					       G_FILE_ATTRIBUTE_STANDARD_SIZE,
+					       cancellable,
+					       &error);
+
+	if (error != NULL)
+	{
+		g_task_return_error (task, error);
+		return;
+	}
+
+	priv->length = g_file_info_get_size (info);
+	g_object_unref (info);
+
+	if (!build_line_index (huge_file, cancellable, &error))
+	{
+		g_task_return_error (task, error);
+		return;
+	}
+
+	gedit_debug_message (DEBUG_LOADER,
+			     "Indexed %" G_GSIZE_FORMAT " bytes, %" G_GINT64_FORMAT " lines",
+			     priv->length,
+			     priv->n_lines);
+
+	g_task_return_pointer (task, g_object_ref (huge_file), g_object_unref);
+}
+
+/**
+ * gedit_huge_file_new_async:
+ * @location: a local #GFile.
+ * @cancellable: (nullable): optional #GCancellable object.
+ * @callback: (scope async): a #GAsyncReadyCallback to call when the file is
+ *   opened and indexed.
+ * @user_data: user data to pass to @callback.
+ *
+ * Opens @location and indexes its lines in a worker thread, without reading
+ * the whole contents in the main thread.
+ */
+void
+gedit_huge_file_new_async (GFile               *location,
+			   GCancellable        *cancellable,
+			   GAsyncReadyCallback  callback,
+			   gpointer             user_data)
+{
+	GeditHugeFile *huge_file;
+	GTask *task;
+
+	g_return_if_fail (G_IS_FILE (location));
+	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+	huge_file = g_object_new (GEDIT_TYPE_HUGE_FILE, NULL);
+	huge_file->priv->location = g_object_ref (location);
+
+	task = g_task_new (huge_file, cancellable, callback, user_data);
+	g_task_run_in_thread (task, load_thread);
+
+	g_object_unref (task);
+	g_object_unref (huge_file);
+}
+
+/**
+ * gedit_huge_file_new_finish:
+ * @result: a #GAsyncResult.
+ * @error: a #GError, or %NULL.
+ *
+ * Returns: (transfer full): the new #GeditHugeFile, or %NULL on error.
+ */
+GeditHugeFile *
+gedit_huge_file_new_finish (GAsyncResult  *result,
+			    GError       **error)
+{
+	g_return_val_if_fail (G_IS_TASK (result), NULL);
+
+	return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+GFile *
+gedit_huge_file_get_location (GeditHugeFile *huge_file)
+{
+	g_return_val_if_fail (GEDIT_IS_HUGE_FILE (huge_file), NULL);
+
+	return huge_file->priv->location;
+}
+
+gsize
+gedit_huge_file_get_length (GeditHugeFile *huge_file)
+{
+	g_return_val_if_fail (GEDIT_IS_HUGE_FILE (huge_file), 0);
+
+	return huge_file->priv->length;
+}
+
+gint64
+gedit_huge_file_get_n_lines (GeditHugeFile *huge_file)
+{
+	g_return_val_if_fail (GEDIT_IS_HUGE_FILE (huge_file), 0);
+
+	return huge_file->priv->n_lines;
+}
+
+/* Returns the last checkpoint at or before @line. */
+static const Checkpoint *
+find_checkpoint_by_line (GeditHugeFilePrivate *priv,
+			 gint64                line)
+{
+	guint low = 0;
+	guint high = priv->checkpoints->len;
+
+	while (high - low > 1)
+	{
+		guint middle = low + (high - low) / 2;
+
+		if (g_array_index (priv->checkpoints, Checkpoint, middle).line <= line)
+		{
+			low = middle;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	return &g_array_index (priv->checkpoints, Checkpoint, low);
+}
+
+/* Returns the last checkpoint at or before @offset. */
+static const Checkpoint *
+find_checkpoint_by_offset (GeditHugeFilePrivate *priv,
+			   gsize                 offset)
+{
+	guint low = 0;
+	guint high = priv->checkpoints->len;
+
+	while (high - low > 1)
+	{
+		guint middle = low + (high - low) / 2;
+
+		if (g_array_index (priv->checkpoints, Checkpoint, middle).offset <= offset)
+		{
+			low = middle;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	return &g_array_index (priv->checkpoints, Checkpoint, low);
+}
+
+/* Returns the offset following the @n_newlines-th newline after @offset, or
+ * the end of the file if there are not as many newlines.
+ */
+static gsize
+skip_newlines (GeditHugeFilePrivate *priv,
+	       gsize                 offset,
+	       gint                  n_newlines)
+{
+	gchar *buffer;
+
+	if (n_newlines == 0)
+	{
+		return offset;
+	}
+
+	buffer = g_malloc (READ_BUFFER_SIZE);
+
+	while (offset < priv->length)
+	{
+		const gchar *pos;
+		const gchar *end;
+		gssize n_read;
+
+		n_read = read_at (priv,
+				  offset,
+				  buffer,
+				  MIN (READ_BUFFER_SIZE, priv->length - offset),
+				  NULL);
+
+		if (n_read <= 0)
+		{
+			break;
+		}
+
+		pos = buffer;
+		end = buffer + n_read;
+
+		while ((pos = memchr (pos, '\n', end - pos)) != NULL)
+		{
+			pos++;
+
+			if (--n_newlines == 0)
+			{
+				g_free (buffer);
+				return offset + (pos - buffer);
+			}
+		}
+
+		offset += n_read;
+	}
+
+	g_free (buffer);
+
+	return priv->length;
+}
+
+/* Walks at most @max_chars characters from @from, without going past @to and,
+ * if @stop_at_newline is set, without going past a newline.
+ *
+ * Returns: the offset where the walk stopped.
+ */
+static gsize
+walk_chars (GeditHugeFilePrivate *priv,
+	    gsize                 from,
+	    gsize                 to,
+	    gint                  max_chars,
+	    gboolean              stop_at_newline,
+	    gint                 *n_chars)
+{
+	gchar *buffer;
+	gsize offset = from;
+	gint count = 0;
+
+	buffer = g_malloc (READ_BUFFER_SIZE);
+
+	while (offset < to && count < max_chars)
+	{
+		const gchar *pos;
+		const gchar *end;
+		const gchar *safe_end;
+		gsize size;
+		gssize n_read;
+
+		size = MIN (READ_BUFFER_SIZE, to - offset);
+		n_read = read_at (priv, offset, buffer, size, NULL);
+
+		if (n_read <= 0)
+		{
+			break;
+		}
+
+		pos = buffer;
+		end = buffer + n_read;
+
+		/* A character cut by the end of the buffer is read again with
+		 * the next buffer, unless the buffer ends where the walk must
+		 * stop anyway.
+		 */
+		safe_end = end;
+
+		if ((gsize) n_read == size && offset + size < to)
+		{
+			safe_end = end - 3;
+		}
+
+		while (pos < safe_end && count < max_chars)
+		{
+			if (stop_at_newline && *pos == '\n')
+			{
+				g_free (buffer);
+				*n_chars = count;
+				return offset + (pos - buffer);
+			}
+
+			pos += get_char_length (pos, end);
+			count++;
+		}
+
+		offset += pos - buffer;
+
+		/* The file has been truncated. */
+		if ((gsize) n_read < size)
+		{
+			break;
+		}
+	}
+
+	g_free (buffer);
+
+	*n_chars = count;
+	return offset;
+}
+
+/**
+ * gedit_huge_file_get_line_start:
+ * @huge_file: a #GeditHugeFile.
+ * @line: a line number, starting at 0.
+ *
+ * Returns: the byte offset of the start of @line, or the length of the file
+ * if @line is past the last line.
+ */
+gsize
+gedit_huge_file_get_line_start (GeditHugeFile *huge_file,
+				gint64         line)
+{
+	GeditHugeFilePrivate *priv;
+	const Checkpoint *checkpoint;
+
+	g_return_val_if_fail (GEDIT_IS_HUGE_FILE (huge_file), 0);
+	g_return_val_if_fail (line >= 0, 0);
+
+	priv = huge_file->priv;
+
+	if (line >= priv->n_lines)
+	{
+		return priv->length;
+	}
+
+	/* Less than LINE_INDEX_STRIDE lines and CHECKPOINT_BYTES bytes to
+	 * skip.
+	 */
+	checkpoint = find_checkpoint_by_line (priv, line);
+
+	return skip_newlines (priv, checkpoint->offset, line - checkpoint->line);
+}
+
+/**
+ * gedit_huge_file_get_line_at_offset:
+ * @huge_file: a #GeditHugeFile.
+ * @offset: a byte offset.
+ * @char_offset: (out) (optional): return location for the character offset
+ *   of @offset inside its line. It stops at the end of the text of the line
+ *   that gedit_huge_file_get_lines() can return.
+ *
+ * Returns: the line containing @offset.
+ */
+gint64
+gedit_huge_file_get_line_at_offset (GeditHugeFile *huge_file,
+				    gsize          offset,
+				    gint          *char_offset)
+{
+	GeditHugeFilePrivate *priv;
+	const Checkpoint *checkpoint;
+	gchar *buffer;
+	gsize pos;
+	gsize scan_end;
+	gsize line_start;
+	gint64 line;
+
+	g_return_val_if_fail (GEDIT_IS_HUGE_FILE (huge_file), 0);
+
+	priv = huge_file->priv;
+	offset = MIN (offset, priv->length);
+
+	checkpoint = find_checkpoint_by_offset (priv, offset);
+
+	line = checkpoint->line;
+	pos = checkpoint->offset;
+	line_start = pos;
+
+	/* A line starting CHECKPOINT_BYTES or more after the checkpoint, and
+	 * not after @offset, would be a later checkpoint. So there is no
+	 * newline to count past that, @offset is in a giant line.
+	 */
+	scan_end = MIN (offset, checkpoint->offset + CHECKPOINT_BYTES);
+
+	buffer = g_malloc (READ_BUFFER_SIZE);
+
+	while (pos < scan_end)
+	{
+		const gchar *newline;
+		const gchar *end;
+		gssize n_read;
+
+		n_read = read_at (priv,
+				  pos,
+				  buffer,
+				  MIN (READ_BUFFER_SIZE, scan_end - pos),
+				  NULL);
+
+		if (n_read <= 0)
+		{
+			break;
+		}
+
+		newline = buffer;
+		end = buffer + n_read;
+
+		while ((newline = memchr (newline, '\n', end - newline)) != NULL)
+		{
+			newline++;
+			line++;
+			line_start = pos + (newline - buffer);
+		}
+
+		pos += n_read;
+	}
+
+	g_free (buffer);
+
+	if (char_offset != NULL)
+	{
+		walk_chars (priv,
+			    line_start,
+			    MIN (offset, line_start + MAX_LINES_BYTES),
+			    G_MAXINT,
+			    FALSE,
+			    char_offset);
+	}
+
+	return line;
+}
+
+/**
+ * gedit_huge_file_get_offset_at_line:
+ * @huge_file: a #GeditHugeFile.
+ * @line: a line number, starting at 0.
+ * @char_offset: a character offset inside @line.
+ *
+ * Returns: the byte offset of the given position. If @char_offset is past the
+ * end of the line, the offset of the end of the line is returned.
+ */
+gsize
+gedit_huge_file_get_offset_at_line (GeditHugeFile *huge_file,
+				    gint64         line,
+				    gint           char_offset)
+{
+	GeditHugeFilePrivate *priv;
+	gsize line_start;
+	gint n_chars;
+
+	g_return_val_if_fail (GEDIT_IS_HUGE_FILE (huge_file), 0);
+
+	priv = huge_file->priv;
+	line_start = gedit_huge_file_get_line_start (huge_file, line);
+
+	/* The buffer never has more of the line than MAX_LINES_BYTES. */
+	return walk_chars (priv,
+			   line_start,
+			   MIN (priv->length, line_start + MAX_LINES_BYTES),
+			   char_offset,
+			   TRUE,
+			   &n_chars);
+}
+
+/**
+ * gedit_huge_file_get_lines:
+ * @huge_file: a #GeditHugeFile.
+ * @first_line: the first line to get, starting at 0.
+ * @n_lines: the number of lines to get.
+ *
+ * Gets a range of lines as valid UTF-8, without the trailing newline. The
+ * returned text is truncated if it would exceed a few megabytes.
+ *
+ * Returns: a newly allocated string.
+ */
+gchar *
+gedit_huge_file_get_lines (GeditHugeFile *huge_file,
+			   gint64         first_line,
+			   gint           n_lines)
+{
+	GeditHugeFilePrivate *priv;
+	GString *string;
+	gchar *buffer;
+	const gchar *remainder;
+	gboolean strip_newline;
+	gsize start;
+	gsize end;
+	gsize size;
+	gssize n_read;
+	gsize remaining_bytes;
+
+	g_return_val_if_fail (GEDIT_IS_HUGE_FILE (huge_file), NULL);
+	g_return_val_if_fail (first_line >= 0 && n_lines >= 0, NULL);
+
+	priv = huge_file->priv;
+
+	start = gedit_huge_file_get_line_start (huge_file, first_line);
+	strip_newline = first_line + n_lines < priv->n_lines;
+
+	if (strip_newline)
+	{
+		end = gedit_huge_file_get_line_start (huge_file, first_line + n_lines);
+	}
+	else
+	{
+		end = priv->length;
+	}
+
+	/* Two more bytes for the newline to strip. */
+	size = MIN (end - start, MAX_LINES_BYTES + 2);
+	buffer = g_malloc (size);
+
+	n_read = read_at (priv, start, buffer, size, NULL);
+	remaining_bytes = MAX (n_read, 0);
+
+	/* Strip the newline of the last line. */
+	if (strip_newline && remaining_bytes == end - start && remaining_bytes > 0)
+	{
+		remaining_bytes--;
+
+		if (remaining_bytes > 0 && buffer[remaining_bytes - 1] == '\r')
+		{
+			remaining_bytes--;
+		}
+	}
+
+	remaining_bytes = MIN (remaining_bytes, MAX_LINES_BYTES);
+
+	remainder = buffer;
+	string = g_string_sized_new (remaining_bytes + 1);
+
+	while (remaining_bytes > 0)
+	{
+		const gchar *invalid;
+		gsize valid_bytes;
+
+		if (g_utf8_validate (remainder, remaining_bytes, &invalid))
+		{
+			g_string_append_len (string, remainder, remaining_bytes);
+			break;
+		}
+
+		valid_bytes = invalid - remainder;
+
+		g_string_append_len (string, remainder, valid_bytes);
+		g_string_append (string, REPLACEMENT_CHAR);
+
+		remaining_bytes -= valid_bytes + 1;
+		remainder = invalid + 1;
+	}
+
+	g_free (buffer);
+
+	return g_string_free (string, FALSE);
+}
+
+static gboolean
+match_at (const gchar *pos,
+	  SearchData  *data)
+{
+	if (data->case_sensitive)
+	{
+		return memcmp (pos, data->text, data->text_length) == 0;
+	}
+
+	return g_ascii_strncasecmp (pos, data->text, data->text_length) == 0;
+}
+
+/* Finds the first match starting in @chunk, which holds @n_starts possible
+ * match starts followed by the bytes needed to check them.
+ */
+static gboolean
+search_chunk_forward (const gchar *chunk,
+		      gsize        n_starts,
+		      SearchData  *data,
+		      gsize       *match)
+{
+	if (data->case_sensitive)
+	{
+		const gchar *pos = chunk;
+		const gchar *end = chunk + n_starts;
+
+		while (pos < end &&
+		       (pos = memchr (pos, data->text[0], end - pos)) != NULL)
+		{
+			if (match_at (pos, data))
+			{
+				*match = pos - chunk;
+				return TRUE;
+			}
+
+			pos++;
+		}
+	}
+	else
+	{
+		gchar first_char_lower = g_ascii_tolower (data->text[0]);
+		gsize i;
+
+		for (i = 0; i < n_starts; i++)
+		{
+			if (g_ascii_tolower (chunk[i]) == first_char_lower &&
+			    match_at (chunk + i, data))
+			{
+				*match = i;
+				return TRUE;
+			}
+		}
+	}
+
+	return FALSE;
+}
+
+/* Finds the last match starting in @chunk, see search_chunk_forward(). */
+static gboolean
+search_chunk_backward (const gchar *chunk,
+		       gsize        n_starts,
+		       SearchData  *data,
+		       gsize       *match)
+{
+	gchar first_char_lower = g_ascii_tolower (data->text[0]);
+	gsize i;
+
+	for (i = n_starts; i > 0; i--)
+	{
+		if (g_ascii_tolower (chunk[i - 1]) == first_char_lower &&
+		    match_at (chunk + i - 1, data))
+		{
+			*match = i - 1;
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/* Finds the first match (or the last one if @backward is set) in [from, to).
+ * The file is read by chunks of SCAN_CHUNK_SIZE possible match starts, each
+ * one followed by the bytes needed to check the matches starting at its end.
+ */
+static gboolean
+search_range (GeditHugeFilePrivate *priv,
+	      gsize                 from,
+	      gsize                 to,
+	      gboolean              backward,
+	      SearchData           *data,
+	      GCancellable         *cancellable)
+{
+	gchar *buffer;
+	gsize starts_end;
+	gsize chunk_start;
+	gsize chunk_end;
+	gboolean found = FALSE;
+
+	if (to < from + data->text_length)
+	{
+		return FALSE;
+	}
+
+	/* Match starts are in [from, starts_end). */
+	starts_end = to - data->text_length + 1;
+
+	buffer = g_malloc (SCAN_CHUNK_SIZE + data->text_length - 1);
+
+	chunk_start = from;
+	chunk_end = starts_end;
+
+	while (!found && chunk_start < chunk_end)
+	{
+		gsize start;
+		gsize n_starts;
+		gsize match;
+		gssize n_read;
+
+		if (g_cancellable_is_cancelled (cancellable))
+		{
+			break;
+		}
+
+		if (backward)
+		{
+			start = chunk_end - MIN (chunk_end - chunk_start, SCAN_CHUNK_SIZE);
+		}
+		else
+		{
+			start = chunk_start;
+		}
+
+		n_starts = MIN (chunk_end - start, SCAN_CHUNK_SIZE);
+
+		n_read = read_at (priv,
+				  start,
+				  buffer,
+				  n_starts + data->text_length - 1,
+				  NULL);
+
+		/* The file has been truncated. */
+		if (n_read < (gssize) data->text_length)
+		{
+			break;
+		}
+
+		n_starts = MIN (n_starts, n_read - data->text_length + 1);
+
+		if (backward)
+		{
+			found = search_chunk_backward (buffer, n_starts, data, &match);
+			chunk_end = start;
+		}
+		else
+		{
+			found = search_chunk_forward (buffer, n_starts, data, &match);
+			chunk_start = start + n_starts;
+		}
+
+		if (found)
+		{
+			data->match_start = start + match;
+		}
+	}
+
+	g_free (buffer);
+
+	return found;
+}
+
+static void
+search_thread (GTask        *task,
+	       gpointer      source_object,
+	       gpointer      task_data,
+	       GCancellable *cancellable)
+{
+	GeditHugeFilePrivate *priv = GEDIT_HUGE_FILE (source_object)->priv;
+	SearchData *data = task_data;
+	gboolean found;
+
+	/* Wrap around, like the search in a normal buffer. The second pass
+	 * only covers the matches that the first pass could not see.
+	 */
+	if (data->backward)
+	{
+		gsize wrap_from = 0;
+
+		if (data->start_at >= data->text_length)
+		{
+			wrap_from = data->start_at - data->text_length + 1;
+		}
+
+		found = (search_range (priv, 0, data->start_at, TRUE, data, cancellable) ||
+			 search_range (priv, wrap_from, priv->length, TRUE, data, cancellable));
+	}
+	else
+	{
+		gsize wrap_to = MIN (priv->length, data->start_at + data->text_length - 1);
+
+		found = (search_range (priv, data->start_at, priv->length, FALSE, data, cancellable) ||
+			 search_range (priv, 0, wrap_to, FALSE, data, cancellable));
+	}
+
+	if (g_task_return_error_if_cancelled (task))
+	{
+		return;
+	}
+
+	g_task_return_boolean (task, found);
+}
+
+/**
+ * gedit_huge_file_search_async:
+ * @huge_file: a #GeditHugeFile.
+ * @text: the text to search, not empty.
+ * @case_sensitive: whether the search is case sensitive. A case insensitive
+ *   search only folds ASCII letters.
+ * @start_at: the byte offset where to begin the search.
+ * @backward: the search direction.
+ * @cancellable: (nullable): optional #GCancellable object.
+ * @callback: (scope async): a #GAsyncReadyCallback to call when the search is
+ *   finished.
+ * @user_data: user data to pass to @callback.
+ *
+ * Searches @text in the file in a worker thread. The search wraps around
+ * the end (or the start) of the file.
+ */
+void
+gedit_huge_file_search_async (GeditHugeFile       *huge_file,
+			      const gchar         *text,
+			      gboolean             case_sensitive,
+			      gsize                start_at,
+			      gboolean             backward,
+			      GCancellable        *cancellable,
+			      GAsyncReadyCallback  callback,
+			      gpointer             user_data)
+{
+	GTask *task;
+	SearchData *data;
+
+	g_return_if_fail (GEDIT_IS_HUGE_FILE (huge_file));
+	g_return_if_fail (text != NULL && text[0] != '\0');
+
+	data = g_slice_new0 (SearchData);
+	data->text = g_strdup (text);
+	data->text_length = strlen (text);
+	data->start_at = MIN (start_at, huge_file->priv->length);
+	data->case_sensitive = case_sensitive != FALSE;
+	data->backward = backward != FALSE;
+
+	task = g_task_new (huge_file, cancellable, callback, user_data);
+	g_task_set_task_data (task, data, (GDestroyNotify) search_data_free);
+	g_task_run_in_thread (task, search_thread);
+
+	g_object_unref (task);
+}
+
+/**
+ * gedit_huge_file_search_finish:
+ * @huge_file: a #GeditHugeFile.
+ * @result: a #GAsyncResult.
+ * @match_start: (out) (optional): return location for the offset of the
+ *   start of the match.
+ * @match_end: (out) (optional): return location for the offset of the end of
+ *   the match.
+ * @error: a #GError, or %NULL.
+ *
+ * Returns: whether a match was found.
+ */
+gboolean
+gedit_huge_file_search_finish (GeditHugeFile  *huge_file,
+			       GAsyncResult   *result,
+			       gsize          *match_start,
+			       gsize          *match_end,
+			       GError        **error)
+{
+	SearchData *data;
+	gboolean found;
+
+	g_return_val_if_fail (GEDIT_IS_HUGE_FILE (huge_file), FALSE);
+	g_return_val_if_fail (g_task_is_valid (result, huge_file), FALSE);
+
+	found = g_task_propagate_boolean (G_TASK (result), error);
+
+	if (found)
+	{
+		data = g_task_get_task_data (G_TASK (result));
+
+		if (match_start != NULL)
+		{
+			*match_start = data->match_start;
+		}
+
+		if (match_end != NULL)
+		{
+			*match_end = data->match_start + data->text_length;
+		}
+	}
+
+	return found;
+}
+
+/* ex:set ts=8 noet: */
@@ -0,0 +1,101 @@
+/*
+ * gedit-huge-file.h
+ * This file is part of gedit
+ *
+ * Copyright (C) 2015 - The gedit Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GEDIT_HUGE_FILE_H__
+#define __GEDIT_HUGE_FILE_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define GEDIT_TYPE_HUGE_FILE		(gedit_huge_file_get_type ())
+#define GEDIT_HUGE_FILE(obj)		(G_TYPE_CHECK_INSTANCE_CAST ((obj), GEDIT_TYPE_HUGE_FILE, GeditHugeFile))
+#define GEDIT_HUGE_FILE_CLASS(klass)	(G_TYPE_CHECK_CLASS_CAST ((klass), GEDIT_TYPE_HUGE_FILE, GeditHugeFileClass))
+#define GEDIT_IS_HUGE_FILE(obj)		(G_TYPE_CHECK_INSTANCE_TYPE ((obj), GEDIT_TYPE_HUGE_FILE))
+#define GEDIT_IS_HUGE_FILE_CLASS(klass)	(G_TYPE_CHECK_CLASS_TYPE ((klass), GEDIT_TYPE_HUGE_FILE))
+#define GEDIT_HUGE_FILE_GET_CLASS(obj)	(G_TYPE_INSTANCE_GET_CLASS ((obj), GEDIT_TYPE_HUGE_FILE, GeditHugeFileClass))
+
+typedef struct _GeditHugeFile		GeditHugeFile;
+typedef struct _GeditHugeFileClass	GeditHugeFileClass;
+typedef struct _GeditHugeFilePrivate	GeditHugeFilePrivate;
+
+struct _GeditHugeFile
+{
+	GObject parent;
+
+	GeditHugeFilePrivate *priv;
+};
+
+struct _GeditHugeFileClass
+{
+	GObjectClass parent_class;
+};
+
+GType		 gedit_huge_file_get_type		(void) G_GNUC_CONST;
+
+void		 gedit_huge_file_new_async		(GFile               *location,
+							 GCancellable        *cancellable,
+							 GAsyncReadyCallback  callback,
+							 gpointer             user_data);
+
+GeditHugeFile	*gedit_huge_file_new_finish		(GAsyncResult        *result,
+							 GError             **error);
+
+GFile		*gedit_huge_file_get_location		(GeditHugeFile       *huge_file);
+
+gsize		 gedit_huge_file_get_length		(GeditHugeFile       *huge_file);
+
+gint64		 gedit_huge_file_get_n_lines		(GeditHugeFile       *huge_file);
+
+gsize		 gedit_huge_file_get_line_start		(GeditHugeFile       *huge_file,
+							 gint64               line);
+
+gint64		 gedit_huge_file_get_line_at_offset	(GeditHugeFile       *huge_file,
+							 gsize                offset,
+							 gint                *char_offset);
+
+gsize		 gedit_huge_file_get_offset_at_line	(GeditHugeFile       *huge_file,
+							 gint64               line,
+							 gint                 char_offset);
+
+gchar		*gedit_huge_file_get_lines		(GeditHugeFile       *huge_file,
+							 gint64               first_line,
+							 gint                 n_lines);
+
+void		 gedit_huge_file_search_async		(GeditHugeFile       *huge_file,
+							 const gchar         *text,
+							 gboolean             case_sensitive,
+							 gsize                start_at,
+							 gboolean             backward,
+							 GCancellable        *cancellable,
+							 GAsyncReadyCallback  callback,
+							 gpointer             user_data);
+
+gboolean	 gedit_huge_file_search_finish		(GeditHugeFile       *huge_file,
+							 GAsyncResult        *result,
+							 gsize               *match_start,
+							 gsize               *match_end,
+							 GError             **error);
+
+G_END_DECLS
+
+#endif /* __GEDIT_HUGE_FILE_H__ */
+
+/* ex:set ts=8 noet: */
@@ -57,6 +57,8 @@ GtkWidget	*gedit_invalid_character_info_bar_new			(GFile               *location
 
 GtkWidget	*gedit_network_unavailable_info_bar_new			(GFile               *location);
 
+GtkWidget	*gedit_huge_file_info_bar_new				(GFile               *location);
+
 G_END_DECLS
 
 #endif  /* __GEDIT_IO_ERROR_INFO_BAR_H__  */
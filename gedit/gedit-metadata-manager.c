@@ -21,19 +21,69 @@
 
 #include "gedit-metadata-manager.h"
 
-#include <stdlib.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib/gstdio.h>
 #include <libxml/xmlreader.h>
 
+#ifdef G_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #include "gedit-debug.h"
 #include "gedit-dirs.h"
 
+/* The metadata are stored in an append-only log of binary records. At startup
+ * the log is memory-mapped and replayed, then each change appends one record
+ * to it. When most of the records are obsolete, the log is compacted: it is
+ * rewritten with only the current values.
+ *
+ * The items are kept in a LRU list, and the least recently used item is
+ * evicted as soon as there are more than MAX_ITEMS.
+ *
+ * The legacy XML file is imported when the log doesn't exist yet.
+ *
+ * Several gedit instances can share the log. The writes are serialized with an
+ * advisory lock on a separate lock file. Before writing, an instance replays
+ * the records appended by the other ones, or reloads the whole log if another
+ * instance compacted it, and re-applies its own pending records on top. So the
+ * concurrent updates are merged, in the order of the log. The compaction
+ * writes a new file and renames it over the log.
+ */
 
 /*
 #define GEDIT_METADATA_VERBOSE_DEBUG	1
 */
 
-#define MAX_ITEMS 50
-#define METADATA_FILE "gedit-metadata.xml"
+#define MAX_ITEMS 20000
+#define METADATA_FILE "gedit-metadata.db"
+#define LEGACY_METADATA_FILE "gedit-metadata.xml"
+#define LOCK_FILE "gedit-metadata.lock"
+
+#define METADATA_MAGIC "GEDITMD1"
+#define METADATA_MAGIC_LENGTH 8
+
+/* Length written for a NULL string. */
+#define NULL_STRING_LENGTH G_MAXUINT32
+
+/* The log is compacted when it contains more than twice the number of records
+ * needed, plus this number.
+ */
+#define COMPACTION_MIN_RECORDS 1024
+
+typedef enum
+{
+	/* Sets a value, or unsets it if the value is NULL. */
+	RECORD_SET = 1,
+
+	/* Updates the access time of an item. */
+	RECORD_TOUCH,
+
+	/* Removes an item. */
+	RECORD_REMOVE
+} RecordType;
 
 typedef struct _GeditMetadataManager GeditMetadataManager;
 
@@ -41,9 +91,17 @@ typedef struct _Item Item;
 
 struct _Item
 {
-	gint64	 	 atime; /* time of last access in seconds since January 1, 1970 UTC */
+	gchar		*uri;
+
+	gint64	 	 atime; /* time of last access in milliseconds since January 1, 1970 UTC */
 
 	GHashTable	*values;
+
+	/* Link in the LRU list, its data is the item itself. */
+	GList		 lru_link;
+
+	/* Value of save_generation when the access time was last logged. */
+	guint		 touch_generation;
 };
 
 struct _GeditMetadataManager
@@ -53,16 +111,68 @@ struct _GeditMetadataManager
 
 	guint 		 timeout_id;
 
+	/* uri -> Item, the keys are owned by the items. */
 	GHashTable	*items;
 
+	/* The most recently used items first. */
+	GQueue		 lru;
+
+	/* The records not yet appended to the log. */
+	GString		*pending_records;
+
+	/* Number of records in the log, and in pending_records. */
+	guint		 n_log_records;
+	guint		 n_pending_records;
+
+	/* Number of records in the log once compacted. */
+	guint		 n_live_records;
+
+	/* Incremented at each save. */
+	guint		 save_generation;
+
+	/* Set when the log must be rewritten entirely at the next save. */
+	guint		 needs_compaction : 1;
+
+	/* Length of the log already replayed or written by this instance, and
+	 * identity of the log file, to detect the changes made by the other
+	 * instances.
+	 */
+	gsize		 log_length;
+	guint64		 log_dev;
+	guint64		 log_ino;
+
 	gchar		*metadata_filename;
+	gchar		*legacy_metadata_filename;
+	gchar		*lock_filename;
 };
 
+typedef struct
+{
+	const gchar *pos;
+	const gchar *end;
+} RecordReader;
+
 static gboolean gedit_metadata_manager_save (gpointer data);
 
 
 static GeditMetadataManager *gedit_metadata_manager = NULL;
 
+static Item *
+item_new (const gchar *uri)
+{
+	Item *item;
+
+	item = g_new0 (Item, 1);
+	item->uri = g_strdup (uri);
+	item->values = g_hash_table_new_full (g_str_hash,
+					      g_str_equal,
+					      g_free,
+					      g_free);
+	item->lru_link.data = item;
+
+	return item;
+}
+
 static void
 item_free (gpointer data)
 {
@@ -76,12 +186,18 @@ item_free (gpointer data)
 
 	item = (Item *)data;
 
-	if (item->values != NULL)
-		g_hash_table_destroy (item->values);
-
+	g_hash_table_destroy (item->values);
+	g_free (item->uri);
 	g_free (item);
 }
 
+/* Number of records needed to store the item in a compacted log. */
+static guint
+item_get_n_records (Item *item)
+{
+	return MAX (1, g_hash_table_size (item->values));
+}
+
 static void
 gedit_metadata_manager_arm_timeout (void)
 {
@@ -119,11 +235,22 @@ gedit_metadata_manager_init (void)
 	gedit_metadata_manager->items =
 		g_hash_table_new_full (g_str_hash,
 				       g_str_equal,
-				       g_free,
+				       NULL,
 				       item_free);
 
+	g_queue_init (&gedit_metadata_manager->lru);
+
+	gedit_metadata_manager->pending_records = g_string_new (NULL);
+
+	/* The replayed items have a touch generation of 0, so their access
+	 * time is logged at the first access.
+	 */
+	gedit_metadata_manager->save_generation = 1;
+
 	cache_dir = gedit_dirs_get_user_cache_dir ();
 	gedit_metadata_manager->metadata_filename = g_build_filename (cache_dir, METADATA_FILE, NULL);
+	gedit_metadata_manager->legacy_metadata_filename = g_build_filename (cache_dir, LEGACY_METADATA_FILE, NULL);
+	gedit_metadata_manager->lock_filename = g_build_filename (cache_dir, LOCK_FILE, NULL);
 }
 
 /**
@@ -144,18 +271,486 @@ gedit_metadata_manager_shutdown (void)
 	{
 		g_source_remove (gedit_metadata_manager->timeout_id);
 		gedit_metadata_manager->timeout_id = 0;
+	}
+
+	/* Also saves the access times logged since the last save. */
+	if (gedit_metadata_manager->pending_records->len > 0 ||
+	    gedit_metadata_manager->needs_compaction)
+	{
 		gedit_metadata_manager_save (NULL);
 	}
 
-	if (gedit_metadata_manager->items != NULL)
-		g_hash_table_destroy (gedit_metadata_manager->items);
+	/* The items are freed by the hash table, the links are embedded in
+	 * them.
+	 */
+	g_queue_init (&gedit_metadata_manager->lru);
+	g_hash_table_destroy (gedit_metadata_manager->items);
+
+	g_string_free (gedit_metadata_manager->pending_records, TRUE);
 
 	g_free (gedit_metadata_manager->metadata_filename);
+	g_free (gedit_metadata_manager->legacy_metadata_filename);
+	g_free (gedit_metadata_manager->lock_filename);
 
 	g_free (gedit_metadata_manager);
 	gedit_metadata_manager = NULL;
 }
 
+static void
+append_uint32 (GString *records,
+	       guint32  value)
+{
+	g_string_append_len (records, (const gchar *)&value, sizeof (guint32));
+}
+
+static void
+append_string (GString     *records,
+	       const gchar *str)
+{
+	if (str == NULL)
+	{
+		append_uint32 (records, NULL_STRING_LENGTH);
+	}
+	else
+	{
+		guint32 length = strlen (str);
+
+		append_uint32 (records, length);
+		g_string_append_len (records, str, length);
+	}
+}
+
+/* A record is made of its type, the access time of the item, the item URI and,
+ * for RECORD_SET, the key and the value. The numbers are in host byte order,
+ * the log is a cache that is not shared between machines.
+ */
+static void
+append_record (GString     *records,
+	       RecordType   type,
+	       const Item  *item,
+	       const gchar *key,
+	       const gchar *value)
+{
+	guint8 type_byte = type;
+
+	g_string_append_len (records, (const gchar *)&type_byte, 1);
+	g_string_append_len (records, (const gchar *)&item->atime, sizeof (gint64));
+	append_string (records, item->uri);
+
+	if (type == RECORD_SET)
+	{
+		append_string (records, key);
+		append_string (records, value);
+	}
+}
+
+static void
+log_record (RecordType   type,
+	    Item        *item,
+	    const gchar *key,
+	    const gchar *value)
+{
+	append_record (gedit_metadata_manager->pending_records, type, item, key, value);
+	gedit_metadata_manager->n_pending_records++;
+
+	item->touch_generation = gedit_metadata_manager->save_generation;
+}
+
+static gboolean
+read_bytes (RecordReader *reader,
+	    gpointer      dest,
+	    gsize         length)
+{
+	if ((gsize) (reader->end - reader->pos) < length)
+	{
+		return FALSE;
+	}
+
+	memcpy (dest, reader->pos, length);
+	reader->pos += length;
+
+	return TRUE;
+}
+
+/* *str is set to a newly allocated string, or to NULL. */
+static gboolean
+read_string (RecordReader  *reader,
+	     gchar        **str)
+{
+	guint32 length;
+
+	*str = NULL;
+
+	if (!read_bytes (reader, &length, sizeof (guint32)))
+	{
+		return FALSE;
+	}
+
+	if (length == NULL_STRING_LENGTH)
+	{
+		return TRUE;
+	}
+
+	if ((gsize) (reader->end - reader->pos) < length)
+	{
+		return FALSE;
+	}
+
+	*str = g_strndup (reader->pos, length);
+	reader->pos += length;
+
+	return TRUE;
+}
+
+static void
+touch_item (Item   *item,
+	    gint64  atime)
+{
+	GQueue *lru = &gedit_metadata_manager->lru;
+
+	item->atime = atime;
+
+	if (lru->head != &item->lru_link)
+	{
+		g_queue_unlink (lru, &item->lru_link);
+		g_queue_push_head_link (lru, &item->lru_link);
+	}
+}
+
+static Item *
+get_or_create_item (const gchar *uri)
+{
+	Item *item;
+
+	item = g_hash_table_lookup (gedit_metadata_manager->items, uri);
+
+	if (item == NULL)
+	{
+		item = item_new (uri);
+
+		g_hash_table_insert (gedit_metadata_manager->items, item->uri, item);
+		g_queue_push_head_link (&gedit_metadata_manager->lru, &item->lru_link);
+
+		gedit_metadata_manager->n_live_records += item_get_n_records (item);
+	}
+
+	return item;
+}
+
+static void
+remove_item (Item *item)
+{
+	gedit_metadata_manager->n_live_records -= item_get_n_records (item);
+
+	g_queue_unlink (&gedit_metadata_manager->lru, &item->lru_link);
+	g_hash_table_remove (gedit_metadata_manager->items, item->uri);
+}
+
+static void
+item_set_value (Item        *item,
+		const gchar *key,
+		const gchar *value)
+{
+	guint n_records_before = item_get_n_records (item);
+
+	if (value != NULL)
+	{
+		g_hash_table_insert (item->values,
+				     g_strdup (key),
+				     g_strdup (value));
+	}
+	else
+	{
+		g_hash_table_remove (item->values, key);
+	}
+
+	gedit_metadata_manager->n_live_records -= n_records_before;
+	gedit_metadata_manager->n_live_records += item_get_n_records (item);
+}
+
+/* If @log is TRUE, the evictions are recorded in the log. */
+static void
+evict_items (gboolean log)
+{
+	while (g_hash_table_size (gedit_metadata_manager->items) > MAX_ITEMS)
+	{
+		Item *item = gedit_metadata_manager->lru.tail->data;
+
+		if (log)
+		{
+			log_record (RECORD_REMOVE, item, NULL, NULL);
+		}
+
+		remove_item (item);
+	}
+}
+
+/* Returns FALSE if the record is truncated or invalid. */
+static gboolean
+replay_record (RecordReader *reader)
+{
+	guint8 type;
+	gint64 atime;
+	gchar *uri = NULL;
+	gchar *key = NULL;
+	gchar *value = NULL;
+	Item *item;
+
+	if (!read_bytes (reader, &type, 1) ||
+	    !read_bytes (reader, &atime, sizeof (gint64)) ||
+	    !read_string (reader, &uri) ||
+	    uri == NULL)
+	{
+		g_free (uri);
+		return FALSE;
+	}
+
+	switch (type)
+	{
+		case RECORD_SET:
+			if (!read_string (reader, &key) ||
+			    key == NULL ||
+			    !read_string (reader, &value))
+			{
+				goto error;
+			}
+
+			item = get_or_create_item (uri);
+			item_set_value (item, key, value);
+			touch_item (item, atime);
+			break;
+
+		case RECORD_TOUCH:
+			item = get_or_create_item (uri);
+			touch_item (item, atime);
+			break;
+
+		case RECORD_REMOVE:
+			item = g_hash_table_lookup (gedit_metadata_manager->items, uri);
+
+			if (item != NULL)
+			{
+				remove_item (item);
+			}
+			break;
+
+		default:
+			goto error;
+	}
+
+	g_free (uri);
+	g_free (key);
+	g_free (value);
+	return TRUE;
+
+error:
+	g_free (uri);
+	g_free (key);
+	g_free (value);
+	return FALSE;
+}
+
+/* Returns a file descriptor to pass to unlock_log(), or -1 if the lock could
+ * not be taken. The lock is advisory, it only serializes the gedit instances.
+ */
+static gint
+lock_log (void)
+{
+#ifdef G_OS_UNIX
+	struct flock lock;
+	gint fd;
+
+	fd = g_open (gedit_metadata_manager->lock_filename, O_RDWR | O_CREAT, 0644);
+
+	if (fd == -1)
+	{
+		return -1;
+	}
+
+	memset (&lock, 0, sizeof (lock));
+	lock.l_type = F_WRLCK;
+	lock.l_whence = SEEK_SET;
+
+	while (fcntl (fd, F_SETLKW, &lock) == -1)
+	{
+		if (errno != EINTR)
+		{
+			close (fd);
+			return -1;
+		}
+	}
+
+	return fd;
+#else
+	return -1;
+#endif
+}
+
+static void
+unlock_log (gint fd)
+{
+#ifdef G_OS_UNIX
+	/* Closing the file releases the lock. */
+	if (fd != -1)
+	{
+		close (fd);
+	}
+#endif
+}
+
+static void
+update_log_identity (void)
+{
+	GStatBuf buf;
+
+	if (g_stat (gedit_metadata_manager->metadata_filename, &buf) == 0)
+	{
+		gedit_metadata_manager->log_dev = buf.st_dev;
+		gedit_metadata_manager->log_ino = buf.st_ino;
+	}
+}
+
+/* Replays the records appended to the log since the last replay, or the whole
+ * log if log_length is 0. Returns FALSE if the log doesn't exist.
+ */
+static gboolean
+replay_log (void)
+{
+	GMappedFile *mapped_file;
+	const gchar *contents;
+	RecordReader reader;
+	GError *error = NULL;
+
+	mapped_file = g_mapped_file_new (gedit_metadata_manager->metadata_filename,
+					 FALSE,
+					 &error);
+
+	if (mapped_file == NULL)
+	{
+		gboolean exists = !g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT);
+
+		if (exists)
+		{
+			g_message ("Could not read the metadata file '%s': %s",
+				   gedit_metadata_manager->metadata_filename,
+				   error->message);
+
+			gedit_metadata_manager->needs_compaction = TRUE;
+		}
+
+		g_error_free (error);
+		return exists;
+	}
+
+	update_log_identity ();
+
+	contents = g_mapped_file_get_contents (mapped_file);
+	reader.pos = contents + gedit_metadata_manager->log_length;
+	reader.end = contents + g_mapped_file_get_length (mapped_file);
+
+	/* Whatever happens, don't read these bytes again. */
+	gedit_metadata_manager->log_length = g_mapped_file_get_length (mapped_file);
+
+	if (reader.pos == contents)
+	{
+		if ((gsize) (reader.end - reader.pos) < METADATA_MAGIC_LENGTH ||
+		    memcmp (reader.pos, METADATA_MAGIC, METADATA_MAGIC_LENGTH) != 0)
+		{
+			g_message ("File '%s' is of the wrong type",
+				   gedit_metadata_manager->metadata_filename);
+
+			gedit_metadata_manager->needs_compaction = TRUE;
+			g_mapped_file_unref (mapped_file);
+			return TRUE;
+		}
+
+		reader.pos += METADATA_MAGIC_LENGTH;
+	}
+
+	while (reader.pos < reader.end)
+	{
+		/* A truncated record can be left by a crash. Appending after
+		 * it would make the following records unreadable, so the log
+		 * is rewritten at the next save.
+		 */
+		if (!replay_record (&reader))
+		{
+			g_message ("The metadata file '%s' is corrupted",
+				   gedit_metadata_manager->metadata_filename);
+
+			gedit_metadata_manager->needs_compaction = TRUE;
+			break;
+		}
+
+		gedit_metadata_manager->n_log_records++;
+	}
+
+	g_mapped_file_unref (mapped_file);
+
+	gedit_debug_message (DEBUG_METADATA, "%u records replayed for %u items",
+			     gedit_metadata_manager->n_log_records,
+			     g_hash_table_size (gedit_metadata_manager->items));
+
+	return TRUE;
+}
+
+static void
+clear_items (void)
+{
+	g_queue_init (&gedit_metadata_manager->lru);
+	g_hash_table_remove_all (gedit_metadata_manager->items);
+
+	gedit_metadata_manager->n_live_records = 0;
+}
+
+/* Brings the items up to date with the changes written by the other gedit
+ * instances. Must be called with the lock held.
+ */
+static void
+sync_with_log (void)
+{
+	GString *pending = gedit_metadata_manager->pending_records;
+	RecordReader reader;
+	GStatBuf buf;
+
+	if (g_stat (gedit_metadata_manager->metadata_filename, &buf) != 0)
+	{
+		/* Write all the values. */
+		gedit_metadata_manager->needs_compaction = TRUE;
+		return;
+	}
+
+	if (buf.st_dev == gedit_metadata_manager->log_dev &&
+	    buf.st_ino == gedit_metadata_manager->log_ino &&
+	    (gsize) buf.st_size == gedit_metadata_manager->log_length)
+	{
+		return;
+	}
+
+	/* Compacted by another instance, reload it. */
+	if (buf.st_dev != gedit_metadata_manager->log_dev ||
+	    buf.st_ino != gedit_metadata_manager->log_ino ||
+	    (gsize) buf.st_size < gedit_metadata_manager->log_length)
+	{
+		gedit_debug_message (DEBUG_METADATA, "Reloading the log");
+
+		clear_items ();
+		gedit_metadata_manager->log_length = 0;
+		gedit_metadata_manager->n_log_records = 0;
+		gedit_metadata_manager->needs_compaction = FALSE;
+	}
+
+	replay_log ();
+
+	/* Our changes go after the ones of the other instances. */
+	reader.pos = pending->str;
+	reader.end = pending->str + pending->len;
+
+	while (reader.pos < reader.end && replay_record (&reader))
+	{
+	}
+}
+
 static void
 parseItem (xmlDocPtr doc, xmlNodePtr cur)
 {
@@ -182,15 +777,10 @@ parseItem (xmlDocPtr doc, xmlNodePtr cur)
 		return;
 	}
 
-	item = g_new0 (Item, 1);
+	item = get_or_create_item ((gchar *)uri);
 
 	item->atime = g_ascii_strtoll ((char *)atime, NULL, 0);
 
-	item->values = g_hash_table_new_full (g_str_hash,
-					      g_str_equal,
-					      g_free,
-					      g_free);
-
 	cur = cur->xmlChildrenNode;
 
 	while (cur != NULL)
@@ -205,9 +795,9 @@ parseItem (xmlDocPtr doc, xmlNodePtr cur)
 
 			if ((key != NULL) && (value != NULL))
 			{
-				g_hash_table_insert (item->values,
-						     g_strdup ((gchar *)key),
-						     g_strdup ((gchar *)value));
+				item_set_value (item,
+						(gchar *)key,
+						(gchar *)value);
 			}
 
 			if (key != NULL)
@@ -219,63 +809,68 @@ parseItem (xmlDocPtr doc, xmlNodePtr cur)
 		cur = cur->next;
 	}
 
-	g_hash_table_insert (gedit_metadata_manager->items,
-			     g_strdup ((gchar *)uri),
-			     item);
-
 	xmlFree (uri);
 	xmlFree (atime);
 }
 
-static gboolean
-load_values (void)
+static gint
+compare_items_atime (gconstpointer a,
+		     gconstpointer b,
+		     gpointer      user_data)
+{
+	const Item *item_a = a;
+	const Item *item_b = b;
+
+	/* Most recently used first. */
+	if (item_a->atime > item_b->atime)
+		return -1;
+
+	return item_a->atime < item_b->atime ? 1 : 0;
+}
+
+static void
+import_legacy_values (void)
 {
 	xmlDocPtr doc;
 	xmlNodePtr cur;
+	GQueue sorted = G_QUEUE_INIT;
+	GList *l;
 
 	gedit_debug (DEBUG_METADATA);
 
-	g_return_val_if_fail (gedit_metadata_manager != NULL, FALSE);
-	g_return_val_if_fail (gedit_metadata_manager->values_loaded == FALSE, FALSE);
-
-	gedit_metadata_manager->values_loaded = TRUE;
-
 	xmlKeepBlanksDefault (0);
 
-	/* FIXME: file locking - Paolo */
-	if ((gedit_metadata_manager->metadata_filename == NULL) ||
-	    (!g_file_test (gedit_metadata_manager->metadata_filename, G_FILE_TEST_EXISTS)))
+	if (!g_file_test (gedit_metadata_manager->legacy_metadata_filename, G_FILE_TEST_EXISTS))
 	{
-		return FALSE;
+		return;
 	}
 
-	doc = xmlParseFile (gedit_metadata_manager->metadata_filename);
+	doc = xmlParseFile (gedit_metadata_manager->legacy_metadata_filename);
 
 	if (doc == NULL)
 	{
-		return FALSE;
+		return;
 	}
 
 	cur = xmlDocGetRootElement (doc);
 	if (cur == NULL)
 	{
 		g_message ("The metadata file '%s' is empty",
-		           g_path_get_basename (gedit_metadata_manager->metadata_filename));
+		           gedit_metadata_manager->legacy_metadata_filename);
 		xmlFreeDoc (doc);
 
-		return FALSE;
+		return;
 	}
 
 	if (xmlStrcmp (cur->name, (const xmlChar *) "metadata"))
 	{
 		g_message ("File '%s' is of the wrong type",
-		           g_path_get_basename (gedit_metadata_manager->metadata_filename));
+		           gedit_metadata_manager->legacy_metadata_filename);
 		xmlFreeDoc (doc);
 
-		return FALSE;
+		return;
 	}
 
-	cur = xmlDocGetRootElement (doc);
 	cur = cur->xmlChildrenNode;
 
 	while (cur != NULL)
@@ -287,7 +882,61 @@ load_values (void)
 
 	xmlFreeDoc (doc);
 
-	return TRUE;
+	/* The XML file is not ordered, rebuild the LRU list from the access
+	 * times.
+	 */
+	for (l = gedit_metadata_manager->lru.head; l != NULL; l = l->next)
+	{
+		g_queue_push_tail (&sorted, l->data);
+	}
+
+	g_queue_sort (&sorted, compare_items_atime, NULL);
+
+	g_queue_init (&gedit_metadata_manager->lru);
+
+	for (l = sorted.head; l != NULL; l = l->next)
+	{
+		Item *item = l->data;
+
+		item->lru_link.prev = NULL;
+		item->lru_link.next = NULL;
+		g_queue_push_tail_link (&gedit_metadata_manager->lru, &item->lru_link);
+	}
+
+	g_queue_clear (&sorted);
+
+	gedit_debug_message (DEBUG_METADATA, "%u items imported",
+			     g_hash_table_size (gedit_metadata_manager->items));
+}
+
+static void
+load_values (void)
+{
+	gint lock_fd;
+
+	gedit_debug (DEBUG_METADATA);
+
+	g_return_if_fail (gedit_metadata_manager != NULL);
+	g_return_if_fail (gedit_metadata_manager->values_loaded == FALSE);
+
+	gedit_metadata_manager->values_loaded = TRUE;
+
+	lock_fd = lock_log ();
+
+	if (!replay_log ())
+	{
+		/* First run with the log: import the XML file once, it is
+		 * written in the log format at the next save.
+		 */
+		import_legacy_values ();
+
+		gedit_metadata_manager->needs_compaction = TRUE;
+		gedit_metadata_manager_arm_timeout ();
+	}
+
+	unlock_log (lock_fd);
+
+	evict_items (FALSE);
 }
 
 /**
@@ -314,15 +963,7 @@ gedit_metadata_manager_get (GFile       *location,
 
 	if (!gedit_metadata_manager->values_loaded)
 	{
-		gboolean res;
-
-		res = load_values ();
-
-		if (!res)
-		{
-			g_free (uri);
-			return NULL;
-		}
+		load_values ();
 	}
 
 	item = (Item *)g_hash_table_lookup (gedit_metadata_manager->items,
@@ -333,10 +974,15 @@ gedit_metadata_manager_get (GFile       *location,
 	if (item == NULL)
 		return NULL;
 
-	item->atime = g_get_real_time () / 1000;
+	touch_item (item, g_get_real_time () / 1000);
 
-	if (item->values == NULL)
-		return NULL;
+	/* Log the access time once per save, it is written with the other
+	 * records.
+	 */
+	if (item->touch_generation != gedit_metadata_manager->save_generation)
+	{
+		log_record (RECORD_TOUCH, item, NULL, NULL);
+	}
 
 	value = g_hash_table_lookup (item->values, key);
 
@@ -371,210 +1017,168 @@ gedit_metadata_manager_set (GFile       *location,
 
 	if (!gedit_metadata_manager->values_loaded)
 	{
-		gboolean res;
-
-		res = load_values ();
-
-		if (!res)
-			return;
+		load_values ();
 	}
 
-	item = (Item *)g_hash_table_lookup (gedit_metadata_manager->items,
-					    uri);
+	item = get_or_create_item (uri);
 
-	if (item == NULL)
-	{
-		item = g_new0 (Item, 1);
+	item_set_value (item, key, value);
+	touch_item (item, g_get_real_time () / 1000);
 
-		g_hash_table_insert (gedit_metadata_manager->items,
-				     g_strdup (uri),
-				     item);
-	}
+	log_record (RECORD_SET, item, key, value);
 
-	if (item->values == NULL)
-	{
-		 item->values = g_hash_table_new_full (g_str_hash,
-				 		       g_str_equal,
-						       g_free,
-						       g_free);
-	}
-
-	if (value != NULL)
-	{
-		g_hash_table_insert (item->values,
-				     g_strdup (key),
-				     g_strdup (value));
-	}
-	else
-	{
-		g_hash_table_remove (item->values,
-				     key);
-	}
-
-	item->atime = g_get_real_time () / 1000;
+	evict_items (TRUE);
 
 	g_free (uri);
 
 	gedit_metadata_manager_arm_timeout ();
 }
 
-static void
-save_values (const gchar *key, const gchar *value, xmlNodePtr parent)
+/* Rewrites the log with only the current values. */
+static gboolean
+compact_log (void)
 {
-	xmlNodePtr xml_node;
+	GString *records;
+	GList *l;
+	GError *error = NULL;
+	gboolean ret = TRUE;
 
-#ifdef GEDIT_METADATA_VERBOSE_DEBUG
-	gedit_debug (DEBUG_METADATA);
-#endif
-
-	g_return_if_fail (key != NULL);
-
-	if (value == NULL)
-		return;
-
-	xml_node = xmlNewChild (parent,
-				NULL,
-				(const xmlChar *)"entry",
-				NULL);
-
-	xmlSetProp (xml_node,
-		    (const xmlChar *)"key",
-		    (const xmlChar *)key);
-	xmlSetProp (xml_node,
-		    (const xmlChar *)"value",
-		    (const xmlChar *)value);
-
-#ifdef GEDIT_METADATA_VERBOSE_DEBUG
-	gedit_debug_message (DEBUG_METADATA, "entry: %s = %s", key, value);
-#endif
-}
+	records = g_string_new_len (METADATA_MAGIC, METADATA_MAGIC_LENGTH);
 
-static void
-save_item (const gchar *key, const gpointer *data, xmlNodePtr parent)
-{
-	xmlNodePtr xml_node;
-	const Item *item = (const Item *)data;
-	gchar *atime;
+	/* Least recently used first, so that the replay rebuilds the same LRU
+	 * list.
+	 */
+	for (l = gedit_metadata_manager->lru.tail; l != NULL; l = l->prev)
+	{
+		Item *item = l->data;
+		GHashTableIter iter;
+		gpointer key;
+		gpointer value;
 
-#ifdef GEDIT_METADATA_VERBOSE_DEBUG
-	gedit_debug (DEBUG_METADATA);
-#endif
+		if (g_hash_table_size (item->values) == 0)
+		{
+			append_record (records, RECORD_TOUCH, item, NULL, NULL);
+			continue;
+		}
 
-	g_return_if_fail (key != NULL);
+		g_hash_table_iter_init (&iter, item->values);
 
-	if (item == NULL)
-		return;
+		while (g_hash_table_iter_next (&iter, &key, &value))
+		{
+			append_record (records, RECORD_SET, item, key, value);
+		}
+	}
 
-	xml_node = xmlNewChild (parent, NULL, (const xmlChar *)"document", NULL);
+	if (!g_file_set_contents (gedit_metadata_manager->metadata_filename,
+				  records->str,
+				  records->len,
+				  &error))
+	{
+		g_message ("Could not write the metadata file '%s': %s",
+			   gedit_metadata_manager->metadata_filename,
+			   error->message);
 
-	xmlSetProp (xml_node, (const xmlChar *)"uri", (const xmlChar *)key);
+		g_error_free (error);
 
-#ifdef GEDIT_METADATA_VERBOSE_DEBUG
-	gedit_debug_message (DEBUG_METADATA, "uri: %s", key);
-#endif
+		/* Retry with all the values at the next save. */
+		gedit_metadata_manager->needs_compaction = TRUE;
+		ret = FALSE;
+	}
+	else
+	{
+		gedit_metadata_manager->n_log_records = gedit_metadata_manager->n_live_records;
+		gedit_metadata_manager->needs_compaction = FALSE;
+		gedit_metadata_manager->log_length = records->len;
 
-	atime = g_strdup_printf ("%" G_GINT64_FORMAT, item->atime);
-	xmlSetProp (xml_node, (const xmlChar *)"atime", (const xmlChar *)atime);
+		update_log_identity ();
+	}
 
-#ifdef GEDIT_METADATA_VERBOSE_DEBUG
-	gedit_debug_message (DEBUG_METADATA, "atime: %s", atime);
-#endif
+	gedit_debug_message (DEBUG_METADATA, "Log compacted, %" G_GSIZE_FORMAT " bytes",
+			     records->len);
 
-	g_free (atime);
+	g_string_free (records, TRUE);
 
-    	g_hash_table_foreach (item->values,
-			      (GHFunc)save_values,
-			      xml_node);
+	return ret;
 }
 
-static void
-get_oldest (const gchar *key, const gpointer value, const gchar ** key_to_remove)
+static gboolean
+append_pending_records (void)
 {
-	const Item *item = (const Item *)value;
+	GString *pending = gedit_metadata_manager->pending_records;
+	FILE *file;
+	gboolean ret;
+
+	file = g_fopen (gedit_metadata_manager->metadata_filename, "ab");
 
-	if (*key_to_remove == NULL)
+	if (file == NULL)
 	{
-		*key_to_remove = key;
+		return FALSE;
 	}
-	else
-	{
-		const Item *item_to_remove =
-			g_hash_table_lookup (gedit_metadata_manager->items,
-					     *key_to_remove);
 
-		g_return_if_fail (item_to_remove != NULL);
+	ret = fwrite (pending->str, 1, pending->len, file) == pending->len;
 
-		if (item->atime < item_to_remove->atime)
-		{
-			*key_to_remove = key;
-		}
+	if (fclose (file) != 0)
+	{
+		ret = FALSE;
 	}
-}
 
-static void
-resize_items (void)
-{
-	while (g_hash_table_size (gedit_metadata_manager->items) > MAX_ITEMS)
+	if (ret)
 	{
-		gpointer key_to_remove = NULL;
-
-		g_hash_table_foreach (gedit_metadata_manager->items,
-				      (GHFunc)get_oldest,
-				      &key_to_remove);
+		gedit_metadata_manager->log_length += pending->len;
+		gedit_metadata_manager->n_log_records += gedit_metadata_manager->n_pending_records;
+	}
 
-		g_return_if_fail (key_to_remove != NULL);
+	gedit_debug_message (DEBUG_METADATA, "%" G_GSIZE_FORMAT " bytes appended",
+			     pending->len);
 
-		g_hash_table_remove (gedit_metadata_manager->items,
-				     key_to_remove);
-	}
+	return ret;
 }
 
 static gboolean
 gedit_metadata_manager_save (gpointer data)
 {
-	xmlDocPtr  doc;
-	xmlNodePtr root;
+	gchar *cache_dir;
+	int res;
+	gint lock_fd;
 
 	gedit_debug (DEBUG_METADATA);
 
 	gedit_metadata_manager->timeout_id = 0;
 
-	resize_items ();
+	/* make sure the cache dir exists */
+	cache_dir = g_path_get_dirname (gedit_metadata_manager->metadata_filename);
+	res = g_mkdir_with_parents (cache_dir, 0755);
+	g_free (cache_dir);
 
-	xmlIndentTreeOutput = TRUE;
+	if (res == -1)
+	{
+		return FALSE;
+	}
 
-	doc = xmlNewDoc ((const xmlChar *)"1.0");
-	if (doc == NULL)
-		return TRUE;
+	lock_fd = lock_log ();
 
-	/* Create metadata root */
-	root = xmlNewDocNode (doc, NULL, (const xmlChar *)"metadata", NULL);
-	xmlDocSetRootElement (doc, root);
+	sync_with_log ();
 
-    	g_hash_table_foreach (gedit_metadata_manager->items,
-			      (GHFunc)save_item,
-			      root);
+	/* The other instances may have added items. */
+	evict_items (TRUE);
 
-	/* FIXME: lock file - Paolo */
-	if (gedit_metadata_manager->metadata_filename != NULL)
+	if (gedit_metadata_manager->needs_compaction ||
+	    gedit_metadata_manager->n_log_records + gedit_metadata_manager->n_pending_records >
+	    2 * gedit_metadata_manager->n_live_records + COMPACTION_MIN_RECORDS)
 	{
-		gchar *cache_dir;
-		int res;
-
-		/* make sure the cache dir exists */
-		cache_dir = g_path_get_dirname (gedit_metadata_manager->metadata_filename);
-		res = g_mkdir_with_parents (cache_dir, 0755);
-		if (res != -1)
-		{
-			xmlSaveFormatFile (gedit_metadata_manager->metadata_filename,
-			                   doc,
-			                   1);
-		}
-
-		g_free (cache_dir);
+		compact_log ();
+	}
+	else if (!append_pending_records ())
+	{
+		/* A partial write leaves a truncated record. */
+		compact_log ();
 	}
 
-	xmlFreeDoc (doc);
+	unlock_log (lock_fd);
+
+	g_string_truncate (gedit_metadata_manager->pending_records, 0);
+	gedit_metadata_manager->n_pending_records = 0;
+	gedit_metadata_manager->save_generation++;
 
 	gedit_debug_message (DEBUG_METADATA, "DONE");
 
@@ -49,10 +49,15 @@ struct _GeditReplaceDialogPrivate
 	GtkWidget *backwards_checkbutton;
 	GtkWidget *wrap_around_checkbutton;
 	GtkWidget *close_button;
+	GtkWidget *replace_all_box;
+	GtkWidget *replace_all_progressbar;
+	GtkWidget *replace_all_stop_button;
 
 	GeditDocument *active_document;
 
 	guint idle_update_sensitivity_id;
+
+	guint replace_all_running : 1;
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (GeditReplaceDialog, gedit_replace_dialog, GTK_TYPE_DIALOG)
@@ -300,7 +305,7 @@ update_replace_response_sensitivity_cb (GeditReplaceDialog *dialog)
 
 	gtk_dialog_set_response_sensitive (GTK_DIALOG (dialog),
 					   GEDIT_REPLACE_DIALOG_REPLACE_RESPONSE,
-					   pos > 0);
+					   pos > 0 && !dialog->priv->replace_all_running);
 
 	dialog->priv->idle_update_sensitivity_id = 0;
 	return G_SOURCE_REMOVE;
@@ -347,7 +352,10 @@ update_responses_sensitivity (GeditReplaceDialog *dialog)
 
 	search_text = gtk_entry_get_text (GTK_ENTRY (dialog->priv->search_text_entry));
 
-	if (search_text[0] == '\0')
+	/* The search settings and the buffer must not change under a running
+	 * Replace All.
+	 */
+	if (search_text[0] == '\0' || dialog->priv->replace_all_running)
 	{
 		gtk_dialog_set_response_sensitive (GTK_DIALOG (dialog),
 						   GEDIT_REPLACE_DIALOG_FIND_RESPONSE,
@@ -541,6 +549,18 @@ gedit_replace_dialog_class_init (GeditReplaceDialogClass *klass)
 	gtk_widget_class_bind_template_child_private (widget_class, GeditReplaceDialog, backwards_checkbutton);
 	gtk_widget_class_bind_template_child_private (widget_class, GeditReplaceDialog, wrap_around_checkbutton);
 	gtk_widget_class_bind_template_child_private (widget_class, GeditReplaceDialog, close_button);
+	gtk_widget_class_bind_template_child_private (widget_class, GeditReplaceDialog, replace_all_box);
+	gtk_widget_class_bind_template_child_private (widget_class, GeditReplaceDialog, replace_all_progressbar);
+	gtk_widget_class_bind_template_child_private (widget_class, GeditReplaceDialog, replace_all_stop_button);
+}
+
+static void
+hide_replace_all_progress (GeditReplaceDialog *dialog)
+{
+	if (!dialog->priv->replace_all_running)
+	{
+		gtk_widget_hide (dialog->priv->replace_all_box);
+	}
 }
 
 static void
@@ -548,6 +568,7 @@ search_text_entry_changed (GtkEditable        *editable,
 			   GeditReplaceDialog *dialog)
 {
 	set_search_error (dialog, NULL);
+	hide_replace_all_progress (dialog);
 
 	update_responses_sensitivity (dialog);
 }
@@ -613,6 +634,8 @@ show_cb (GeditReplaceDialog *dialog)
 	gchar *selection = NULL;
 	gint selection_length;
 
+	hide_replace_all_progress (dialog);
+
 	window = get_gedit_window (dialog);
 
 	if (window == NULL)
@@ -656,6 +679,14 @@ show_cb (GeditReplaceDialog *dialog)
 	g_free (selection);
 }
 
+static void
+replace_all_stop_button_clicked (GtkButton          *button,
+				 GeditReplaceDialog *dialog)
+{
+	gtk_dialog_response (GTK_DIALOG (dialog),
+			     GEDIT_REPLACE_DIALOG_STOP_REPLACE_ALL_RESPONSE);
+}
+
 static void
 hide_cb (GeditReplaceDialog *dialog)
 {
@@ -725,6 +756,11 @@ gedit_replace_dialog_init (GeditReplaceDialog *dlg)
 			  G_CALLBACK (regex_checkbutton_toggled),
 			  dlg);
 
+	g_signal_connect (dlg->priv->replace_all_stop_button,
+			  "clicked",
+			  G_CALLBACK (replace_all_stop_button_clicked),
+			  dlg);
+
 	g_signal_connect (dlg,
 			  "show",
 			  G_CALLBACK (show_cb),
@@ -802,6 +838,64 @@ gedit_replace_dialog_get_backwards (GeditReplaceDialog *dialog)
 	return gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (dialog->priv->backwards_checkbutton));
 }
 
+/**
+ * gedit_replace_dialog_set_replace_all_progress:
+ * @dialog: a #GeditReplaceDialog.
+ * @fraction: the fraction of the document done.
+ * @text: the progress text.
+ *
+ * Shows the progress of a running Replace All, with a button to stop it. The
+ * buttons of the dialog are insensitive until
+ * gedit_replace_dialog_replace_all_finished() is called.
+ */
+void
+gedit_replace_dialog_set_replace_all_progress (GeditReplaceDialog *dialog,
+					       gdouble             fraction,
+					       const gchar        *text)
+{
+	g_return_if_fail (GEDIT_IS_REPLACE_DIALOG (dialog));
+
+	if (!dialog->priv->replace_all_running)
+	{
+		dialog->priv->replace_all_running = TRUE;
+
+		gtk_widget_show (dialog->priv->replace_all_stop_button);
+		gtk_widget_show (dialog->priv->replace_all_box);
+
+		gtk_dialog_set_response_sensitive (GTK_DIALOG (dialog),
+						   GEDIT_REPLACE_DIALOG_REPLACE_RESPONSE,
+						   FALSE);
+		update_responses_sensitivity (dialog);
+	}
+
+	gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (dialog->priv->replace_all_progressbar),
+				       CLAMP (fraction, 0.0, 1.0));
+	gtk_progress_bar_set_text (GTK_PROGRESS_BAR (dialog->priv->replace_all_progressbar),
+				   text);
+}
+
+/**
+ * gedit_replace_dialog_replace_all_finished:
+ * @dialog: a #GeditReplaceDialog.
+ * @summary: the text shown in place of the progress.
+ */
+void
+gedit_replace_dialog_replace_all_finished (GeditReplaceDialog *dialog,
+					   const gchar        *summary)
+{
+	g_return_if_fail (GEDIT_IS_REPLACE_DIALOG (dialog));
+
+	dialog->priv->replace_all_running = FALSE;
+
+	gtk_widget_hide (dialog->priv->replace_all_stop_button);
+
+	gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (dialog->priv->replace_all_progressbar), 1.0);
+	gtk_progress_bar_set_text (GTK_PROGRESS_BAR (dialog->priv->replace_all_progressbar),
+				   summary);
+
+	update_responses_sensitivity (dialog);
+}
+
 /* This function returns the original search text. The search text from the
  * search settings has been unescaped, and the escape function is not
  * reciprocal. So to avoid bugs, we have to deal with the original search text.
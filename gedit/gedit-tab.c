@@ -32,6 +32,8 @@
 #include "gedit-recent.h"
 #include "gedit-utils.h"
 #include "gedit-io-error-info-bar.h"
+#include "gedit-huge-file.h"
+#include "gedit-file-classifier.h"
 #include "gedit-print-job.h"
 #include "gedit-print-preview.h"
 #include "gedit-progress-info-bar.h"
@@ -42,6 +44,35 @@
 
 #define GEDIT_TAB_KEY "GEDIT_TAB_KEY"
 
+/* Number of lines of a huge file kept in the buffer. */
+#define HUGE_FILE_WINDOW_LINES 2000
+
+/* The window is moved when the visible area gets closer than this number of
+ * lines to one of its ends.
+ */
+#define HUGE_FILE_WINDOW_MARGIN (HUGE_FILE_WINDOW_LINES / 8)
+
+/* The file loader inserts the text in the buffer chunk by chunk. Its callbacks
+ * run at a lower priority than the redraws and the GtkTextView validation, so
+ * that what is already loaded is painted without waiting for the end of the
+ * loading.
+ */
+#define LOADING_PRIORITY (GDK_PRIORITY_REDRAW + 10)
+
+/* Number of lines to load after the requested line before scrolling to it. */
+#define LOADING_SCREEN_LINES 100
+
+/* At most this number of file loaders run at the same time for each URI
+ * scheme, the other tabs wait in the pending loads queue. The local files
+ * don't wait for remote loads that hang, and the other way around.
+ */
+#define MAX_RUNNING_LOADS 4
+
+/* Replace All works in slices of this time, in seconds, between which the
+ * main loop runs.
+ */
+#define REPLACE_ALL_TIME_SLICE 0.010
+
 struct _GeditTabPrivate
 {
 	GSettings	       *editor;
@@ -61,12 +92,27 @@ struct _GeditTabPrivate
 	/* tmp data for loading */
 	GtkSourceFileLoader    *loader;
 	GCancellable           *cancellable;
+	const GtkSourceEncoding *tmp_encoding;
 	gint                    tmp_line_pos;
 	gint                    tmp_column_pos;
+	gint                    tmp_restore_offset;
 	guint			idle_scroll;
 
+	/* Interned URI scheme of the running load, whose slot it takes. */
+	const gchar            *load_scheme;
+
 	GTimer 		       *timer;
 
+	/* Read-only mode for files bigger than the huge-file-threshold
+	 * setting: the file is read on demand and the buffer only contains
+	 * a window of HUGE_FILE_WINDOW_LINES lines starting at
+	 * huge_file_first_line.
+	 */
+	GeditHugeFile          *huge_file;
+	GCancellable           *huge_file_search_cancellable;
+	gint64                  huge_file_first_line;
+	guint                   huge_file_idle_scroll;
+
 	gint                    auto_save_interval;
 	guint                   auto_save_timeout;
 
@@ -77,6 +123,7 @@ struct _GeditTabPrivate
 
 	/* tmp data for loading */
 	guint			user_requested_encoding : 1;
+	guint			requested_position_shown : 1;
 };
 
 typedef struct _SaverData SaverData;
@@ -108,6 +155,13 @@ struct _SaverData
 
 G_DEFINE_TYPE_WITH_PRIVATE (GeditTab, gedit_tab, GTK_TYPE_BOX)
 
+/* Tabs waiting for a free file loader slot, shared by all the windows. */
+static GQueue pending_loads = G_QUEUE_INIT;
+static guint pending_loads_idle_id = 0;
+
+/* Interned URI scheme -> number of running loads. */
+static GHashTable *running_loads = NULL;
+
 enum
 {
 	PROP_0,
@@ -133,6 +187,8 @@ static void load (GeditTab                *tab,
 		  gint                     line_pos,
 		  gint                     column_pos);
 
+static void finish_running_load (GeditTab *tab);
+
 static void save (GeditTab *tab);
 
 static SaverData *
@@ -191,6 +247,7 @@ update_auto_save_timeout (GeditTab *tab)
 
 	if (tab->priv->state == GEDIT_TAB_STATE_NORMAL &&
 	    tab->priv->auto_save &&
+	    tab->priv->huge_file == NULL &&
 	    !gedit_document_is_untitled (doc) &&
 	    !gedit_document_get_readonly (doc))
 	{
@@ -278,6 +335,13 @@ gedit_tab_dispose (GObject *object)
 	g_clear_object (&tab->priv->print_job);
 	g_clear_object (&tab->priv->print_preview);
 	g_clear_object (&tab->priv->task_saver);
+	g_clear_object (&tab->priv->huge_file);
+
+	if (tab->priv->huge_file_search_cancellable != NULL)
+	{
+		g_cancellable_cancel (tab->priv->huge_file_search_cancellable);
+		g_clear_object (&tab->priv->huge_file_search_cancellable);
+	}
 
 	clear_loading (tab);
 
@@ -302,6 +366,12 @@ gedit_tab_finalize (GObject *object)
 		tab->priv->idle_scroll = 0;
 	}
 
+	if (tab->priv->huge_file_idle_scroll != 0)
+	{
+		g_source_remove (tab->priv->huge_file_idle_scroll);
+		tab->priv->huge_file_idle_scroll = 0;
+	}
+
 	G_OBJECT_CLASS (gedit_tab_parent_class)->finalize (object);
 }
 
@@ -1169,6 +1239,32 @@ display_externally_modified_notification (GeditTab *tab)
 			  tab);
 }
 
+static void
+check_externally_modified_cb (GeditDocument *doc,
+			      GAsyncResult  *result,
+			      GeditTab      *tab)
+{
+	gboolean externally_modified;
+
+	externally_modified = _gedit_document_check_externally_modified_finish (doc, result);
+
+	/* The tab may have been closed, or its state changed, in the
+	 * meantime.
+	 */
+	if (externally_modified &&
+	    gtk_widget_get_parent (GTK_WIDGET (tab)) != NULL &&
+	    tab->priv->state == GEDIT_TAB_STATE_NORMAL &&
+	    tab->priv->ask_if_externally_modified)
+	{
+		gedit_tab_set_state (tab, GEDIT_TAB_STATE_EXTERNALLY_MODIFIED_NOTIFICATION);
+
+		display_externally_modified_notification (tab);
+	}
+
+	/* Async operation finished. */
+	g_object_unref (tab);
+}
+
 static gboolean
 view_focused_in (GtkWidget     *widget,
                  GdkEventFocus *event,
@@ -1198,12 +1294,12 @@ view_focused_in (GtkWidget     *widget,
 		return GDK_EVENT_PROPAGATE;
 	}
 
-	if (_gedit_document_check_externally_modified (doc))
-	{
-		gedit_tab_set_state (tab, GEDIT_TAB_STATE_EXTERNALLY_MODIFIED_NOTIFICATION);
+	/* Keep the tab alive during the async operation. */
+	g_object_ref (tab);
 
-		display_externally_modified_notification (tab);
-	}
+	_gedit_document_check_externally_modified_async (doc,
+							 (GAsyncReadyCallback) check_externally_modified_cb,
+							 tab);
 
 	return GDK_EVENT_PROPAGATE;
 }
@@ -1631,6 +1727,53 @@ gedit_tab_get_from_document (GeditDocument *doc)
 	return g_object_get_data (G_OBJECT (doc), GEDIT_TAB_KEY);
 }
 
+/* Scrolls to the position where the cursor will be placed at the end of the
+ * loading, as soon as that part of the file is in the buffer.
+ */
+static void
+show_requested_position (GeditTab *tab)
+{
+	GtkTextBuffer *buffer = GTK_TEXT_BUFFER (gedit_tab_get_document (tab));
+	GtkTextIter iter;
+
+	if (tab->priv->requested_position_shown)
+	{
+		return;
+	}
+
+	if (tab->priv->tmp_line_pos > 0)
+	{
+		if (gtk_text_buffer_get_line_count (buffer) < tab->priv->tmp_line_pos + LOADING_SCREEN_LINES)
+		{
+			return;
+		}
+
+		gtk_text_buffer_get_iter_at_line (buffer, &iter, tab->priv->tmp_line_pos - 1);
+	}
+	else if (tab->priv->tmp_restore_offset > 0)
+	{
+		if (gtk_text_buffer_get_char_count (buffer) <= tab->priv->tmp_restore_offset)
+		{
+			return;
+		}
+
+		gtk_text_buffer_get_iter_at_offset (buffer, &iter, tab->priv->tmp_restore_offset);
+		gtk_text_iter_set_line_offset (&iter, 0);
+	}
+	else
+	{
+		return;
+	}
+
+	gedit_debug_message (DEBUG_TAB, "Scrolling to line %d before the end of the loading",
+			     gtk_text_iter_get_line (&iter));
+
+	gtk_text_buffer_place_cursor (buffer, &iter);
+	gedit_view_scroll_to_cursor (gedit_tab_get_view (tab));
+
+	tab->priv->requested_position_shown = TRUE;
+}
+
 static void
 loader_progress_cb (goffset   size,
 		    goffset   total_size,
@@ -1662,6 +1805,8 @@ loader_progress_cb (goffset   size,
 	}
 
 	info_bar_set_progress (tab, size, total_size);
+
+	show_requested_position (tab);
 }
 
 static void
@@ -1722,6 +1867,8 @@ load_cb (GtkSourceFileLoader *loader,
 	gboolean create_named_new_doc;
 	GError *error = NULL;
 
+	finish_running_load (tab);
+
 	g_return_if_fail (tab->priv->state == GEDIT_TAB_STATE_LOADING ||
 			  tab->priv->state == GEDIT_TAB_STATE_REVERTING);
 
@@ -1985,17 +2132,39 @@ get_candidate_encodings (GeditTab *tab)
 	return encodings;
 }
 
+/* Whether classifying the beginning of the file can change the encoding
+ * trial: UTF-8 is a candidate, but another encoding is tried first.
+ */
+static gboolean
+should_classify (GeditTab *tab)
+{
+	const GtkSourceEncoding *utf8_encoding = gtk_source_encoding_get_utf8 ();
+	GSList *candidate_encodings;
+	gboolean ret;
+
+	candidate_encodings = get_candidate_encodings (tab);
+
+	ret = (candidate_encodings != NULL &&
+	       candidate_encodings->data != utf8_encoding &&
+	       g_slist_find (candidate_encodings, utf8_encoding) != NULL);
+
+	g_slist_free (candidate_encodings);
+
+	return ret;
+}
+
+/* @classification can be %NULL if the beginning of the file has not been
+ * classified.
+ */
 static void
-load (GeditTab                *tab,
-      const GtkSourceEncoding *encoding,
-      gint                     line_pos,
-      gint                     column_pos)
+start_loader (GeditTab                      *tab,
+	      const GeditFileClassification *classification)
 {
+	const GtkSourceEncoding *encoding = tab->priv->tmp_encoding;
+	gint line_pos = tab->priv->tmp_line_pos;
 	GSList *candidate_encodings = NULL;
 	GeditDocument *doc;
 
-	g_return_if_fail (GTK_SOURCE_IS_FILE_LOADER (tab->priv->loader));
-
 	if (encoding != NULL)
 	{
 		tab->priv->user_requested_encoding = TRUE;
@@ -2003,27 +2172,51 @@ load (GeditTab                *tab,
 	}
 	else
 	{
+		const GtkSourceEncoding *utf8_encoding = gtk_source_encoding_get_utf8 ();
+
 		tab->priv->user_requested_encoding = FALSE;
 		candidate_encodings = get_candidate_encodings (tab);
+
+		/* An 8-bit encoding tried first would accept valid UTF-8
+		 * and load garbage. An ASCII file is loaded the same way with
+		 * any candidate, the first one is kept so that it is saved
+		 * back with it. The other candidates stay in case the rest of
+		 * the file is not valid UTF-8.
+		 */
+		if (classification != NULL &&
+		    classification->file_class == GEDIT_FILE_CLASS_UTF8 &&
+		    g_slist_find (candidate_encodings, utf8_encoding) != NULL)
+		{
+			gedit_debug_message (DEBUG_TAB, "Trying UTF-8 first");
+
+			candidate_encodings = g_slist_remove (candidate_encodings, utf8_encoding);
+			candidate_encodings = g_slist_prepend (candidate_encodings, (gpointer) utf8_encoding);
+		}
 	}
 
 	gtk_source_file_loader_set_candidate_encodings (tab->priv->loader, candidate_encodings);
 	g_slist_free (candidate_encodings);
 
-	tab->priv->tmp_line_pos = line_pos;
-	tab->priv->tmp_column_pos = column_pos;
-
-	g_clear_object (&tab->priv->cancellable);
-	tab->priv->cancellable = g_cancellable_new ();
+	tab->priv->tmp_restore_offset = 0;
+	tab->priv->requested_position_shown = FALSE;
 
 	doc = gedit_tab_get_document (tab);
-	g_signal_emit_by_name (doc, "load");
 
-	/* Keep the tab alive during the async operation. */
-	g_object_ref (tab);
+	if (line_pos <= 0 &&
+	    g_settings_get_boolean (tab->priv->editor, GEDIT_SETTINGS_RESTORE_CURSOR_POSITION))
+	{
+		gchar *pos;
+
+		pos = gedit_document_get_metadata (doc, GEDIT_METADATA_ATTRIBUTE_POSITION);
+
+		tab->priv->tmp_restore_offset = pos != NULL ? atoi (pos) : 0;
+		g_free (pos);
+	}
+
+	g_signal_emit_by_name (doc, "load");
 
 	gtk_source_file_loader_load_async (tab->priv->loader,
-					   G_PRIORITY_DEFAULT,
+					   LOADING_PRIORITY,
 					   tab->priv->cancellable,
 					   (GFileProgressCallback) loader_progress_cb,
 					   tab,
@@ -2032,177 +2225,966 @@ load (GeditTab                *tab,
 					   tab);
 }
 
-void
-_gedit_tab_load (GeditTab                *tab,
-		 GFile                   *location,
-		 const GtkSourceEncoding *encoding,
-		 gint                     line_pos,
-		 gint                     column_pos,
-		 gboolean                 create)
+static void
+classify_cb (GFile        *location,
+	     GAsyncResult *result,
+	     GeditTab     *tab)
 {
-	GeditDocument *doc;
-	GtkSourceFile *file;
-
-	g_return_if_fail (GEDIT_IS_TAB (tab));
-	g_return_if_fail (G_IS_FILE (location));
-	g_return_if_fail (tab->priv->state == GEDIT_TAB_STATE_NORMAL);
+	GeditFileClassification classification;
+	gboolean classified;
 
-	gedit_tab_set_state (tab, GEDIT_TAB_STATE_LOADING);
-
-	doc = gedit_tab_get_document (tab);
-	file = gedit_document_get_file (doc);
+	/* Errors, if any, are reported by the file loader. */
+	classified = _gedit_file_classify_finish (location, result, &classification, NULL);
 
-	if (tab->priv->loader != NULL)
+	/* The tab has been destroyed in the meantime. */
+	if (tab->priv->loader == NULL)
 	{
-		g_warning ("GeditTab: file loader already exists.");
-		g_object_unref (tab->priv->loader);
+		finish_running_load (tab);
+		g_object_unref (tab);
+		return;
 	}
 
-	gtk_source_file_set_location (file, location);
-
-	tab->priv->loader = gtk_source_file_loader_new (GTK_SOURCE_BUFFER (doc), file);
-
-	_gedit_document_set_create (doc, create);
-
-	load (tab, encoding, line_pos, column_pos);
+	start_loader (tab, classified ? &classification : NULL);
 }
 
-void
-_gedit_tab_load_stream (GeditTab                *tab,
-			GInputStream            *stream,
-			const GtkSourceEncoding *encoding,
-			gint                     line_pos,
-			gint                     column_pos)
+static void
+metadata_ready_cb (GeditDocument *doc,
+		   GAsyncResult  *result,
+		   GeditTab      *tab)
 {
-	GeditDocument *doc;
-	GtkSourceFile *file;
-
-	g_return_if_fail (GEDIT_IS_TAB (tab));
-	g_return_if_fail (G_IS_INPUT_STREAM (stream));
-	g_return_if_fail (tab->priv->state == GEDIT_TAB_STATE_NORMAL);
-
-	gedit_tab_set_state (tab, GEDIT_TAB_STATE_LOADING);
+	GFile *location;
 
-	doc = gedit_tab_get_document (tab);
-	file = gedit_document_get_file (doc);
+	_gedit_document_wait_metadata_finish (doc, result, NULL);
 
-	if (tab->priv->loader != NULL)
+	/* The tab has been destroyed in the meantime. */
+	if (tab->priv->loader == NULL)
 	{
-		g_warning ("GeditTab: file loader already exists.");
-		g_object_unref (tab->priv->loader);
+		finish_running_load (tab);
+		g_object_unref (tab);
+		return;
 	}
 
-	gtk_source_file_set_location (file, NULL);
-
-	tab->priv->loader = gtk_source_file_loader_new_from_stream (GTK_SOURCE_BUFFER (doc),
-								    file,
-								    stream);
-
-	_gedit_document_set_create (doc, FALSE);
+	location = gtk_source_file_loader_get_location (tab->priv->loader);
 
-	load (tab, encoding, line_pos, column_pos);
+	/* Classifying the beginning of a remote file would read it twice. */
+	if (tab->priv->tmp_encoding == NULL &&
+	    location != NULL &&
+	    g_file_is_native (location) &&
+	    should_classify (tab))
+	{
+		_gedit_file_classify_async (location,
+					    tab->priv->cancellable,
+					    (GAsyncReadyCallback) classify_cb,
+					    tab);
+	}
+	else
+	{
+		start_loader (tab, NULL);
+	}
 }
 
-void
-_gedit_tab_revert (GeditTab *tab)
+/* The streams have no location, they share the "" scheme. */
+static const gchar *
+get_load_scheme (GeditTab *tab)
 {
-	GeditDocument *doc;
-	GtkSourceFile *file;
 	GFile *location;
+	gchar *scheme;
+	const gchar *ret;
 
-	g_return_if_fail (GEDIT_IS_TAB (tab));
-	g_return_if_fail (tab->priv->state == GEDIT_TAB_STATE_NORMAL ||
-			  tab->priv->state == GEDIT_TAB_STATE_EXTERNALLY_MODIFIED_NOTIFICATION);
+	location = gtk_source_file_loader_get_location (tab->priv->loader);
 
-	if (tab->priv->state == GEDIT_TAB_STATE_EXTERNALLY_MODIFIED_NOTIFICATION)
+	if (location == NULL)
 	{
-		set_info_bar (tab, NULL, GTK_RESPONSE_NONE);
+		return g_intern_static_string ("");
 	}
 
-	doc = gedit_tab_get_document (tab);
-	file = gedit_document_get_file (doc);
-	location = gtk_source_file_get_location (file);
-	g_return_if_fail (location != NULL);
+	scheme = g_file_get_uri_scheme (location);
+	ret = g_intern_string (scheme != NULL ? scheme : "");
+	g_free (scheme);
 
-	gedit_tab_set_state (tab, GEDIT_TAB_STATE_REVERTING);
+	return ret;
+}
 
-	if (tab->priv->loader != NULL)
+static guint
+get_n_running_loads (const gchar *scheme)
+{
+	if (running_loads == NULL)
 	{
-		g_warning ("GeditTab: file loader already exists.");
-		g_object_unref (tab->priv->loader);
+		return 0;
 	}
 
-	tab->priv->loader = gtk_source_file_loader_new (GTK_SOURCE_BUFFER (doc), file);
-
-	load (tab, NULL, 0, 0);
+	return GPOINTER_TO_UINT (g_hash_table_lookup (running_loads, scheme));
 }
 
+/* The tab must be referenced, the reference is released by load_cb(). */
 static void
-close_printing (GeditTab *tab)
+start_load (GeditTab *tab)
 {
-	if (tab->priv->print_preview != NULL)
+	const gchar *scheme;
+
+	if (running_loads == NULL)
 	{
-		gtk_widget_destroy (tab->priv->print_preview);
+		running_loads = g_hash_table_new (g_direct_hash, g_direct_equal);
 	}
 
-	g_clear_object (&tab->priv->print_job);
-	g_clear_object (&tab->priv->print_preview);
+	scheme = get_load_scheme (tab);
+	g_hash_table_insert (running_loads,
+			     (gpointer) scheme,
+			     GUINT_TO_POINTER (get_n_running_loads (scheme) + 1));
 
-	/* destroy the info bar */
-	set_info_bar (tab, NULL, GTK_RESPONSE_NONE);
+	tab->priv->load_scheme = scheme;
 
-	gedit_tab_set_state (tab, GEDIT_TAB_STATE_NORMAL);
+	/* The candidate encodings and the cursor position come from the
+	 * metadata, which are queried asynchronously.
+	 */
+	_gedit_document_wait_metadata_async (gedit_tab_get_document (tab),
+					     tab->priv->cancellable,
+					     (GAsyncReadyCallback) metadata_ready_cb,
+					     tab);
 }
 
-static void
-saver_progress_cb (goffset   size,
-		   goffset   total_size,
-		   GeditTab *tab)
+/* Starts the queued loads whose scheme has a free slot, in the order of the
+ * queue. The loads are started from an idle, so when a lot of files are
+ * opened at once the tabs are all created before the first loader runs.
+ */
+static gboolean
+pending_loads_idle_cb (gpointer user_data)
 {
-	gdouble elapsed_time;
-	gdouble total_time;
-	gdouble remaining_time;
-
-	g_return_if_fail (tab->priv->state == GEDIT_TAB_STATE_SAVING);
+	GList *l = pending_loads.head;
 
-	if (tab->priv->timer == NULL)
+	while (l != NULL)
 	{
-		tab->priv->timer = g_timer_new ();
-	}
+		GeditTab *tab = l->data;
+		GList *next = l->next;
 
-	elapsed_time = g_timer_elapsed (tab->priv->timer, NULL);
+		/* The tab has been destroyed in the meantime. */
+		if (tab->priv->loader == NULL)
+		{
+			g_queue_delete_link (&pending_loads, l);
+			g_object_unref (tab);
+		}
+		else if (get_n_running_loads (get_load_scheme (tab)) < MAX_RUNNING_LOADS)
+		{
+			g_queue_delete_link (&pending_loads, l);
+			start_load (tab);
+		}
 
-	/* elapsed_time / total_time = size / total_size */
-	total_time = (elapsed_time * total_size) / size;
+		l = next;
+	}
 
-	remaining_time = total_time - elapsed_time;
+	pending_loads_idle_id = 0;
+	return G_SOURCE_REMOVE;
+}
 
-	/* Approximately more than 3 seconds remaining. */
-	if (remaining_time > 3.0)
+static void
+schedule_pending_loads (void)
+{
+	if (pending_loads_idle_id == 0 &&
+	    !g_queue_is_empty (&pending_loads))
 	{
-		show_saving_info_bar (tab);
+		pending_loads_idle_id = g_idle_add (pending_loads_idle_cb, NULL);
 	}
-
-	info_bar_set_progress (tab, size, total_size);
 }
 
+/* Frees the slot of a load started by start_load(). */
 static void
-save_cb (GtkSourceFileSaver *saver,
-	 GAsyncResult       *result,
-	 GeditTab           *tab)
+finish_running_load (GeditTab *tab)
 {
-	GeditDocument *doc = gedit_tab_get_document (tab);
-	GFile *location = gtk_source_file_saver_get_location (saver);
-	GError *error = NULL;
+	const gchar *scheme = tab->priv->load_scheme;
+	guint n_loads;
 
-	g_return_if_fail (tab->priv->state == GEDIT_TAB_STATE_SAVING);
-	g_return_if_fail (tab->priv->task_saver != NULL);
+	g_return_if_fail (scheme != NULL);
 
-	gtk_source_file_saver_save_finish (saver, result, &error);
+	n_loads = get_n_running_loads (scheme);
+	g_assert (n_loads > 0);
 
-	if (error != NULL)
+	if (n_loads == 1)
 	{
-		gedit_debug_message (DEBUG_TAB, "File saving error: %s", error->message);
+		g_hash_table_remove (running_loads, scheme);
+	}
+	else
+	{
+		g_hash_table_insert (running_loads, (gpointer) scheme, GUINT_TO_POINTER (n_loads - 1));
+	}
+
+	tab->priv->load_scheme = NULL;
+
+	schedule_pending_loads ();
+}
+
+static void
+load (GeditTab                *tab,
+      const GtkSourceEncoding *encoding,
+      gint                     line_pos,
+      gint                     column_pos)
+{
+	g_return_if_fail (GTK_SOURCE_IS_FILE_LOADER (tab->priv->loader));
+
+	tab->priv->tmp_encoding = encoding;
+	tab->priv->tmp_line_pos = line_pos;
+	tab->priv->tmp_column_pos = column_pos;
+
+	g_clear_object (&tab->priv->cancellable);
+	tab->priv->cancellable = g_cancellable_new ();
+
+	/* Keep the tab alive while it is queued and during the async
+	 * operation.
+	 */
+	g_object_ref (tab);
+
+	g_queue_push_tail (&pending_loads, tab);
+	schedule_pending_loads ();
+}
+
+static void
+huge_file_show_window (GeditTab *tab,
+		       gint64    first_line)
+{
+	GtkTextBuffer *buffer = GTK_TEXT_BUFFER (gedit_tab_get_document (tab));
+	gint64 n_lines;
+	gchar *text;
+
+	n_lines = gedit_huge_file_get_n_lines (tab->priv->huge_file);
+	first_line = CLAMP (first_line, 0, MAX (0, n_lines - HUGE_FILE_WINDOW_LINES));
+
+	text = gedit_huge_file_get_lines (tab->priv->huge_file,
+					  first_line,
+					  HUGE_FILE_WINDOW_LINES);
+
+	gtk_source_buffer_begin_not_undoable_action (GTK_SOURCE_BUFFER (buffer));
+	gtk_text_buffer_set_text (buffer, text, -1);
+	gtk_source_buffer_end_not_undoable_action (GTK_SOURCE_BUFFER (buffer));
+
+	gtk_text_buffer_set_modified (buffer, FALSE);
+
+	tab->priv->huge_file_first_line = first_line;
+
+	g_free (text);
+}
+
+static gboolean
+huge_file_window_contains_line (GeditTab *tab,
+				gint64    line)
+{
+	GtkTextBuffer *buffer = GTK_TEXT_BUFFER (gedit_tab_get_document (tab));
+	gint64 first_line = tab->priv->huge_file_first_line;
+
+	return (line >= first_line &&
+		line < first_line + gtk_text_buffer_get_line_count (buffer));
+}
+
+static void
+huge_file_ensure_line_in_window (GeditTab *tab,
+				 gint64    line)
+{
+	if (!huge_file_window_contains_line (tab, line))
+	{
+		huge_file_show_window (tab, line - HUGE_FILE_WINDOW_LINES / 2);
+	}
+}
+
+/* Doesn't move the window, the line must already be in it. */
+static void
+huge_file_get_iter_at_line_offset (GeditTab    *tab,
+				   GtkTextIter *iter,
+				   gint64       line,
+				   gint         char_offset)
+{
+	GtkTextBuffer *buffer = GTK_TEXT_BUFFER (gedit_tab_get_document (tab));
+	gint buffer_line;
+
+	buffer_line = CLAMP (line - tab->priv->huge_file_first_line,
+			     0,
+			     gtk_text_buffer_get_line_count (buffer) - 1);
+
+	gtk_text_buffer_get_iter_at_line (buffer, iter, buffer_line);
+
+	if (char_offset > 0)
+	{
+		GtkTextIter line_end = *iter;
+
+		if (!gtk_text_iter_ends_line (&line_end))
+		{
+			gtk_text_iter_forward_to_line_end (&line_end);
+		}
+
+		gtk_text_iter_set_line_offset (iter,
+					       MIN (char_offset,
+						    gtk_text_iter_get_line_offset (&line_end)));
+	}
+}
+
+static gsize
+huge_file_get_offset_at_iter (GeditTab          *tab,
+			      const GtkTextIter *iter)
+{
+	return gedit_huge_file_get_offset_at_line (tab->priv->huge_file,
+						   tab->priv->huge_file_first_line + gtk_text_iter_get_line (iter),
+						   gtk_text_iter_get_line_offset (iter));
+}
+
+static gboolean
+huge_file_scroll_idle_cb (GeditTab *tab)
+{
+	GtkTextView *view = GTK_TEXT_VIEW (gedit_tab_get_view (tab));
+	GtkTextBuffer *buffer = gtk_text_view_get_buffer (view);
+	GdkRectangle visible_rect;
+	GtkTextIter iter;
+	GtkTextMark *top_mark;
+	gint64 first_line;
+	gint n_buffer_lines;
+	gint64 top_line;
+	gint bottom_line;
+	gint64 cursor_line;
+	gint cursor_offset;
+	gint64 new_first_line;
+
+	tab->priv->huge_file_idle_scroll = 0;
+
+	if (tab->priv->huge_file == NULL ||
+	    tab->priv->state != GEDIT_TAB_STATE_NORMAL)
+	{
+		return G_SOURCE_REMOVE;
+	}
+
+	first_line = tab->priv->huge_file_first_line;
+	n_buffer_lines = gtk_text_buffer_get_line_count (buffer);
+
+	gtk_text_view_get_visible_rect (view, &visible_rect);
+
+	gtk_text_view_get_line_at_y (view, &iter, visible_rect.y, NULL);
+	top_line = gtk_text_iter_get_line (&iter);
+
+	gtk_text_view_get_line_at_y (view, &iter, visible_rect.y + visible_rect.height, NULL);
+	bottom_line = gtk_text_iter_get_line (&iter);
+
+	if (bottom_line >= n_buffer_lines - HUGE_FILE_WINDOW_MARGIN &&
+	    first_line + n_buffer_lines < gedit_huge_file_get_n_lines (tab->priv->huge_file))
+	{
+		new_first_line = first_line + top_line - HUGE_FILE_WINDOW_LINES / 4;
+	}
+	else if (top_line < HUGE_FILE_WINDOW_MARGIN && first_line > 0)
+	{
+		new_first_line = first_line + top_line - 3 * HUGE_FILE_WINDOW_LINES / 4;
+	}
+	else
+	{
+		return G_SOURCE_REMOVE;
+	}
+
+	gedit_debug_message (DEBUG_TAB, "Moving huge file window to line %" G_GINT64_FORMAT, new_first_line);
+
+	/* Keep the cursor and the top of the visible area at the same places
+	 * of the file.
+	 */
+	top_line += first_line;
+
+	gtk_text_buffer_get_iter_at_mark (buffer, &iter, gtk_text_buffer_get_insert (buffer));
+	cursor_line = first_line + gtk_text_iter_get_line (&iter);
+	cursor_offset = gtk_text_iter_get_line_offset (&iter);
+
+	huge_file_show_window (tab, new_first_line);
+
+	if (huge_file_window_contains_line (tab, cursor_line))
+	{
+		huge_file_get_iter_at_line_offset (tab, &iter, cursor_line, cursor_offset);
+	}
+	else
+	{
+		huge_file_get_iter_at_line_offset (tab, &iter, top_line, 0);
+	}
+
+	gtk_text_buffer_place_cursor (buffer, &iter);
+
+	huge_file_get_iter_at_line_offset (tab, &iter, top_line, 0);
+	top_mark = gtk_text_buffer_create_mark (buffer, NULL, &iter, TRUE);
+	gtk_text_view_scroll_to_mark (view, top_mark, 0.0, TRUE, 0.0, 0.0);
+	gtk_text_buffer_delete_mark (buffer, top_mark);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+huge_file_vadjustment_value_changed (GtkAdjustment *adjustment,
+				     GeditTab      *tab)
+{
+	if (tab->priv->huge_file != NULL && tab->priv->huge_file_idle_scroll == 0)
+	{
+		tab->priv->huge_file_idle_scroll = g_idle_add ((GSourceFunc) huge_file_scroll_idle_cb, tab);
+	}
+}
+
+static void
+huge_file_info_bar_response (GtkWidget *info_bar,
+			     gint       response_id,
+			     GeditTab  *tab)
+{
+	set_info_bar (tab, NULL, GTK_RESPONSE_NONE);
+}
+
+static void
+huge_file_loaded_cb (GObject      *source_object,
+		     GAsyncResult *result,
+		     GeditTab     *tab)
+{
+	GeditDocument *doc = gedit_tab_get_document (tab);
+	GFile *location = gtk_source_file_get_location (gedit_document_get_file (doc));
+	GeditHugeFile *huge_file;
+	GtkAdjustment *vadjustment;
+	GtkWidget *info_bar;
+	GtkTextIter iter;
+	gboolean reverting;
+	gint64 line;
+	gint line_offset;
+	GError *error = NULL;
+
+	huge_file = gedit_huge_file_new_finish (result, &error);
+
+	/* The tab has been destroyed in the meantime. */
+	if (tab->priv->cancellable == NULL)
+	{
+		g_clear_object (&huge_file);
+		g_clear_error (&error);
+		goto end;
+	}
+
+	reverting = tab->priv->state == GEDIT_TAB_STATE_REVERTING;
+
+	if (tab->priv->timer != NULL)
+	{
+		g_timer_destroy (tab->priv->timer);
+		tab->priv->timer = NULL;
+	}
+
+	set_info_bar (tab, NULL, GTK_RESPONSE_NONE);
+
+	if (error != NULL)
+	{
+		gedit_debug_message (DEBUG_TAB, "Huge file loading error: %s", error->message);
+
+		if (error->domain == G_IO_ERROR &&
+		    error->code == G_IO_ERROR_CANCELLED)
+		{
+			if (reverting)
+			{
+				clear_loading (tab);
+				gedit_tab_set_state (tab, GEDIT_TAB_STATE_NORMAL);
+			}
+			else
+			{
+				remove_tab (tab);
+			}
+		}
+		else if (reverting)
+		{
+			gedit_tab_set_state (tab, GEDIT_TAB_STATE_REVERTING_ERROR);
+
+			info_bar = gedit_unrecoverable_reverting_error_info_bar_new (location, error);
+
+			g_signal_connect (info_bar,
+					  "response",
+					  G_CALLBACK (unrecoverable_reverting_error_info_bar_response),
+					  tab);
+
+			set_info_bar (tab, info_bar, GTK_RESPONSE_CANCEL);
+		}
+		else
+		{
+			/* Fall back to the normal file loader, which reports
+			 * the error properly if the file can't be read at all.
+			 */
+			load (tab, NULL, tab->priv->tmp_line_pos, tab->priv->tmp_column_pos);
+		}
+
+		g_error_free (error);
+		goto end;
+	}
+
+	if (reverting)
+	{
+		GtkTextBuffer *buffer = GTK_TEXT_BUFFER (doc);
+
+		gtk_text_buffer_get_iter_at_mark (buffer, &iter, gtk_text_buffer_get_insert (buffer));
+		line = tab->priv->huge_file_first_line + gtk_text_iter_get_line (&iter);
+		line_offset = gtk_text_iter_get_line_offset (&iter);
+	}
+	else
+	{
+		line = MAX (0, tab->priv->tmp_line_pos - 1);
+		line_offset = MAX (0, tab->priv->tmp_column_pos - 1);
+
+		vadjustment = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (gedit_tab_get_view (tab)));
+
+		g_signal_connect_object (vadjustment,
+					 "value-changed",
+					 G_CALLBACK (huge_file_vadjustment_value_changed),
+					 tab,
+					 0);
+	}
+
+	g_clear_object (&tab->priv->huge_file);
+	tab->priv->huge_file = huge_file;
+
+	/* Never saved, and the buffer positions are not file positions. */
+	_gedit_document_set_partial (doc, TRUE);
+
+	line = MIN (line, gedit_huge_file_get_n_lines (huge_file) - 1);
+
+	huge_file_show_window (tab, line - HUGE_FILE_WINDOW_LINES / 2);
+	huge_file_get_iter_at_line_offset (tab, &iter, line, line_offset);
+	gtk_text_buffer_place_cursor (GTK_TEXT_BUFFER (doc), &iter);
+
+	tab->priv->editable = FALSE;
+	tab->priv->ask_if_externally_modified = TRUE;
+
+	clear_loading (tab);
+
+	gedit_tab_set_state (tab, GEDIT_TAB_STATE_NORMAL);
+
+	info_bar = gedit_huge_file_info_bar_new (location);
+
+	g_signal_connect (info_bar,
+			  "response",
+			  G_CALLBACK (huge_file_info_bar_response),
+			  tab);
+
+	set_info_bar (tab, info_bar, GTK_RESPONSE_CLOSE);
+
+	if (tab->priv->idle_scroll == 0)
+	{
+		tab->priv->idle_scroll = g_idle_add ((GSourceFunc)scroll_to_cursor, tab);
+	}
+
+	if (!reverting)
+	{
+		gedit_recent_add_document (doc);
+	}
+
+	g_signal_emit_by_name (doc, "loaded");
+
+end:
+	/* Async operation finished. */
+	g_object_unref (tab);
+}
+
+static void
+huge_file_load (GeditTab *tab)
+{
+	GeditDocument *doc = gedit_tab_get_document (tab);
+	GtkSourceFile *file = gedit_document_get_file (doc);
+
+	g_clear_object (&tab->priv->cancellable);
+	tab->priv->cancellable = g_cancellable_new ();
+
+	g_signal_emit_by_name (doc, "load");
+
+	/* Opening the file is immediate, but indexing the lines of a file of
+	 * several gigabytes is not.
+	 */
+	show_loading_info_bar (tab);
+
+	/* Keep the tab alive during the async operation. */
+	g_object_ref (tab);
+
+	gedit_huge_file_new_async (gtk_source_file_get_location (file),
+				   tab->priv->cancellable,
+				   (GAsyncReadyCallback) huge_file_loaded_cb,
+				   tab);
+}
+
+static void
+query_size_cb (GFile        *location,
+	       GAsyncResult *result,
+	       GeditTab     *tab)
+{
+	GFileInfo *info;
+	guint threshold;
+
+	info = g_file_query_info_finish (location, result, NULL);
+
+	/* The tab has been destroyed in the meantime. */
+	if (tab->priv->loader == NULL)
+	{
+		g_clear_object (&info);
+		g_object_unref (tab);
+		return;
+	}
+
+	threshold = g_settings_get_uint (tab->priv->editor, GEDIT_SETTINGS_HUGE_FILE_THRESHOLD);
+
+	if (info != NULL &&
+	    threshold > 0 &&
+	    g_file_info_get_size (info) >= (goffset) threshold * 1024 * 1024)
+	{
+		huge_file_load (tab);
+	}
+	else
+	{
+		/* Errors, if any, are reported by the file loader. */
+		load (tab, NULL, tab->priv->tmp_line_pos, tab->priv->tmp_column_pos);
+	}
+
+	g_clear_object (&info);
+
+	/* Async operation finished. */
+	g_object_unref (tab);
+}
+
+/* Decides between the file loader and the read-only huge file mode. */
+static void
+query_size_and_load (GeditTab *tab,
+		     GFile    *location,
+		     gint      line_pos,
+		     gint      column_pos)
+{
+	tab->priv->tmp_line_pos = line_pos;
+	tab->priv->tmp_column_pos = column_pos;
+
+	/* Keep the tab alive during the async operation. */
+	g_object_ref (tab);
+
+	g_file_query_info_async (location,
+				 G_FILE_ATTRIBUTE_STANDARD_SIZE,
+				 G_FILE_QUERY_INFO_NONE,
+				 G_PRIORITY_DEFAULT,
+				 NULL,
+				 (GAsyncReadyCallback) query_size_cb,
+				 tab);
+}
+
+void
+_gedit_tab_load (GeditTab                *tab,
+		 GFile                   *location,
+		 const GtkSourceEncoding *encoding,
+		 gint                     line_pos,
+		 gint                     column_pos,
+		 gboolean                 create)
+{
+	GeditDocument *doc;
+	GtkSourceFile *file;
+
+	g_return_if_fail (GEDIT_IS_TAB (tab));
+	g_return_if_fail (G_IS_FILE (location));
+	g_return_if_fail (tab->priv->state == GEDIT_TAB_STATE_NORMAL);
+
+	gedit_tab_set_state (tab, GEDIT_TAB_STATE_LOADING);
+
+	doc = gedit_tab_get_document (tab);
+	file = gedit_document_get_file (doc);
+
+	if (tab->priv->loader != NULL)
+	{
+		g_warning ("GeditTab: file loader already exists.");
+		g_object_unref (tab->priv->loader);
+	}
+
+	gtk_source_file_set_location (file, location);
+
+	tab->priv->loader = gtk_source_file_loader_new (GTK_SOURCE_BUFFER (doc), file);
+
+	_gedit_document_set_create (doc, create);
+
+	/* The huge file mode only handles UTF-8 and ASCII-compatible files, so
+	 * it is not used when the user chose an encoding explicitly.
+	 */
+	if (encoding == NULL && g_file_is_native (location))
+	{
+		query_size_and_load (tab, location, line_pos, column_pos);
+	}
+	else
+	{
+		load (tab, encoding, line_pos, column_pos);
+	}
+}
+
+void
+_gedit_tab_load_stream (GeditTab                *tab,
+			GInputStream            *stream,
+			const GtkSourceEncoding *encoding,
+			gint                     line_pos,
+			gint                     column_pos)
+{
+	GeditDocument *doc;
+	GtkSourceFile *file;
+
+	g_return_if_fail (GEDIT_IS_TAB (tab));
+	g_return_if_fail (G_IS_INPUT_STREAM (stream));
+	g_return_if_fail (tab->priv->state == GEDIT_TAB_STATE_NORMAL);
+
+	gedit_tab_set_state (tab, GEDIT_TAB_STATE_LOADING);
+
+	doc = gedit_tab_get_document (tab);
+	file = gedit_document_get_file (doc);
+
+	if (tab->priv->loader != NULL)
+	{
+		g_warning ("GeditTab: file loader already exists.");
+		g_object_unref (tab->priv->loader);
+	}
+
+	gtk_source_file_set_location (file, NULL);
+
+	tab->priv->loader = gtk_source_file_loader_new_from_stream (GTK_SOURCE_BUFFER (doc),
+								    file,
+								    stream);
+
+	_gedit_document_set_create (doc, FALSE);
+
+	load (tab, encoding, line_pos, column_pos);
+}
+
+void
+_gedit_tab_revert (GeditTab *tab)
+{
+	GeditDocument *doc;
+	GtkSourceFile *file;
+	GFile *location;
+
+	g_return_if_fail (GEDIT_IS_TAB (tab));
+	g_return_if_fail (tab->priv->state == GEDIT_TAB_STATE_NORMAL ||
+			  tab->priv->state == GEDIT_TAB_STATE_EXTERNALLY_MODIFIED_NOTIFICATION);
+
+	if (tab->priv->state == GEDIT_TAB_STATE_EXTERNALLY_MODIFIED_NOTIFICATION)
+	{
+		set_info_bar (tab, NULL, GTK_RESPONSE_NONE);
+	}
+
+	doc = gedit_tab_get_document (tab);
+	file = gedit_document_get_file (doc);
+	location = gtk_source_file_get_location (file);
+	g_return_if_fail (location != NULL);
+
+	gedit_tab_set_state (tab, GEDIT_TAB_STATE_REVERTING);
+
+	/* Map the new contents of the file, without trying to load it in the
+	 * buffer.
+	 */
+	if (tab->priv->huge_file != NULL)
+	{
+		huge_file_load (tab);
+		return;
+	}
+
+	if (tab->priv->loader != NULL)
+	{
+		g_warning ("GeditTab: file loader already exists.");
+		g_object_unref (tab->priv->loader);
+	}
+
+	tab->priv->loader = gtk_source_file_loader_new (GTK_SOURCE_BUFFER (doc), file);
+
+	load (tab, NULL, 0, 0);
+}
+
+gboolean
+_gedit_tab_is_huge_file (GeditTab *tab)
+{
+	g_return_val_if_fail (GEDIT_IS_TAB (tab), FALSE);
+
+	return tab->priv->huge_file != NULL;
+}
+
+/* Returns the line of the file displayed at the first line of the buffer. */
+gint64
+_gedit_tab_get_huge_file_first_line (GeditTab *tab)
+{
+	g_return_val_if_fail (GEDIT_IS_TAB (tab), 0);
+
+	return tab->priv->huge_file != NULL ? tab->priv->huge_file_first_line : 0;
+}
+
+/* Like gedit_document_goto_line_offset(), but with a line number of the whole
+ * file instead of the buffer.
+ */
+gboolean
+_gedit_tab_huge_file_goto_line (GeditTab *tab,
+				gint64    line,
+				gint      line_offset)
+{
+	GtkTextIter iter;
+	gint64 n_lines;
+
+	g_return_val_if_fail (GEDIT_IS_TAB (tab), FALSE);
+	g_return_val_if_fail (tab->priv->huge_file != NULL, FALSE);
+	g_return_val_if_fail (line >= 0, FALSE);
+
+	n_lines = gedit_huge_file_get_n_lines (tab->priv->huge_file);
+
+	huge_file_ensure_line_in_window (tab, MIN (line, n_lines - 1));
+	huge_file_get_iter_at_line_offset (tab, &iter, line, line_offset);
+
+	gtk_text_buffer_place_cursor (GTK_TEXT_BUFFER (gedit_tab_get_document (tab)), &iter);
+
+	return (line < n_lines &&
+		tab->priv->huge_file_first_line + gtk_text_iter_get_line (&iter) == line &&
+		gtk_text_iter_get_line_offset (&iter) == line_offset);
+}
+
+static void
+huge_file_search_cb (GeditHugeFile *huge_file,
+		     GAsyncResult  *result,
+		     GTask         *task)
+{
+	GeditTab *tab = g_task_get_source_object (task);
+	gsize match_start;
+	gsize match_end;
+	gboolean found;
+	GError *error = NULL;
+
+	found = gedit_huge_file_search_finish (huge_file,
+					       result,
+					       &match_start,
+					       &match_end,
+					       &error);
+
+	if (error != NULL)
+	{
+		g_task_return_error (task, error);
+		g_object_unref (task);
+		return;
+	}
+
+	/* The file may have been reverted during the search. */
+	if (found && huge_file == tab->priv->huge_file)
+	{
+		GtkTextIter start;
+		GtkTextIter end;
+		gint64 start_line;
+		gint start_offset;
+		gint64 end_line;
+		gint end_offset;
+
+		start_line = gedit_huge_file_get_line_at_offset (huge_file, match_start, &start_offset);
+		end_line = gedit_huge_file_get_line_at_offset (huge_file, match_end, &end_offset);
+
+		huge_file_ensure_line_in_window (tab, start_line);
+		huge_file_get_iter_at_line_offset (tab, &start, start_line, start_offset);
+		huge_file_get_iter_at_line_offset (tab, &end, end_line, end_offset);
+
+		gtk_text_buffer_select_range (GTK_TEXT_BUFFER (gedit_tab_get_document (tab)),
+					      &start,
+					      &end);
+	}
+
+	g_task_return_boolean (task, found);
+	g_object_unref (task);
+}
+
+/* Searches the whole file, not only the lines present in the buffer, and
+ * selects the match. A previous search still running is cancelled.
+ */
+void
+_gedit_tab_huge_file_search_async (GeditTab            *tab,
+				   const gchar         *text,
+				   gboolean             case_sensitive,
+				   const GtkTextIter   *start_at,
+				   gboolean             backward,
+				   GAsyncReadyCallback  callback,
+				   gpointer             user_data)
+{
+	GTask *task;
+
+	g_return_if_fail (GEDIT_IS_TAB (tab));
+	g_return_if_fail (tab->priv->huge_file != NULL);
+	g_return_if_fail (text != NULL && text[0] != '\0');
+	g_return_if_fail (start_at != NULL);
+
+	if (tab->priv->huge_file_search_cancellable != NULL)
+	{
+		g_cancellable_cancel (tab->priv->huge_file_search_cancellable);
+		g_object_unref (tab->priv->huge_file_search_cancellable);
+	}
+
+	tab->priv->huge_file_search_cancellable = g_cancellable_new ();
+
+	task = g_task_new (tab, tab->priv->huge_file_search_cancellable, callback, user_data);
+
+	gedit_huge_file_search_async (tab->priv->huge_file,
+				      text,
+				      case_sensitive,
+				      huge_file_get_offset_at_iter (tab, start_at),
+				      backward,
+				      tab->priv->huge_file_search_cancellable,
+				      (GAsyncReadyCallback) huge_file_search_cb,
+				      task);
+}
+
+gboolean
+_gedit_tab_huge_file_search_finish (GeditTab      *tab,
+				    GAsyncResult  *result,
+				    GError       **error)
+{
+	g_return_val_if_fail (g_task_is_valid (result, tab), FALSE);
+
+	return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+static void
+close_printing (GeditTab *tab)
+{
+	if (tab->priv->print_preview != NULL)
+	{
+		gtk_widget_destroy (tab->priv->print_preview);
+	}
+
+	g_clear_object (&tab->priv->print_job);
+	g_clear_object (&tab->priv->print_preview);
+
+	/* destroy the info bar */
+	set_info_bar (tab, NULL, GTK_RESPONSE_NONE);
+
+	gedit_tab_set_state (tab, GEDIT_TAB_STATE_NORMAL);
+}
+
+static void
+saver_progress_cb (goffset   size,
+		   goffset   total_size,
+		   GeditTab *tab)
+{
+	gdouble elapsed_time;
+	gdouble total_time;
+	gdouble remaining_time;
+
+	g_return_if_fail (tab->priv->state == GEDIT_TAB_STATE_SAVING);
+
+	if (tab->priv->timer == NULL)
+	{
+		tab->priv->timer = g_timer_new ();
+	}
+
+	elapsed_time = g_timer_elapsed (tab->priv->timer, NULL);
+
+	/* elapsed_time / total_time = size / total_size */
+	total_time = (elapsed_time * total_size) / size;
+
+	remaining_time = total_time - elapsed_time;
+
+	/* Approximately more than 3 seconds remaining. */
+	if (remaining_time > 3.0)
+	{
+		show_saving_info_bar (tab);
+	}
+
+	info_bar_set_progress (tab, size, total_size);
+}
+
+static void
+save_cb (GtkSourceFileSaver *saver,
+	 GAsyncResult       *result,
+	 GeditTab           *tab)
+{
+	GeditDocument *doc = gedit_tab_get_document (tab);
+	GFile *location = gtk_source_file_saver_get_location (saver);
+	GError *error = NULL;
+
+	g_return_if_fail (tab->priv->state == GEDIT_TAB_STATE_SAVING);
+	g_return_if_fail (tab->priv->task_saver != NULL);
+
+	gtk_source_file_saver_save_finish (saver, result, &error);
+
+	if (error != NULL)
+	{
+		gedit_debug_message (DEBUG_TAB, "File saving error: %s", error->message);
 	}
 
 	if (tab->priv->timer != NULL)
@@ -2384,6 +3366,17 @@ _gedit_tab_save_async (GeditTab            *tab,
 		return;
 	}
 
+	/* The buffer only contains a part of a huge file, saving it would
+	 * truncate the file. The Save actions are insensitive, but Save All,
+	 * the auto-save and the plugins can still get here.
+	 */
+	if (tab->priv->huge_file != NULL)
+	{
+		tab->priv->task_saver = g_task_new (tab, cancellable, callback, user_data);
+		g_task_return_boolean (tab->priv->task_saver, FALSE);
+		return;
+	}
+
 	/* The Save and Save As window actions are insensitive when the print
 	 * preview is shown, but it's still possible to save several documents
 	 * at once (with the Save All action or when quitting gedit). In that
@@ -2465,6 +3458,13 @@ gedit_tab_auto_save (GeditTab *tab)
 	g_return_val_if_fail (!gedit_document_is_untitled (doc), G_SOURCE_REMOVE);
 	g_return_val_if_fail (!gedit_document_get_readonly (doc), G_SOURCE_REMOVE);
 
+	/* Only a part of a huge file is in the buffer. */
+	if (tab->priv->huge_file != NULL)
+	{
+		tab->priv->auto_save_timeout = 0;
+		return G_SOURCE_REMOVE;
+	}
+
 	if (!gtk_text_buffer_get_modified (GTK_TEXT_BUFFER (doc)))
 	{
 		gedit_debug_message (DEBUG_TAB, "Document not modified");
@@ -2546,7 +3546,14 @@ _gedit_tab_save_as_async (GeditTab                 *tab,
 		return;
 	}
 
-	/* See note at _gedit_tab_save_async(). */
+	/* See notes at _gedit_tab_save_async(). */
+	if (tab->priv->huge_file != NULL)
+	{
+		tab->priv->task_saver = g_task_new (tab, cancellable, callback, user_data);
+		g_task_return_boolean (tab->priv->task_saver, FALSE);
+		return;
+	}
+
 	if (tab->priv->state == GEDIT_TAB_STATE_SHOWING_PRINT_PREVIEW)
 	{
 		close_printing (tab);
@@ -2876,6 +3883,337 @@ _gedit_tab_mark_for_closing (GeditTab *tab)
 	gedit_tab_set_state (tab, GEDIT_TAB_STATE_CLOSING);
 }
 
+/* A long operation that modifies the document in several steps, like Replace
+ * All, puts the tab in the GEDIT_TAB_STATE_GENERIC_NOT_EDITABLE state: the
+ * document can't be edited, undone or saved until it is finished.
+ */
+void
+_gedit_tab_set_busy (GeditTab *tab,
+		     gboolean  busy)
+{
+	g_return_if_fail (GEDIT_IS_TAB (tab));
+
+	if (busy)
+	{
+		g_return_if_fail (tab->priv->state == GEDIT_TAB_STATE_NORMAL);
+
+		gedit_tab_set_state (tab, GEDIT_TAB_STATE_GENERIC_NOT_EDITABLE);
+	}
+	else if (tab->priv->state == GEDIT_TAB_STATE_GENERIC_NOT_EDITABLE)
+	{
+		gedit_tab_set_state (tab, GEDIT_TAB_STATE_NORMAL);
+	}
+}
+
+typedef struct _ReplaceAllData ReplaceAllData;
+struct _ReplaceAllData
+{
+	GtkSourceSearchContext *search_context;
+
+	/* Where the next search starts. */
+	GtkTextMark *mark;
+
+	gchar *replace;
+
+	GeditTabReplaceAllProgress progress_callback;
+	gpointer progress_data;
+
+	gint n_replaced;
+
+	guint saved_highlight : 1;
+};
+
+static void
+replace_all_data_free (ReplaceAllData *data)
+{
+	g_object_unref (data->search_context);
+	g_free (data->replace);
+
+	g_slice_free (ReplaceAllData, data);
+}
+
+/* The user action is closed and the tab given back before the callback runs,
+ * so that the callback can undo, save or start another Replace All.
+ */
+static void
+replace_all_done (GTask  *task,
+		  GError *error)
+{
+	GeditTab *tab = g_task_get_source_object (task);
+	ReplaceAllData *data = g_task_get_task_data (task);
+	GtkTextBuffer *buffer;
+
+	buffer = GTK_TEXT_BUFFER (gtk_source_search_context_get_buffer (data->search_context));
+
+	gtk_source_search_context_set_highlight (data->search_context,
+						 data->saved_highlight);
+
+	gtk_text_buffer_delete_mark (buffer, data->mark);
+	gtk_text_buffer_end_user_action (buffer);
+
+	/* After the end of the user action, so that it can be undone. */
+	_gedit_tab_set_busy (tab, FALSE);
+
+	gedit_debug_message (DEBUG_TAB, "Replaced %d occurrences", data->n_replaced);
+
+	if (error != NULL)
+	{
+		g_task_return_error (task, error);
+	}
+	else
+	{
+		g_task_return_boolean (task, TRUE);
+	}
+}
+
+static gboolean
+replace_all_idle_cb (GTask *task)
+{
+	GeditTab *tab = g_task_get_source_object (task);
+	ReplaceAllData *data = g_task_get_task_data (task);
+	GtkTextBuffer *buffer;
+	GTimer *slice_timer;
+	GtkTextIter iter;
+	gint n_chars;
+	gdouble fraction = 0.0;
+	GError *error = NULL;
+	gboolean done = FALSE;
+
+	if (g_cancellable_set_error_if_cancelled (g_task_get_cancellable (task), &error))
+	{
+		replace_all_done (task, error);
+		return G_SOURCE_REMOVE;
+	}
+
+	/* The tab has been closed in the meantime. */
+	if (tab->priv->state != GEDIT_TAB_STATE_GENERIC_NOT_EDITABLE ||
+	    gtk_widget_get_parent (GTK_WIDGET (tab)) == NULL)
+	{
+		replace_all_done (task,
+				  g_error_new_literal (G_IO_ERROR,
+						       G_IO_ERROR_CANCELLED,
+						       _("The document has been closed")));
+		return G_SOURCE_REMOVE;
+	}
+
+	buffer = GTK_TEXT_BUFFER (gtk_source_search_context_get_buffer (data->search_context));
+
+	slice_timer = g_timer_new ();
+
+	while (!done && g_timer_elapsed (slice_timer, NULL) < REPLACE_ALL_TIME_SLICE)
+	{
+		GtkTextIter match_start;
+		GtkTextIter match_end;
+		gboolean empty_match;
+
+		gtk_text_buffer_get_iter_at_mark (buffer, &iter, data->mark);
+
+		if (!gtk_source_search_context_forward (data->search_context,
+							&iter,
+							&match_start,
+							&match_end) ||
+		    gtk_text_iter_compare (&match_start, &iter) < 0)
+		{
+			/* No more matches, or wrapped around. */
+			done = TRUE;
+			break;
+		}
+
+		empty_match = gtk_text_iter_equal (&match_start, &match_end);
+
+		/* The mark has a right gravity, so it is moved after the
+		 * replacement text.
+		 */
+		gtk_text_buffer_move_mark (buffer, data->mark, &match_end);
+
+		if (!gtk_source_search_context_replace (data->search_context,
+							&match_start,
+							&match_end,
+							data->replace,
+							-1,
+							&error))
+		{
+			done = TRUE;
+			break;
+		}
+
+		data->n_replaced++;
+
+		if (empty_match)
+		{
+			gtk_text_buffer_get_iter_at_mark (buffer, &iter, data->mark);
+
+			if (!gtk_text_iter_forward_char (&iter))
+			{
+				done = TRUE;
+				break;
+			}
+
+			gtk_text_buffer_move_mark (buffer, data->mark, &iter);
+		}
+	}
+
+	g_timer_destroy (slice_timer);
+
+	if (done)
+	{
+		replace_all_done (task, error);
+		return G_SOURCE_REMOVE;
+	}
+
+	if (data->progress_callback != NULL)
+	{
+		gtk_text_buffer_get_iter_at_mark (buffer, &iter, data->mark);
+		n_chars = gtk_text_buffer_get_char_count (buffer);
+
+		if (n_chars > 0)
+		{
+			fraction = (gdouble) gtk_text_iter_get_offset (&iter) / n_chars;
+		}
+
+		data->progress_callback (data->n_replaced, fraction, data->progress_data);
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+
+/**
+ * gedit_tab_replace_all_async:
+ * @tab: a #GeditTab.
+ * @search_context: a #GtkSourceSearchContext of the document of @tab.
+ * @replace: the replacement text.
+ * @cancellable: (nullable): optional #GCancellable object, %NULL to ignore.
+ * @progress_callback: (nullable): function to call with the progress after
+ *   each slice, or %NULL.
+ * @progress_data: (closure progress_callback): data to pass to
+ *   @progress_callback.
+ * @callback: (scope async): a #GAsyncReadyCallback to call when the request is
+ *   satisfied.
+ * @user_data: user data to pass to @callback.
+ *
+ * Replaces all the matches of @search_context by @replace, like
+ * gtk_source_search_context_replace_all(), but in small slices of time from
+ * an idle so that the UI stays responsive on big documents.
+ *
+ * All the replacements are done in one user action, so they are undone at
+ * once. Until @callback is called, the tab is in the
+ * %GEDIT_TAB_STATE_GENERIC_NOT_EDITABLE state: the document can't be edited,
+ * undone or saved.
+ *
+ * The operation fails with %G_IO_ERROR_BUSY if @tab is not in the
+ * %GEDIT_TAB_STATE_NORMAL state, and with %G_IO_ERROR_NOT_SUPPORTED if the
+ * document can't be edited, for example when only a part of a huge file is
+ * loaded.
+ */
+void
+gedit_tab_replace_all_async (GeditTab                   *tab,
+			     GtkSourceSearchContext     *search_context,
+			     const gchar                *replace,
+			     GCancellable               *cancellable,
+			     GeditTabReplaceAllProgress  progress_callback,
+			     gpointer                    progress_data,
+			     GAsyncReadyCallback         callback,
+			     gpointer                    user_data)
+{
+	GTask *task;
+	ReplaceAllData *data;
+	GtkTextBuffer *buffer;
+	GtkTextIter start;
+
+	g_return_if_fail (GEDIT_IS_TAB (tab));
+	g_return_if_fail (GTK_SOURCE_IS_SEARCH_CONTEXT (search_context));
+	g_return_if_fail (gtk_source_search_context_get_buffer (search_context) ==
+			  GTK_SOURCE_BUFFER (gedit_tab_get_document (tab)));
+	g_return_if_fail (replace != NULL);
+	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+	task = g_task_new (tab, cancellable, callback, user_data);
+
+	data = g_slice_new0 (ReplaceAllData);
+	data->search_context = g_object_ref (search_context);
+	data->replace = g_strdup (replace);
+	data->progress_callback = progress_callback;
+	data->progress_data = progress_data;
+
+	g_task_set_task_data (task, data, (GDestroyNotify) replace_all_data_free);
+
+	if (tab->priv->state != GEDIT_TAB_STATE_NORMAL)
+	{
+		g_task_return_new_error (task,
+					 G_IO_ERROR,
+					 G_IO_ERROR_BUSY,
+					 _("The document is busy"));
+		g_object_unref (task);
+		return;
+	}
+
+	/* The buffer of a huge file is only a window on the file. */
+	if (tab->priv->huge_file != NULL || !tab->priv->editable)
+	{
+		g_task_return_new_error (task,
+					 G_IO_ERROR,
+					 G_IO_ERROR_NOT_SUPPORTED,
+					 _("The document can't be edited"));
+		g_object_unref (task);
+		return;
+	}
+
+	buffer = GTK_TEXT_BUFFER (gedit_tab_get_document (tab));
+
+	gtk_text_buffer_get_start_iter (buffer, &start);
+	data->mark = gtk_text_buffer_create_mark (buffer, NULL, &start, FALSE);
+
+	gtk_text_buffer_begin_user_action (buffer);
+
+	/* Highlighting each match while the buffer changes is only a waste
+	 * of time.
+	 */
+	data->saved_highlight = gtk_source_search_context_get_highlight (search_context);
+	gtk_source_search_context_set_highlight (search_context, FALSE);
+
+	/* The user must not edit, undo or save the buffer under the
+	 * replacements.
+	 */
+	_gedit_tab_set_busy (tab, TRUE);
+
+	g_idle_add_full (G_PRIORITY_DEFAULT_IDLE + 10,
+			 (GSourceFunc) replace_all_idle_cb,
+			 task,
+			 g_object_unref);
+}
+
+/**
+ * gedit_tab_replace_all_finish:
+ * @tab: a #GeditTab.
+ * @result: a #GAsyncResult.
+ * @n_replaced: (out) (optional): return location for the number of
+ *   replacements, also set on errors.
+ * @error: a #GError, or %NULL.
+ *
+ * Finishes an operation started with gedit_tab_replace_all_async(). When it
+ * has been cancelled, or the tab closed, the error is %G_IO_ERROR_CANCELLED
+ * and the replacements already done are kept.
+ *
+ * Returns: whether all the matches have been replaced.
+ */
+gboolean
+gedit_tab_replace_all_finish (GeditTab      *tab,
+			      GAsyncResult  *result,
+			      gint          *n_replaced,
+			      GError       **error)
+{
+	g_return_val_if_fail (g_task_is_valid (result, tab), FALSE);
+
+	if (n_replaced != NULL)
+	{
+		ReplaceAllData *data = g_task_get_task_data (G_TASK (result));
+
+		*n_replaced = data->n_replaced;
+	}
+
+	return g_task_propagate_boolean (G_TASK (result), error);
+}
+
 gboolean
 _gedit_tab_get_can_close (GeditTab *tab)
 {
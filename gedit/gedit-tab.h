@@ -73,6 +73,18 @@ struct _GeditTabClass
 				 gchar    **uri_list);
 };
 
+/**
+ * GeditTabReplaceAllProgress:
+ * @n_replaced: the number of replacements done so far.
+ * @fraction: the part of the document already searched, between 0 and 1.
+ * @user_data: user data passed to gedit_tab_replace_all_async().
+ *
+ * The type of the progress callback of gedit_tab_replace_all_async().
+ */
+typedef void (* GeditTabReplaceAllProgress) (gint     n_replaced,
+					     gdouble  fraction,
+					     gpointer user_data);
+
 GType 		 gedit_tab_get_type 		(void) G_GNUC_CONST;
 
 GeditView	*gedit_tab_get_view		(GeditTab            *tab);
@@ -100,6 +112,20 @@ void		 gedit_tab_set_auto_save_interval
 
 void		 gedit_tab_set_info_bar		(GeditTab            *tab,
 						 GtkWidget           *info_bar);
+
+void		 gedit_tab_replace_all_async	(GeditTab                   *tab,
+						 GtkSourceSearchContext     *search_context,
+						 const gchar                *replace,
+						 GCancellable               *cancellable,
+						 GeditTabReplaceAllProgress  progress_callback,
+						 gpointer                    progress_data,
+						 GAsyncReadyCallback         callback,
+						 gpointer                    user_data);
+
+gboolean	 gedit_tab_replace_all_finish	(GeditTab            *tab,
+						 GAsyncResult        *result,
+						 gint                *n_replaced,
+						 GError             **error);
 /*
  * Non exported methods
  */
@@ -157,6 +183,9 @@ void		 _gedit_tab_print		(GeditTab            *tab);
 
 void		 _gedit_tab_mark_for_closing	(GeditTab	     *tab);
 
+void		 _gedit_tab_set_busy		(GeditTab            *tab,
+						 gboolean             busy);
+
 gboolean	 _gedit_tab_get_can_close	(GeditTab	     *tab);
 
 GtkWidget	*_gedit_tab_get_view_frame	(GeditTab            *tab);
@@ -165,6 +194,29 @@ void		 _gedit_tab_set_network_available
 						(GeditTab	     *tab,
 						 gboolean	     enable);
 
+gboolean	 _gedit_tab_is_huge_file	(GeditTab            *tab);
+
+gint64		 _gedit_tab_get_huge_file_first_line
+						(GeditTab            *tab);
+
+gboolean	 _gedit_tab_huge_file_goto_line	(GeditTab            *tab,
+						 gint64               line,
+						 gint                 line_offset);
+
+void		 _gedit_tab_huge_file_search_async
+						(GeditTab            *tab,
+						 const gchar         *text,
+						 gboolean             case_sensitive,
+						 const GtkTextIter   *start_at,
+						 gboolean             backward,
+						 GAsyncReadyCallback  callback,
+						 gpointer             user_data);
+
+gboolean	 _gedit_tab_huge_file_search_finish
+						(GeditTab            *tab,
+						 GAsyncResult        *result,
+						 GError             **error);
+
 G_END_DECLS
 
 #endif  /* __GEDIT_TAB_H__  */
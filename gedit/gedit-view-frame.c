@@ -33,6 +33,7 @@
 #include <stdlib.h>
 
 #include "gedit-window.h"
+#include "gedit-tab.h"
 #include "gedit-view-holder.h"
 #include "gedit-debug.h"
 #include "gedit-utils.h"
@@ -328,6 +329,75 @@ finish_search (GeditViewFrame    *frame,
 	}
 }
 
+/* Returns the tab if its document is only a window on a huge file, in which
+ * case the search must be done on the file and not with the search context.
+ */
+static GeditTab *
+get_huge_file_tab (GeditViewFrame *frame)
+{
+	GeditTab *tab;
+
+	tab = gedit_tab_get_from_document (gedit_view_frame_get_document (frame));
+
+	if (tab != NULL && _gedit_tab_is_huge_file (tab))
+	{
+		return tab;
+	}
+
+	return NULL;
+}
+
+static void
+huge_file_search_finished (GeditTab       *tab,
+			   GAsyncResult   *result,
+			   GeditViewFrame *frame)
+{
+	gboolean found;
+	GError *error = NULL;
+
+	found = _gedit_tab_huge_file_search_finish (tab, result, &error);
+
+	if (error != NULL)
+	{
+		gboolean cancelled = g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+
+		g_error_free (error);
+
+		/* Superseded by another search, or the tab is destroyed. */
+		if (cancelled)
+		{
+			return;
+		}
+	}
+
+	finish_search (frame, found);
+}
+
+static void
+huge_file_search (GeditViewFrame    *frame,
+		  GeditTab          *tab,
+		  const GtkTextIter *start_at,
+		  gboolean           backward)
+{
+	const gchar *text;
+
+	text = gtk_source_search_settings_get_search_text (frame->priv->search_settings);
+
+	if (text == NULL)
+	{
+		finish_search (frame, FALSE);
+		return;
+	}
+
+	_gedit_tab_huge_file_search_async (tab,
+					   text,
+					   gtk_source_search_settings_get_case_sensitive (frame->priv->search_settings),
+					   start_at,
+					   backward,
+					   (GAsyncReadyCallback) huge_file_search_finished,
+					   frame);
+}
+
 static void
 start_search_finished (GtkSourceSearchContext *search_context,
 		       GAsyncResult           *result,
@@ -374,6 +444,7 @@ start_search (GeditViewFrame *frame)
 	GtkTextIter start_at;
 	GtkTextBuffer *buffer;
 	GtkSourceSearchContext *search_context;
+	GeditTab *tab;
 
 	g_return_if_fail (frame->priv->search_mode == SEARCH);
 
@@ -390,6 +461,14 @@ start_search (GeditViewFrame *frame)
 					  &start_at,
 					  frame->priv->start_mark);
 
+	tab = get_huge_file_tab (frame);
+
+	if (tab != NULL)
+	{
+		huge_file_search (frame, tab, &start_at, FALSE);
+		return;
+	}
+
 	gtk_source_search_context_forward_async (search_context,
 						 &start_at,
 						 NULL,
@@ -430,6 +509,7 @@ forward_search (GeditViewFrame *frame)
 	GtkTextIter start_at;
 	GtkTextBuffer *buffer;
 	GtkSourceSearchContext *search_context;
+	GeditTab *tab;
 
 	g_return_if_fail (frame->priv->search_mode == SEARCH);
 
@@ -446,6 +526,14 @@ forward_search (GeditViewFrame *frame)
 
 	gtk_text_buffer_get_selection_bounds (buffer, NULL, &start_at);
 
+	tab = get_huge_file_tab (frame);
+
+	if (tab != NULL)
+	{
+		huge_file_search (frame, tab, &start_at, FALSE);
+		return;
+	}
+
 	gtk_source_search_context_forward_async (search_context,
 						 &start_at,
 						 NULL,
@@ -487,6 +575,7 @@ backward_search (GeditViewFrame *frame)
 	GtkTextIter start_at;
 	GtkTextBuffer *buffer;
 	GtkSourceSearchContext *search_context;
+	GeditTab *tab;
 
 	g_return_if_fail (frame->priv->search_mode == SEARCH);
 
@@ -503,6 +592,14 @@ backward_search (GeditViewFrame *frame)
 
 	gtk_text_buffer_get_selection_bounds (buffer, &start_at, NULL);
 
+	tab = get_huge_file_tab (frame);
+
+	if (tab != NULL)
+	{
+		huge_file_search (frame, tab, &start_at, TRUE);
+		return;
+	}
+
 	gtk_source_search_context_backward_async (search_context,
 						  &start_at,
 						  NULL,
@@ -1070,13 +1167,15 @@ update_goto_line (GeditViewFrame *frame)
 	const gchar *entry_text;
 	gboolean moved;
 	gboolean moved_offset;
-	gint line;
-	gint offset_line = 0;
+	gint64 line;
+	gint64 offset_line = 0;
 	gint line_offset = 0;
 	gchar **split_text = NULL;
 	const gchar *text;
 	GtkTextIter iter;
 	GeditDocument *doc;
+	GeditTab *tab;
+	gint64 first_line;
 
 	entry_text = gtk_entry_get_text (GTK_ENTRY (frame->priv->search_entry));
 
@@ -1086,6 +1185,8 @@ update_goto_line (GeditViewFrame *frame)
 	}
 
 	doc = gedit_view_frame_get_document (frame);
+	tab = get_huge_file_tab (frame);
+	first_line = tab != NULL ? _gedit_tab_get_huge_file_first_line (tab) : 0;
 
 	gtk_text_buffer_get_iter_at_mark (GTK_TEXT_BUFFER (doc),
 					  &iter,
@@ -1104,29 +1205,29 @@ update_goto_line (GeditViewFrame *frame)
 
 	if (text[0] == '-')
 	{
-		gint cur_line = gtk_text_iter_get_line (&iter);
+		gint64 cur_line = first_line + gtk_text_iter_get_line (&iter);
 
 		if (text[1] != '\0')
 		{
-			offset_line = MAX (atoi (text + 1), 0);
+			offset_line = MAX (g_ascii_strtoll (text + 1, NULL, 10), 0);
 		}
 
 		line = MAX (cur_line - offset_line, 0);
 	}
 	else if (entry_text[0] == '+')
 	{
-		gint cur_line = gtk_text_iter_get_line (&iter);
+		gint64 cur_line = first_line + gtk_text_iter_get_line (&iter);
 
 		if (text[1] != '\0')
 		{
-			offset_line = MAX (atoi (text + 1), 0);
+			offset_line = MAX (g_ascii_strtoll (text + 1, NULL, 10), 0);
 		}
 
 		line = cur_line + offset_line;
 	}
 	else
 	{
-		line = MAX (atoi (text) - 1, 0);
+		line = MAX (g_ascii_strtoll (text, NULL, 10) - 1, 0);
 	}
 
 	if (split_text[1] != NULL)
@@ -1136,8 +1237,19 @@ update_goto_line (GeditViewFrame *frame)
 
 	g_strfreev (split_text);
 
-	moved = gedit_document_goto_line (doc, line);
-	moved_offset = gedit_document_goto_line_offset (doc, line, line_offset);
+	if (tab != NULL)
+	{
+		moved = _gedit_tab_huge_file_goto_line (tab, line, line_offset);
+		moved_offset = moved;
+	}
+	else
+	{
+		/* The lines of a buffer are counted with a gint. */
+		line = MIN (line, G_MAXINT);
+
+		moved = gedit_document_goto_line (doc, line);
+		moved_offset = gedit_document_goto_line_offset (doc, line, line_offset);
+	}
 
 	gedit_view_scroll_to_cursor (frame->priv->view);
 
@@ -1233,9 +1345,10 @@ init_search_entry (GeditViewFrame *frame)
 
 	if (frame->priv->search_mode == GOTO_LINE)
 	{
-		gint line;
+		gint64 line;
 		gchar *line_str;
 		GtkTextIter iter;
+		GeditTab *tab;
 
 		gtk_text_buffer_get_iter_at_mark (buffer,
 		                                  &iter,
@@ -1243,7 +1356,14 @@ init_search_entry (GeditViewFrame *frame)
 
 		line = gtk_text_iter_get_line (&iter);
 
-		line_str = g_strdup_printf ("%d", line + 1);
+		tab = get_huge_file_tab (frame);
+
+		if (tab != NULL)
+		{
+			line += _gedit_tab_get_huge_file_first_line (tab);
+		}
+
+		line_str = g_strdup_printf ("%" G_GINT64_FORMAT, line + 1);
 
 		gtk_entry_set_text (GTK_ENTRY (frame->priv->search_entry), line_str);
 
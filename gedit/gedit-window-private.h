@@ -114,6 +114,12 @@ struct _GeditWindowPrivate
 
 	GSList         *closed_docs_stack;
 
+	/* Index of the tabs by location: GFile -> GList of GeditTab, and
+	 * GeditTab -> GFile to find the location under which a tab is indexed.
+	 */
+	GHashTable     *tabs_by_location;
+	GHashTable     *tab_locations;
+
 	guint           removing_tabs : 1;
 	guint           dispose_has_run : 1;
 
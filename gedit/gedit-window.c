@@ -242,6 +242,14 @@ gedit_window_dispose (GObject *object)
 	G_OBJECT_CLASS (gedit_window_parent_class)->dispose (object);
 }
 
+static void
+free_tab_list (GFile *location,
+	       GList *tabs,
+	       gpointer user_data)
+{
+	g_list_free (tabs);
+}
+
 static void
 gedit_window_finalize (GObject *object)
 {
@@ -249,6 +257,12 @@ gedit_window_finalize (GObject *object)
 
 	g_slist_free_full (window->priv->closed_docs_stack, (GDestroyNotify)g_object_unref);
 
+	g_hash_table_foreach (window->priv->tabs_by_location,
+			      (GHFunc) free_tab_list,
+			      NULL);
+	g_hash_table_unref (window->priv->tabs_by_location);
+	g_hash_table_unref (window->priv->tab_locations);
+
 	G_OBJECT_CLASS (gedit_window_parent_class)->finalize (object);
 }
 
@@ -571,6 +585,7 @@ update_actions_sensitivity (GeditWindow *window)
 	GAction *action;
 	gboolean editable = FALSE;
 	gboolean empty_search = FALSE;
+	gboolean huge_file = FALSE;
 	GtkClipboard *clipboard;
 	GeditLockdownMask lockdown;
 	gboolean enable_syntax_highlighting;
@@ -590,6 +605,7 @@ update_actions_sensitivity (GeditWindow *window)
 		tab_number = gtk_notebook_page_num (GTK_NOTEBOOK (notebook), GTK_WIDGET (tab));
 		editable = gtk_text_view_get_editable (GTK_TEXT_VIEW (view));
 		empty_search = _gedit_document_get_empty_search (doc);
+		huge_file = _gedit_tab_is_huge_file (tab);
 	}
 
 	lockdown = gedit_app_get_lockdown (GEDIT_APP (g_application_get_default ()));
@@ -601,6 +617,7 @@ update_actions_sensitivity (GeditWindow *window)
 	                             ((state == GEDIT_TAB_STATE_NORMAL) ||
 	                              (state == GEDIT_TAB_STATE_EXTERNALLY_MODIFIED_NOTIFICATION)) &&
 	                             (doc != NULL) && !gedit_document_get_readonly (doc) &&
+	                             !huge_file &&
 	                             !(lockdown & GEDIT_LOCKDOWN_SAVE_TO_DISK));
 
 	action = g_action_map_lookup_action (G_ACTION_MAP (window), "save-as");
@@ -608,7 +625,7 @@ update_actions_sensitivity (GeditWindow *window)
 	                             ((state == GEDIT_TAB_STATE_NORMAL) ||
 	                              (state == GEDIT_TAB_STATE_SAVING_ERROR) ||
 	                              (state == GEDIT_TAB_STATE_EXTERNALLY_MODIFIED_NOTIFICATION)) &&
-	                             (doc != NULL) &&
+	                             (doc != NULL) && !huge_file &&
 	                             !(lockdown & GEDIT_LOCKDOWN_SAVE_TO_DISK));
 
 	action = g_action_map_lookup_action (G_ACTION_MAP (window), "revert");
@@ -624,7 +641,7 @@ update_actions_sensitivity (GeditWindow *window)
 	g_simple_action_set_enabled (G_SIMPLE_ACTION (action),
 	                             ((state == GEDIT_TAB_STATE_NORMAL) ||
 	                              (state == GEDIT_TAB_STATE_SHOWING_PRINT_PREVIEW)) &&
-	                             (doc != NULL) &&
+	                             (doc != NULL) && !huge_file &&
 	                             !(lockdown & GEDIT_LOCKDOWN_PRINTING));
 
 	action = g_action_map_lookup_action (G_ACTION_MAP (window), "close");
@@ -992,7 +1009,8 @@ static void
 update_cursor_position_statusbar (GtkTextBuffer *buffer,
 				  GeditWindow   *window)
 {
-	gint line, col;
+	gint64 line;
+	gint col;
 	GtkTextIter iter;
 	GeditView *view;
 	gchar *msg = NULL;
@@ -1008,14 +1026,21 @@ update_cursor_position_statusbar (GtkTextBuffer *buffer,
 					  &iter,
 					  gtk_text_buffer_get_insert (buffer));
 
-	line = 1 + gtk_text_iter_get_line (&iter);
+	/* For huge files the buffer only contains a part of the file. */
+	line = 1 + gtk_text_iter_get_line (&iter) +
+	       _gedit_tab_get_huge_file_first_line (gedit_window_get_active_tab (window));
 	col = 1 + gtk_source_view_get_visual_column (GTK_SOURCE_VIEW (view), &iter);
 
 	if ((line >= 0) || (col >= 0))
 	{
+		/* The line of a huge file may not fit in a gint. */
+		gchar *line_str = g_strdup_printf ("%" G_GINT64_FORMAT, line);
+
 		/* Translators: "Ln" is an abbreviation for "Line", Col is an abbreviation for "Column". Please,
-		use abbreviations if possible to avoid space problems. */
-		msg = g_strdup_printf (_("  Ln %d, Col %d"), line, col);
+		use abbreviations if possible to avoid space problems. The first placeholder is the line number. */
+		msg = g_strdup_printf (_("  Ln %s, Col %d"), line_str, col);
+
+		g_free (line_str);
 	}
 
 	gedit_status_menu_button_set_label (GEDIT_STATUS_MENU_BUTTON (window->priv->line_col_button), msg);
@@ -1590,11 +1615,89 @@ sync_state (GeditTab    *tab,
 	}
 }
 
+static void
+unindex_tab_location (GeditWindow *window,
+		      GeditTab    *tab)
+{
+	GFile *location;
+	GList *tabs;
+
+	location = g_hash_table_lookup (window->priv->tab_locations, tab);
+
+	if (location == NULL)
+	{
+		return;
+	}
+
+	tabs = g_hash_table_lookup (window->priv->tabs_by_location, location);
+	tabs = g_list_remove (tabs, tab);
+
+	if (tabs == NULL)
+	{
+		g_hash_table_remove (window->priv->tabs_by_location, location);
+	}
+	else
+	{
+		g_hash_table_insert (window->priv->tabs_by_location,
+				     g_object_ref (location),
+				     tabs);
+	}
+
+	/* Last, it releases the location. */
+	g_hash_table_remove (window->priv->tab_locations, tab);
+}
+
+/* Keeps the location index in sync with the location of the tab document.
+ * Called when a tab is added and each time its name may have changed, which
+ * is the case when the location changes.
+ */
+static void
+index_tab_location (GeditWindow *window,
+		    GeditTab    *tab)
+{
+	GtkSourceFile *file;
+	GFile *location;
+	GFile *indexed_location;
+	GList *tabs;
+
+	file = gedit_document_get_file (gedit_tab_get_document (tab));
+	location = gtk_source_file_get_location (file);
+	indexed_location = g_hash_table_lookup (window->priv->tab_locations, tab);
+
+	if (location == indexed_location ||
+	    (location != NULL &&
+	     indexed_location != NULL &&
+	     g_file_equal (location, indexed_location)))
+	{
+		return;
+	}
+
+	unindex_tab_location (window, tab);
+
+	if (location == NULL)
+	{
+		return;
+	}
+
+	g_hash_table_insert (window->priv->tab_locations,
+			     tab,
+			     g_object_ref (location));
+
+	tabs = g_hash_table_lookup (window->priv->tabs_by_location, location);
+	tabs = g_list_append (tabs, tab);
+
+	g_hash_table_insert (window->priv->tabs_by_location,
+			     g_object_ref (location),
+			     tabs);
+}
+
 static void
 sync_name (GeditTab    *tab,
 	   GParamSpec  *pspec,
 	   GeditWindow *window)
 {
+	index_tab_location (window, tab);
+
 	if (tab == gedit_window_get_active_tab (window))
 	{
 		set_title (window);
@@ -1929,6 +2032,8 @@ on_tab_added (GeditMultiNotebook *multi,
 	view = gedit_tab_get_view (tab);
 	doc = gedit_tab_get_document (tab);
 
+	index_tab_location (window, tab);
+
 	/* IMPORTANT: remember to disconnect the signal in notebook_tab_removed
 	 * if a new signal is connected here */
 
@@ -2038,6 +2143,8 @@ on_tab_removed (GeditMultiNotebook *multi,
 	view = gedit_tab_get_view (tab);
 	doc = gedit_tab_get_document (tab);
 
+	unindex_tab_location (window, tab);
+
 	g_signal_handlers_disconnect_by_func (tab,
 					      G_CALLBACK (sync_name),
 					      window);
@@ -2737,6 +2844,14 @@ gedit_window_init (GeditWindow *window)
 	window->priv->fullscreen_controls = NULL;
 	window->priv->direct_save_uri = NULL;
 	window->priv->closed_docs_stack = NULL;
+	window->priv->tabs_by_location = g_hash_table_new_full (g_file_hash,
+								(GEqualFunc) g_file_equal,
+								g_object_unref,
+								NULL);
+	window->priv->tab_locations = g_hash_table_new_full (NULL,
+							     NULL,
+							     NULL,
+							     g_object_unref);
 	window->priv->editor_settings = g_settings_new ("org.gnome.gedit.preferences.editor");
 	window->priv->ui_settings = g_settings_new ("org.gnome.gedit.preferences.ui");
 
@@ -3572,41 +3687,48 @@ gedit_window_get_tab_from_location (GeditWindow *window,
 				    GFile       *location)
 {
 	GList *tabs;
-	GList *l;
-	GeditTab *ret = NULL;
 
 	g_return_val_if_fail (GEDIT_IS_WINDOW (window), NULL);
 	g_return_val_if_fail (G_IS_FILE (location), NULL);
 
-	tabs = gedit_multi_notebook_get_all_tabs (window->priv->multi_notebook);
+	tabs = g_hash_table_lookup (window->priv->tabs_by_location, location);
 
-	for (l = tabs; l != NULL; l = g_list_next (l))
+	return tabs != NULL ? tabs->data : NULL;
+}
+
+/**
+ * gedit_window_get_tabs_from_locations:
+ * @window: a #GeditWindow
+ * @locations: (element-type Gio.File): a list of #GFile
+ *
+ * Gets the tabs that match with the given @locations, in the same order. The
+ * locations that are not opened in @window are skipped.
+ *
+ * Returns: (element-type Gedit.Tab) (transfer container): a newly allocated
+ * list of the tabs that match with @locations.
+ */
+GList *
+gedit_window_get_tabs_from_locations (GeditWindow  *window,
+				      const GSList *locations)
+{
+	GList *res = NULL;
+	const GSList *l;
+
+	g_return_val_if_fail (GEDIT_IS_WINDOW (window), NULL);
+
+	for (l = locations; l != NULL; l = l->next)
 	{
-		GeditDocument *doc;
-		GtkSourceFile *file;
-		GeditTab *tab;
-		GFile *cur_location;
+		GList *tabs;
 
-		tab = GEDIT_TAB (l->data);
-		doc = gedit_tab_get_document (tab);
-		file = gedit_document_get_file (doc);
-		cur_location = gtk_source_file_get_location (file);
+		tabs = g_hash_table_lookup (window->priv->tabs_by_location, l->data);
 
-		if (cur_location != NULL)
+		if (tabs != NULL)
 		{
-			gboolean found = g_file_equal (location, cur_location);
-
-			if (found)
-			{
-				ret = tab;
-				break;
-			}
+			res = g_list_prepend (res, tabs->data);
 		}
 	}
 
-	g_list_free (tabs);
-
-	return ret;
+	return g_list_reverse (res);
 }
 
 /**
@@ -135,6 +135,9 @@ GeditWindowState gedit_window_get_state 		(GeditWindow         *window);
 GeditTab        *gedit_window_get_tab_from_location	(GeditWindow         *window,
 							 GFile               *location);
 
+GList		*gedit_window_get_tabs_from_locations	(GeditWindow         *window,
+							 const GSList        *locations);
+
 /* Message bus */
 GeditMessageBus	*gedit_window_get_message_bus		(GeditWindow         *window);
 
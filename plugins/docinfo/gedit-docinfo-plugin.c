@@ -27,7 +27,6 @@
 #include <string.h> /* For strlen (...) */
 
 #include <glib/gi18n.h>
-#include <pango/pango-break.h>
 #include <gmodule.h>
 
 #include <gedit/gedit-app.h>
@@ -38,6 +37,18 @@
 #include <gedit/gedit-app-activatable.h>
 #include <gedit/gedit-window-activatable.h>
 
+#include "gedit-docinfo-stats.h"
+
+/* Interval between two updates of the partial counts of the document, in
+ * milliseconds.
+ */
+#define PROGRESS_INTERVAL	100
+
+/* The selection is counted again when it has not changed for this long, in
+ * milliseconds.
+ */
+#define SELECTION_DELAY		150
+
 struct _GeditDocinfoPluginPrivate
 {
 	GeditWindow *window;
@@ -64,6 +75,14 @@ struct _GeditDocinfoPluginPrivate
 	GtkWidget *selected_chars_ns_label;
 	GtkWidget *selected_bytes_label;
 
+	/* The document shown in the dialog. */
+	GeditDocument *doc;
+	guint document_timeout_id;
+
+	GCancellable *selection_cancellable;
+	gint selected_lines;
+	guint selection_timeout_id;
+
 	GeditApp  *app;
 	GeditMenuExtension *menu_ext;
 };
@@ -89,58 +108,61 @@ G_DEFINE_DYNAMIC_TYPE_EXTENDED (GeditDocinfoPlugin,
 				G_ADD_PRIVATE_DYNAMIC (GeditDocinfoPlugin))
 
 static void
-calculate_info (GeditDocument *doc,
-		GtkTextIter   *start,
-		GtkTextIter   *end,
-		gint          *chars,
-		gint          *words,
-		gint          *white_chars,
-		gint          *bytes)
+set_document_labels (GeditDocinfoPlugin       *plugin,
+		     const GeditDocinfoCounts *counts)
 {
-	gchar *text;
+	GeditDocinfoPluginPrivate *priv = plugin->priv;
+	gint lines = counts->lines;
+	gchar *tmp_str;
 
-	gedit_debug (DEBUG_PLUGINS);
+	if (counts->chars == 0)
+	{
+		lines = 0;
+	}
 
-	text = gtk_text_buffer_get_slice (GTK_TEXT_BUFFER (doc),
-					  start,
-					  end,
-					  TRUE);
+	gedit_debug_message (DEBUG_PLUGINS, "Chars: %d", counts->chars);
+	gedit_debug_message (DEBUG_PLUGINS, "Lines: %d", lines);
+	gedit_debug_message (DEBUG_PLUGINS, "Words: %d", counts->words);
+	gedit_debug_message (DEBUG_PLUGINS, "Chars non-space: %d", counts->chars - counts->white_chars);
+	gedit_debug_message (DEBUG_PLUGINS, "Bytes: %d", counts->bytes);
+
+	tmp_str = g_strdup_printf("%d", lines);
+	gtk_label_set_text (GTK_LABEL (priv->document_lines_label), tmp_str);
+	g_free (tmp_str);
 
-	*chars = g_utf8_strlen (text, -1);
-	*bytes = strlen (text);
+	tmp_str = g_strdup_printf("%d", counts->words);
+	gtk_label_set_text (GTK_LABEL (priv->document_words_label), tmp_str);
+	g_free (tmp_str);
 
-	if (*chars > 0)
-	{
-		PangoLogAttr *attrs;
-		gint i;
+	tmp_str = g_strdup_printf("%d", counts->chars);
+	gtk_label_set_text (GTK_LABEL (priv->document_chars_label), tmp_str);
+	g_free (tmp_str);
 
-		attrs = g_new0 (PangoLogAttr, *chars + 1);
+	tmp_str = g_strdup_printf("%d", counts->chars - counts->white_chars);
+	gtk_label_set_text (GTK_LABEL (priv->document_chars_ns_label), tmp_str);
+	g_free (tmp_str);
 
-		pango_get_log_attrs (text,
-				     -1,
-				     0,
-				     pango_language_from_string ("C"),
-				     attrs,
-				     *chars + 1);
+	tmp_str = g_strdup_printf("%d", counts->bytes);
+	gtk_label_set_text (GTK_LABEL (priv->document_bytes_label), tmp_str);
+	g_free (tmp_str);
+}
 
-		for (i = 0; i < (*chars); i++)
-		{
-			if (attrs[i].is_white)
-				++(*white_chars);
+static void update_document_info (GeditDocinfoPlugin *plugin,
+				  GeditDocument      *doc);
 
-			if (attrs[i].is_word_start)
-				++(*words);
-		}
+static gboolean
+document_timeout_cb (GeditDocinfoPlugin *plugin)
+{
+	GeditDocinfoPluginPrivate *priv = plugin->priv;
 
-		g_free (attrs);
-	}
-	else
+	priv->document_timeout_id = 0;
+
+	if (priv->dialog != NULL && priv->doc != NULL)
 	{
-		*white_chars = 0;
-		*words = 0;
+		update_document_info (plugin, priv->doc);
 	}
 
-	g_free (text);
+	return G_SOURCE_REMOVE;
 }
 
 static void
@@ -148,100 +170,149 @@ update_document_info (GeditDocinfoPlugin *plugin,
 		      GeditDocument      *doc)
 {
 	GeditDocinfoPluginPrivate *priv;
-	GtkTextIter start, end;
-	gint words = 0;
-	gint chars = 0;
-	gint white_chars = 0;
-	gint lines = 0;
-	gint bytes = 0;
+	GeditDocinfoCounts counts;
 	gchar *doc_name;
-	gchar *tmp_str;
 
 	gedit_debug (DEBUG_PLUGINS);
 
 	priv = plugin->priv;
 
-	gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (doc),
-				    &start,
-				    &end);
-
-	lines = gtk_text_buffer_get_line_count (GTK_TEXT_BUFFER (doc));
-
-	calculate_info (doc,
-			&start, &end,
-			&chars, &words, &white_chars, &bytes);
+	doc_name = gedit_document_get_short_name_for_display (doc);
+	gtk_header_bar_set_subtitle (GTK_HEADER_BAR (priv->header_bar), doc_name);
+	g_free (doc_name);
 
-	if (chars == 0)
+	/* Kept up to date along with the changes. The first time, the
+	 * document is counted in the background and the partial counts are
+	 * shown until it is done.
+	 */
+	if (!gedit_docinfo_stats_get_counts (doc, &counts) &&
+	    priv->document_timeout_id == 0)
 	{
-		lines = 0;
+		priv->document_timeout_id = g_timeout_add (PROGRESS_INTERVAL,
+							   (GSourceFunc) document_timeout_cb,
+							   plugin);
 	}
 
-	gedit_debug_message (DEBUG_PLUGINS, "Chars: %d", chars);
-	gedit_debug_message (DEBUG_PLUGINS, "Lines: %d", lines);
-	gedit_debug_message (DEBUG_PLUGINS, "Words: %d", words);
-	gedit_debug_message (DEBUG_PLUGINS, "Chars non-space: %d", chars - white_chars);
-	gedit_debug_message (DEBUG_PLUGINS, "Bytes: %d", bytes);
+	set_document_labels (plugin, &counts);
+}
 
-	doc_name = gedit_document_get_short_name_for_display (doc);
-	gtk_header_bar_set_subtitle (GTK_HEADER_BAR (priv->header_bar), doc_name);
-	g_free (doc_name);
+static void
+set_selection_labels (GeditDocinfoPlugin       *plugin,
+		      const GeditDocinfoCounts *counts)
+{
+	GeditDocinfoPluginPrivate *priv = plugin->priv;
+	gint lines = priv->selected_lines;
+	gchar *tmp_str;
+
+	if (counts->chars == 0)
+		lines = 0;
+
+	gedit_debug_message (DEBUG_PLUGINS, "Selected chars: %d", counts->chars);
+	gedit_debug_message (DEBUG_PLUGINS, "Selected lines: %d", lines);
+	gedit_debug_message (DEBUG_PLUGINS, "Selected words: %d", counts->words);
+	gedit_debug_message (DEBUG_PLUGINS, "Selected chars non-space: %d", counts->chars - counts->white_chars);
+	gedit_debug_message (DEBUG_PLUGINS, "Selected bytes: %d", counts->bytes);
 
 	tmp_str = g_strdup_printf("%d", lines);
-	gtk_label_set_text (GTK_LABEL (priv->document_lines_label), tmp_str);
+	gtk_label_set_text (GTK_LABEL (priv->selected_lines_label), tmp_str);
 	g_free (tmp_str);
 
-	tmp_str = g_strdup_printf("%d", words);
-	gtk_label_set_text (GTK_LABEL (priv->document_words_label), tmp_str);
+	tmp_str = g_strdup_printf("%d", counts->words);
+	gtk_label_set_text (GTK_LABEL (priv->selected_words_label), tmp_str);
 	g_free (tmp_str);
 
-	tmp_str = g_strdup_printf("%d", chars);
-	gtk_label_set_text (GTK_LABEL (priv->document_chars_label), tmp_str);
+	tmp_str = g_strdup_printf("%d", counts->chars);
+	gtk_label_set_text (GTK_LABEL (priv->selected_chars_label), tmp_str);
 	g_free (tmp_str);
 
-	tmp_str = g_strdup_printf("%d", chars - white_chars);
-	gtk_label_set_text (GTK_LABEL (priv->document_chars_ns_label), tmp_str);
+	tmp_str = g_strdup_printf("%d", counts->chars - counts->white_chars);
+	gtk_label_set_text (GTK_LABEL (priv->selected_chars_ns_label), tmp_str);
 	g_free (tmp_str);
 
-	tmp_str = g_strdup_printf("%d", bytes);
-	gtk_label_set_text (GTK_LABEL (priv->document_bytes_label), tmp_str);
+	tmp_str = g_strdup_printf("%d", counts->bytes);
+	gtk_label_set_text (GTK_LABEL (priv->selected_bytes_label), tmp_str);
 	g_free (tmp_str);
 }
 
+static void
+selection_progress_cb (const GeditDocinfoCounts *counts,
+		       GeditDocinfoPlugin       *plugin)
+{
+	set_selection_labels (plugin, counts);
+}
+
+static void
+selection_count_cb (GObject            *source_object,
+		    GAsyncResult       *result,
+		    GeditDocinfoPlugin *plugin)
+{
+	GeditDocinfoCounts counts;
+
+	/* Cancelled when the selection changes, or when the dialog or the
+	 * plugin go away.
+	 */
+	if (!gedit_docinfo_count_text_finish (result, &counts, NULL))
+	{
+		return;
+	}
+
+	g_clear_object (&plugin->priv->selection_cancellable);
+
+	set_selection_labels (plugin, &counts);
+}
+
+static void
+cancel_selection_count (GeditDocinfoPlugin *plugin)
+{
+	GeditDocinfoPluginPrivate *priv = plugin->priv;
+
+	if (priv->selection_cancellable != NULL)
+	{
+		g_cancellable_cancel (priv->selection_cancellable);
+		g_clear_object (&priv->selection_cancellable);
+	}
+}
+
 static void
 update_selection_info (GeditDocinfoPlugin *plugin,
 		       GeditDocument      *doc)
 {
 	GeditDocinfoPluginPrivate *priv;
+	GeditDocinfoCounts counts = { 0 };
 	gboolean sel;
 	GtkTextIter start, end;
-	gint words = 0;
-	gint chars = 0;
-	gint white_chars = 0;
-	gint lines = 0;
-	gint bytes = 0;
-	gchar *tmp_str;
 
 	gedit_debug (DEBUG_PLUGINS);
 
 	priv = plugin->priv;
 
+	cancel_selection_count (plugin);
+
 	sel = gtk_text_buffer_get_selection_bounds (GTK_TEXT_BUFFER (doc),
 						    &start,
 						    &end);
 
 	if (sel)
 	{
-		lines = gtk_text_iter_get_line (&end) - gtk_text_iter_get_line (&start) + 1;
+		gchar *text;
 
-		calculate_info (doc,
-				&start, &end,
-				&chars, &words, &white_chars, &bytes);
+		priv->selected_lines = gtk_text_iter_get_line (&end) - gtk_text_iter_get_line (&start) + 1;
 
-		gedit_debug_message (DEBUG_PLUGINS, "Selected chars: %d", chars);
-		gedit_debug_message (DEBUG_PLUGINS, "Selected lines: %d", lines);
-		gedit_debug_message (DEBUG_PLUGINS, "Selected words: %d", words);
-		gedit_debug_message (DEBUG_PLUGINS, "Selected chars non-space: %d", chars - white_chars);
-		gedit_debug_message (DEBUG_PLUGINS, "Selected bytes: %d", bytes);
+		text = gtk_text_buffer_get_slice (GTK_TEXT_BUFFER (doc),
+						  &start,
+						  &end,
+						  TRUE);
+
+		priv->selection_cancellable = g_cancellable_new ();
+
+		/* The labels are updated as the count goes. */
+		gedit_docinfo_count_text_async (text,
+						strlen (text),
+						priv->selection_cancellable,
+						(GeditDocinfoCountsFunc) selection_progress_cb,
+						plugin,
+						(GAsyncReadyCallback) selection_count_cb,
+						plugin);
 
 		gtk_widget_set_sensitive (priv->selection_label, TRUE);
 		gtk_widget_set_sensitive (priv->selected_words_label, TRUE);
@@ -254,6 +325,8 @@ update_selection_info (GeditDocinfoPlugin *plugin,
 	{
 		gedit_debug_message (DEBUG_PLUGINS, "Selection empty");
 
+		priv->selected_lines = 0;
+
 		gtk_widget_set_sensitive (priv->selection_label, FALSE);
 		gtk_widget_set_sensitive (priv->selected_words_label, FALSE);
 		gtk_widget_set_sensitive (priv->selected_bytes_label, FALSE);
@@ -262,28 +335,118 @@ update_selection_info (GeditDocinfoPlugin *plugin,
 		gtk_widget_set_sensitive (priv->selected_chars_ns_label, FALSE);
 	}
 
-	if (chars == 0)
-		lines = 0;
+	set_selection_labels (plugin, &counts);
+}
 
-	tmp_str = g_strdup_printf("%d", lines);
-	gtk_label_set_text (GTK_LABEL (priv->selected_lines_label), tmp_str);
-	g_free (tmp_str);
+static gboolean
+selection_timeout_cb (GeditDocinfoPlugin *plugin)
+{
+	GeditDocinfoPluginPrivate *priv = plugin->priv;
 
-	tmp_str = g_strdup_printf("%d", words);
-	gtk_label_set_text (GTK_LABEL (priv->selected_words_label), tmp_str);
-	g_free (tmp_str);
+	priv->selection_timeout_id = 0;
 
-	tmp_str = g_strdup_printf("%d", chars);
-	gtk_label_set_text (GTK_LABEL (priv->selected_chars_label), tmp_str);
-	g_free (tmp_str);
+	if (priv->dialog != NULL && priv->doc != NULL)
+	{
+		update_selection_info (plugin, priv->doc);
+	}
 
-	tmp_str = g_strdup_printf("%d", chars - white_chars);
-	gtk_label_set_text (GTK_LABEL (priv->selected_chars_ns_label), tmp_str);
-	g_free (tmp_str);
+	return G_SOURCE_REMOVE;
+}
 
-	tmp_str = g_strdup_printf("%d", bytes);
-	gtk_label_set_text (GTK_LABEL (priv->selected_bytes_label), tmp_str);
-	g_free (tmp_str);
+static void
+mark_set_cb (GtkTextBuffer      *buffer,
+	     GtkTextIter        *location,
+	     GtkTextMark        *mark,
+	     GeditDocinfoPlugin *plugin)
+{
+	GeditDocinfoPluginPrivate *priv = plugin->priv;
+
+	if (mark != gtk_text_buffer_get_insert (buffer) &&
+	    mark != gtk_text_buffer_get_selection_bound (buffer))
+	{
+		return;
+	}
+
+	/* The count of the previous selection is useless now. */
+	cancel_selection_count (plugin);
+
+	if (priv->selection_timeout_id != 0)
+	{
+		g_source_remove (priv->selection_timeout_id);
+	}
+
+	priv->selection_timeout_id = g_timeout_add (SELECTION_DELAY,
+						    (GSourceFunc) selection_timeout_cb,
+						    plugin);
+}
+
+static void
+set_document (GeditDocinfoPlugin *plugin,
+	      GeditDocument      *doc)
+{
+	GeditDocinfoPluginPrivate *priv = plugin->priv;
+
+	if (priv->doc == doc)
+	{
+		return;
+	}
+
+	if (priv->doc != NULL)
+	{
+		g_signal_handlers_disconnect_by_func (priv->doc, mark_set_cb, plugin);
+		g_object_remove_weak_pointer (G_OBJECT (priv->doc), (gpointer *) &priv->doc);
+	}
+
+	priv->doc = doc;
+
+	if (doc != NULL)
+	{
+		g_object_add_weak_pointer (G_OBJECT (doc), (gpointer *) &priv->doc);
+
+		g_signal_connect (doc,
+				  "mark-set",
+				  G_CALLBACK (mark_set_cb),
+				  plugin);
+	}
+}
+
+static void
+stop_updates (GeditDocinfoPlugin *plugin)
+{
+	GeditDocinfoPluginPrivate *priv = plugin->priv;
+
+	cancel_selection_count (plugin);
+
+	if (priv->selection_timeout_id != 0)
+	{
+		g_source_remove (priv->selection_timeout_id);
+		priv->selection_timeout_id = 0;
+	}
+
+	if (priv->document_timeout_id != 0)
+	{
+		g_source_remove (priv->document_timeout_id);
+		priv->document_timeout_id = 0;
+	}
+
+	set_document (plugin, NULL);
+}
+
+static void
+update_info (GeditDocinfoPlugin *plugin,
+	     GeditDocument      *doc)
+{
+	set_document (plugin, doc);
+
+	update_document_info (plugin, doc);
+	update_selection_info (plugin, doc);
+}
+
+static void
+docinfo_dialog_destroy_cb (GtkWidget          *dialog,
+			   GeditDocinfoPlugin *plugin)
+{
+	stop_updates (plugin);
 }
 
 static void
@@ -316,8 +479,7 @@ docinfo_dialog_response_cb (GtkDialog          *widget,
 
 			doc = gedit_window_get_active_document (priv->window);
 
-			update_document_info (plugin, doc);
-			update_selection_info (plugin, doc);
+			update_info (plugin, doc);
 
 			break;
 		}
@@ -362,6 +524,10 @@ create_docinfo_dialog (GeditDocinfoPlugin *plugin)
 	gtk_window_set_transient_for (GTK_WINDOW (priv->dialog),
 				      GTK_WINDOW (priv->window));
 
+	g_signal_connect (priv->dialog,
+			  "destroy",
+			  G_CALLBACK (docinfo_dialog_destroy_cb),
+			  plugin);
 	g_signal_connect (priv->dialog,
 			  "destroy",
 			  G_CALLBACK (gtk_widget_destroyed),
@@ -421,8 +587,7 @@ docinfo_cb (GAction            *action,
 		gtk_widget_show (GTK_WIDGET (priv->dialog));
 	}
 
-	update_document_info (plugin, doc);
-	update_selection_info (plugin, doc);
+	update_info (plugin, doc);
 }
 
 static void
@@ -440,6 +605,8 @@ gedit_docinfo_plugin_dispose (GObject *object)
 
 	gedit_debug_message (DEBUG_PLUGINS, "GeditDocinfoPlugin dispose");
 
+	stop_updates (plugin);
+
 	g_clear_object (&plugin->priv->action);
 	g_clear_object (&plugin->priv->window);
 	g_clear_object (&plugin->priv->menu_ext);
@@ -573,12 +740,28 @@ static void
 gedit_docinfo_plugin_window_deactivate (GeditWindowActivatable *activatable)
 {
 	GeditDocinfoPluginPrivate *priv;
+	GList *documents;
+	GList *l;
 
 	gedit_debug (DEBUG_PLUGINS);
 
 	priv = GEDIT_DOCINFO_PLUGIN (activatable)->priv;
 
 	g_action_map_remove_action (G_ACTION_MAP (priv->window), "docinfo");
+
+	stop_updates (GEDIT_DOCINFO_PLUGIN (activatable));
+
+	/* The statistics stay up to date while the dialog is closed, so that
+	 * opening it again is immediate.
+	 */
+	documents = gedit_window_get_documents (priv->window);
+
+	for (l = documents; l != NULL; l = l->next)
+	{
+		gedit_docinfo_stats_stop_tracking (GEDIT_DOCUMENT (l->data));
+	}
+
+	g_list_free (documents);
 }
 
 static void
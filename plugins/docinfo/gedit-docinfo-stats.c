@@ -0,0 +1,823 @@
+/*
+ * gedit-docinfo-stats.c
+ *
+ * Copyright (C) 2015 - The gedit Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gedit-docinfo-stats.h"
+
+#include <string.h>
+#include <pango/pango-break.h>
+
+#include <gedit/gedit-debug.h>
+
+/* The statistics of a document are kept up to date from the insert-text
+ * and delete-range signals: before a change the words around it are
+ * subtracted, after it the resulting words are added back. A word always
+ * ends at an ASCII char other than a letter or a digit, so the text can be
+ * cut just after such chars and counted by parts. The part around a change
+ * is usually a few words, even on a single line of several megabytes. When
+ * no such char is found nearby, the whole text is counted again in the
+ * background the next time the statistics are asked for.
+ *
+ * The first count is done on a copy of the text in a worker thread. The
+ * changes made in the meantime are tracked as usual: each one is an exact
+ * difference, so adding them to the count of the copy gives the count of the
+ * current text.
+ *
+ * The text is handled line by line, the same way by the worker and for the
+ * changes. A line of ASCII text, detected a machine word at a time, is
+ * counted by a small state machine that gives the same word starts as
+ * pango_get_log_attrs(): a word is a run of letters or a run of digits.
+ * Only the other lines go through pango_get_log_attrs().
+ */
+
+#define STATS_KEY "GeditDocinfoStatsKey"
+
+/* The worker reports its progress after each chunk, cut at a line end. */
+#define CHUNK_SIZE (1024 * 1024)
+
+#define ASCII_MASK G_GUINT64_CONSTANT (0x8080808080808080)
+
+/* How far to look for the end of the words around a change. */
+#define MAX_PART_CHARS 4096
+
+typedef struct
+{
+	GeditDocument *doc;
+
+	/* Only words, white_chars and bytes are tracked, the buffer already
+	 * knows the number of chars and lines.
+	 */
+	GeditDocinfoCounts counts;
+
+	/* The offset of the part around the change in progress. */
+	gint pending_offset;
+
+	/* The first count, while it runs. */
+	GCancellable *cancellable;
+	GeditDocinfoCounts partial;
+
+	/* The first count has been cancelled by the deletion of the whole
+	 * text, it is started again once the text is deleted.
+	 */
+	guint restart_first_count : 1;
+
+	/* A change could not be counted by parts, the counts are invalid
+	 * until the whole text is counted again.
+	 */
+	guint stale : 1;
+} Tracker;
+
+typedef struct
+{
+	gchar *text;
+	gsize length;
+
+	/* Only used by the worker. */
+	GeditDocinfoCounts counts;
+
+	GeditDocinfoCountsFunc progress_func;
+	gpointer progress_data;
+
+	/* Only used in the main thread. */
+	guint finished : 1;
+} CountData;
+
+typedef struct
+{
+	GTask *task;
+	GeditDocinfoCounts counts;
+} Progress;
+
+static void start_first_count (Tracker *tracker);
+
+/**
+ * gedit_docinfo_count_text:
+ * @text: UTF-8 text.
+ * @length: the length of @text in bytes, or -1 if it is nul-terminated.
+ * @counts: the #GeditDocinfoCounts to add to.
+ *
+ * Adds the number of chars, words, white chars and bytes of @text to
+ * @counts. The number of lines is left untouched.
+ */
+void
+gedit_docinfo_count_text (const gchar        *text,
+			  gssize              length,
+			  GeditDocinfoCounts *counts)
+{
+	gint n_chars;
+
+	if (length < 0)
+	{
+		length = strlen (text);
+	}
+
+	n_chars = g_utf8_strlen (text, length);
+
+	counts->chars += n_chars;
+	counts->bytes += length;
+
+	if (n_chars > 0)
+	{
+		PangoLogAttr *attrs;
+		gint i;
+
+		attrs = g_new0 (PangoLogAttr, n_chars + 1);
+
+		pango_get_log_attrs (text,
+				     length,
+				     0,
+				     pango_language_from_string ("C"),
+				     attrs,
+				     n_chars + 1);
+
+		for (i = 0; i < n_chars; i++)
+		{
+			if (attrs[i].is_white)
+				++counts->white_chars;
+
+			if (attrs[i].is_word_start)
+				++counts->words;
+		}
+
+		g_free (attrs);
+	}
+}
+
+static gboolean
+is_ascii (const gchar *p,
+	  gsize        length)
+{
+	const gchar *end = p + length;
+
+	while ((gsize) (end - p) >= sizeof (guint64))
+	{
+		guint64 word;
+
+		memcpy (&word, p, sizeof (guint64));
+
+		if (word & ASCII_MASK)
+		{
+			return FALSE;
+		}
+
+		p += sizeof (guint64);
+	}
+
+	while (p < end)
+	{
+		if (*p & 0x80)
+		{
+			return FALSE;
+		}
+
+		p++;
+	}
+
+	return TRUE;
+}
+
+/* Same as g_unichar_isspace() on ASCII. */
+static inline gboolean
+ascii_is_white (gchar c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+enum
+{
+	ASCII_OTHER,
+	ASCII_LETTER,
+	ASCII_DIGIT
+};
+
+static void
+count_ascii (const gchar        *text,
+	     gsize               length,
+	     GeditDocinfoCounts *counts)
+{
+	gint prev_class = ASCII_OTHER;
+	gsize i;
+
+	counts->chars += length;
+	counts->bytes += length;
+
+	for (i = 0; i < length; i++)
+	{
+		gchar c = text[i];
+		gint class;
+
+		if (g_ascii_isalpha (c))
+		{
+			class = ASCII_LETTER;
+		}
+		else if (g_ascii_isdigit (c))
+		{
+			class = ASCII_DIGIT;
+		}
+		else
+		{
+			class = ASCII_OTHER;
+
+			if (ascii_is_white (c))
+			{
+				++counts->white_chars;
+			}
+		}
+
+		/* Pango ends a word at any punctuation, and between letters
+		 * and digits.
+		 */
+		if (class != ASCII_OTHER && class != prev_class)
+		{
+			++counts->words;
+		}
+
+		prev_class = class;
+	}
+}
+
+static void
+count_chunk (const gchar        *text,
+	     gsize               length,
+	     GeditDocinfoCounts *counts)
+{
+	const gchar *p = text;
+	const gchar *end = text + length;
+
+	while (p < end)
+	{
+		const gchar *line_end;
+
+		line_end = memchr (p, '\n', end - p);
+
+		if (line_end != NULL)
+		{
+			line_end++;
+			++counts->lines;
+		}
+		else
+		{
+			line_end = end;
+		}
+
+		if (is_ascii (p, line_end - p))
+		{
+			count_ascii (p, line_end - p, counts);
+		}
+		else
+		{
+			gedit_docinfo_count_text (p, line_end - p, counts);
+		}
+
+		p = line_end;
+	}
+}
+
+static void
+count_data_free (CountData *data)
+{
+	g_free (data->text);
+	g_slice_free (CountData, data);
+}
+
+static gboolean
+progress_idle_cb (Progress *progress)
+{
+	CountData *data = g_task_get_task_data (progress->task);
+
+	if (!data->finished &&
+	    !g_cancellable_is_cancelled (g_task_get_cancellable (progress->task)))
+	{
+		data->progress_func (&progress->counts, data->progress_data);
+	}
+
+	g_object_unref (progress->task);
+	g_slice_free (Progress, progress);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+count_thread (GTask        *task,
+	      gpointer      source_object,
+	      gpointer      task_data,
+	      GCancellable *cancellable)
+{
+	CountData *data = task_data;
+	const gchar *p = data->text;
+	const gchar *end = data->text + data->length;
+
+	while (p < end)
+	{
+		const gchar *chunk_end;
+
+		if (g_task_return_error_if_cancelled (task))
+		{
+			return;
+		}
+
+		chunk_end = p + MIN (CHUNK_SIZE, (gsize) (end - p));
+
+		if (chunk_end < end)
+		{
+			const gchar *nl = memchr (chunk_end, '\n', end - chunk_end);
+
+			chunk_end = nl != NULL ? nl + 1 : end;
+		}
+
+		count_chunk (p, chunk_end - p, &data->counts);
+		p = chunk_end;
+
+		if (p < end && data->progress_func != NULL)
+		{
+			Progress *progress;
+
+			progress = g_slice_new (Progress);
+			progress->task = g_object_ref (task);
+			progress->counts = data->counts;
+
+			g_idle_add ((GSourceFunc) progress_idle_cb, progress);
+		}
+	}
+
+	g_task_return_boolean (task, TRUE);
+}
+
+/**
+ * gedit_docinfo_count_text_async:
+ * @text: (transfer full): UTF-8 text.
+ * @length: the length of @text in bytes.
+ * @cancellable: (nullable): optional #GCancellable object.
+ * @progress_func: (nullable): called in the main thread with the partial
+ *   counts.
+ * @progress_data: data passed to @progress_func.
+ * @callback: (scope async): a #GAsyncReadyCallback to call when the count is
+ *   finished.
+ * @user_data: user data to pass to @callback.
+ *
+ * Counts @text in a worker thread, the same way as gedit_docinfo_count_text().
+ * The number of lines is the number of newlines. @progress_func is not called
+ * anymore once @cancellable is cancelled.
+ */
+void
+gedit_docinfo_count_text_async (gchar                  *text,
+				gsize                   length,
+				GCancellable           *cancellable,
+				GeditDocinfoCountsFunc  progress_func,
+				gpointer                progress_data,
+				GAsyncReadyCallback     callback,
+				gpointer                user_data)
+{
+	GTask *task;
+	CountData *data;
+
+	g_return_if_fail (text != NULL);
+
+	data = g_slice_new0 (CountData);
+	data->text = text;
+	data->length = length;
+	data->progress_func = progress_func;
+	data->progress_data = progress_data;
+
+	task = g_task_new (NULL, cancellable, callback, user_data);
+	g_task_set_task_data (task, data, (GDestroyNotify) count_data_free);
+	g_task_run_in_thread (task, count_thread);
+
+	g_object_unref (task);
+}
+
+/**
+ * gedit_docinfo_count_text_finish:
+ * @result: a #GAsyncResult.
+ * @counts: (out): the counts of the text.
+ * @error: a #GError, or %NULL.
+ *
+ * Returns: %FALSE if the count has been cancelled.
+ */
+gboolean
+gedit_docinfo_count_text_finish (GAsyncResult        *result,
+				 GeditDocinfoCounts  *counts,
+				 GError             **error)
+{
+	CountData *data;
+
+	g_return_val_if_fail (g_task_is_valid (result, NULL), FALSE);
+	g_return_val_if_fail (counts != NULL, FALSE);
+
+	data = g_task_get_task_data (G_TASK (result));
+	data->finished = TRUE;
+
+	if (!g_task_propagate_boolean (G_TASK (result), error))
+	{
+		return FALSE;
+	}
+
+	*counts = data->counts;
+	return TRUE;
+}
+
+/* Whether a word always ends at @c, in Pango and in count_ascii(). */
+static inline gboolean
+is_word_break (gunichar c)
+{
+	return c < 0x80 && !g_ascii_isalnum (c);
+}
+
+/* Moves @iter backward to the start of its part. Returns %FALSE if it is too
+ * far.
+ */
+static gboolean
+backward_part_start (GtkTextIter *iter)
+{
+	gint i;
+
+	for (i = 0; i < MAX_PART_CHARS; i++)
+	{
+		GtkTextIter prev = *iter;
+
+		if (!gtk_text_iter_backward_char (&prev) ||
+		    is_word_break (gtk_text_iter_get_char (&prev)))
+		{
+			return TRUE;
+		}
+
+		*iter = prev;
+	}
+
+	return FALSE;
+}
+
+/* Moves @iter forward to the end of its part, i.e. just after the next word
+ * break. Returns %FALSE if it is too far.
+ */
+static gboolean
+forward_part_end (GtkTextIter *iter)
+{
+	gint i;
+
+	for (i = 0; i < MAX_PART_CHARS; i++)
+	{
+		gunichar c;
+
+		if (gtk_text_iter_is_end (iter))
+		{
+			return TRUE;
+		}
+
+		c = gtk_text_iter_get_char (iter);
+		gtk_text_iter_forward_char (iter);
+
+		if (is_word_break (c))
+		{
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static void
+invalidate (Tracker *tracker)
+{
+	gedit_debug_message (DEBUG_PLUGINS, "Statistics to count again");
+
+	if (tracker->cancellable != NULL)
+	{
+		g_cancellable_cancel (tracker->cancellable);
+		g_clear_object (&tracker->cancellable);
+	}
+
+	memset (&tracker->counts, 0, sizeof (GeditDocinfoCounts));
+	memset (&tracker->partial, 0, sizeof (GeditDocinfoCounts));
+	tracker->stale = TRUE;
+}
+
+/* Counts the text from @start to the end of the part of @end, like the first
+ * count does, and adds it to the counts with @sign.
+ */
+static void
+add_part (Tracker           *tracker,
+	  const GtkTextIter *start,
+	  const GtkTextIter *end,
+	  gint               sign)
+{
+	GeditDocinfoCounts counts = { 0 };
+	GtkTextIter part_end = *end;
+	gchar *text;
+
+	if (!forward_part_end (&part_end))
+	{
+		invalidate (tracker);
+		return;
+	}
+
+	text = gtk_text_buffer_get_slice (GTK_TEXT_BUFFER (tracker->doc),
+					  start,
+					  &part_end,
+					  TRUE);
+	count_chunk (text, strlen (text), &counts);
+	g_free (text);
+
+	tracker->counts.words += sign * counts.words;
+	tracker->counts.white_chars += sign * counts.white_chars;
+	tracker->counts.bytes += sign * counts.bytes;
+}
+
+/* Subtracts the part around [@start, @end) before a change. */
+static void
+remove_part (Tracker           *tracker,
+	     const GtkTextIter *start,
+	     const GtkTextIter *end)
+{
+	GtkTextIter part_start = *start;
+
+	if (!backward_part_start (&part_start))
+	{
+		invalidate (tracker);
+		return;
+	}
+
+	tracker->pending_offset = gtk_text_iter_get_offset (&part_start);
+
+	add_part (tracker, &part_start, end, -1);
+}
+
+/* Adds the part that ends around @end back after a change. The text before
+ * the change is untouched, so the part starts at the same offset.
+ */
+static void
+restore_part (Tracker           *tracker,
+	      const GtkTextIter *end)
+{
+	GtkTextIter part_start;
+
+	gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (tracker->doc),
+					    &part_start,
+					    tracker->pending_offset);
+
+	add_part (tracker, &part_start, end, 1);
+}
+
+static void
+insert_text_cb (GtkTextBuffer *buffer,
+		GtkTextIter   *location,
+		const gchar   *text,
+		gint           len,
+		Tracker       *tracker)
+{
+	if (!tracker->stale)
+	{
+		remove_part (tracker, location, location);
+	}
+}
+
+static void
+insert_text_after_cb (GtkTextBuffer *buffer,
+		      GtkTextIter   *location,
+		      const gchar   *text,
+		      gint           len,
+		      Tracker       *tracker)
+{
+	/* The location has been moved to the end of the inserted text. */
+	if (!tracker->stale)
+	{
+		restore_part (tracker, location);
+	}
+}
+
+static void
+delete_range_cb (GtkTextBuffer *buffer,
+		 GtkTextIter   *start,
+		 GtkTextIter   *end,
+		 Tracker       *tracker)
+{
+	if (tracker->stale)
+	{
+		return;
+	}
+
+	if (gtk_text_iter_is_start (start) && gtk_text_iter_is_end (end))
+	{
+		/* A running first count would add the deleted text back. */
+		if (tracker->cancellable != NULL)
+		{
+			g_cancellable_cancel (tracker->cancellable);
+			g_clear_object (&tracker->cancellable);
+			tracker->restart_first_count = TRUE;
+		}
+
+		/* No need to count what is going away entirely. */
+		memset (&tracker->counts, 0, sizeof (GeditDocinfoCounts));
+		memset (&tracker->partial, 0, sizeof (GeditDocinfoCounts));
+		tracker->pending_offset = 0;
+		return;
+	}
+
+	remove_part (tracker, start, end);
+}
+
+static void
+delete_range_after_cb (GtkTextBuffer *buffer,
+		       GtkTextIter   *start,
+		       GtkTextIter   *end,
+		       Tracker       *tracker)
+{
+	if (tracker->restart_first_count)
+	{
+		tracker->restart_first_count = FALSE;
+		start_first_count (tracker);
+		return;
+	}
+
+	if (!tracker->stale)
+	{
+		restore_part (tracker, start);
+	}
+}
+
+static void
+first_count_progress_cb (const GeditDocinfoCounts *counts,
+			 Tracker                  *tracker)
+{
+	tracker->partial = *counts;
+}
+
+static void
+first_count_cb (GObject      *source_object,
+		GAsyncResult *result,
+		Tracker      *tracker)
+{
+	GeditDocinfoCounts counts;
+
+	/* The tracker is gone when the count is cancelled. */
+	if (!gedit_docinfo_count_text_finish (result, &counts, NULL))
+	{
+		return;
+	}
+
+	gedit_debug_message (DEBUG_PLUGINS, "First count of the statistics done");
+
+	tracker->counts.words += counts.words;
+	tracker->counts.white_chars += counts.white_chars;
+	tracker->counts.bytes += counts.bytes;
+
+	g_clear_object (&tracker->cancellable);
+}
+
+static void
+start_first_count (Tracker *tracker)
+{
+	GtkTextBuffer *buffer = GTK_TEXT_BUFFER (tracker->doc);
+	GtkTextIter start;
+	GtkTextIter end;
+	gchar *text;
+
+	tracker->cancellable = g_cancellable_new ();
+
+	gtk_text_buffer_get_bounds (buffer, &start, &end);
+	text = gtk_text_buffer_get_slice (buffer, &start, &end, TRUE);
+
+	gedit_docinfo_count_text_async (text,
+					strlen (text),
+					tracker->cancellable,
+					(GeditDocinfoCountsFunc) first_count_progress_cb,
+					tracker,
+					(GAsyncReadyCallback) first_count_cb,
+					tracker);
+}
+
+static void
+tracker_free (Tracker *tracker)
+{
+	if (tracker->cancellable != NULL)
+	{
+		g_cancellable_cancel (tracker->cancellable);
+		g_object_unref (tracker->cancellable);
+	}
+
+	g_signal_handlers_disconnect_by_data (tracker->doc, tracker);
+
+	g_slice_free (Tracker, tracker);
+}
+
+static Tracker *
+get_tracker (GeditDocument *doc)
+{
+	Tracker *tracker;
+
+	tracker = g_object_get_data (G_OBJECT (doc), STATS_KEY);
+
+	if (tracker != NULL)
+	{
+		return tracker;
+	}
+
+	gedit_debug_message (DEBUG_PLUGINS, "Start tracking the statistics");
+
+	tracker = g_slice_new0 (Tracker);
+	tracker->doc = doc;
+
+	start_first_count (tracker);
+
+	g_signal_connect (doc,
+			  "insert-text",
+			  G_CALLBACK (insert_text_cb),
+			  tracker);
+
+	g_signal_connect_after (doc,
+				"insert-text",
+				G_CALLBACK (insert_text_after_cb),
+				tracker);
+
+	g_signal_connect (doc,
+			  "delete-range",
+			  G_CALLBACK (delete_range_cb),
+			  tracker);
+
+	g_signal_connect_after (doc,
+				"delete-range",
+				G_CALLBACK (delete_range_after_cb),
+				tracker);
+
+	g_object_set_data_full (G_OBJECT (doc),
+				STATS_KEY,
+				tracker,
+				(GDestroyNotify) tracker_free);
+
+	return tracker;
+}
+
+/**
+ * gedit_docinfo_stats_get_counts:
+ * @doc: a #GeditDocument.
+ * @counts: (out): the statistics of @doc.
+ *
+ * The first call starts counting the whole document in the background, then
+ * the statistics are updated along with the changes until
+ * gedit_docinfo_stats_stop_tracking() is called. Keeping track of a change
+ * only costs the words around it.
+ *
+ * Returns: %FALSE if the first count is still running, @counts is then
+ *   partial.
+ */
+gboolean
+gedit_docinfo_stats_get_counts (GeditDocument      *doc,
+				GeditDocinfoCounts *counts)
+{
+	Tracker *tracker;
+
+	g_return_val_if_fail (GEDIT_IS_DOCUMENT (doc), FALSE);
+	g_return_val_if_fail (counts != NULL, FALSE);
+
+	tracker = get_tracker (doc);
+
+	if (tracker->stale)
+	{
+		tracker->stale = FALSE;
+		start_first_count (tracker);
+	}
+
+	*counts = tracker->counts;
+
+	if (tracker->cancellable != NULL)
+	{
+		counts->words += tracker->partial.words;
+		counts->white_chars += tracker->partial.white_chars;
+		counts->bytes += tracker->partial.bytes;
+	}
+
+	counts->chars = gtk_text_buffer_get_char_count (GTK_TEXT_BUFFER (doc));
+	counts->lines = gtk_text_buffer_get_line_count (GTK_TEXT_BUFFER (doc));
+
+	return tracker->cancellable == NULL;
+}
+
+void
+gedit_docinfo_stats_stop_tracking (GeditDocument *doc)
+{
+	g_return_if_fail (GEDIT_IS_DOCUMENT (doc));
+
+	g_object_set_data (G_OBJECT (doc), STATS_KEY, NULL);
+}
+
+/* ex:set ts=8 noet: */
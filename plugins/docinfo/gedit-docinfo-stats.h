@@ -0,0 +1,67 @@
+/*
+ * gedit-docinfo-stats.h
+ *
+ * Copyright (C) 2015 - The gedit Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __GEDIT_DOCINFO_STATS_H__
+#define __GEDIT_DOCINFO_STATS_H__
+
+#include <gedit/gedit-document.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GeditDocinfoCounts GeditDocinfoCounts;
+
+struct _GeditDocinfoCounts
+{
+	gint chars;
+	gint words;
+	gint white_chars;
+	gint bytes;
+	gint lines;
+};
+
+typedef void (* GeditDocinfoCountsFunc) (const GeditDocinfoCounts *counts,
+					 gpointer                  user_data);
+
+void		gedit_docinfo_count_text		(const gchar             *text,
+							 gssize                   length,
+							 GeditDocinfoCounts      *counts);
+
+void		gedit_docinfo_count_text_async		(gchar                   *text,
+							 gsize                    length,
+							 GCancellable            *cancellable,
+							 GeditDocinfoCountsFunc   progress_func,
+							 gpointer                 progress_data,
+							 GAsyncReadyCallback      callback,
+							 gpointer                 user_data);
+
+gboolean	gedit_docinfo_count_text_finish		(GAsyncResult            *result,
+							 GeditDocinfoCounts      *counts,
+							 GError                 **error);
+
+gboolean	gedit_docinfo_stats_get_counts		(GeditDocument           *doc,
+							 GeditDocinfoCounts      *counts);
+
+void		gedit_docinfo_stats_stop_tracking	(GeditDocument           *doc);
+
+G_END_DECLS
+
+#endif /* __GEDIT_DOCINFO_STATS_H__ */
+
+/* ex:set ts=8 noet: */
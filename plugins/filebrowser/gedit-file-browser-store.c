@@ -72,7 +72,6 @@ struct _AsyncNode
 {
 	FileBrowserNodeDir *dir;
 	GCancellable *cancellable;
-	GSList *original_children;
 };
 
 typedef struct {
@@ -89,18 +88,35 @@ struct _FileBrowserNode
 	gchar *name;
 	gchar *markup;
 
+	/* Filename collation key of the name, used for sorting */
+	gchar *collate_key;
+	gsize collate_key_len;
+
 	GdkPixbuf *icon;
 	GdkPixbuf *emblem;
 
 	FileBrowserNode *parent;
-	gint pos;
+
+	/* Index of the node in the children array of its parent */
+	guint pos;
+
 	gboolean inserted;
+
+	/* Whether the node is counted in the visible index of its parent */
+	gboolean indexed;
 };
 
 struct _FileBrowserNodeDir
 {
 	FileBrowserNode node;
-	GSList *children;
+
+	/* The children, sorted, and a Fenwick tree counting the ones which
+	   are inserted and visible, so that the position of a child in the
+	   model and the child at a given position are both found in
+	   O(log n) */
+	GPtrArray *children;
+	gint *visible_index;
+	guint visible_index_size;
 
 	GCancellable *cancellable;
 	GFileMonitor *monitor;
@@ -111,6 +127,10 @@ struct _GeditFileBrowserStorePrivate
 {
 	FileBrowserNode *root;
 	FileBrowserNode *virtual_root;
+
+	/* Maps the GFile of every node to the node */
+	GHashTable *file_index;
+
 	GType column_types[GEDIT_FILE_BROWSER_STORE_COLUMN_NUM];
 
 	GeditFileBrowserStoreFilterMode filter_mode;
@@ -251,6 +271,7 @@ gedit_file_browser_store_finalize (GObject *object)
 
 	/* Free all the nodes */
 	file_browser_node_free (obj, obj->priv->root);
+	g_hash_table_destroy (obj->priv->file_index);
 
 	if (obj->priv->binary_patterns != NULL)
 	{
@@ -503,6 +524,9 @@ gedit_file_browser_store_init (GeditFileBrowserStore *obj)
 	/* Default filter mode is hiding the hidden files */
 	obj->priv->filter_mode = gedit_file_browser_store_filter_mode_get_default ();
 	obj->priv->sort_func = model_sort_default;
+
+	obj->priv->file_index = g_hash_table_new (g_file_hash,
+						  (GEqualFunc) g_file_equal);
 }
 
 static gboolean
@@ -552,6 +576,239 @@ model_node_inserted (GeditFileBrowserStore *model,
 	       (model_node_visibility (model, node) && node->inserted);
 }
 
+/* File index */
+
+static void
+model_index_node (GeditFileBrowserStore *model,
+		  FileBrowserNode       *node)
+{
+	if (node->file != NULL)
+		g_hash_table_replace (model->priv->file_index, node->file, node);
+}
+
+static void
+model_unindex_node (GeditFileBrowserStore *model,
+		    FileBrowserNode       *node)
+{
+	/* The key is the file of the node, it must be removed before
+	   the file is released */
+	if (node->file != NULL &&
+	    g_hash_table_lookup (model->priv->file_index, node->file) == node)
+	{
+		g_hash_table_remove (model->priv->file_index, node->file);
+	}
+}
+
+/* Returns the child of @parent for @file, or NULL */
+static FileBrowserNode *
+model_lookup_child (GeditFileBrowserStore *model,
+		    FileBrowserNode       *parent,
+		    GFile                 *file)
+{
+	FileBrowserNode *node;
+
+	node = g_hash_table_lookup (model->priv->file_index, file);
+
+	if (node != NULL && node->parent == parent)
+		return node;
+
+	return NULL;
+}
+
+/* Visible index */
+
+/* For the children of a directory in the tree this is the same as
+   model_node_visibility, without walking up to the virtual root */
+static gboolean
+node_visible_in_parent (FileBrowserNode *node)
+{
+	if (NODE_IS_DUMMY (node))
+		return !NODE_IS_HIDDEN (node);
+
+	return !NODE_IS_FILTERED (node);
+}
+
+static void
+visible_index_add (FileBrowserNodeDir *dir,
+		   guint               pos,
+		   gint                delta)
+{
+	guint i;
+
+	for (i = pos + 1; i <= dir->children->len; i += i & -i)
+		dir->visible_index[i - 1] += delta;
+}
+
+/* Returns the number of indexed children before @pos */
+static gint
+visible_index_count (FileBrowserNodeDir *dir,
+		     guint               pos)
+{
+	gint count = 0;
+	guint i;
+
+	for (i = pos; i > 0; i -= i & -i)
+		count += dir->visible_index[i - 1];
+
+	return count;
+}
+
+/* Returns the @n-th indexed child, or NULL */
+static FileBrowserNode *
+visible_index_find (FileBrowserNodeDir *dir,
+		    gint                n)
+{
+	guint len = dir->children->len;
+	guint pos = 0;
+	guint step = 1;
+
+	if (n < 0)
+		return NULL;
+
+	while (step <= len / 2)
+		step <<= 1;
+
+	/* Find the largest pos with at most n indexed children before it */
+	for (; step > 0; step >>= 1)
+	{
+		if (pos + step <= len && dir->visible_index[pos + step - 1] <= n)
+		{
+			pos += step;
+			n -= dir->visible_index[pos - 1];
+		}
+	}
+
+	if (pos >= len)
+		return NULL;
+
+	return (FileBrowserNode *) g_ptr_array_index (dir->children, pos);
+}
+
+/* Updates the positions of the children from @start on and rebuilds the
+   visible index, this must be called after every change to the array */
+static void
+file_browser_node_dir_reindex (FileBrowserNodeDir *dir,
+			       guint               start)
+{
+	guint len = dir->children->len;
+	guint i;
+
+	for (i = start; i < len; ++i)
+	{
+		FileBrowserNode *child;
+
+		child = (FileBrowserNode *) g_ptr_array_index (dir->children, i);
+		child->pos = i;
+	}
+
+	if (len > dir->visible_index_size)
+	{
+		dir->visible_index_size = MAX (len, dir->visible_index_size * 2);
+		dir->visible_index = g_renew (gint,
+					      dir->visible_index,
+					      dir->visible_index_size);
+	}
+
+	for (i = 0; i < len; ++i)
+	{
+		FileBrowserNode *child;
+
+		child = (FileBrowserNode *) g_ptr_array_index (dir->children, i);
+		dir->visible_index[i] = child->indexed ? 1 : 0;
+	}
+
+	for (i = 1; i <= len; ++i)
+	{
+		guint parent = i + (i & -i);
+
+		if (parent <= len)
+			dir->visible_index[parent - 1] += dir->visible_index[i - 1];
+	}
+}
+
+/* Must be called whenever the inserted state or the visibility flags of
+   a node in the children array of its parent change */
+static void
+file_browser_node_update_index (FileBrowserNode *node)
+{
+	gboolean indexed;
+
+	indexed = node->inserted && node_visible_in_parent (node);
+
+	if (indexed == node->indexed || node->parent == NULL)
+		return;
+
+	node->indexed = indexed;
+	visible_index_add (FILE_BROWSER_NODE_DIR (node->parent),
+			   node->pos,
+			   indexed ? 1 : -1);
+}
+
+/* The visible index is only used for the directories in the tree, outside
+   of it model_node_inserted depends on more than the node itself */
+static gboolean
+model_node_dir_indexed (GeditFileBrowserStore *model,
+			FileBrowserNode       *node)
+{
+	return node == model->priv->virtual_root || node_in_tree (model, node);
+}
+
+/* Returns the @n-th inserted child of @node from position @start on */
+static FileBrowserNode *
+model_find_inserted_child (GeditFileBrowserStore *model,
+			   FileBrowserNode       *node,
+			   guint                  start,
+			   gint                   n)
+{
+	FileBrowserNodeDir *dir;
+	guint i;
+
+	if (node == NULL || !NODE_IS_DIR (node))
+		return NULL;
+
+	dir = FILE_BROWSER_NODE_DIR (node);
+
+	if (model_node_dir_indexed (model, node))
+		return visible_index_find (dir, visible_index_count (dir, start) + n);
+
+	for (i = start; i < dir->children->len; ++i)
+	{
+		FileBrowserNode *child;
+
+		child = (FileBrowserNode *) g_ptr_array_index (dir->children, i);
+
+		if (model_node_inserted (model, child) && n-- == 0)
+			return child;
+	}
+
+	return NULL;
+}
+
+static gint
+model_count_inserted_children (GeditFileBrowserStore *model,
+			       FileBrowserNode       *node)
+{
+	FileBrowserNodeDir *dir;
+	gint num = 0;
+	guint i;
+
+	if (node == NULL || !NODE_IS_DIR (node))
+		return 0;
+
+	dir = FILE_BROWSER_NODE_DIR (node);
+
+	if (model_node_dir_indexed (model, node))
+		return visible_index_count (dir, dir->children->len);
+
+	for (i = 0; i < dir->children->len; ++i)
+	{
+		if (model_node_inserted (model, g_ptr_array_index (dir->children, i)))
+			++num;
+	}
+
+	return num;
+}
+
 /* Interface implementation */
 
 static GtkTreeModelFlags
@@ -602,36 +859,10 @@ gedit_file_browser_store_get_iter (GtkTreeModel *tree_model,
 
 	for (i = 0; i < depth; ++i)
 	{
-		GSList *item;
-		gint num = 0;
+		node = model_find_inserted_child (model, node, 0, indices[i]);
 
 		if (node == NULL)
 			return FALSE;
-
-		if (!NODE_IS_DIR (node))
-			return FALSE;
-
-		for (item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
-		{
-			FileBrowserNode *child = (FileBrowserNode *) (item->data);
-
-			if (model_node_inserted (model, child))
-			{
-				if (num == indices[i])
-				{
-					break;
-				}
-
-				num++;
-			}
-		}
-
-		if (item == NULL)
-		{
-			return FALSE;
-		}
-
-		node = (FileBrowserNode *) (item->data);
 	}
 
 	iter->user_data = node;
@@ -646,47 +877,29 @@ gedit_file_browser_store_get_path_real (GeditFileBrowserStore *model,
 					FileBrowserNode       *node)
 {
 	GtkTreePath *path;
-	gint num = 0;
+
+	/* Nodes outside of the tree have no path */
+	if (node != model->priv->virtual_root && !node_in_tree (model, node))
+		return NULL;
 
 	path = gtk_tree_path_new ();
 
 	while (node != model->priv->virtual_root)
 	{
-		GSList *item;
+		if (!node_visible_in_parent (node))
+		{
+			if (NODE_IS_DUMMY (node))
+				g_warning ("Dummy not visible???");
 
-		if (node->parent == NULL) {
 			gtk_tree_path_free (path);
 			return NULL;
 		}
 
-		num = 0;
-
-		for (item = FILE_BROWSER_NODE_DIR (node->parent)->children; item; item = item->next)
-		{
-			FileBrowserNode *check;
-
-			check = (FileBrowserNode *) (item->data);
-
-			if (model_node_visibility (model, check) && (check == node || check->inserted))
-			{
-				if (check == node)
-				{
-					gtk_tree_path_prepend_index (path,
-								     num);
-					break;
-				}
-
-				++num;
-			}
-			else if (check == node)
-			{
-				if (NODE_IS_DUMMY (node))
-					g_warning ("Dummy not visible???");
-
-				gtk_tree_path_free (path);
-				return NULL;
-			}
-		}
+		/* The node itself may not be inserted yet, it is counted
+		   only among the siblings before it */
+		gtk_tree_path_prepend_index (path,
+					     visible_index_count (FILE_BROWSER_NODE_DIR (node->parent),
+								  node->pos));
 
 		node = node->parent;
 	}
@@ -753,8 +966,7 @@ gedit_file_browser_store_iter_next (GtkTreeModel *tree_model,
 {
 	GeditFileBrowserStore *model;
 	FileBrowserNode *node;
-	GSList *item;
-	GSList *first;
+	FileBrowserNode *next;
 
 	g_return_val_if_fail (GEDIT_IS_FILE_BROWSER_STORE (tree_model),
 			      FALSE);
@@ -767,18 +979,13 @@ gedit_file_browser_store_iter_next (GtkTreeModel *tree_model,
 	if (node->parent == NULL)
 		return FALSE;
 
-	first = g_slist_next (g_slist_find (FILE_BROWSER_NODE_DIR (node->parent)->children, node));
+	next = model_find_inserted_child (model, node->parent, node->pos + 1, 0);
 
-	for (item = first; item; item = item->next)
-	{
-		if (model_node_inserted (model, (FileBrowserNode *) (item->data)))
-		{
-			iter->user_data = item->data;
-			return TRUE;
-		}
-	}
+	if (next == NULL)
+		return FALSE;
 
-	return FALSE;
+	iter->user_data = next;
+	return TRUE;
 }
 
 static gboolean
@@ -787,8 +994,8 @@ gedit_file_browser_store_iter_children (GtkTreeModel *tree_model,
 					GtkTreeIter  *parent)
 {
 	FileBrowserNode *node;
+	FileBrowserNode *child;
 	GeditFileBrowserStore *model;
-	GSList *item;
 
 	g_return_val_if_fail (GEDIT_IS_FILE_BROWSER_STORE (tree_model), FALSE);
 	g_return_val_if_fail (parent == NULL || parent->user_data != NULL, FALSE);
@@ -800,40 +1007,20 @@ gedit_file_browser_store_iter_children (GtkTreeModel *tree_model,
 	else
 		node = (FileBrowserNode *) (parent->user_data);
 
-	if (node == NULL)
-		return FALSE;
+	child = model_find_inserted_child (model, node, 0, 0);
 
-	if (!NODE_IS_DIR (node))
+	if (child == NULL)
 		return FALSE;
 
-	for (item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
-	{
-		if (model_node_inserted (model, (FileBrowserNode *) (item->data)))
-		{
-			iter->user_data = item->data;
-			return TRUE;
-		}
-	}
-
-	return FALSE;
+	iter->user_data = child;
+	return TRUE;
 }
 
 static gboolean
 filter_tree_model_iter_has_child_real (GeditFileBrowserStore *model,
 				       FileBrowserNode       *node)
 {
-	GSList *item;
-
-	if (!NODE_IS_DIR (node))
-		return FALSE;
-
-	for (item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
-	{
-		if (model_node_inserted (model, (FileBrowserNode *) (item->data)))
-			return TRUE;
-	}
-
-	return FALSE;
+	return model_find_inserted_child (model, node, 0, 0) != NULL;
 }
 
 static gboolean
@@ -864,8 +1051,6 @@ gedit_file_browser_store_iter_n_children (GtkTreeModel *tree_model,
 {
 	FileBrowserNode *node;
 	GeditFileBrowserStore *model;
-	GSList *item;
-	gint num = 0;
 
 	g_return_val_if_fail (GEDIT_IS_FILE_BROWSER_STORE (tree_model),
 			      FALSE);
@@ -879,16 +1064,7 @@ gedit_file_browser_store_iter_n_children (GtkTreeModel *tree_model,
 	else
 		node = (FileBrowserNode *) (iter->user_data);
 
-	if (!NODE_IS_DIR (node))
-		return 0;
-
-	for (item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
-	{
-		if (model_node_inserted (model, (FileBrowserNode *) (item->data)))
-			++num;
-	}
-
-	return num;
+	return model_count_inserted_children (model, node);
 }
 
 static gboolean
@@ -898,9 +1074,8 @@ gedit_file_browser_store_iter_nth_child (GtkTreeModel *tree_model,
 					 gint          n)
 {
 	FileBrowserNode *node;
+	FileBrowserNode *child;
 	GeditFileBrowserStore *model;
-	GSList *item;
-	gint num = 0;
 
 	g_return_val_if_fail (GEDIT_IS_FILE_BROWSER_STORE (tree_model), FALSE);
 	g_return_val_if_fail (parent == NULL || parent->user_data != NULL, FALSE);
@@ -912,24 +1087,13 @@ gedit_file_browser_store_iter_nth_child (GtkTreeModel *tree_model,
 	else
 		node = (FileBrowserNode *) (parent->user_data);
 
-	if (!NODE_IS_DIR (node))
-		return FALSE;
-
-	for (item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
-	{
-		if (model_node_inserted (model, (FileBrowserNode *) (item->data)))
-		{
-			if (num == n)
-			{
-				iter->user_data = item->data;
-				return TRUE;
-			}
+	child = model_find_inserted_child (model, node, 0, n);
 
-			++num;
-		}
-	}
+	if (child == NULL)
+		return FALSE;
 
-	return FALSE;
+	iter->user_data = child;
+	return TRUE;
 }
 
 static gboolean
@@ -965,6 +1129,7 @@ gedit_file_browser_store_row_inserted (GtkTreeModel *tree_model,
 	FileBrowserNode *node = (FileBrowserNode *)(iter->user_data);
 
 	node->inserted = TRUE;
+	file_browser_node_update_index (node);
 }
 
 static gboolean
@@ -1049,27 +1214,23 @@ model_end_loading (GeditFileBrowserStore *model,
 	g_signal_emit (model, model_signals[END_LOADING], 0, &iter);
 }
 
-static void
-model_node_update_visibility (GeditFileBrowserStore *model,
-			      FileBrowserNode       *node)
+static gboolean
+model_node_filtered (GeditFileBrowserStore *model,
+		     FileBrowserNode       *node)
 {
 	GtkTreeIter iter;
 
-	node->flags &= ~GEDIT_FILE_BROWSER_STORE_FLAG_IS_FILTERED;
-
 	if (FILTER_HIDDEN (model->priv->filter_mode) &&
 	    NODE_IS_HIDDEN (node))
 	{
-		node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_FILTERED;
-		return;
+		return TRUE;
 	}
 
 	if (FILTER_BINARY (model->priv->filter_mode) && !NODE_IS_DIR (node))
 	{
 		if (!NODE_IS_TEXT (node))
 		{
-			node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_FILTERED;
-			return;
+			return TRUE;
 		}
 		else if (model->priv->binary_patterns != NULL)
 		{
@@ -1089,9 +1250,8 @@ model_node_update_visibility (GeditFileBrowserStore *model,
 				if (g_pattern_match (spec, name_length,
 				                     node->name, name_reversed))
 				{
-					node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_FILTERED;
 					g_free (name_reversed);
-					return;
+					return TRUE;
 				}
 			}
 
@@ -1106,35 +1266,47 @@ model_node_update_visibility (GeditFileBrowserStore *model,
 		if (!model->priv->filter_func (model, &iter,
 					       model->priv->filter_user_data))
 		{
-			node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_FILTERED;
+			return TRUE;
 		}
 	}
+
+	return FALSE;
+}
+
+static void
+model_node_update_visibility (GeditFileBrowserStore *model,
+			      FileBrowserNode       *node)
+{
+	node->flags &= ~GEDIT_FILE_BROWSER_STORE_FLAG_IS_FILTERED;
+
+	if (model_node_filtered (model, node))
+		node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_FILTERED;
+
+	file_browser_node_update_index (node);
 }
 
 static gint
 collate_nodes (FileBrowserNode *node1,
 	       FileBrowserNode *node2)
 {
-	if (node1->name == NULL)
+	if (node1->collate_key == NULL)
 	{
 		return -1;
 	}
-	else if (node2->name == NULL)
+	else if (node2->collate_key == NULL)
 	{
 		return 1;
 	}
 	else
 	{
-		gchar *k1, *k2;
 		gint result;
 
-		k1 = g_utf8_collate_key_for_filename (node1->name, -1);
-		k2 = g_utf8_collate_key_for_filename (node2->name, -1);
-
-		result = strcmp (k1, k2);
+		result = memcmp (node1->collate_key,
+				 node2->collate_key,
+				 MIN (node1->collate_key_len, node2->collate_key_len));
 
-		g_free (k1);
-		g_free (k2);
+		if (result == 0 && node1->collate_key_len != node2->collate_key_len)
+			result = node1->collate_key_len < node2->collate_key_len ? -1 : 1;
 
 		return result;
 	}
@@ -1164,14 +1336,25 @@ model_sort_default (FileBrowserNode *node1,
 	return collate_nodes (node1, node2);
 }
 
+static gint
+compare_children (gconstpointer a,
+		  gconstpointer b,
+		  gpointer      user_data)
+{
+	GeditFileBrowserStore *model = GEDIT_FILE_BROWSER_STORE (user_data);
+
+	return model->priv->sort_func (*((FileBrowserNode **) a),
+				       *((FileBrowserNode **) b));
+}
+
 static void
 model_resort_node (GeditFileBrowserStore *model,
 		   FileBrowserNode       *node)
 {
 	FileBrowserNodeDir *dir;
-	GSList *item;
 	FileBrowserNode *child;
 	gint pos = 0;
+	guint i;
 	GtkTreeIter iter;
 	GtkTreePath *path;
 	gint *neworder;
@@ -1181,34 +1364,35 @@ model_resort_node (GeditFileBrowserStore *model,
 	if (!model_node_visibility (model, node->parent))
 	{
 		/* Just sort the children of the parent */
-		dir->children = g_slist_sort (dir->children,
-					      (GCompareFunc) (model->priv->sort_func));
+		g_ptr_array_sort_with_data (dir->children, compare_children, model);
+		file_browser_node_dir_reindex (dir, 0);
 	}
 	else
 	{
 		/* Store current positions */
-		for (item = dir->children; item; item = item->next)
+		for (i = 0; i < dir->children->len; ++i)
 		{
-			child = (FileBrowserNode *) (item->data);
+			child = (FileBrowserNode *) g_ptr_array_index (dir->children, i);
 
 			if (model_node_visibility (model, child))
 				child->pos = pos++;
 		}
 
-		dir->children = g_slist_sort (dir->children,
-					      (GCompareFunc) (model->priv->sort_func));
+		g_ptr_array_sort_with_data (dir->children, compare_children, model);
 		neworder = g_new (gint, pos);
 		pos = 0;
 
 		/* Store the new positions */
-		for (item = dir->children; item; item = item->next)
+		for (i = 0; i < dir->children->len; ++i)
 		{
-			child = (FileBrowserNode *) (item->data);
+			child = (FileBrowserNode *) g_ptr_array_index (dir->children, i);
 
 			if (model_node_visibility (model, child))
 				neworder[pos++] = child->pos;
 		}
 
+		file_browser_node_dir_reindex (dir, 0);
+
 		iter.user_data = node->parent;
 		path = gedit_file_browser_store_get_path_real (model, node->parent);
 
@@ -1280,6 +1464,7 @@ row_deleted (GeditFileBrowserStore *model,
 
 	hidden = FILE_IS_HIDDEN (node->flags);
 	node->flags &= ~GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
+	file_browser_node_update_index (node);
 
 	/* Create temporary copies of the path as the signals may alter it */
 
@@ -1294,6 +1479,8 @@ row_deleted (GeditFileBrowserStore *model,
 		node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
 	}
 
+	file_browser_node_update_index (node);
+
 	copy = gtk_tree_path_copy (path);
 	gtk_tree_model_row_deleted (GTK_TREE_MODEL (model), copy);
 	gtk_tree_path_free (copy);
@@ -1307,7 +1494,7 @@ model_refilter_node (GeditFileBrowserStore  *model,
 	gboolean old_visible;
 	gboolean new_visible;
 	FileBrowserNodeDir *dir;
-	GSList *item;
+	guint i;
 	GtkTreeIter iter;
 	GtkTreePath *tmppath = NULL;
 	gboolean in_tree;
@@ -1338,10 +1525,10 @@ model_refilter_node (GeditFileBrowserStore  *model,
 
 		dir = FILE_BROWSER_NODE_DIR (node);
 
-		for (item = dir->children; item; item = item->next)
+		for (i = 0; i < dir->children->len; ++i)
 		{
 			model_refilter_node (model,
-					     (FileBrowserNode *) (item->data),
+					     g_ptr_array_index (dir->children, i),
 					     path);
 		}
 
@@ -1389,6 +1576,7 @@ file_browser_node_set_name (FileBrowserNode *node)
 {
 	g_free (node->name);
 	g_free (node->markup);
+	g_free (node->collate_key);
 
 	if (node->file)
 		node->name = gedit_file_browser_utils_file_basename (node->file);
@@ -1396,9 +1584,19 @@ file_browser_node_set_name (FileBrowserNode *node)
 		node->name = NULL;
 
 	if (node->name)
+	{
 		node->markup = g_markup_escape_text (node->name, -1);
+
+		/* Computed once here rather than on every comparison */
+		node->collate_key = g_utf8_collate_key_for_filename (node->name, -1);
+		node->collate_key_len = strlen (node->collate_key);
+	}
 	else
+	{
 		node->markup = NULL;
+		node->collate_key = NULL;
+		node->collate_key_len = 0;
+	}
 }
 
 static void
@@ -1436,6 +1634,7 @@ file_browser_node_dir_new (GeditFileBrowserStore *model,
 
 	node->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_DIRECTORY;
 
+	FILE_BROWSER_NODE_DIR (node)->children = g_ptr_array_new ();
 	FILE_BROWSER_NODE_DIR (node)->model = model;
 
 	return node;
@@ -1445,18 +1644,20 @@ static void
 file_browser_node_free_children (GeditFileBrowserStore *model,
 				 FileBrowserNode       *node)
 {
-	GSList *item;
+	FileBrowserNodeDir *dir;
+	guint i;
 
 	if (node == NULL || !NODE_IS_DIR (node))
 		return;
 
-	for (item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
+	dir = FILE_BROWSER_NODE_DIR (node);
+
+	for (i = 0; i < dir->children->len; ++i)
 	{
-		file_browser_node_free (model, (FileBrowserNode *) (item->data));
+		file_browser_node_free (model, g_ptr_array_index (dir->children, i));
 	}
 
-	g_slist_free (FILE_BROWSER_NODE_DIR (node)->children);
-	FILE_BROWSER_NODE_DIR (node)->children = NULL;
+	g_ptr_array_set_size (dir->children, 0);
 
 	/* This node is no longer loaded */
 	node->flags &= ~GEDIT_FILE_BROWSER_STORE_FLAG_LOADED;
@@ -1485,6 +1686,9 @@ file_browser_node_free (GeditFileBrowserStore *model,
 
 		file_browser_node_free_children (model, node);
 
+		g_ptr_array_unref (dir->children);
+		g_free (dir->visible_index);
+
 		if (dir->monitor)
 		{
 			g_file_monitor_cancel (dir->monitor);
@@ -1494,6 +1698,8 @@ file_browser_node_free (GeditFileBrowserStore *model,
 
 	if (node->file)
 	{
+		model_unindex_node (model, node);
+
 		g_signal_emit (model, model_signals[UNLOAD], 0, node->file);
 		g_object_unref (node->file);
 	}
@@ -1506,6 +1712,7 @@ file_browser_node_free (GeditFileBrowserStore *model,
 
 	g_free (node->name);
 	g_free (node->markup);
+	g_free (node->collate_key);
 
 	if (NODE_IS_DIR (node))
 		g_slice_free (FileBrowserNodeDir, (FileBrowserNodeDir *)node);
@@ -1532,15 +1739,15 @@ model_remove_node_children (GeditFileBrowserStore *model,
 {
 	FileBrowserNodeDir *dir;
 	GtkTreePath *path_child;
-	GSList *list;
-	GSList *item;
+	GPtrArray *children;
+	guint i;
 
 	if (node == NULL || !NODE_IS_DIR (node))
 		return;
 
 	dir = FILE_BROWSER_NODE_DIR (node);
 
-	if (dir->children == NULL)
+	if (dir->children->len == 0)
 		return;
 
 	if (!model_node_visibility (model, node))
@@ -1560,15 +1767,52 @@ model_remove_node_children (GeditFileBrowserStore *model,
 
 	gtk_tree_path_down (path_child);
 
-	list = g_slist_copy (dir->children);
+	/* Work on a copy, removing the nodes alters the array */
+	children = g_ptr_array_sized_new (dir->children->len);
 
-	for (item = list; item; item = item->next)
+	for (i = 0; i < dir->children->len; ++i)
+		g_ptr_array_add (children, g_ptr_array_index (dir->children, i));
+
+	if (!free_nodes)
 	{
-		model_remove_node (model, (FileBrowserNode *) (item->data),
-				   path_child, free_nodes);
+		for (i = 0; i < children->len; ++i)
+		{
+			model_remove_node (model, g_ptr_array_index (children, i),
+					   path_child, free_nodes);
+		}
 	}
+	else
+	{
+		FileBrowserNode *child = NULL;
+
+		/* Removing the children one by one from the array moves and
+		   reindexes the rest every time, so only take them out of the
+		   model here and clear the array at once */
+		for (i = 0; i < children->len; ++i)
+		{
+			child = g_ptr_array_index (children, i);
+
+			model_remove_node_children (model, child, path_child, TRUE);
+
+			if (model_node_visibility (model, child))
+				row_deleted (model, child, path_child);
+		}
+
+		g_ptr_array_set_size (dir->children, 0);
+		file_browser_node_dir_reindex (dir, 0);
+
+		/* Like model_remove_node, only check the dummy if the last
+		   removed node was not the dummy itself */
+		if (!NODE_IS_DUMMY (child))
+			model_check_dummy (model, node);
 
-	g_slist_free (list);
+		/* Free the nodes last, the signal handlers above may still
+		   walk the array */
+		for (i = 0; i < children->len; ++i)
+			file_browser_node_free (model, g_ptr_array_index (children, i));
+	}
+
+	g_ptr_array_unref (children);
 	gtk_tree_path_free (path_child);
 }
 
@@ -1615,13 +1859,13 @@ model_remove_node (GeditFileBrowserStore *model,
 
 	if (free_nodes)
 	{
-		/* Remove the node from the parents children list */
+		/* Remove the node from the parents children array */
 		if (parent)
 		{
-			FILE_BROWSER_NODE_DIR (node->parent)->children =
-			    g_slist_remove (FILE_BROWSER_NODE_DIR
-					    (node->parent)->children,
-					    node);
+			FileBrowserNodeDir *dir = FILE_BROWSER_NODE_DIR (parent);
+
+			g_ptr_array_remove_index (dir->children, node->pos);
+			file_browser_node_dir_reindex (dir, node->pos);
 		}
 	}
 
@@ -1663,11 +1907,11 @@ model_clear (GeditFileBrowserStore *model,
 
 		dir = FILE_BROWSER_NODE_DIR (model->priv->virtual_root);
 
-		if (dir->children != NULL)
+		if (dir->children->len > 0)
 		{
 			FileBrowserNode *dummy;
 
-			dummy = (FileBrowserNode *) (dir->children->data);
+			dummy = (FileBrowserNode *) g_ptr_array_index (dir->children, 0);
 
 			if (NODE_IS_DUMMY (dummy) &&
 			    model_node_visibility (model, dummy))
@@ -1844,23 +2088,25 @@ model_check_dummy (GeditFileBrowserStore *model,
 
 		dir = FILE_BROWSER_NODE_DIR (node);
 
-		if (dir->children == NULL)
+		if (dir->children->len == 0)
 		{
 			model_add_dummy_node (model, node);
 			return;
 		}
 
-		dummy = (FileBrowserNode *) (dir->children->data);
+		dummy = (FileBrowserNode *) g_ptr_array_index (dir->children, 0);
 
 		if (!NODE_IS_DUMMY (dummy))
 		{
 			dummy = model_create_dummy_node (model, node);
-			dir->children = g_slist_prepend (dir->children, dummy);
+			g_ptr_array_insert (dir->children, 0, dummy);
+			file_browser_node_dir_reindex (dir, 0);
 		}
 
 		if (!model_node_visibility (model, node))
 		{
 			dummy->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
+			file_browser_node_update_index (dummy);
 			return;
 		}
 
@@ -1868,10 +2114,12 @@ model_check_dummy (GeditFileBrowserStore *model,
 		   for real children */
 		flags = dummy->flags;
 		dummy->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
+		file_browser_node_update_index (dummy);
 
 		if (!filter_tree_model_iter_has_child_real (model, node))
 		{
 			dummy->flags &= ~GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
+			file_browser_node_update_index (dummy);
 
 			if (FILE_IS_HIDDEN (flags))
 			{
@@ -1906,19 +2154,34 @@ insert_node_sorted (GeditFileBrowserStore *model,
 		    FileBrowserNode       *parent)
 {
 	FileBrowserNodeDir *dir;
+	guint low = 0;
+	guint high;
 
 	dir = FILE_BROWSER_NODE_DIR (parent);
+	high = dir->children->len;
 
-	if (model->priv->sort_func == NULL)
+	if (model->priv->sort_func != NULL)
 	{
-		dir->children = g_slist_append (dir->children, child);
+		/* Insert after the children comparing equal */
+		while (low < high)
+		{
+			guint mid = low + (high - low) / 2;
+
+			if (model->priv->sort_func (g_ptr_array_index (dir->children, mid), child) > 0)
+				high = mid;
+			else
+				low = mid + 1;
+		}
 	}
 	else
 	{
-		dir->children =
-		    g_slist_insert_sorted (dir->children, child,
-					   (GCompareFunc) (model->priv->sort_func));
+		low = high;
 	}
+
+	g_ptr_array_insert (dir->children, low, child);
+	file_browser_node_dir_reindex (dir, low);
+
+	model_index_node (model, child);
 }
 
 static void
@@ -1954,91 +2217,79 @@ model_add_nodes_batch (GeditFileBrowserStore *model,
 {
 	GSList *sorted_children;
 	GSList *child;
-	GSList *prev;
-	GSList *l;
+	FileBrowserNode **nodes;
 	FileBrowserNodeDir *dir;
+	guint n_nodes;
+	guint n_old;
+	guint i;
+	guint j;
+	guint k;
 
 	dir = FILE_BROWSER_NODE_DIR (parent);
 
 	sorted_children = g_slist_sort (children, (GCompareFunc) model->priv->sort_func);
 
-	child = sorted_children;
-	l = dir->children;
-	prev = NULL;
-
 	model_check_dummy (model, parent);
 
-	while (child)
-	{
-		FileBrowserNode *node = child->data;
-		GtkTreeIter iter;
-		GtkTreePath *path;
+	n_nodes = g_slist_length (sorted_children);
+	nodes = g_new (FileBrowserNode *, n_nodes);
 
-		/* Reached the end of the first list, just append the second */
-		if (l == NULL)
-		{
-			dir->children = g_slist_concat (dir->children, child);
+	for (child = sorted_children, k = 0; child; child = child->next, ++k)
+	{
+		nodes[k] = child->data;
+		model_index_node (model, nodes[k]);
+	}
 
-			for (l = child; l; l = l->next)
-			{
-				if (model_node_visibility (model, parent) &&
-				    model_node_visibility (model, l->data))
-				{
-					iter.user_data = l->data;
-					path = gedit_file_browser_store_get_path_real (model, l->data);
+	/* Merge the nodes into the children from the end, a new node goes
+	   after the children comparing equal to it. The new nodes are not
+	   inserted yet, so they stay out of the visible index until their
+	   row-inserted is emitted below */
+	n_old = dir->children->len;
+	g_ptr_array_set_size (dir->children, n_old + n_nodes);
 
-					/* Emit row inserted */
-					row_inserted (model, &path, &iter);
-					gtk_tree_path_free (path);
-				}
+	i = n_old;
+	j = n_nodes;
+	k = n_old + n_nodes;
 
-				model_check_dummy (model, l->data);
-			}
-
-			break;
+	while (j > 0)
+	{
+		if (i > 0 &&
+		    model->priv->sort_func (g_ptr_array_index (dir->children, i - 1),
+					    nodes[j - 1]) > 0)
+		{
+			dir->children->pdata[--k] = dir->children->pdata[--i];
 		}
-
-		if (model->priv->sort_func (l->data, node) > 0)
+		else
 		{
-			GSList *next_child;
-
-			if (prev == NULL)
-			{
-				/* Prepend to the list */
-				dir->children = g_slist_prepend (dir->children, child);
-			}
-			else
-			{
-				prev->next = child;
-			}
+			dir->children->pdata[--k] = nodes[--j];
+		}
+	}
 
-			next_child = child->next;
-			prev = child;
-			child->next = l;
-			child = next_child;
+	file_browser_node_dir_reindex (dir, k);
+	g_free (nodes);
 
-			if (model_node_visibility (model, parent) &&
-			    model_node_visibility (model, node))
-			{
-				iter.user_data = node;
-				path = gedit_file_browser_store_get_path_real (model, node);
+	for (child = sorted_children; child; child = child->next)
+	{
+		FileBrowserNode *node = child->data;
 
-				/* Emit row inserted */
-				row_inserted (model, &path, &iter);
-				gtk_tree_path_free (path);
-			}
+		if (model_node_visibility (model, parent) &&
+		    model_node_visibility (model, node))
+		{
+			GtkTreeIter iter;
+			GtkTreePath *path;
 
-			model_check_dummy (model, node);
+			iter.user_data = node;
+			path = gedit_file_browser_store_get_path_real (model, node);
 
-			/* Try again at the same l position with the next child */
-		}
-		else
-		{
-			/* Move to the next item in the list */
-			prev = l;
-			l = l->next;
+			/* Emit row inserted */
+			row_inserted (model, &path, &iter);
+			gtk_tree_path_free (path);
 		}
+
+		model_check_dummy (model, node);
 	}
+
+	g_slist_free (sorted_children);
 }
 
 static gchar const *
@@ -2166,28 +2417,6 @@ file_browser_node_set_from_info (GeditFileBrowserStore *model,
 	}
 }
 
-static FileBrowserNode *
-node_list_contains_file (GSList *children,
-			 GFile  *file)
-{
-	GSList *item;
-
-	for (item = children; item; item = item->next)
-	{
-		FileBrowserNode *node;
-
-		node = (FileBrowserNode *) (item->data);
-
-		if (node->file != NULL &&
-		    g_file_equal (node->file, file))
-		{
-			return node;
-		}
-	}
-
-	return NULL;
-}
-
 static FileBrowserNode *
 model_add_node_from_file (GeditFileBrowserStore *model,
 			  FileBrowserNode       *parent,
@@ -2198,7 +2427,7 @@ model_add_node_from_file (GeditFileBrowserStore *model,
 	gboolean free_info = FALSE;
 	GError *error = NULL;
 
-	if ((node = node_list_contains_file (FILE_BROWSER_NODE_DIR (parent)->children, file)) == NULL)
+	if ((node = model_lookup_child (model, parent, file)) == NULL)
 	{
 		if (info == NULL)
 		{
@@ -2237,13 +2466,9 @@ model_add_node_from_file (GeditFileBrowserStore *model,
 	return node;
 }
 
-/* We pass in a copy of the list of parent->children so that we do
- * not have to check if a file already exists among the ones we just
- * added */
 static void
 model_add_nodes_from_files (GeditFileBrowserStore *model,
 			    FileBrowserNode       *parent,
-			    GSList                *original_children,
 			    GList                 *files)
 {
 	GList *item;
@@ -2280,7 +2505,7 @@ model_add_nodes_from_files (GeditFileBrowserStore *model,
 		}
 
 		file = g_file_get_child (parent->file, name);
-		node = node_list_contains_file (original_children, file);
+		node = model_lookup_child (model, parent, file);
 		if (node == NULL)
 		{
 			if (type == G_FILE_TYPE_DIRECTORY)
@@ -2309,7 +2534,7 @@ model_add_node_from_dir (GeditFileBrowserStore *model,
 	FileBrowserNode *node;
 
 	/* Check if it already exists */
-	if ((node = node_list_contains_file (FILE_BROWSER_NODE_DIR (parent)->children, file)) == NULL)
+	if ((node = model_lookup_child (model, parent, file)) == NULL)
 	{
 		node = file_browser_node_dir_new (model, file, parent);
 		file_browser_node_set_from_info (model, node, NULL, FALSE);
@@ -2339,7 +2564,7 @@ on_directory_monitor_event (GFileMonitor      *monitor,
 	switch (event_type)
 	{
 		case G_FILE_MONITOR_EVENT_DELETED:
-			node = node_list_contains_file (dir->children, file);
+			node = model_lookup_child (dir->model, parent, file);
 
 			if (node != NULL)
 				model_remove_node (dir->model, node, NULL, TRUE);
@@ -2358,7 +2583,6 @@ static void
 async_node_free (AsyncNode *async)
 {
 	g_object_unref (async->cancellable);
-	g_slist_free (async->original_children);
 	g_slice_free (AsyncNode, async);
 }
 
@@ -2436,7 +2660,7 @@ model_iterate_next_files_cb (GFileEnumerator *enumerator,
 	}
 	else
 	{
-		model_add_nodes_from_files (dir->model, parent, async->original_children, files);
+		model_add_nodes_from_files (dir->model, parent, files);
 
 		g_list_free (files);
 		next_files_async (enumerator, async);
@@ -2516,7 +2740,6 @@ model_load_directory (GeditFileBrowserStore *model,
 	async = g_slice_new (AsyncNode);
 	async->dir = dir;
 	async->cancellable = g_object_ref (dir->cancellable);
-	async->original_children = g_slist_copy (dir->children);
 
 	/* Start loading async */
 	g_file_enumerate_children_async (node->file,
@@ -2557,8 +2780,9 @@ model_fill (GeditFileBrowserStore  *model,
 {
 	gboolean free_path = FALSE;
 	GtkTreeIter iter = {0,};
-	GSList *item;
+	FileBrowserNodeDir *dir;
 	FileBrowserNode *child;
+	guint i;
 
 	if (node == NULL)
 	{
@@ -2593,9 +2817,11 @@ model_fill (GeditFileBrowserStore  *model,
 		/* Go to the first child */
 		gtk_tree_path_down (*path);
 
-		for (item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
+		dir = FILE_BROWSER_NODE_DIR (node);
+
+		for (i = 0; i < dir->children->len; ++i)
 		{
-			child = (FileBrowserNode *) (item->data);
+			child = (FileBrowserNode *) g_ptr_array_index (dir->children, i);
 
 			if (model_node_visibility (model, child))
 			{
@@ -2624,8 +2850,9 @@ set_virtual_root_from_node (GeditFileBrowserStore *model,
 	FileBrowserNode *prev;
 	FileBrowserNode *check;
 	FileBrowserNodeDir *dir;
-	GSList *item;
-	GSList *copy;
+	GPtrArray *children;
+	guint i;
+	guint j;
 	GtkTreePath *empty = NULL;
 
 	prev = node;
@@ -2635,14 +2862,13 @@ set_virtual_root_from_node (GeditFileBrowserStore *model,
 	while (prev != model->priv->root)
 	{
 		dir = FILE_BROWSER_NODE_DIR (next);
-		copy = g_slist_copy (dir->children);
 
-		for (item = copy; item; item = item->next)
+		if (prev == node)
 		{
-			check = (FileBrowserNode *) (item->data);
-
-			if (prev == node)
+			for (i = 0; i < dir->children->len; ++i)
 			{
+				check = (FileBrowserNode *) g_ptr_array_index (dir->children, i);
+
 				/* Only free the children, keeping this depth in cache */
 				if (check != node)
 				{
@@ -2652,41 +2878,55 @@ set_virtual_root_from_node (GeditFileBrowserStore *model,
 								  FALSE);
 				}
 			}
-			else if (check != prev)
+		}
+		else
+		{
+			/* Only keep the node in the chain */
+			children = dir->children;
+			dir->children = g_ptr_array_new ();
+			g_ptr_array_add (dir->children, prev);
+			file_browser_node_dir_reindex (dir, 0);
+
+			for (i = 0; i < children->len; ++i)
 			{
-				/* Only free when the node is not in the chain */
-				dir->children = g_slist_remove (dir->children, check);
-				file_browser_node_free (model, check);
+				check = (FileBrowserNode *) g_ptr_array_index (children, i);
+
+				if (check != prev)
+					file_browser_node_free (model, check);
 			}
-		}
 
-		if (prev != node)
+			g_ptr_array_unref (children);
 			file_browser_node_unload (model, next, FALSE);
+		}
 
-		g_slist_free (copy);
 		prev = next;
 		next = prev->parent;
 	}
 
 	/* Free all the nodes up that we don't need in cache */
-	for (item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
+	dir = FILE_BROWSER_NODE_DIR (node);
+
+	for (i = 0; i < dir->children->len; ++i)
 	{
-		check = (FileBrowserNode *) (item->data);
+		check = (FileBrowserNode *) g_ptr_array_index (dir->children, i);
 
 		if (NODE_IS_DIR (check))
 		{
-			for (copy = FILE_BROWSER_NODE_DIR (check)->children; copy; copy = copy->next)
+			children = FILE_BROWSER_NODE_DIR (check)->children;
+
+			for (j = 0; j < children->len; ++j)
 			{
 				file_browser_node_free_children (model,
-								 (FileBrowserNode*) (copy->data));
+								 g_ptr_array_index (children, j));
 				file_browser_node_unload (model,
-							  (FileBrowserNode*) (copy->data),
+							  g_ptr_array_index (children, j),
 							  FALSE);
 			}
 		}
 		else if (NODE_IS_DUMMY (check))
 		{
 			check->flags |= GEDIT_FILE_BROWSER_STORE_FLAG_IS_HIDDEN;
+			file_browser_node_update_index (check);
 		}
 	}
 
@@ -2715,6 +2955,15 @@ set_virtual_root_from_file (GeditFileBrowserStore *model,
 	/* Always clear the model before altering the nodes */
 	model_clear (model, FALSE);
 
+	/* If the directory is already known, so is the path to it */
+	parent = g_hash_table_lookup (model->priv->file_index, file);
+
+	if (parent != NULL && NODE_IS_DIR (parent))
+	{
+		set_virtual_root_from_node (model, parent);
+		return;
+	}
+
 	/* Create the node path, get all the uri's */
 	files = get_parent_files (model, file);
 	parent = model->priv->root;
@@ -2731,49 +2980,23 @@ set_virtual_root_from_file (GeditFileBrowserStore *model,
 	set_virtual_root_from_node (model, parent);
 }
 
-static FileBrowserNode *
-model_find_node_children (GeditFileBrowserStore *model,
-			  FileBrowserNode       *parent,
-			  GFile                 *file)
-{
-	FileBrowserNodeDir *dir;
-	FileBrowserNode *child;
-	FileBrowserNode *result;
-	GSList *children;
-
-	if (!NODE_IS_DIR (parent))
-		return NULL;
-
-	dir = FILE_BROWSER_NODE_DIR (parent);
-
-	for (children = dir->children; children; children = children->next)
-	{
-		child = (FileBrowserNode *)(children->data);
-
-		result = model_find_node (model, child, file);
-
-		if (result)
-			return result;
-	}
-
-	return NULL;
-}
-
 static FileBrowserNode *
 model_find_node (GeditFileBrowserStore *model,
 		 FileBrowserNode       *node,
 		 GFile                 *file)
 {
+	FileBrowserNode *result;
+
 	if (node == NULL)
 		node = model->priv->root;
 
-	if (node->file && g_file_equal (node->file, file))
-		return node;
+	result = g_hash_table_lookup (model->priv->file_index, file);
 
-	if (NODE_IS_DIR (node) && g_file_has_prefix (file, node->file))
-		return model_find_node_children (model, node, file);
+	/* Only look below node */
+	if (result != NULL && result != node && !node_has_parent (result, node))
+		return NULL;
 
-	return NULL;
+	return result;
 }
 
 static GQuark
@@ -3228,6 +3451,7 @@ gedit_file_browser_store_set_root_and_virtual_root (GeditFileBrowserStore *model
 	{
 		/* Create the root node */
 		node = file_browser_node_dir_new (model, root, NULL);
+		model_index_node (model, node);
 
 		model->priv->root = node;
 		return model_mount_root (model, virtual_root);
@@ -3299,7 +3523,8 @@ _gedit_file_browser_store_iter_collapsed (GeditFileBrowserStore *model,
 					  GtkTreeIter           *iter)
 {
 	FileBrowserNode *node;
-	GSList *item;
+	FileBrowserNodeDir *dir;
+	guint i;
 
 	g_return_if_fail (GEDIT_IS_FILE_BROWSER_STORE (model));
 	g_return_if_fail (iter != NULL);
@@ -3310,10 +3535,11 @@ _gedit_file_browser_store_iter_collapsed (GeditFileBrowserStore *model,
 	if (NODE_IS_DIR (node) && NODE_LOADED (node))
 	{
 		/* Unload children of the children, keeping 1 depth in cache */
+		dir = FILE_BROWSER_NODE_DIR (node);
 
-		for (item = FILE_BROWSER_NODE_DIR (node)->children; item; item = item->next)
+		for (i = 0; i < dir->children->len; ++i)
 		{
-			node = (FileBrowserNode *) (item->data);
+			node = (FileBrowserNode *) g_ptr_array_index (dir->children, i);
 
 			if (NODE_IS_DIR (node) && NODE_LOADED (node))
 			{
@@ -3433,8 +3659,9 @@ gedit_file_browser_store_refresh (GeditFileBrowserStore *model)
 }
 
 static void
-reparent_node (FileBrowserNode *node,
-	       gboolean         reparent)
+reparent_node (GeditFileBrowserStore *model,
+	       FileBrowserNode       *node,
+	       gboolean               reparent)
 {
 	if (!node->file)
 		return;
@@ -3446,22 +3673,24 @@ reparent_node (FileBrowserNode *node,
 
 		parent = node->parent->file;
 		base = g_file_get_basename (node->file);
+		model_unindex_node (model, node);
 		g_object_unref (node->file);
 
 		node->file = g_file_get_child (parent, base);
+		model_index_node (model, node);
 		g_free (base);
 	}
 
 	if (NODE_IS_DIR (node))
 	{
 		FileBrowserNodeDir *dir;
-		GSList *child;
+		guint i;
 
 		dir = FILE_BROWSER_NODE_DIR (node);
 
-		for (child = dir->children; child; child = child->next)
+		for (i = 0; i < dir->children->len; ++i)
 		{
-			reparent_node ((FileBrowserNode *)child->data, TRUE);
+			reparent_node (model, g_ptr_array_index (dir->children, i), TRUE);
 		}
 	}
 }
@@ -3499,14 +3728,18 @@ gedit_file_browser_store_rename (GeditFileBrowserStore  *model,
 
 	if (g_file_move (node->file, file, G_FILE_COPY_NONE, NULL, NULL, NULL, &err))
 	{
+		model_unindex_node (model, node);
+
 		previous = node->file;
 		node->file = file;
 
+		model_index_node (model, node);
+
 		/* This makes sure the actual info for the node is requeried */
 		file_browser_node_set_name (node);
 		file_browser_node_set_from_info (model, node, NULL, TRUE);
 
-		reparent_node (node, FALSE);
+		reparent_node (model, node, FALSE);
 
 		if (model_node_visibility (model, node))
 		{
@@ -3876,6 +4109,55 @@ gedit_file_browser_store_new_directory (GeditFileBrowserStore *model,
 	return result;
 }
 
+/* Only for the tests: adds the files named @names to the directory at @iter
+ * the way a directory load does, by batches of
+ * DIRECTORY_LOAD_ITEMS_PER_CALLBACK, without querying the files */
+void
+_gedit_file_browser_store_add_files (GeditFileBrowserStore *model,
+				     GtkTreeIter           *iter,
+				     const gchar * const   *names)
+{
+	FileBrowserNode *parent;
+	guint i = 0;
+
+	g_return_if_fail (GEDIT_IS_FILE_BROWSER_STORE (model));
+	g_return_if_fail (iter != NULL);
+	g_return_if_fail (iter->user_data != NULL);
+	g_return_if_fail (names != NULL);
+
+	parent = (FileBrowserNode *) (iter->user_data);
+
+	g_return_if_fail (NODE_IS_DIR (parent));
+
+	while (names[i] != NULL)
+	{
+		GSList *nodes = NULL;
+		guint n;
+
+		for (n = 0; n < DIRECTORY_LOAD_ITEMS_PER_CALLBACK && names[i] != NULL; ++n, ++i)
+		{
+			GFile *file;
+
+			file = g_file_get_child (parent->file, names[i]);
+
+			if (model_lookup_child (model, parent, file) == NULL)
+			{
+				FileBrowserNode *node;
+
+				node = file_browser_node_new (file, parent);
+				model_node_update_visibility (model, node);
+
+				nodes = g_slist_prepend (nodes, node);
+			}
+
+			g_object_unref (file);
+		}
+
+		if (nodes)
+			model_add_nodes_batch (model, nodes, parent);
+	}
+}
+
 void
 _gedit_file_browser_store_register_type (GTypeModule *type_module)
 {
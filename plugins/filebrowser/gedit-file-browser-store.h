@@ -204,6 +204,11 @@ gedit_file_browser_store_cancel_mount_operation			(GeditFileBrowserStore
 
 void		 _gedit_file_browser_store_register_type	(GTypeModule                      *type_module);
 
+/* Only for the tests */
+void		 _gedit_file_browser_store_add_files		(GeditFileBrowserStore            *model,
+								 GtkTreeIter                      *iter,
+								 const gchar * const              *names);
+
 G_END_DECLS
 
 #endif /* __GEDIT_FILE_BROWSER_STORE_H__ */
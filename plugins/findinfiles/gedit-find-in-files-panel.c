@@ -0,0 +1,1092 @@
+/*
+ * gedit-find-in-files-panel.c
+ * This file is part of gedit
+ *
+ * Copyright (C) 2015 - The gedit Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gedit-find-in-files-panel.h"
+
+#include <string.h>
+#include <glib/gi18n.h>
+
+#include <gedit/gedit-app.h>
+#include <gedit/gedit-commands.h>
+#include <gedit/gedit-debug.h>
+#include <gedit/gedit-document.h>
+#include <gedit/gedit-tab.h>
+#include <gedit/gedit-view.h>
+
+#include "gedit-find-in-files-search.h"
+
+/* The filters of the file browser are used for the search too. */
+#define FILEBROWSER_BASE_SETTINGS	"org.gnome.gedit.plugins.filebrowser"
+#define FILEBROWSER_FILTER_MODE		"filter-mode"
+#define FILEBROWSER_BINARY_PATTERNS	"binary-patterns"
+
+/* Same values as GeditFileBrowserStoreFilterMode. */
+#define FILTER_MODE_HIDE_HIDDEN		(1 << 0)
+#define FILTER_MODE_HIDE_BINARY		(1 << 1)
+
+/* Interval between two updates of the status while searching, in
+ * milliseconds.
+ */
+#define STATUS_INTERVAL			250
+
+typedef struct _ReplaceAllData ReplaceAllData;
+
+enum
+{
+	COLUMN_TEXT,
+	COLUMN_LOCATION,
+	COLUMN_LINE,
+	COLUMN_COLUMN,
+	COLUMN_DOCUMENT
+};
+
+struct _GeditFindInFilesPanelPrivate
+{
+	GeditWindow *window;
+
+	GSettings *filebrowser_settings;
+
+	GeditFindInFilesSearch *search;
+	GFile *root;
+	guint n_matches;
+	guint status_id;
+
+	/* The pattern and the flags of the last search, for Replace All. */
+	gchar *pattern;
+	GeditFindInFilesFlags flags;
+
+	/* GFile -> GtkTreeIter of the row of the file. */
+	GHashTable *file_rows;
+
+	/* GeditDocument -> GtkTreeIter of the row of the document. */
+	GHashTable *document_rows;
+
+	/* The running Replace All, or NULL. */
+	ReplaceAllData *replace_all;
+
+	GtkWidget *search_entry;
+	GtkWidget *folder_button;
+	GtkWidget *documents_checkbutton;
+	GtkWidget *case_checkbutton;
+	GtkWidget *regex_checkbutton;
+	GtkWidget *find_button;
+	GtkWidget *replace_entry;
+	GtkWidget *replace_all_button;
+	GtkWidget *status_label;
+	GtkWidget *results_treeview;
+	GtkTreeStore *results_store;
+};
+
+G_DEFINE_DYNAMIC_TYPE_EXTENDED (GeditFindInFilesPanel,
+				gedit_find_in_files_panel,
+				GTK_TYPE_BOX,
+				0,
+				G_ADD_PRIVATE_DYNAMIC (GeditFindInFilesPanel))
+
+static GSettings *
+settings_try_new (const gchar *schema_id)
+{
+	GSettings *settings = NULL;
+	GSettingsSchemaSource *source;
+	GSettingsSchema *schema;
+
+	source = g_settings_schema_source_get_default ();
+
+	schema = g_settings_schema_source_lookup (source, schema_id, TRUE);
+
+	if (schema != NULL)
+	{
+		settings = g_settings_new_full (schema, NULL, NULL);
+		g_settings_schema_unref (schema);
+	}
+
+	return settings;
+}
+
+static void
+tree_iter_free (GtkTreeIter *iter)
+{
+	g_slice_free (GtkTreeIter, iter);
+}
+
+/* The results keep a reference on the documents, which can have been closed
+ * since the search.
+ */
+static GeditTab *
+get_open_tab (GeditDocument *doc)
+{
+	GList *documents;
+	GeditTab *tab = NULL;
+
+	documents = gedit_app_get_documents (GEDIT_APP (g_application_get_default ()));
+
+	if (g_list_find (documents, doc) != NULL)
+	{
+		tab = gedit_tab_get_from_document (doc);
+	}
+
+	g_list_free (documents);
+
+	return tab;
+}
+
+static void
+update_status (GeditFindInFilesPanel *panel)
+{
+	GeditFindInFilesPanelPrivate *priv = panel->priv;
+	guint n_files;
+	guint64 n_bytes;
+	gdouble elapsed;
+	gchar *size;
+	gchar *matches;
+	gchar *status;
+
+	if (priv->search == NULL)
+	{
+		return;
+	}
+
+	gedit_find_in_files_search_get_progress (priv->search, &n_files, &n_bytes, &elapsed);
+
+	size = g_format_size (elapsed > 0 ? (guint64) (n_bytes / elapsed) : n_bytes);
+
+	matches = g_strdup_printf (ngettext ("%u match", "%u matches", priv->n_matches),
+				   priv->n_matches);
+
+	/* Translators: the first %s is the number of matches, the second one
+	 * is the throughput, for example "2.5 MB".
+	 */
+	status = g_strdup_printf (ngettext ("%s in %u file, %s/s",
+					    "%s in %u files, %s/s",
+					    n_files),
+				  matches,
+				  n_files,
+				  size);
+
+	if (gedit_find_in_files_search_is_truncated (priv->search))
+	{
+		gchar *truncated;
+
+		truncated = g_strdup_printf ("%s %s", _("Too many matches, the search stopped."), status);
+		g_free (status);
+		status = truncated;
+	}
+
+	gtk_label_set_text (GTK_LABEL (priv->status_label), status);
+
+	g_free (size);
+	g_free (matches);
+	g_free (status);
+}
+
+static gboolean
+status_timeout_cb (GeditFindInFilesPanel *panel)
+{
+	update_status (panel);
+
+	return G_SOURCE_CONTINUE;
+}
+
+static GtkTreeIter *
+get_file_row (GeditFindInFilesPanel *panel,
+	      GeditFindInFilesMatch *match,
+	      gboolean              *created)
+{
+	GeditFindInFilesPanelPrivate *priv = panel->priv;
+	GHashTable *rows;
+	gpointer key;
+	GtkTreeIter *iter;
+	gchar *name;
+
+	if (match->document != NULL)
+	{
+		rows = priv->document_rows;
+		key = match->document;
+	}
+	else
+	{
+		rows = priv->file_rows;
+		key = match->location;
+	}
+
+	iter = g_hash_table_lookup (rows, key);
+
+	if (iter != NULL)
+	{
+		*created = FALSE;
+		return iter;
+	}
+
+	if (match->document != NULL)
+	{
+		name = gedit_document_get_short_name_for_display (GEDIT_DOCUMENT (match->document));
+	}
+	else
+	{
+		name = g_file_get_relative_path (priv->root, match->location);
+
+		if (name == NULL)
+		{
+			name = g_file_get_parse_name (match->location);
+		}
+	}
+
+	iter = g_slice_new (GtkTreeIter);
+
+	gtk_tree_store_insert_with_values (priv->results_store,
+					   iter,
+					   NULL,
+					   -1,
+					   COLUMN_TEXT, name,
+					   COLUMN_LOCATION, match->location,
+					   COLUMN_LINE, -1,
+					   COLUMN_COLUMN, -1,
+					   COLUMN_DOCUMENT, match->document,
+					   -1);
+
+	g_hash_table_insert (rows, g_object_ref (key), iter);
+
+	g_free (name);
+
+	*created = TRUE;
+	return iter;
+}
+
+static void
+matches_found_cb (GeditFindInFilesSearch *search,
+		  GPtrArray              *matches,
+		  GeditFindInFilesPanel  *panel)
+{
+	GeditFindInFilesPanelPrivate *priv = panel->priv;
+	guint i;
+
+	for (i = 0; i < matches->len; i++)
+	{
+		GeditFindInFilesMatch *match = g_ptr_array_index (matches, i);
+		GtkTreeIter *parent;
+		gboolean created;
+		gchar *text;
+
+		parent = get_file_row (panel, match, &created);
+
+		text = g_strdup_printf ("%d: %s", match->line + 1, g_strchug (match->text));
+
+		gtk_tree_store_insert_with_values (priv->results_store,
+						   NULL,
+						   parent,
+						   -1,
+						   COLUMN_TEXT, text,
+						   COLUMN_LOCATION, match->location,
+						   COLUMN_LINE, match->line,
+						   COLUMN_COLUMN, match->column,
+						   COLUMN_DOCUMENT, match->document,
+						   -1);
+
+		g_free (text);
+
+		if (created)
+		{
+			GtkTreePath *path;
+
+			path = gtk_tree_model_get_path (GTK_TREE_MODEL (priv->results_store), parent);
+			gtk_tree_view_expand_row (GTK_TREE_VIEW (priv->results_treeview), path, FALSE);
+			gtk_tree_path_free (path);
+		}
+	}
+
+	priv->n_matches += matches->len;
+}
+
+static void
+finished_cb (GeditFindInFilesSearch *search,
+	     GeditFindInFilesPanel  *panel)
+{
+	GeditFindInFilesPanelPrivate *priv = panel->priv;
+
+	gedit_debug (DEBUG_PLUGINS);
+
+	if (priv->status_id != 0)
+	{
+		g_source_remove (priv->status_id);
+		priv->status_id = 0;
+	}
+
+	update_status (panel);
+
+	gtk_button_set_label (GTK_BUTTON (priv->find_button), _("_Find"));
+
+	gtk_widget_set_sensitive (priv->replace_all_button,
+				  g_hash_table_size (priv->document_rows) > 0);
+}
+
+static void
+clear_results (GeditFindInFilesPanel *panel)
+{
+	GeditFindInFilesPanelPrivate *priv = panel->priv;
+
+	gtk_tree_store_clear (priv->results_store);
+	g_hash_table_remove_all (priv->file_rows);
+	g_hash_table_remove_all (priv->document_rows);
+	priv->n_matches = 0;
+
+	gtk_widget_set_sensitive (priv->replace_all_button, FALSE);
+}
+
+static void
+stop_search (GeditFindInFilesPanel *panel)
+{
+	GeditFindInFilesPanelPrivate *priv = panel->priv;
+
+	if (priv->status_id != 0)
+	{
+		g_source_remove (priv->status_id);
+		priv->status_id = 0;
+	}
+
+	if (priv->search != NULL)
+	{
+		g_signal_handlers_disconnect_by_data (priv->search, panel);
+		gedit_find_in_files_search_cancel (priv->search);
+		g_clear_object (&priv->search);
+	}
+}
+
+static void
+start_search (GeditFindInFilesPanel *panel)
+{
+	GeditFindInFilesPanelPrivate *priv = panel->priv;
+	GeditFindInFilesFlags flags = GEDIT_FIND_IN_FILES_FLAG_HIDE_HIDDEN |
+				      GEDIT_FIND_IN_FILES_FLAG_HIDE_BINARY;
+	gchar **binary_patterns = NULL;
+	const gchar *pattern;
+	GFile *root;
+	GError *error = NULL;
+
+	gedit_debug (DEBUG_PLUGINS);
+
+	pattern = gtk_entry_get_text (GTK_ENTRY (priv->search_entry));
+
+	/* The Find button is insensitive during Replace All, but not the
+	 * entry.
+	 */
+	if (pattern[0] == '\0' || priv->replace_all != NULL)
+	{
+		return;
+	}
+
+	stop_search (panel);
+
+	if (gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (priv->case_checkbutton)))
+	{
+		flags |= GEDIT_FIND_IN_FILES_FLAG_CASE_SENSITIVE;
+	}
+
+	if (gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (priv->regex_checkbutton)))
+	{
+		flags |= GEDIT_FIND_IN_FILES_FLAG_REGEX;
+	}
+
+	if (priv->filebrowser_settings != NULL)
+	{
+		guint filter_mode;
+
+		filter_mode = g_settings_get_flags (priv->filebrowser_settings, FILEBROWSER_FILTER_MODE);
+
+		if (!(filter_mode & FILTER_MODE_HIDE_HIDDEN))
+		{
+			flags &= ~GEDIT_FIND_IN_FILES_FLAG_HIDE_HIDDEN;
+		}
+
+		if (!(filter_mode & FILTER_MODE_HIDE_BINARY))
+		{
+			flags &= ~GEDIT_FIND_IN_FILES_FLAG_HIDE_BINARY;
+		}
+
+		binary_patterns = g_settings_get_strv (priv->filebrowser_settings,
+						       FILEBROWSER_BINARY_PATTERNS);
+	}
+
+	if (gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (priv->documents_checkbutton)))
+	{
+		GList *documents;
+
+		root = NULL;
+
+		documents = gedit_window_get_documents (priv->window);
+
+		priv->search = gedit_find_in_files_search_new_for_documents (documents,
+									     pattern,
+									     flags,
+									     &error);
+
+		g_list_free (documents);
+	}
+	else
+	{
+		root = gtk_file_chooser_get_file (GTK_FILE_CHOOSER (priv->folder_button));
+
+		if (root == NULL)
+		{
+			root = g_file_new_for_path (g_get_home_dir ());
+		}
+
+		priv->search = gedit_find_in_files_search_new (root,
+							       pattern,
+							       flags,
+							       (const gchar * const *) binary_patterns,
+							       &error);
+	}
+
+	g_strfreev (binary_patterns);
+
+	clear_results (panel);
+
+	g_clear_object (&priv->root);
+	priv->root = root;
+
+	g_free (priv->pattern);
+	priv->pattern = g_strdup (pattern);
+	priv->flags = flags;
+
+	if (priv->search == NULL)
+	{
+		gtk_label_set_text (GTK_LABEL (priv->status_label), error->message);
+		g_error_free (error);
+		return;
+	}
+
+	g_signal_connect (priv->search,
+			  "matches-found",
+			  G_CALLBACK (matches_found_cb),
+			  panel);
+
+	g_signal_connect (priv->search,
+			  "finished",
+			  G_CALLBACK (finished_cb),
+			  panel);
+
+	gedit_find_in_files_search_start (priv->search);
+
+	gtk_button_set_label (GTK_BUTTON (priv->find_button), _("_Stop"));
+	gtk_label_set_text (GTK_LABEL (priv->status_label), _("Searching…"));
+
+	priv->status_id = g_timeout_add (STATUS_INTERVAL,
+					 (GSourceFunc) status_timeout_cb,
+					 panel);
+}
+
+static void
+find_button_clicked_cb (GtkButton             *button,
+			GeditFindInFilesPanel *panel)
+{
+	GeditFindInFilesPanelPrivate *priv = panel->priv;
+
+	if (priv->search != NULL &&
+	    gedit_find_in_files_search_is_running (priv->search))
+	{
+		/* finished_cb() updates the button and the status. */
+		gedit_find_in_files_search_cancel (priv->search);
+	}
+	else
+	{
+		start_search (panel);
+	}
+}
+
+static void
+search_entry_activate_cb (GtkEntry              *entry,
+			  GeditFindInFilesPanel *panel)
+{
+	start_search (panel);
+}
+
+static void
+results_treeview_row_activated_cb (GtkTreeView           *treeview,
+				   GtkTreePath           *path,
+				   GtkTreeViewColumn     *column,
+				   GeditFindInFilesPanel *panel)
+{
+	GeditFindInFilesPanelPrivate *priv = panel->priv;
+	GtkTreeIter iter;
+	GFile *location;
+	GObject *document;
+	GeditTab *tab = NULL;
+	gint line;
+	gint line_column;
+
+	if (!gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->results_store), &iter, path))
+	{
+		return;
+	}
+
+	gtk_tree_model_get (GTK_TREE_MODEL (priv->results_store),
+			    &iter,
+			    COLUMN_LOCATION, &location,
+			    COLUMN_LINE, &line,
+			    COLUMN_COLUMN, &line_column,
+			    COLUMN_DOCUMENT, &document,
+			    -1);
+
+	if (document != NULL)
+	{
+		tab = get_open_tab (GEDIT_DOCUMENT (document));
+	}
+
+	if (tab != NULL)
+	{
+		GtkWidget *window;
+		GeditView *view;
+
+		/* The document can have been moved to another window. */
+		window = gtk_widget_get_toplevel (GTK_WIDGET (tab));
+		gedit_window_set_active_tab (GEDIT_WINDOW (window), tab);
+		gtk_window_present (GTK_WINDOW (window));
+
+		view = gedit_tab_get_view (tab);
+
+		if (line >= 0)
+		{
+			gedit_document_goto_line_offset (GEDIT_DOCUMENT (document), line, line_column);
+			gedit_view_scroll_to_cursor (view);
+		}
+
+		gtk_widget_grab_focus (GTK_WIDGET (view));
+	}
+	else if (location != NULL)
+	{
+		/* The file rows have no line, the file is just opened. */
+		gedit_commands_load_location (priv->window,
+					      location,
+					      NULL,
+					      line + 1,
+					      line_column + 1);
+	}
+
+	g_clear_object (&location);
+	g_clear_object (&document);
+}
+
+/* Replace All goes through the documents one at a time, each one with
+ * gedit_tab_replace_all_async(), so the UI stays responsive and each document
+ * gets its own undo action.
+ */
+struct _ReplaceAllData
+{
+	/* NULL once the panel is disposed. */
+	GeditFindInFilesPanel *panel;
+
+	GCancellable *cancellable;
+	GtkSourceSearchSettings *settings;
+	gchar *replace;
+
+	/* The documents left, with a reference. */
+	GList *documents;
+
+	guint n_replaced;
+	guint n_documents;
+	guint n_skipped;
+};
+
+static void
+replace_all_data_free (ReplaceAllData *data)
+{
+	g_object_unref (data->cancellable);
+	g_object_unref (data->settings);
+	g_free (data->replace);
+	g_list_free_full (data->documents, g_object_unref);
+
+	g_slice_free (ReplaceAllData, data);
+}
+
+static void
+replace_all_finished (ReplaceAllData *data,
+		      const GError   *error)
+{
+	GeditFindInFilesPanel *panel = data->panel;
+	GeditFindInFilesPanelPrivate *priv;
+	gchar *replaced;
+	gchar *status;
+
+	if (panel == NULL)
+	{
+		replace_all_data_free (data);
+		return;
+	}
+
+	priv = panel->priv;
+	priv->replace_all = NULL;
+
+	gtk_button_set_label (GTK_BUTTON (priv->replace_all_button), _("_Replace All"));
+	gtk_widget_set_sensitive (priv->replace_all_button, FALSE);
+	gtk_widget_set_sensitive (priv->find_button, TRUE);
+
+	if (error != NULL)
+	{
+		gtk_label_set_text (GTK_LABEL (priv->status_label), error->message);
+		replace_all_data_free (data);
+		return;
+	}
+
+	replaced = g_strdup_printf (ngettext ("Replaced %u occurrence",
+					      "Replaced %u occurrences",
+					      data->n_replaced),
+				    data->n_replaced);
+
+	/* Translators: the %s is "Replaced N occurrences". */
+	status = g_strdup_printf (ngettext ("%s in %u document",
+					    "%s in %u documents",
+					    data->n_documents),
+				  replaced,
+				  data->n_documents);
+
+	if (data->n_skipped > 0)
+	{
+		gchar *skipped;
+
+		/* Translators: the %s is "Replaced N occurrences in M
+		 * documents".
+		 */
+		skipped = g_strdup_printf (ngettext ("%s, %u read-only or busy document skipped",
+						     "%s, %u read-only or busy documents skipped",
+						     data->n_skipped),
+					   status,
+					   data->n_skipped);
+
+		g_free (status);
+		status = skipped;
+	}
+
+	gtk_label_set_text (GTK_LABEL (priv->status_label), status);
+
+	g_free (replaced);
+	g_free (status);
+
+	replace_all_data_free (data);
+}
+
+static void
+replace_all_progress_cb (gint            n_replaced,
+			 gdouble         fraction,
+			 ReplaceAllData *data)
+{
+	gchar *status;
+	guint total;
+
+	if (data->panel == NULL)
+	{
+		return;
+	}
+
+	total = data->n_replaced + n_replaced;
+
+	status = g_strdup_printf (ngettext ("%u occurrence replaced",
+					    "%u occurrences replaced",
+					    total),
+				  total);
+
+	gtk_label_set_text (GTK_LABEL (data->panel->priv->status_label), status);
+
+	g_free (status);
+}
+
+static void replace_all_next (ReplaceAllData *data);
+
+static void
+replace_all_cb (GeditTab       *tab,
+		GAsyncResult   *result,
+		ReplaceAllData *data)
+{
+	gint n_replaced = 0;
+	GError *error = NULL;
+
+	gedit_tab_replace_all_finish (tab, result, &n_replaced, &error);
+
+	if (n_replaced > 0)
+	{
+		data->n_replaced += n_replaced;
+		data->n_documents++;
+	}
+
+	if (error == NULL)
+	{
+		replace_all_next (data);
+		return;
+	}
+
+	if (g_cancellable_is_cancelled (data->cancellable))
+	{
+		/* Stopped, the counts so far are shown. */
+		replace_all_finished (data, NULL);
+	}
+	else if (error->domain == G_IO_ERROR &&
+		 (error->code == G_IO_ERROR_CANCELLED ||
+		  error->code == G_IO_ERROR_BUSY ||
+		  error->code == G_IO_ERROR_NOT_SUPPORTED))
+	{
+		/* The document has been closed or can't be edited. */
+		data->n_skipped++;
+		replace_all_next (data);
+	}
+	else
+	{
+		/* For example an invalid reference in the replacement of a
+		 * regex, which fails in every document.
+		 */
+		replace_all_finished (data, error);
+	}
+
+	g_error_free (error);
+}
+
+static void
+replace_all_next (ReplaceAllData *data)
+{
+	if (data->panel == NULL)
+	{
+		replace_all_finished (data, NULL);
+		return;
+	}
+
+	while (data->documents != NULL)
+	{
+		GeditDocument *doc = data->documents->data;
+		GeditTab *tab;
+		GtkSourceSearchContext *search_context;
+
+		data->documents = g_list_delete_link (data->documents, data->documents);
+
+		tab = get_open_tab (doc);
+
+		/* Closed in the meantime. */
+		if (tab == NULL)
+		{
+			g_object_unref (doc);
+			continue;
+		}
+
+		/* The read-only documents can't be saved back, and a tab
+		 * that is loading, saving, printing or showing a huge file
+		 * can't be edited.
+		 */
+		if (gedit_document_get_readonly (doc) ||
+		    gedit_tab_get_state (tab) != GEDIT_TAB_STATE_NORMAL ||
+		    !gtk_text_view_get_editable (GTK_TEXT_VIEW (gedit_tab_get_view (tab))))
+		{
+			data->n_skipped++;
+			g_object_unref (doc);
+			continue;
+		}
+
+		search_context = gtk_source_search_context_new (GTK_SOURCE_BUFFER (doc),
+								data->settings);
+		gtk_source_search_context_set_highlight (search_context, FALSE);
+
+		gedit_tab_replace_all_async (tab,
+					     search_context,
+					     data->replace,
+					     data->cancellable,
+					     (GeditTabReplaceAllProgress) replace_all_progress_cb,
+					     data,
+					     (GAsyncReadyCallback) replace_all_cb,
+					     data);
+
+		g_object_unref (search_context);
+		g_object_unref (doc);
+		return;
+	}
+
+	replace_all_finished (data, NULL);
+}
+
+static void
+start_replace_all (GeditFindInFilesPanel *panel)
+{
+	GeditFindInFilesPanelPrivate *priv = panel->priv;
+	ReplaceAllData *data;
+	GHashTableIter iter;
+	gpointer document;
+
+	gedit_debug (DEBUG_PLUGINS);
+
+	if (priv->pattern == NULL || g_hash_table_size (priv->document_rows) == 0)
+	{
+		return;
+	}
+
+	stop_search (panel);
+
+	data = g_slice_new0 (ReplaceAllData);
+	data->panel = panel;
+	data->cancellable = g_cancellable_new ();
+	data->replace = g_strdup (gtk_entry_get_text (GTK_ENTRY (priv->replace_entry)));
+
+	data->settings = gtk_source_search_settings_new ();
+	gtk_source_search_settings_set_search_text (data->settings, priv->pattern);
+	gtk_source_search_settings_set_case_sensitive (data->settings,
+						       (priv->flags & GEDIT_FIND_IN_FILES_FLAG_CASE_SENSITIVE) != 0);
+	gtk_source_search_settings_set_regex_enabled (data->settings,
+						      (priv->flags & GEDIT_FIND_IN_FILES_FLAG_REGEX) != 0);
+
+	/* The documents may have changed since the search, so they are
+	 * searched again.
+	 */
+	g_hash_table_iter_init (&iter, priv->document_rows);
+
+	while (g_hash_table_iter_next (&iter, &document, NULL))
+	{
+		data->documents = g_list_prepend (data->documents, g_object_ref (document));
+	}
+
+	/* The results are out of date. */
+	clear_results (panel);
+
+	priv->replace_all = data;
+
+	gtk_button_set_label (GTK_BUTTON (priv->replace_all_button), _("_Stop"));
+	gtk_widget_set_sensitive (priv->replace_all_button, TRUE);
+	gtk_widget_set_sensitive (priv->find_button, FALSE);
+
+	replace_all_next (data);
+}
+
+static void
+replace_all_button_clicked_cb (GtkButton             *button,
+			       GeditFindInFilesPanel *panel)
+{
+	GeditFindInFilesPanelPrivate *priv = panel->priv;
+
+	if (priv->replace_all != NULL)
+	{
+		/* replace_all_cb() updates the button and the status. */
+		g_cancellable_cancel (priv->replace_all->cancellable);
+	}
+	else
+	{
+		start_replace_all (panel);
+	}
+}
+
+static void
+documents_checkbutton_toggled_cb (GtkToggleButton       *button,
+				  GeditFindInFilesPanel *panel)
+{
+	gtk_widget_set_sensitive (panel->priv->folder_button,
+				  !gtk_toggle_button_get_active (button));
+}
+
+static void
+gedit_find_in_files_panel_dispose (GObject *object)
+{
+	GeditFindInFilesPanel *panel = GEDIT_FIND_IN_FILES_PANEL (object);
+
+	stop_search (panel);
+
+	/* Freed when the running document is done. */
+	if (panel->priv->replace_all != NULL)
+	{
+		panel->priv->replace_all->panel = NULL;
+		g_cancellable_cancel (panel->priv->replace_all->cancellable);
+		panel->priv->replace_all = NULL;
+	}
+
+	g_clear_object (&panel->priv->filebrowser_settings);
+	g_clear_object (&panel->priv->root);
+
+	if (panel->priv->file_rows != NULL)
+	{
+		g_hash_table_destroy (panel->priv->file_rows);
+		panel->priv->file_rows = NULL;
+	}
+
+	if (panel->priv->document_rows != NULL)
+	{
+		g_hash_table_destroy (panel->priv->document_rows);
+		panel->priv->document_rows = NULL;
+	}
+
+	g_free (panel->priv->pattern);
+	panel->priv->pattern = NULL;
+
+	G_OBJECT_CLASS (gedit_find_in_files_panel_parent_class)->dispose (object);
+}
+
+static void
+gedit_find_in_files_panel_class_init (GeditFindInFilesPanelClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+
+	object_class->dispose = gedit_find_in_files_panel_dispose;
+
+	gtk_widget_class_set_template_from_resource (widget_class,
+						     "/org/gnome/gedit/plugins/findinfiles/ui/gedit-find-in-files-panel.ui");
+	gtk_widget_class_bind_template_child_private (widget_class, GeditFindInFilesPanel, search_entry);
+	gtk_widget_class_bind_template_child_private (widget_class, GeditFindInFilesPanel, folder_button);
+	gtk_widget_class_bind_template_child_private (widget_class, GeditFindInFilesPanel, documents_checkbutton);
+	gtk_widget_class_bind_template_child_private (widget_class, GeditFindInFilesPanel, case_checkbutton);
+	gtk_widget_class_bind_template_child_private (widget_class, GeditFindInFilesPanel, regex_checkbutton);
+	gtk_widget_class_bind_template_child_private (widget_class, GeditFindInFilesPanel, find_button);
+	gtk_widget_class_bind_template_child_private (widget_class, GeditFindInFilesPanel, replace_entry);
+	gtk_widget_class_bind_template_child_private (widget_class, GeditFindInFilesPanel, replace_all_button);
+	gtk_widget_class_bind_template_child_private (widget_class, GeditFindInFilesPanel, status_label);
+	gtk_widget_class_bind_template_child_private (widget_class, GeditFindInFilesPanel, results_treeview);
+	gtk_widget_class_bind_template_child_private (widget_class, GeditFindInFilesPanel, results_store);
+}
+
+static void
+gedit_find_in_files_panel_class_finalize (GeditFindInFilesPanelClass *klass)
+{
+}
+
+static void
+gedit_find_in_files_panel_init (GeditFindInFilesPanel *panel)
+{
+	panel->priv = gedit_find_in_files_panel_get_instance_private (panel);
+
+	gtk_widget_init_template (GTK_WIDGET (panel));
+
+	panel->priv->filebrowser_settings = settings_try_new (FILEBROWSER_BASE_SETTINGS);
+
+	panel->priv->file_rows = g_hash_table_new_full (g_file_hash,
+							(GEqualFunc) g_file_equal,
+							g_object_unref,
+							(GDestroyNotify) tree_iter_free);
+
+	panel->priv->document_rows = g_hash_table_new_full (NULL,
+							    NULL,
+							    g_object_unref,
+							    (GDestroyNotify) tree_iter_free);
+
+	g_signal_connect (panel->priv->documents_checkbutton,
+			  "toggled",
+			  G_CALLBACK (documents_checkbutton_toggled_cb),
+			  panel);
+
+	g_signal_connect (panel->priv->search_entry,
+			  "activate",
+			  G_CALLBACK (search_entry_activate_cb),
+			  panel);
+
+	g_signal_connect (panel->priv->find_button,
+			  "clicked",
+			  G_CALLBACK (find_button_clicked_cb),
+			  panel);
+
+	g_signal_connect (panel->priv->replace_all_button,
+			  "clicked",
+			  G_CALLBACK (replace_all_button_clicked_cb),
+			  panel);
+
+	g_signal_connect (panel->priv->results_treeview,
+			  "row-activated",
+			  G_CALLBACK (results_treeview_row_activated_cb),
+			  panel);
+}
+
+GtkWidget *
+gedit_find_in_files_panel_new (GeditWindow *window)
+{
+	GeditFindInFilesPanel *panel;
+
+	g_return_val_if_fail (GEDIT_IS_WINDOW (window), NULL);
+
+	panel = g_object_new (GEDIT_TYPE_FIND_IN_FILES_PANEL, NULL);
+
+	/* The panel is inside the window. */
+	panel->priv->window = window;
+
+	return GTK_WIDGET (panel);
+}
+
+/**
+ * gedit_find_in_files_panel_prepare:
+ * @panel: a #GeditFindInFilesPanel.
+ *
+ * Prepares a new search: the folder defaults to the one of the active
+ * document, and the text to the selection.
+ */
+void
+gedit_find_in_files_panel_prepare (GeditFindInFilesPanel *panel)
+{
+	GeditFindInFilesPanelPrivate *priv;
+	GeditDocument *doc;
+	GFile *folder;
+
+	g_return_if_fail (GEDIT_IS_FIND_IN_FILES_PANEL (panel));
+
+	priv = panel->priv;
+
+	doc = gedit_window_get_active_document (priv->window);
+	folder = gtk_file_chooser_get_file (GTK_FILE_CHOOSER (priv->folder_button));
+
+	if (folder == NULL && doc != NULL)
+	{
+		GFile *location;
+
+		location = gtk_source_file_get_location (gedit_document_get_file (doc));
+
+		if (location != NULL && g_file_is_native (location))
+		{
+			GFile *parent = g_file_get_parent (location);
+
+			if (parent != NULL)
+			{
+				gtk_file_chooser_set_current_folder_file (GTK_FILE_CHOOSER (priv->folder_button),
+									  parent,
+									  NULL);
+				g_object_unref (parent);
+			}
+		}
+	}
+	else if (folder != NULL)
+	{
+		g_object_unref (folder);
+	}
+
+	if (doc != NULL)
+	{
+		GtkTextIter start;
+		GtkTextIter end;
+
+		if (gtk_text_buffer_get_selection_bounds (GTK_TEXT_BUFFER (doc), &start, &end) &&
+		    gtk_text_iter_get_line (&start) == gtk_text_iter_get_line (&end))
+		{
+			gchar *text;
+
+			text = gtk_text_buffer_get_text (GTK_TEXT_BUFFER (doc), &start, &end, FALSE);
+			gtk_entry_set_text (GTK_ENTRY (priv->search_entry), text);
+			g_free (text);
+		}
+	}
+
+	gtk_widget_grab_focus (priv->search_entry);
+}
+
+void
+_gedit_find_in_files_panel_register_type (GTypeModule *type_module)
+{
+	gedit_find_in_files_panel_register_type (type_module);
+}
+
+/* ex:set ts=8 noet: */
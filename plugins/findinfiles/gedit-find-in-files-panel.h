@@ -0,0 +1,64 @@
+/*
+ * gedit-find-in-files-panel.h
+ * This file is part of gedit
+ *
+ * Copyright (C) 2015 - The gedit Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GEDIT_FIND_IN_FILES_PANEL_H__
+#define __GEDIT_FIND_IN_FILES_PANEL_H__
+
+#include <gtk/gtk.h>
+#include <gedit/gedit-window.h>
+
+G_BEGIN_DECLS
+
+#define GEDIT_TYPE_FIND_IN_FILES_PANEL			(gedit_find_in_files_panel_get_type ())
+#define GEDIT_FIND_IN_FILES_PANEL(obj)			(G_TYPE_CHECK_INSTANCE_CAST ((obj), GEDIT_TYPE_FIND_IN_FILES_PANEL, GeditFindInFilesPanel))
+#define GEDIT_FIND_IN_FILES_PANEL_CLASS(klass)		(G_TYPE_CHECK_CLASS_CAST ((klass), GEDIT_TYPE_FIND_IN_FILES_PANEL, GeditFindInFilesPanelClass))
+#define GEDIT_IS_FIND_IN_FILES_PANEL(obj)		(G_TYPE_CHECK_INSTANCE_TYPE ((obj), GEDIT_TYPE_FIND_IN_FILES_PANEL))
+#define GEDIT_IS_FIND_IN_FILES_PANEL_CLASS(klass)	(G_TYPE_CHECK_CLASS_TYPE ((klass), GEDIT_TYPE_FIND_IN_FILES_PANEL))
+#define GEDIT_FIND_IN_FILES_PANEL_GET_CLASS(obj)	(G_TYPE_INSTANCE_GET_CLASS ((obj), GEDIT_TYPE_FIND_IN_FILES_PANEL, GeditFindInFilesPanelClass))
+
+typedef struct _GeditFindInFilesPanel		GeditFindInFilesPanel;
+typedef struct _GeditFindInFilesPanelClass	GeditFindInFilesPanelClass;
+typedef struct _GeditFindInFilesPanelPrivate	GeditFindInFilesPanelPrivate;
+
+struct _GeditFindInFilesPanel
+{
+	GtkBox parent;
+
+	GeditFindInFilesPanelPrivate *priv;
+};
+
+struct _GeditFindInFilesPanelClass
+{
+	GtkBoxClass parent_class;
+};
+
+GType		 gedit_find_in_files_panel_get_type		(void) G_GNUC_CONST;
+
+GtkWidget	*gedit_find_in_files_panel_new			(GeditWindow           *window);
+
+void		 gedit_find_in_files_panel_prepare		(GeditFindInFilesPanel *panel);
+
+void		 _gedit_find_in_files_panel_register_type	(GTypeModule           *type_module);
+
+G_END_DECLS
+
+#endif /* __GEDIT_FIND_IN_FILES_PANEL_H__ */
+
+/* ex:set ts=8 noet: */
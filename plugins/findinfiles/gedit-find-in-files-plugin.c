@@ -0,0 +1,282 @@
+/*
+ * gedit-find-in-files-plugin.c
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gedit-find-in-files-plugin.h"
+
+#include <glib/gi18n.h>
+
+#include <gedit/gedit-debug.h>
+#include <gedit/gedit-app.h>
+#include <gedit/gedit-window.h>
+#include <gedit/gedit-app-activatable.h>
+#include <gedit/gedit-window-activatable.h>
+
+#include "gedit-find-in-files-panel.h"
+#include "gedit-find-in-files-search.h"
+
+static void gedit_app_activatable_iface_init (GeditAppActivatableInterface *iface);
+static void gedit_window_activatable_iface_init (GeditWindowActivatableInterface *iface);
+
+struct _GeditFindInFilesPluginPrivate
+{
+	GeditWindow *window;
+
+	GSimpleAction *action;
+	GtkWidget *panel;
+
+	GeditApp *app;
+	GeditMenuExtension *menu_ext;
+};
+
+enum
+{
+	PROP_0,
+	PROP_WINDOW,
+	PROP_APP
+};
+
+G_DEFINE_DYNAMIC_TYPE_EXTENDED (GeditFindInFilesPlugin,
+				gedit_find_in_files_plugin,
+				PEAS_TYPE_EXTENSION_BASE,
+				0,
+				G_IMPLEMENT_INTERFACE_DYNAMIC (GEDIT_TYPE_APP_ACTIVATABLE,
+							       gedit_app_activatable_iface_init)
+				G_IMPLEMENT_INTERFACE_DYNAMIC (GEDIT_TYPE_WINDOW_ACTIVATABLE,
+							       gedit_window_activatable_iface_init)
+				G_ADD_PRIVATE_DYNAMIC (GeditFindInFilesPlugin)
+				_gedit_find_in_files_panel_register_type (type_module);
+				_gedit_find_in_files_search_register_type (type_module);
+)
+
+static void
+find_in_files_cb (GAction                *action,
+		  GVariant               *parameter,
+		  GeditFindInFilesPlugin *plugin)
+{
+	GeditFindInFilesPluginPrivate *priv;
+	GtkWidget *bottom_panel;
+
+	gedit_debug (DEBUG_PLUGINS);
+
+	priv = plugin->priv;
+
+	bottom_panel = gedit_window_get_bottom_panel (priv->window);
+
+	gtk_stack_set_visible_child (GTK_STACK (bottom_panel), priv->panel);
+	gtk_widget_show (bottom_panel);
+
+	gedit_find_in_files_panel_prepare (GEDIT_FIND_IN_FILES_PANEL (priv->panel));
+}
+
+static void
+gedit_find_in_files_plugin_app_activate (GeditAppActivatable *activatable)
+{
+	GeditFindInFilesPluginPrivate *priv;
+	GMenuItem *item;
+	const gchar *accels[] = { "<Primary><Shift>F", NULL };
+
+	gedit_debug (DEBUG_PLUGINS);
+
+	priv = GEDIT_FIND_IN_FILES_PLUGIN (activatable)->priv;
+
+	gtk_application_set_accels_for_action (GTK_APPLICATION (priv->app),
+					       "win.find-in-files",
+					       accels);
+
+	priv->menu_ext = gedit_app_activatable_extend_menu (activatable, "search-section");
+	item = g_menu_item_new (_("Find in F_iles…"), "win.find-in-files");
+	gedit_menu_extension_append_menu_item (priv->menu_ext, item);
+	g_object_unref (item);
+}
+
+static void
+gedit_find_in_files_plugin_app_deactivate (GeditAppActivatable *activatable)
+{
+	GeditFindInFilesPluginPrivate *priv;
+	const gchar *accels[] = { NULL };
+
+	gedit_debug (DEBUG_PLUGINS);
+
+	priv = GEDIT_FIND_IN_FILES_PLUGIN (activatable)->priv;
+
+	gtk_application_set_accels_for_action (GTK_APPLICATION (priv->app),
+					       "win.find-in-files",
+					       accels);
+
+	g_clear_object (&priv->menu_ext);
+}
+
+static void
+gedit_find_in_files_plugin_window_activate (GeditWindowActivatable *activatable)
+{
+	GeditFindInFilesPluginPrivate *priv;
+	GtkWidget *bottom_panel;
+
+	gedit_debug (DEBUG_PLUGINS);
+
+	priv = GEDIT_FIND_IN_FILES_PLUGIN (activatable)->priv;
+
+	priv->panel = gedit_find_in_files_panel_new (priv->window);
+
+	bottom_panel = gedit_window_get_bottom_panel (priv->window);
+
+	gtk_stack_add_titled (GTK_STACK (bottom_panel),
+			      priv->panel,
+			      "GeditFindInFilesPanel",
+			      _("Find in Files"));
+
+	priv->action = g_simple_action_new ("find-in-files", NULL);
+	g_signal_connect (priv->action, "activate",
+			  G_CALLBACK (find_in_files_cb), activatable);
+	g_action_map_add_action (G_ACTION_MAP (priv->window),
+				 G_ACTION (priv->action));
+}
+
+static void
+gedit_find_in_files_plugin_window_deactivate (GeditWindowActivatable *activatable)
+{
+	GeditFindInFilesPluginPrivate *priv;
+	GtkWidget *bottom_panel;
+
+	gedit_debug (DEBUG_PLUGINS);
+
+	priv = GEDIT_FIND_IN_FILES_PLUGIN (activatable)->priv;
+
+	g_action_map_remove_action (G_ACTION_MAP (priv->window), "find-in-files");
+
+	bottom_panel = gedit_window_get_bottom_panel (priv->window);
+	gtk_container_remove (GTK_CONTAINER (bottom_panel), priv->panel);
+	priv->panel = NULL;
+}
+
+static void
+gedit_find_in_files_plugin_init (GeditFindInFilesPlugin *plugin)
+{
+	gedit_debug_message (DEBUG_PLUGINS, "GeditFindInFilesPlugin initializing");
+
+	plugin->priv = gedit_find_in_files_plugin_get_instance_private (plugin);
+}
+
+static void
+gedit_find_in_files_plugin_dispose (GObject *object)
+{
+	GeditFindInFilesPlugin *plugin = GEDIT_FIND_IN_FILES_PLUGIN (object);
+
+	gedit_debug_message (DEBUG_PLUGINS, "GeditFindInFilesPlugin disposing");
+
+	g_clear_object (&plugin->priv->action);
+	g_clear_object (&plugin->priv->window);
+	g_clear_object (&plugin->priv->menu_ext);
+	g_clear_object (&plugin->priv->app);
+
+	G_OBJECT_CLASS (gedit_find_in_files_plugin_parent_class)->dispose (object);
+}
+
+static void
+gedit_find_in_files_plugin_set_property (GObject      *object,
+					 guint         prop_id,
+					 const GValue *value,
+					 GParamSpec   *pspec)
+{
+	GeditFindInFilesPlugin *plugin = GEDIT_FIND_IN_FILES_PLUGIN (object);
+
+	switch (prop_id)
+	{
+		case PROP_WINDOW:
+			plugin->priv->window = GEDIT_WINDOW (g_value_dup_object (value));
+			break;
+		case PROP_APP:
+			plugin->priv->app = GEDIT_APP (g_value_dup_object (value));
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+			break;
+	}
+}
+
+static void
+gedit_find_in_files_plugin_get_property (GObject    *object,
+					 guint       prop_id,
+					 GValue     *value,
+					 GParamSpec *pspec)
+{
+	GeditFindInFilesPlugin *plugin = GEDIT_FIND_IN_FILES_PLUGIN (object);
+
+	switch (prop_id)
+	{
+		case PROP_WINDOW:
+			g_value_set_object (value, plugin->priv->window);
+			break;
+		case PROP_APP:
+			g_value_set_object (value, plugin->priv->app);
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+			break;
+	}
+}
+
+static void
+gedit_find_in_files_plugin_class_init (GeditFindInFilesPluginClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->dispose = gedit_find_in_files_plugin_dispose;
+	object_class->set_property = gedit_find_in_files_plugin_set_property;
+	object_class->get_property = gedit_find_in_files_plugin_get_property;
+
+	g_object_class_override_property (object_class, PROP_WINDOW, "window");
+	g_object_class_override_property (object_class, PROP_APP, "app");
+}
+
+static void
+gedit_find_in_files_plugin_class_finalize (GeditFindInFilesPluginClass *klass)
+{
+}
+
+static void
+gedit_app_activatable_iface_init (GeditAppActivatableInterface *iface)
+{
+	iface->activate = gedit_find_in_files_plugin_app_activate;
+	iface->deactivate = gedit_find_in_files_plugin_app_deactivate;
+}
+
+static void
+gedit_window_activatable_iface_init (GeditWindowActivatableInterface *iface)
+{
+	iface->activate = gedit_find_in_files_plugin_window_activate;
+	iface->deactivate = gedit_find_in_files_plugin_window_deactivate;
+}
+
+G_MODULE_EXPORT void
+peas_register_types (PeasObjectModule *module)
+{
+	gedit_find_in_files_plugin_register_type (G_TYPE_MODULE (module));
+
+	peas_object_module_register_extension_type (module,
+						    GEDIT_TYPE_APP_ACTIVATABLE,
+						    GEDIT_TYPE_FIND_IN_FILES_PLUGIN);
+	peas_object_module_register_extension_type (module,
+						    GEDIT_TYPE_WINDOW_ACTIVATABLE,
+						    GEDIT_TYPE_FIND_IN_FILES_PLUGIN);
+}
+
+/* ex:set ts=8 noet: */
@@ -0,0 +1,59 @@
+/*
+ * gedit-find-in-files-plugin.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GEDIT_FIND_IN_FILES_PLUGIN_H__
+#define __GEDIT_FIND_IN_FILES_PLUGIN_H__
+
+#include <glib.h>
+#include <glib-object.h>
+#include <libpeas/peas-extension-base.h>
+#include <libpeas/peas-object-module.h>
+
+G_BEGIN_DECLS
+
+#define GEDIT_TYPE_FIND_IN_FILES_PLUGIN		(gedit_find_in_files_plugin_get_type ())
+#define GEDIT_FIND_IN_FILES_PLUGIN(o)		(G_TYPE_CHECK_INSTANCE_CAST ((o), GEDIT_TYPE_FIND_IN_FILES_PLUGIN, GeditFindInFilesPlugin))
+#define GEDIT_FIND_IN_FILES_PLUGIN_CLASS(k)	(G_TYPE_CHECK_CLASS_CAST((k), GEDIT_TYPE_FIND_IN_FILES_PLUGIN, GeditFindInFilesPluginClass))
+#define GEDIT_IS_FIND_IN_FILES_PLUGIN(o)	(G_TYPE_CHECK_INSTANCE_TYPE ((o), GEDIT_TYPE_FIND_IN_FILES_PLUGIN))
+#define GEDIT_IS_FIND_IN_FILES_PLUGIN_CLASS(k)	(G_TYPE_CHECK_CLASS_TYPE ((k), GEDIT_TYPE_FIND_IN_FILES_PLUGIN))
+#define GEDIT_FIND_IN_FILES_PLUGIN_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), GEDIT_TYPE_FIND_IN_FILES_PLUGIN, GeditFindInFilesPluginClass))
+
+typedef struct _GeditFindInFilesPlugin		GeditFindInFilesPlugin;
+typedef struct _GeditFindInFilesPluginPrivate	GeditFindInFilesPluginPrivate;
+typedef struct _GeditFindInFilesPluginClass	GeditFindInFilesPluginClass;
+
+struct _GeditFindInFilesPlugin
+{
+	PeasExtensionBase parent;
+
+	/*< private >*/
+	GeditFindInFilesPluginPrivate *priv;
+};
+
+struct _GeditFindInFilesPluginClass
+{
+	PeasExtensionBaseClass parent_class;
+};
+
+GType			gedit_find_in_files_plugin_get_type	(void) G_GNUC_CONST;
+
+G_MODULE_EXPORT void	peas_register_types		(PeasObjectModule *module);
+
+G_END_DECLS
+
+#endif /* __GEDIT_FIND_IN_FILES_PLUGIN_H__ */
+/* ex:set ts=8 noet: */
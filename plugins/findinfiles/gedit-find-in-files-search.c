@@ -0,0 +1,1270 @@
+/*
+ * gedit-find-in-files-search.c
+ * This file is part of gedit
+ *
+ * Copyright (C) 2015 - The gedit Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gedit-find-in-files-search.h"
+
+#include <string.h>
+
+#include <gedit/gedit-debug.h>
+#include <gedit/gedit-document.h>
+
+/* The directory tree is walked by a pool of worker threads. Each worker has
+ * its own deque of jobs (a directory to enumerate or a file to search): it
+ * pushes the children it finds at the tail, pops its next job from the tail,
+ * and when its deque is empty it steals a job from the head of the deque of
+ * another worker. So a worker mostly stays in the same part of the tree, and
+ * the big directories are shared out between all the workers.
+ *
+ * The files are read by chunks of whole lines, never mapped in memory, so that
+ * a file truncated during the search cannot raise a SIGBUS. A case sensitive
+ * literal search looks for the first byte of the pattern with memchr(),
+ * which the C library implements with vector instructions, and compares the
+ * rest. The other searches use a GRegex on each chunk, so a regex cannot
+ * match across two chunks.
+ *
+ * The open documents can be searched instead of a directory: their text is
+ * copied in the main thread when the search is created, and each copy is a
+ * job for the workers.
+ *
+ * The matches are accumulated by the workers and delivered to the main loop
+ * in batches.
+ */
+
+#define MAX_WORKERS		8
+
+/* Delay between two deliveries of matches, in milliseconds. */
+#define FLUSH_INTERVAL		100
+
+/* Timeout of an idle worker waiting for new jobs, in microseconds. */
+#define IDLE_WAIT		(10 * G_TIME_SPAN_MILLISECOND)
+
+/* Number of bytes looked at to detect binary files. */
+#define BINARY_SNIFF_LENGTH	8192
+
+/* Size of the reads of the searched files. A chunk grows up to
+ * MAX_CHUNK_SIZE to hold a longer line, after that the line is cut.
+ */
+#define CHUNK_SIZE		(4 * 1024 * 1024)
+#define MAX_CHUNK_SIZE		(64 * 1024 * 1024)
+
+/* The search stops when there are too many matches to be useful. */
+#define MAX_MATCHES		50000
+
+/* Maximum number of characters of the matching line kept in a match. */
+#define MAX_TEXT_CHARS		256
+
+#define ENUMERATE_ATTRIBUTES					\
+	G_FILE_ATTRIBUTE_STANDARD_NAME ","			\
+	G_FILE_ATTRIBUTE_STANDARD_TYPE ","			\
+	G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN ","			\
+	G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP ","			\
+	G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE
+
+/* The text of an open document. */
+typedef struct
+{
+	GeditDocument *document;
+	GFile *location;
+	gchar *text;
+	gsize length;
+} Snapshot;
+
+typedef struct
+{
+	/* Either a file or a snapshot, owned by the search. */
+	GFile *file;
+	Snapshot *snapshot;
+	guint is_dir : 1;
+} Job;
+
+typedef struct
+{
+	GeditFindInFilesSearch *search;
+
+	GMutex mutex;
+	GQueue jobs;
+} Worker;
+
+struct _GeditFindInFilesSearchPrivate
+{
+	/* Either the root directory or the snapshots of the documents. */
+	GFile *root;
+	GPtrArray *snapshots;
+	GeditFindInFilesFlags flags;
+
+	/* Set for a case sensitive literal search, otherwise the regexes are
+	 * used. The raw regex is used for the files that are not valid UTF-8.
+	 */
+	gchar *literal;
+	gsize literal_length;
+	GRegex *regex;
+	GRegex *raw_regex;
+
+	GPtrArray *binary_pattern_specs;
+
+	GCancellable *cancellable;
+	GTimer *timer;
+
+	Worker *workers;
+	guint n_workers;
+
+	/* The jobs queued or being processed. */
+	volatile gint n_outstanding_jobs;
+	volatile gint n_live_workers;
+
+	GMutex idle_mutex;
+	GCond idle_cond;
+
+	/* Protected by results_mutex. */
+	GMutex results_mutex;
+	GPtrArray *pending_matches;
+	guint n_files;
+	guint64 n_bytes;
+	guint n_matches;
+	gboolean truncated;
+
+	guint flush_id;
+
+	guint started : 1;
+	guint running : 1;
+};
+
+enum
+{
+	MATCHES_FOUND,
+	FINISHED,
+	LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+G_DEFINE_DYNAMIC_TYPE_EXTENDED (GeditFindInFilesSearch,
+				gedit_find_in_files_search,
+				G_TYPE_OBJECT,
+				0,
+				G_ADD_PRIVATE_DYNAMIC (GeditFindInFilesSearch))
+
+static void
+match_free (GeditFindInFilesMatch *match)
+{
+	g_clear_object (&match->location);
+	g_clear_object (&match->document);
+	g_free (match->text);
+	g_slice_free (GeditFindInFilesMatch, match);
+}
+
+static void
+job_free (Job *job)
+{
+	g_clear_object (&job->file);
+	g_slice_free (Job, job);
+}
+
+static void
+snapshot_free (Snapshot *snapshot)
+{
+	g_object_unref (snapshot->document);
+	g_clear_object (&snapshot->location);
+	g_free (snapshot->text);
+	g_slice_free (Snapshot, snapshot);
+}
+
+static void
+gedit_find_in_files_search_finalize (GObject *object)
+{
+	GeditFindInFilesSearchPrivate *priv = GEDIT_FIND_IN_FILES_SEARCH (object)->priv;
+	guint i;
+
+	for (i = 0; i < priv->n_workers; i++)
+	{
+		g_queue_free_full (&priv->workers[i].jobs, (GDestroyNotify) job_free);
+		g_mutex_clear (&priv->workers[i].mutex);
+	}
+
+	g_free (priv->workers);
+
+	g_clear_object (&priv->root);
+
+	if (priv->snapshots != NULL)
+	{
+		g_ptr_array_unref (priv->snapshots);
+	}
+
+	g_free (priv->literal);
+
+	if (priv->regex != NULL)
+	{
+		g_regex_unref (priv->regex);
+		g_regex_unref (priv->raw_regex);
+	}
+
+	if (priv->binary_pattern_specs != NULL)
+	{
+		g_ptr_array_unref (priv->binary_pattern_specs);
+	}
+
+	g_object_unref (priv->cancellable);
+	g_timer_destroy (priv->timer);
+
+	g_mutex_clear (&priv->idle_mutex);
+	g_cond_clear (&priv->idle_cond);
+	g_mutex_clear (&priv->results_mutex);
+	g_ptr_array_unref (priv->pending_matches);
+
+	G_OBJECT_CLASS (gedit_find_in_files_search_parent_class)->finalize (object);
+}
+
+static void
+gedit_find_in_files_search_class_init (GeditFindInFilesSearchClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->finalize = gedit_find_in_files_search_finalize;
+
+	/**
+	 * GeditFindInFilesSearch::matches-found:
+	 * @search: the #GeditFindInFilesSearch.
+	 * @matches: (element-type GeditFindInFilesMatch): the new matches,
+	 *   only valid during the emission.
+	 */
+	signals[MATCHES_FOUND] =
+		g_signal_new ("matches-found",
+			      G_OBJECT_CLASS_TYPE (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (GeditFindInFilesSearchClass, matches_found),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__POINTER,
+			      G_TYPE_NONE,
+			      1,
+			      G_TYPE_POINTER);
+
+	signals[FINISHED] =
+		g_signal_new ("finished",
+			      G_OBJECT_CLASS_TYPE (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (GeditFindInFilesSearchClass, finished),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__VOID,
+			      G_TYPE_NONE,
+			      0);
+}
+
+static void
+gedit_find_in_files_search_class_finalize (GeditFindInFilesSearchClass *klass)
+{
+}
+
+static void
+gedit_find_in_files_search_init (GeditFindInFilesSearch *search)
+{
+	search->priv = gedit_find_in_files_search_get_instance_private (search);
+
+	search->priv->cancellable = g_cancellable_new ();
+	search->priv->timer = g_timer_new ();
+	search->priv->pending_matches = g_ptr_array_new_with_free_func ((GDestroyNotify) match_free);
+
+	g_mutex_init (&search->priv->idle_mutex);
+	g_cond_init (&search->priv->idle_cond);
+	g_mutex_init (&search->priv->results_mutex);
+}
+
+static GeditFindInFilesSearch *
+search_new (const gchar            *pattern,
+	    GeditFindInFilesFlags   flags,
+	    GError                **error)
+{
+	GeditFindInFilesSearch *search;
+	GeditFindInFilesSearchPrivate *priv;
+
+	search = g_object_new (GEDIT_TYPE_FIND_IN_FILES_SEARCH, NULL);
+	priv = search->priv;
+
+	priv->flags = flags;
+
+	if ((flags & GEDIT_FIND_IN_FILES_FLAG_CASE_SENSITIVE) &&
+	    !(flags & GEDIT_FIND_IN_FILES_FLAG_REGEX))
+	{
+		priv->literal = g_strdup (pattern);
+		priv->literal_length = strlen (pattern);
+	}
+	else
+	{
+		GRegexCompileFlags compile_flags = G_REGEX_MULTILINE | G_REGEX_OPTIMIZE;
+		gchar *regex_pattern;
+
+		if (!(flags & GEDIT_FIND_IN_FILES_FLAG_CASE_SENSITIVE))
+		{
+			compile_flags |= G_REGEX_CASELESS;
+		}
+
+		if (flags & GEDIT_FIND_IN_FILES_FLAG_REGEX)
+		{
+			regex_pattern = g_strdup (pattern);
+		}
+		else
+		{
+			regex_pattern = g_regex_escape_string (pattern, -1);
+		}
+
+		priv->regex = g_regex_new (regex_pattern, compile_flags, 0, error);
+
+		if (priv->regex != NULL)
+		{
+			priv->raw_regex = g_regex_new (regex_pattern,
+						       compile_flags | G_REGEX_RAW,
+						       0,
+						       NULL);
+		}
+
+		g_free (regex_pattern);
+
+		if (priv->regex == NULL || priv->raw_regex == NULL)
+		{
+			g_clear_pointer (&priv->regex, g_regex_unref);
+			g_object_unref (search);
+			return NULL;
+		}
+	}
+
+	return search;
+}
+
+/**
+ * gedit_find_in_files_search_new:
+ * @root: the directory to search in.
+ * @pattern: the text or the regular expression to search.
+ * @flags: the #GeditFindInFilesFlags.
+ * @binary_patterns: (allow-none): the file name patterns of the binary files,
+ *   in addition to the content types, used with
+ *   %GEDIT_FIND_IN_FILES_FLAG_HIDE_BINARY.
+ * @error: a #GError, set if @pattern is not a valid regular expression.
+ *
+ * Returns: a new #GeditFindInFilesSearch, or %NULL on error.
+ */
+GeditFindInFilesSearch *
+gedit_find_in_files_search_new (GFile                  *root,
+				const gchar            *pattern,
+				GeditFindInFilesFlags   flags,
+				const gchar * const    *binary_patterns,
+				GError                **error)
+{
+	GeditFindInFilesSearch *search;
+	GeditFindInFilesSearchPrivate *priv;
+
+	g_return_val_if_fail (G_IS_FILE (root), NULL);
+	g_return_val_if_fail (pattern != NULL && pattern[0] != '\0', NULL);
+
+	search = search_new (pattern, flags, error);
+
+	if (search == NULL)
+	{
+		return NULL;
+	}
+
+	priv = search->priv;
+
+	priv->root = g_object_ref (root);
+
+	if (binary_patterns != NULL && binary_patterns[0] != NULL)
+	{
+		gint i;
+
+		priv->binary_pattern_specs = g_ptr_array_new_with_free_func ((GDestroyNotify) g_pattern_spec_free);
+
+		for (i = 0; binary_patterns[i] != NULL; i++)
+		{
+			g_ptr_array_add (priv->binary_pattern_specs,
+					 g_pattern_spec_new (binary_patterns[i]));
+		}
+	}
+
+	return search;
+}
+
+/**
+ * gedit_find_in_files_search_new_for_documents:
+ * @documents: (element-type GeditDocument): the documents to search in.
+ * @pattern: the text or the regular expression to search.
+ * @flags: the #GeditFindInFilesFlags, the filters are ignored.
+ * @error: a #GError, set if @pattern is not a valid regular expression.
+ *
+ * The text of @documents is copied, so the documents can be modified while
+ * the search runs. The matches have their document set.
+ *
+ * Returns: a new #GeditFindInFilesSearch, or %NULL on error.
+ */
+GeditFindInFilesSearch *
+gedit_find_in_files_search_new_for_documents (GList                  *documents,
+					      const gchar            *pattern,
+					      GeditFindInFilesFlags   flags,
+					      GError                **error)
+{
+	GeditFindInFilesSearch *search;
+	GeditFindInFilesSearchPrivate *priv;
+	GList *l;
+
+	g_return_val_if_fail (pattern != NULL && pattern[0] != '\0', NULL);
+
+	search = search_new (pattern, flags, error);
+
+	if (search == NULL)
+	{
+		return NULL;
+	}
+
+	priv = search->priv;
+
+	priv->snapshots = g_ptr_array_new_with_free_func ((GDestroyNotify) snapshot_free);
+
+	for (l = documents; l != NULL; l = l->next)
+	{
+		GtkTextBuffer *buffer = GTK_TEXT_BUFFER (l->data);
+		GFile *location;
+		Snapshot *snapshot;
+		GtkTextIter start;
+		GtkTextIter end;
+
+		gtk_text_buffer_get_bounds (buffer, &start, &end);
+
+		location = gtk_source_file_get_location (gedit_document_get_file (GEDIT_DOCUMENT (buffer)));
+
+		snapshot = g_slice_new (Snapshot);
+		snapshot->document = g_object_ref (buffer);
+		snapshot->location = location != NULL ? g_object_ref (location) : NULL;
+		snapshot->text = gtk_text_buffer_get_text (buffer, &start, &end, TRUE);
+		snapshot->length = strlen (snapshot->text);
+
+		g_ptr_array_add (priv->snapshots, snapshot);
+	}
+
+	return search;
+}
+
+/* Same rule as the file browser. */
+static gboolean
+content_type_is_text (const gchar *content_type)
+{
+	if (content_type == NULL || g_content_type_is_unknown (content_type))
+	{
+		return TRUE;
+	}
+
+	return g_content_type_is_a (content_type, "text/plain");
+}
+
+static gboolean
+is_filtered (GeditFindInFilesSearch *search,
+	     GFileInfo              *info,
+	     gboolean                is_dir)
+{
+	GeditFindInFilesSearchPrivate *priv = search->priv;
+	const gchar *name;
+	gsize name_length;
+	gchar *name_reversed;
+	gboolean filtered = FALSE;
+	guint i;
+
+	if ((priv->flags & GEDIT_FIND_IN_FILES_FLAG_HIDE_HIDDEN) &&
+	    (g_file_info_get_is_hidden (info) || g_file_info_get_is_backup (info)))
+	{
+		return TRUE;
+	}
+
+	if (is_dir || !(priv->flags & GEDIT_FIND_IN_FILES_FLAG_HIDE_BINARY))
+	{
+		return FALSE;
+	}
+
+	if (!content_type_is_text (g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE)))
+	{
+		return TRUE;
+	}
+
+	if (priv->binary_pattern_specs == NULL)
+	{
+		return FALSE;
+	}
+
+	name = g_file_info_get_name (info);
+	name_length = strlen (name);
+	name_reversed = g_utf8_strreverse (name, name_length);
+
+	for (i = 0; i < priv->binary_pattern_specs->len && !filtered; i++)
+	{
+		GPatternSpec *spec = g_ptr_array_index (priv->binary_pattern_specs, i);
+
+		filtered = g_pattern_match (spec, name_length, name, name_reversed);
+	}
+
+	g_free (name_reversed);
+
+	return filtered;
+}
+
+static void
+wake_workers (GeditFindInFilesSearch *search)
+{
+	g_mutex_lock (&search->priv->idle_mutex);
+	g_cond_broadcast (&search->priv->idle_cond);
+	g_mutex_unlock (&search->priv->idle_mutex);
+}
+
+/* Takes ownership of @file. */
+static void
+push_job (GeditFindInFilesSearch *search,
+	  Worker                 *worker,
+	  GFile                  *file,
+	  Snapshot               *snapshot,
+	  gboolean                is_dir)
+{
+	Job *job;
+
+	job = g_slice_new (Job);
+	job->file = file;
+	job->snapshot = snapshot;
+	job->is_dir = is_dir != FALSE;
+
+	g_atomic_int_inc (&search->priv->n_outstanding_jobs);
+
+	g_mutex_lock (&worker->mutex);
+	g_queue_push_tail (&worker->jobs, job);
+	g_mutex_unlock (&worker->mutex);
+}
+
+static Job *
+pop_job (GeditFindInFilesSearch *search,
+	 Worker                 *worker)
+{
+	GeditFindInFilesSearchPrivate *priv = search->priv;
+	guint index = worker - priv->workers;
+	Job *job;
+	guint i;
+
+	g_mutex_lock (&worker->mutex);
+	job = g_queue_pop_tail (&worker->jobs);
+	g_mutex_unlock (&worker->mutex);
+
+	for (i = 1; job == NULL && i < priv->n_workers; i++)
+	{
+		Worker *victim = &priv->workers[(index + i) % priv->n_workers];
+
+		g_mutex_lock (&victim->mutex);
+		job = g_queue_pop_head (&victim->jobs);
+		g_mutex_unlock (&victim->mutex);
+	}
+
+	return job;
+}
+
+static void
+search_directory (GeditFindInFilesSearch *search,
+		  Worker                 *worker,
+		  GFile                  *dir)
+{
+	GFileEnumerator *enumerator;
+	GFileInfo *info;
+	gboolean pushed = FALSE;
+
+	/* The symbolic links are not followed, they could make loops. */
+	enumerator = g_file_enumerate_children (dir,
+						ENUMERATE_ATTRIBUTES,
+						G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+						search->priv->cancellable,
+						NULL);
+
+	if (enumerator == NULL)
+	{
+		return;
+	}
+
+	while ((info = g_file_enumerator_next_file (enumerator, search->priv->cancellable, NULL)) != NULL)
+	{
+		GFileType type = g_file_info_get_file_type (info);
+		gboolean is_dir = type == G_FILE_TYPE_DIRECTORY;
+
+		if ((is_dir || type == G_FILE_TYPE_REGULAR) &&
+		    !is_filtered (search, info, is_dir))
+		{
+			push_job (search,
+				  worker,
+				  g_file_get_child (dir, g_file_info_get_name (info)),
+				  NULL,
+				  is_dir);
+
+			pushed = TRUE;
+		}
+
+		g_object_unref (info);
+	}
+
+	g_object_unref (enumerator);
+
+	if (pushed)
+	{
+		wake_workers (search);
+	}
+}
+
+static const gchar *
+find_literal (const gchar *p,
+	      const gchar *end,
+	      const gchar *needle,
+	      gsize        needle_length)
+{
+	while ((gsize) (end - p) >= needle_length)
+	{
+		p = memchr (p, needle[0], (end - p) - needle_length + 1);
+
+		if (p == NULL)
+		{
+			return NULL;
+		}
+
+		if (memcmp (p + 1, needle + 1, needle_length - 1) == 0)
+		{
+			return p;
+		}
+
+		p++;
+	}
+
+	return NULL;
+}
+
+static const gchar *
+find_regex (GRegex      *regex,
+	    const gchar *data,
+	    gsize        length,
+	    const gchar *p)
+{
+	GMatchInfo *match_info;
+	const gchar *found = NULL;
+	gint start;
+
+	if (g_regex_match_full (regex, data, length, p - data, 0, &match_info, NULL) &&
+	    g_match_info_fetch_pos (match_info, 0, &start, NULL))
+	{
+		found = data + start;
+	}
+
+	g_match_info_free (match_info);
+
+	return found;
+}
+
+static GeditFindInFilesMatch *
+match_new (GFile         *location,
+	   GeditDocument *document,
+	   gint           line,
+	   const gchar   *line_start,
+	   const gchar   *line_end,
+	   const gchar   *match_start)
+{
+	GeditFindInFilesMatch *match;
+
+	if (line_end > line_start && line_end[-1] == '\r')
+	{
+		line_end--;
+	}
+
+	match = g_slice_new (GeditFindInFilesMatch);
+	match->location = location != NULL ? g_object_ref (location) : NULL;
+	match->document = document != NULL ? g_object_ref (document) : NULL;
+	match->line = line;
+
+	if (g_utf8_validate (line_start, line_end - line_start, NULL))
+	{
+		const gchar *text_end = line_start;
+		gint n_chars = 0;
+
+		while (text_end < line_end && n_chars < MAX_TEXT_CHARS)
+		{
+			text_end = g_utf8_next_char (text_end);
+			n_chars++;
+		}
+
+		match->text = g_strndup (line_start, text_end - line_start);
+		match->column = g_utf8_strlen (line_start, match_start - line_start);
+	}
+	else
+	{
+		/* Every byte sequence is valid ISO-8859-1. */
+		match->text = g_convert (line_start,
+					 MIN (line_end - line_start, MAX_TEXT_CHARS),
+					 "UTF-8",
+					 "ISO-8859-1",
+					 NULL, NULL, NULL);
+		match->column = match_start - line_start;
+	}
+
+	return match;
+}
+
+/* Reports one match per matching line, like grep. @data starts at the line
+ * @first_line.
+ *
+ * Returns: the line at the end of @data.
+ */
+static gint
+search_buffer (GeditFindInFilesSearch *search,
+	       GFile                  *location,
+	       GeditDocument          *document,
+	       const gchar            *data,
+	       gsize                   length,
+	       gint                    first_line,
+	       GPtrArray              *matches)
+{
+	GeditFindInFilesSearchPrivate *priv = search->priv;
+	const gchar *end = data + length;
+	const gchar *p = data;
+	const gchar *line_start = data;
+	const gchar *counted = data;
+	const gchar *nl;
+	GRegex *regex = NULL;
+	gint line = first_line;
+
+	if (priv->literal == NULL)
+	{
+		/* PCRE takes the offsets as int. */
+		if (length > G_MAXINT)
+		{
+			return line;
+		}
+
+		regex = g_utf8_validate (data, length, NULL) ? priv->regex : priv->raw_regex;
+	}
+
+	while (p < end && !g_cancellable_is_cancelled (priv->cancellable))
+	{
+		const gchar *found;
+		const gchar *line_end;
+
+		if (regex != NULL)
+		{
+			found = find_regex (regex, data, length, p);
+		}
+		else
+		{
+			found = find_literal (p, end, priv->literal, priv->literal_length);
+		}
+
+		if (found == NULL)
+		{
+			break;
+		}
+
+		while ((nl = memchr (counted, '\n', found - counted)) != NULL)
+		{
+			line++;
+			line_start = nl + 1;
+			counted = nl + 1;
+		}
+
+		counted = found;
+
+		line_end = memchr (found, '\n', end - found);
+
+		if (line_end == NULL)
+		{
+			line_end = end;
+		}
+
+		g_ptr_array_add (matches,
+				 match_new (location, document, line, line_start, line_end, found));
+
+		if (line_end == end)
+		{
+			break;
+		}
+
+		p = line_end + 1;
+	}
+
+	/* Count the lines after the last match, for the next chunk. */
+	while ((nl = memchr (counted, '\n', end - counted)) != NULL)
+	{
+		line++;
+		counted = nl + 1;
+	}
+
+	return line;
+}
+
+/* Takes ownership of @matches. */
+static void
+add_results (GeditFindInFilesSearch *search,
+	     GPtrArray              *matches,
+	     gsize                   length)
+{
+	GeditFindInFilesSearchPrivate *priv = search->priv;
+
+	g_mutex_lock (&priv->results_mutex);
+
+	priv->n_files++;
+	priv->n_bytes += length;
+
+	if (matches->len > 0 && !priv->truncated)
+	{
+		guint i;
+
+		for (i = 0; i < matches->len; i++)
+		{
+			g_ptr_array_add (priv->pending_matches, g_ptr_array_index (matches, i));
+		}
+
+		priv->n_matches += matches->len;
+		g_ptr_array_set_size (matches, 0);
+
+		if (priv->n_matches >= MAX_MATCHES)
+		{
+			priv->truncated = TRUE;
+			g_cancellable_cancel (priv->cancellable);
+		}
+	}
+
+	g_mutex_unlock (&priv->results_mutex);
+
+	/* Left over if the search has been truncated. */
+	g_ptr_array_foreach (matches, (GFunc) match_free, NULL);
+	g_ptr_array_unref (matches);
+}
+
+/* Returns the length of the complete lines at the start of @data. */
+static gsize
+get_complete_lines_length (const gchar *data,
+			   gsize        length)
+{
+	while (length > 0 && data[length - 1] != '\n')
+	{
+		length--;
+	}
+
+	return length;
+}
+
+static void
+search_file (GeditFindInFilesSearch *search,
+	     GFile                  *location)
+{
+	GeditFindInFilesSearchPrivate *priv = search->priv;
+	GFileInputStream *stream;
+	GPtrArray *matches;
+	gchar *buffer;
+	gsize buffer_size = CHUNK_SIZE;
+	gsize n_buffered = 0;
+	gsize length = 0;
+	gint line = 0;
+	gboolean eof = FALSE;
+	gchar *path;
+
+	/* Only the local files are searched. */
+	path = g_file_get_path (location);
+
+	if (path == NULL)
+	{
+		return;
+	}
+
+	g_free (path);
+
+	stream = g_file_read (location, priv->cancellable, NULL);
+
+	if (stream == NULL)
+	{
+		return;
+	}
+
+	matches = g_ptr_array_new ();
+	buffer = g_malloc (buffer_size);
+
+	while (!eof)
+	{
+		gsize n_read;
+		gsize chunk_length;
+
+		if (n_buffered == buffer_size)
+		{
+			buffer_size *= 2;
+			buffer = g_realloc (buffer, buffer_size);
+		}
+
+		if (!g_input_stream_read_all (G_INPUT_STREAM (stream),
+					      buffer + n_buffered,
+					      buffer_size - n_buffered,
+					      &n_read,
+					      priv->cancellable,
+					      NULL))
+		{
+			break;
+		}
+
+		eof = n_read < buffer_size - n_buffered;
+
+		if (length == 0 &&
+		    (priv->flags & GEDIT_FIND_IN_FILES_FLAG_HIDE_BINARY) &&
+		    memchr (buffer, '\0', MIN (n_read, BINARY_SNIFF_LENGTH)) != NULL)
+		{
+			length = n_read;
+			break;
+		}
+
+		length += n_read;
+		n_buffered += n_read;
+
+		if (eof)
+		{
+			chunk_length = n_buffered;
+		}
+		else
+		{
+			chunk_length = get_complete_lines_length (buffer, n_buffered);
+
+			/* Read more of the line, unless it is too long. */
+			if (chunk_length == 0)
+			{
+				if (buffer_size < MAX_CHUNK_SIZE)
+				{
+					continue;
+				}
+
+				chunk_length = n_buffered;
+			}
+		}
+
+		line = search_buffer (search, location, NULL, buffer, chunk_length, line, matches);
+
+		if (g_cancellable_is_cancelled (priv->cancellable))
+		{
+			break;
+		}
+
+		n_buffered -= chunk_length;
+		memmove (buffer, buffer + chunk_length, n_buffered);
+	}
+
+	g_free (buffer);
+	g_object_unref (stream);
+
+	add_results (search, matches, length);
+}
+
+static void
+search_snapshot (GeditFindInFilesSearch *search,
+		 Snapshot               *snapshot)
+{
+	GPtrArray *matches;
+
+	matches = g_ptr_array_new ();
+
+	search_buffer (search,
+		       snapshot->location,
+		       snapshot->document,
+		       snapshot->text,
+		       snapshot->length,
+		       0,
+		       matches);
+
+	add_results (search, matches, snapshot->length);
+}
+
+static void
+flush_matches (GeditFindInFilesSearch *search)
+{
+	GeditFindInFilesSearchPrivate *priv = search->priv;
+	GPtrArray *matches;
+
+	g_mutex_lock (&priv->results_mutex);
+	matches = priv->pending_matches;
+	priv->pending_matches = g_ptr_array_new_with_free_func ((GDestroyNotify) match_free);
+	g_mutex_unlock (&priv->results_mutex);
+
+	if (matches->len > 0)
+	{
+		g_signal_emit (search, signals[MATCHES_FOUND], 0, matches);
+	}
+
+	g_ptr_array_unref (matches);
+}
+
+static gboolean
+flush_timeout_cb (GeditFindInFilesSearch *search)
+{
+	flush_matches (search);
+
+	return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+finish_idle_cb (GeditFindInFilesSearch *search)
+{
+	GeditFindInFilesSearchPrivate *priv = search->priv;
+
+	g_source_remove (priv->flush_id);
+	priv->flush_id = 0;
+
+	g_timer_stop (priv->timer);
+
+	flush_matches (search);
+
+	priv->running = FALSE;
+
+	gedit_debug_message (DEBUG_PLUGINS,
+			     "Searched %u files, %" G_GUINT64_FORMAT " bytes in %f seconds",
+			     priv->n_files,
+			     priv->n_bytes,
+			     g_timer_elapsed (priv->timer, NULL));
+
+	g_signal_emit (search, signals[FINISHED], 0);
+
+	/* The workers are gone. */
+	g_object_unref (search);
+
+	return G_SOURCE_REMOVE;
+}
+
+static gpointer
+worker_thread (Worker *worker)
+{
+	GeditFindInFilesSearch *search = worker->search;
+	GeditFindInFilesSearchPrivate *priv = search->priv;
+
+	while (TRUE)
+	{
+		Job *job = pop_job (search, worker);
+
+		if (job != NULL)
+		{
+			/* The remaining jobs are just dropped when the search
+			 * is cancelled.
+			 */
+			if (!g_cancellable_is_cancelled (priv->cancellable))
+			{
+				if (job->snapshot != NULL)
+				{
+					search_snapshot (search, job->snapshot);
+				}
+				else if (job->is_dir)
+				{
+					search_directory (search, worker, job->file);
+				}
+				else
+				{
+					search_file (search, job->file);
+				}
+			}
+
+			job_free (job);
+
+			if (g_atomic_int_dec_and_test (&priv->n_outstanding_jobs))
+			{
+				wake_workers (search);
+			}
+
+			continue;
+		}
+
+		if (g_atomic_int_get (&priv->n_outstanding_jobs) == 0)
+		{
+			break;
+		}
+
+		/* The jobs being processed by the other workers can queue new
+		 * ones.
+		 */
+		g_mutex_lock (&priv->idle_mutex);
+		g_cond_wait_until (&priv->idle_cond,
+				   &priv->idle_mutex,
+				   g_get_monotonic_time () + IDLE_WAIT);
+		g_mutex_unlock (&priv->idle_mutex);
+	}
+
+	if (g_atomic_int_dec_and_test (&priv->n_live_workers))
+	{
+		g_idle_add ((GSourceFunc) finish_idle_cb, search);
+	}
+
+	return NULL;
+}
+
+/**
+ * gedit_find_in_files_search_start:
+ * @search: a #GeditFindInFilesSearch.
+ *
+ * Starts the search. The matches are delivered by the
+ * #GeditFindInFilesSearch::matches-found signal, then
+ * #GeditFindInFilesSearch::finished is emitted. A search can only be started
+ * once.
+ */
+void
+gedit_find_in_files_search_start (GeditFindInFilesSearch *search)
+{
+	GeditFindInFilesSearchPrivate *priv;
+	guint i;
+
+	g_return_if_fail (GEDIT_IS_FIND_IN_FILES_SEARCH (search));
+	g_return_if_fail (!search->priv->started);
+
+	priv = search->priv;
+
+	priv->started = TRUE;
+	priv->running = TRUE;
+
+	priv->n_workers = CLAMP (g_get_num_processors (), 1, MAX_WORKERS);
+	priv->workers = g_new0 (Worker, priv->n_workers);
+
+	for (i = 0; i < priv->n_workers; i++)
+	{
+		priv->workers[i].search = search;
+		g_mutex_init (&priv->workers[i].mutex);
+		g_queue_init (&priv->workers[i].jobs);
+	}
+
+	if (priv->snapshots != NULL)
+	{
+		/* Shared out from the start, the workers steal the rest. */
+		for (i = 0; i < priv->snapshots->len; i++)
+		{
+			push_job (search,
+				  &priv->workers[i % priv->n_workers],
+				  NULL,
+				  g_ptr_array_index (priv->snapshots, i),
+				  FALSE);
+		}
+	}
+	else
+	{
+		push_job (search, &priv->workers[0], g_object_ref (priv->root), NULL, TRUE);
+	}
+
+	priv->n_live_workers = priv->n_workers;
+
+	/* Released by finish_idle_cb(). */
+	g_object_ref (search);
+
+	priv->flush_id = g_timeout_add (FLUSH_INTERVAL,
+					(GSourceFunc) flush_timeout_cb,
+					search);
+
+	g_timer_start (priv->timer);
+
+	for (i = 0; i < priv->n_workers; i++)
+	{
+		GThread *thread;
+
+		thread = g_thread_new ("gedit-find-in-files",
+				       (GThreadFunc) worker_thread,
+				       &priv->workers[i]);
+		g_thread_unref (thread);
+	}
+}
+
+/**
+ * gedit_find_in_files_search_cancel:
+ * @search: a #GeditFindInFilesSearch.
+ *
+ * Stops the search. #GeditFindInFilesSearch::finished is still emitted, once
+ * the workers have stopped.
+ */
+void
+gedit_find_in_files_search_cancel (GeditFindInFilesSearch *search)
+{
+	g_return_if_fail (GEDIT_IS_FIND_IN_FILES_SEARCH (search));
+
+	g_cancellable_cancel (search->priv->cancellable);
+}
+
+gboolean
+gedit_find_in_files_search_is_running (GeditFindInFilesSearch *search)
+{
+	g_return_val_if_fail (GEDIT_IS_FIND_IN_FILES_SEARCH (search), FALSE);
+
+	return search->priv->running;
+}
+
+/**
+ * gedit_find_in_files_search_is_truncated:
+ * @search: a #GeditFindInFilesSearch.
+ *
+ * Returns: whether the search stopped because there were too many matches.
+ */
+gboolean
+gedit_find_in_files_search_is_truncated (GeditFindInFilesSearch *search)
+{
+	gboolean truncated;
+
+	g_return_val_if_fail (GEDIT_IS_FIND_IN_FILES_SEARCH (search), FALSE);
+
+	g_mutex_lock (&search->priv->results_mutex);
+	truncated = search->priv->truncated;
+	g_mutex_unlock (&search->priv->results_mutex);
+
+	return truncated;
+}
+
+/**
+ * gedit_find_in_files_search_get_progress:
+ * @search: a #GeditFindInFilesSearch.
+ * @n_files: (out) (allow-none): the number of files searched.
+ * @n_bytes: (out) (allow-none): the number of bytes searched.
+ * @elapsed: (out) (allow-none): the duration of the search, in seconds.
+ */
+void
+gedit_find_in_files_search_get_progress (GeditFindInFilesSearch *search,
+					 guint                  *n_files,
+					 guint64                *n_bytes,
+					 gdouble                *elapsed)
+{
+	GeditFindInFilesSearchPrivate *priv;
+
+	g_return_if_fail (GEDIT_IS_FIND_IN_FILES_SEARCH (search));
+
+	priv = search->priv;
+
+	g_mutex_lock (&priv->results_mutex);
+
+	if (n_files != NULL)
+	{
+		*n_files = priv->n_files;
+	}
+
+	if (n_bytes != NULL)
+	{
+		*n_bytes = priv->n_bytes;
+	}
+
+	g_mutex_unlock (&priv->results_mutex);
+
+	if (elapsed != NULL)
+	{
+		*elapsed = g_timer_elapsed (priv->timer, NULL);
+	}
+}
+
+void
+_gedit_find_in_files_search_register_type (GTypeModule *type_module)
+{
+	gedit_find_in_files_search_register_type (type_module);
+}
+
+/* ex:set ts=8 noet: */
@@ -0,0 +1,115 @@
+/*
+ * gedit-find-in-files-search.h
+ * This file is part of gedit
+ *
+ * Copyright (C) 2015 - The gedit Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GEDIT_FIND_IN_FILES_SEARCH_H__
+#define __GEDIT_FIND_IN_FILES_SEARCH_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define GEDIT_TYPE_FIND_IN_FILES_SEARCH			(gedit_find_in_files_search_get_type ())
+#define GEDIT_FIND_IN_FILES_SEARCH(obj)			(G_TYPE_CHECK_INSTANCE_CAST ((obj), GEDIT_TYPE_FIND_IN_FILES_SEARCH, GeditFindInFilesSearch))
+#define GEDIT_FIND_IN_FILES_SEARCH_CLASS(klass)		(G_TYPE_CHECK_CLASS_CAST ((klass), GEDIT_TYPE_FIND_IN_FILES_SEARCH, GeditFindInFilesSearchClass))
+#define GEDIT_IS_FIND_IN_FILES_SEARCH(obj)		(G_TYPE_CHECK_INSTANCE_TYPE ((obj), GEDIT_TYPE_FIND_IN_FILES_SEARCH))
+#define GEDIT_IS_FIND_IN_FILES_SEARCH_CLASS(klass)	(G_TYPE_CHECK_CLASS_TYPE ((klass), GEDIT_TYPE_FIND_IN_FILES_SEARCH))
+#define GEDIT_FIND_IN_FILES_SEARCH_GET_CLASS(obj)	(G_TYPE_INSTANCE_GET_CLASS ((obj), GEDIT_TYPE_FIND_IN_FILES_SEARCH, GeditFindInFilesSearchClass))
+
+typedef struct _GeditFindInFilesSearch		GeditFindInFilesSearch;
+typedef struct _GeditFindInFilesSearchClass	GeditFindInFilesSearchClass;
+typedef struct _GeditFindInFilesSearchPrivate	GeditFindInFilesSearchPrivate;
+typedef struct _GeditFindInFilesMatch		GeditFindInFilesMatch;
+
+typedef enum
+{
+	GEDIT_FIND_IN_FILES_FLAG_NONE		= 0,
+	GEDIT_FIND_IN_FILES_FLAG_CASE_SENSITIVE	= 1 << 0,
+	GEDIT_FIND_IN_FILES_FLAG_REGEX		= 1 << 1,
+	GEDIT_FIND_IN_FILES_FLAG_HIDE_HIDDEN	= 1 << 2,
+	GEDIT_FIND_IN_FILES_FLAG_HIDE_BINARY	= 1 << 3
+} GeditFindInFilesFlags;
+
+struct _GeditFindInFilesMatch
+{
+	/* The location is %NULL for a new document. */
+	GFile *location;
+
+	/* The GeditDocument, for a search in the open documents. */
+	GObject *document;
+
+	/* Both start at 0, the column is in characters. */
+	gint line;
+	gint column;
+
+	/* The matching line, in UTF-8. */
+	gchar *text;
+};
+
+struct _GeditFindInFilesSearch
+{
+	GObject parent;
+
+	GeditFindInFilesSearchPrivate *priv;
+};
+
+struct _GeditFindInFilesSearchClass
+{
+	GObjectClass parent_class;
+
+	/* Signals */
+	void (* matches_found)	(GeditFindInFilesSearch *search,
+				 GPtrArray              *matches);
+
+	void (* finished)	(GeditFindInFilesSearch *search);
+};
+
+GType			 gedit_find_in_files_search_get_type		(void) G_GNUC_CONST;
+
+GeditFindInFilesSearch	*gedit_find_in_files_search_new			(GFile                   *root,
+									 const gchar             *pattern,
+									 GeditFindInFilesFlags    flags,
+									 const gchar * const     *binary_patterns,
+									 GError                 **error);
+
+GeditFindInFilesSearch	*gedit_find_in_files_search_new_for_documents	(GList                   *documents,
+										 const gchar             *pattern,
+										 GeditFindInFilesFlags    flags,
+										 GError                 **error);
+
+void			 gedit_find_in_files_search_start		(GeditFindInFilesSearch  *search);
+
+void			 gedit_find_in_files_search_cancel		(GeditFindInFilesSearch  *search);
+
+gboolean		 gedit_find_in_files_search_is_running		(GeditFindInFilesSearch  *search);
+
+gboolean		 gedit_find_in_files_search_is_truncated	(GeditFindInFilesSearch  *search);
+
+void			 gedit_find_in_files_search_get_progress	(GeditFindInFilesSearch  *search,
+									 guint                   *n_files,
+									 guint64                 *n_bytes,
+									 gdouble                 *elapsed);
+
+void			 _gedit_find_in_files_search_register_type	(GTypeModule             *type_module);
+
+G_END_DECLS
+
+#endif /* __GEDIT_FIND_IN_FILES_SEARCH_H__ */
+
+/* ex:set ts=8 noet: */
@@ -0,0 +1,917 @@
+/*
+ * gedit-sort-engine.c
+ *
+ * Copyright (C) 2015 - The gedit Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gedit-sort-engine.h"
+
+#include <string.h>
+#include <gio/gio.h>
+
+#include <gedit/gedit-debug.h>
+
+/* The collation key of each line is computed once, and the keys of a range
+ * of lines are stored one after the other in a single string. The lines are
+ * then sorted through an array of (key, line index) entries: each thread
+ * sorts a slice of the array, and the sorted slices are merged two by two,
+ * the merges of a round being done in parallel too.
+ *
+ * Both g_qsort_with_data() and the merges are stable, so the lines with the
+ * same key keep their order, like before.
+ */
+
+#define MAX_THREADS		8
+
+/* Below this, a thread costs more than it saves. */
+#define MIN_LINES_PER_THREAD	16384
+
+typedef struct
+{
+	/* NULL if the line is shorter than the starting column. */
+	const gchar *key;
+	guint index;
+} SortEntry;
+
+typedef struct
+{
+	gchar **lines;
+	SortEntry *entries;
+	SortEntry *merged;
+	const GeditSortOptions *options;
+
+	/* The range of the job, and the end of its first half for a merge. */
+	guint begin;
+	guint middle;
+	guint end;
+
+	GString *keys;
+} SortJob;
+
+static gint
+compare_keys (const gchar            *key1,
+	      const gchar            *key2,
+	      const GeditSortOptions *options)
+{
+	gint ret;
+
+	/* The lines shorter than the starting column come first, and are
+	 * all equal.
+	 */
+	if (key1 == NULL || key2 == NULL)
+	{
+		ret = (key1 != NULL) - (key2 != NULL);
+	}
+	else
+	{
+		ret = strcmp (key1, key2);
+	}
+
+	return options->reverse_order ? -ret : ret;
+}
+
+static gint
+compare_entries (gconstpointer a,
+		 gconstpointer b,
+		 gpointer      data)
+{
+	const SortEntry *entry1 = a;
+	const SortEntry *entry2 = b;
+
+	return compare_keys (entry1->key, entry2->key, data);
+}
+
+/* Returns NULL if the line is shorter than the starting column. */
+static gchar *
+get_key (const gchar            *line,
+	 const GeditSortOptions *options)
+{
+	gchar *folded = NULL;
+	const gchar *p;
+	gchar *key = NULL;
+	gint i;
+
+	if (options->ignore_case)
+	{
+		folded = g_utf8_casefold (line, -1);
+		line = folded;
+	}
+
+	p = line;
+
+	for (i = 0; i < options->starting_column && *p != '\0'; i++)
+	{
+		p = g_utf8_next_char (p);
+	}
+
+	if (i == options->starting_column)
+	{
+		key = g_utf8_collate_key (p, -1);
+	}
+
+	g_free (folded);
+
+	return key;
+}
+
+/* Returns the offset of the key in @keys plus one, or 0 if the line is too
+ * short.
+ */
+static gsize
+append_key (const gchar            *line,
+	    const GeditSortOptions *options,
+	    GString                *keys)
+{
+	gchar *key;
+	gsize offset;
+
+	key = get_key (line, options);
+
+	if (key == NULL)
+	{
+		return 0;
+	}
+
+	offset = keys->len + 1;
+	g_string_append_len (keys, key, strlen (key) + 1);
+
+	g_free (key);
+
+	return offset;
+}
+
+static gpointer
+compute_keys_thread (SortJob *job)
+{
+	guint i;
+
+	for (i = job->begin; i < job->end; i++)
+	{
+		gsize offset;
+
+		offset = append_key (job->lines[i], job->options, job->keys);
+
+		/* The string can still move, so only the offset is kept for
+		 * now.
+		 */
+		job->entries[i].key = GSIZE_TO_POINTER (offset);
+		job->entries[i].index = i;
+	}
+
+	return NULL;
+}
+
+static gpointer
+sort_thread (SortJob *job)
+{
+	g_qsort_with_data (job->entries + job->begin,
+			   job->end - job->begin,
+			   sizeof (SortEntry),
+			   compare_entries,
+			   (gpointer) job->options);
+
+	return NULL;
+}
+
+static gpointer
+merge_thread (SortJob *job)
+{
+	SortEntry *left = job->entries + job->begin;
+	SortEntry *left_end = job->entries + job->middle;
+	SortEntry *right = left_end;
+	SortEntry *right_end = job->entries + job->end;
+	SortEntry *out = job->merged + job->begin;
+
+	while (left < left_end && right < right_end)
+	{
+		/* Take from the left on equality, to keep the sort stable. */
+		if (compare_entries (right, left, (gpointer) job->options) < 0)
+		{
+			*out++ = *right++;
+		}
+		else
+		{
+			*out++ = *left++;
+		}
+	}
+
+	memcpy (out, left, (left_end - left) * sizeof (SortEntry));
+	out += left_end - left;
+	memcpy (out, right, (right_end - right) * sizeof (SortEntry));
+
+	return NULL;
+}
+
+static void
+run_jobs (GThreadFunc  func,
+	  SortJob     *jobs,
+	  guint        n_jobs)
+{
+	GThread **threads;
+	guint i;
+
+	if (n_jobs == 1)
+	{
+		func (&jobs[0]);
+		return;
+	}
+
+	threads = g_new (GThread *, n_jobs);
+
+	for (i = 0; i < n_jobs; i++)
+	{
+		threads[i] = g_thread_new ("gedit-sort", func, &jobs[i]);
+	}
+
+	for (i = 0; i < n_jobs; i++)
+	{
+		g_thread_join (threads[i]);
+	}
+
+	g_free (threads);
+}
+
+/**
+ * gedit_sort_lines:
+ * @lines: the lines to sort.
+ * @n_lines: the number of lines.
+ * @options: the #GeditSortOptions.
+ *
+ * Sorts @lines in place, by comparing the collation keys of the lines from
+ * the starting column.
+ */
+void
+gedit_sort_lines (gchar                  **lines,
+		  guint                    n_lines,
+		  const GeditSortOptions  *options)
+{
+	SortEntry *entries;
+	SortEntry *merged;
+	SortJob *jobs;
+	guint *bounds;
+	guint n_threads;
+	guint n_runs;
+	gchar **sorted;
+	GTimer *timer;
+	guint i;
+
+	g_return_if_fail (lines != NULL || n_lines == 0);
+	g_return_if_fail (options != NULL);
+
+	if (n_lines < 2)
+	{
+		return;
+	}
+
+	timer = g_timer_new ();
+
+	n_threads = CLAMP (n_lines / MIN_LINES_PER_THREAD, 1, (guint) g_get_num_processors ());
+	n_threads = MIN (n_threads, MAX_THREADS);
+
+	entries = g_new (SortEntry, n_lines);
+	jobs = g_new0 (SortJob, n_threads);
+
+	/* The slices, bounds[i] to bounds[i + 1]. */
+	bounds = g_new (guint, n_threads + 1);
+
+	for (i = 0; i <= n_threads; i++)
+	{
+		bounds[i] = (guint) ((guint64) n_lines * i / n_threads);
+	}
+
+	for (i = 0; i < n_threads; i++)
+	{
+		jobs[i].lines = lines;
+		jobs[i].entries = entries;
+		jobs[i].options = options;
+		jobs[i].begin = bounds[i];
+		jobs[i].end = bounds[i + 1];
+		jobs[i].keys = g_string_new (NULL);
+	}
+
+	run_jobs ((GThreadFunc) compute_keys_thread, jobs, n_threads);
+
+	for (i = 0; i < n_threads; i++)
+	{
+		guint j;
+
+		for (j = jobs[i].begin; j < jobs[i].end; j++)
+		{
+			gsize offset = GPOINTER_TO_SIZE (entries[j].key);
+
+			entries[j].key = offset > 0 ? jobs[i].keys->str + offset - 1 : NULL;
+		}
+	}
+
+	gedit_debug_message (DEBUG_PLUGINS,
+			     "Keys of %u lines computed with %u threads in %f seconds",
+			     n_lines,
+			     n_threads,
+			     g_timer_elapsed (timer, NULL));
+
+	run_jobs ((GThreadFunc) sort_thread, jobs, n_threads);
+
+	/* Merge the sorted slices two by two until there is only one. */
+	merged = g_new (SortEntry, n_lines);
+
+	for (n_runs = n_threads; n_runs > 1; n_runs = (n_runs + 1) / 2)
+	{
+		guint n_jobs = 0;
+		SortEntry *tmp;
+
+		for (i = 0; i < n_runs; i += 2)
+		{
+			SortJob *job = &jobs[n_jobs++];
+
+			job->entries = entries;
+			job->merged = merged;
+			job->begin = bounds[i];
+
+			job->middle = bounds[i + 1];
+
+			/* A run left alone is merged with nothing. */
+			job->end = i + 1 < n_runs ? bounds[i + 2] : bounds[i + 1];
+		}
+
+		run_jobs ((GThreadFunc) merge_thread, jobs, n_jobs);
+
+		for (i = 0; i < n_jobs; i++)
+		{
+			bounds[i] = jobs[i].begin;
+		}
+
+		bounds[n_jobs] = n_lines;
+
+		tmp = entries;
+		entries = merged;
+		merged = tmp;
+	}
+
+	sorted = g_new (gchar *, n_lines);
+
+	for (i = 0; i < n_lines; i++)
+	{
+		sorted[i] = lines[entries[i].index];
+	}
+
+	memcpy (lines, sorted, n_lines * sizeof (gchar *));
+
+	gedit_debug_message (DEBUG_PLUGINS,
+			     "%u lines sorted in %f seconds",
+			     n_lines,
+			     g_timer_elapsed (timer, NULL));
+
+	for (i = 0; i < n_threads; i++)
+	{
+		g_string_free (jobs[i].keys, TRUE);
+	}
+
+	g_free (sorted);
+	g_free (merged);
+	g_free (entries);
+	g_free (bounds);
+	g_free (jobs);
+	g_timer_destroy (timer);
+}
+
+/* External sort
+ *
+ * When a selection is too big to be sorted in memory, it is split in batches
+ * that are sorted with gedit_sort_lines() and written to temporary files, the
+ * runs. The runs are then merged by reading one line of each at a time, so
+ * only a line per run has to be in memory. The next line comes from a binary
+ * heap of the run readers.
+ *
+ * At most MAX_MERGE_RUNS runs are open at once. When there are more, groups of
+ * consecutive runs are first merged into bigger runs, pass after pass, which
+ * keeps the merge stable.
+ */
+
+/* The size of the chunks written to the runs and passed to the output
+ * function.
+ */
+#define CHUNK_SIZE	(1024 * 1024)
+
+#define MAX_MERGE_RUNS	64
+
+struct _GeditSortRuns
+{
+	GeditSortOptions options;
+
+	/* GFile */
+	GPtrArray *files;
+};
+
+typedef struct
+{
+	GDataInputStream *stream;
+	gchar *line;
+	gchar *key;
+
+	/* The position of the run, between equal keys the first run wins. */
+	guint index;
+} RunReader;
+
+typedef struct
+{
+	GOutputStream *stream;
+	GError *error;
+} RunWriter;
+
+/**
+ * gedit_sort_runs_new:
+ * @options: the #GeditSortOptions.
+ *
+ * Returns: (transfer full): a new #GeditSortRuns, without any run.
+ */
+GeditSortRuns *
+gedit_sort_runs_new (const GeditSortOptions *options)
+{
+	GeditSortRuns *runs;
+
+	g_return_val_if_fail (options != NULL, NULL);
+
+	runs = g_slice_new (GeditSortRuns);
+	runs->options = *options;
+	runs->files = g_ptr_array_new_with_free_func (g_object_unref);
+
+	return runs;
+}
+
+/**
+ * gedit_sort_runs_free:
+ * @runs: a #GeditSortRuns.
+ *
+ * Deletes the temporary files of @runs, and frees it.
+ */
+void
+gedit_sort_runs_free (GeditSortRuns *runs)
+{
+	guint i;
+
+	if (runs == NULL)
+	{
+		return;
+	}
+
+	for (i = 0; i < runs->files->len; i++)
+	{
+		g_file_delete (g_ptr_array_index (runs->files, i), NULL, NULL);
+	}
+
+	g_ptr_array_unref (runs->files);
+	g_slice_free (GeditSortRuns, runs);
+}
+
+/**
+ * gedit_sort_runs_add:
+ * @runs: a #GeditSortRuns.
+ * @lines: the lines of the run, without their line terminator.
+ * @n_lines: the number of lines.
+ * @error: a #GError, or %NULL.
+ *
+ * Sorts @lines in place, and writes them to a new temporary file.
+ *
+ * Returns: %TRUE on success.
+ */
+gboolean
+gedit_sort_runs_add (GeditSortRuns  *runs,
+		     gchar         **lines,
+		     guint           n_lines,
+		     GError        **error)
+{
+	GFile *file;
+	GFileIOStream *iostream;
+	GOutputStream *stream;
+	GString *chunk;
+	gboolean ret = TRUE;
+	guint i;
+
+	g_return_val_if_fail (runs != NULL, FALSE);
+	g_return_val_if_fail (lines != NULL || n_lines == 0, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	gedit_sort_lines (lines, n_lines, &runs->options);
+
+	file = g_file_new_tmp ("gedit-sort-XXXXXX", &iostream, error);
+
+	if (file == NULL)
+	{
+		return FALSE;
+	}
+
+	/* Added right away, so that the file is deleted on error too. */
+	g_ptr_array_add (runs->files, file);
+
+	stream = g_io_stream_get_output_stream (G_IO_STREAM (iostream));
+	chunk = g_string_sized_new (CHUNK_SIZE);
+
+	for (i = 0; i < n_lines && ret; i++)
+	{
+		g_string_append (chunk, lines[i]);
+		g_string_append_c (chunk, '\n');
+
+		if (chunk->len >= CHUNK_SIZE || i == n_lines - 1)
+		{
+			ret = g_output_stream_write_all (stream,
+							 chunk->str,
+							 chunk->len,
+							 NULL,
+							 NULL,
+							 error);
+
+			g_string_truncate (chunk, 0);
+		}
+	}
+
+	if (ret)
+	{
+		ret = g_io_stream_close (G_IO_STREAM (iostream), NULL, error);
+	}
+
+	g_string_free (chunk, TRUE);
+	g_object_unref (iostream);
+
+	return ret;
+}
+
+/* Reads the next line of the run, and its key. The line is NULL at the end of
+ * the run.
+ */
+static gboolean
+run_reader_next (RunReader               *reader,
+		 const GeditSortOptions  *options,
+		 GError                 **error)
+{
+	GError *read_error = NULL;
+
+	g_free (reader->line);
+	g_free (reader->key);
+	reader->key = NULL;
+
+	reader->line = g_data_input_stream_read_line_utf8 (reader->stream,
+							   NULL,
+							   NULL,
+							   &read_error);
+
+	if (read_error != NULL)
+	{
+		g_propagate_error (error, read_error);
+		return FALSE;
+	}
+
+	if (reader->line != NULL)
+	{
+		reader->key = get_key (reader->line, options);
+	}
+
+	return TRUE;
+}
+
+static gboolean
+reader_less (const RunReader        *reader1,
+	     const RunReader        *reader2,
+	     const GeditSortOptions *options)
+{
+	gint cmp;
+
+	cmp = compare_keys (reader1->key, reader2->key, options);
+
+	return cmp < 0 || (cmp == 0 && reader1->index < reader2->index);
+}
+
+static void
+heap_sift_down (RunReader              **heap,
+		guint                    n_readers,
+		guint                    i,
+		const GeditSortOptions  *options)
+{
+	for (;;)
+	{
+		guint smallest = i;
+		guint child = 2 * i + 1;
+		RunReader *tmp;
+
+		if (child < n_readers && reader_less (heap[child], heap[smallest], options))
+		{
+			smallest = child;
+		}
+
+		if (child + 1 < n_readers && reader_less (heap[child + 1], heap[smallest], options))
+		{
+			smallest = child + 1;
+		}
+
+		if (smallest == i)
+		{
+			break;
+		}
+
+		tmp = heap[i];
+		heap[i] = heap[smallest];
+		heap[smallest] = tmp;
+
+		i = smallest;
+	}
+}
+
+/* Merges the @n_files runs starting at @first, at most MAX_MERGE_RUNS. */
+static gboolean
+merge_files (GPtrArray               *files,
+	     guint                    first,
+	     guint                    n_files,
+	     const GeditSortOptions  *options,
+	     gboolean                 remove_duplicates,
+	     GeditSortOutputFunc      output_func,
+	     gpointer                 user_data,
+	     GError                 **error)
+{
+	RunReader *readers;
+	RunReader **heap;
+	guint n_readers = 0;
+	GString *chunk;
+	gchar *last_line = NULL;
+	gboolean ret = TRUE;
+	guint i;
+
+	g_assert (n_files <= MAX_MERGE_RUNS);
+
+	readers = g_new0 (RunReader, n_files);
+	heap = g_new (RunReader *, n_files);
+
+	for (i = 0; i < n_files && ret; i++)
+	{
+		GFileInputStream *stream;
+
+		stream = g_file_read (g_ptr_array_index (files, first + i), NULL, error);
+
+		if (stream == NULL)
+		{
+			ret = FALSE;
+			break;
+		}
+
+		readers[i].index = i;
+		readers[i].stream = g_data_input_stream_new (G_INPUT_STREAM (stream));
+		g_data_input_stream_set_newline_type (readers[i].stream,
+						      G_DATA_STREAM_NEWLINE_TYPE_LF);
+		g_object_unref (stream);
+
+		ret = run_reader_next (&readers[i], options, error);
+
+		if (ret && readers[i].line != NULL)
+		{
+			heap[n_readers++] = &readers[i];
+		}
+	}
+
+	for (i = n_readers / 2; i > 0; i--)
+	{
+		heap_sift_down (heap, n_readers, i - 1, options);
+	}
+
+	chunk = g_string_sized_new (CHUNK_SIZE);
+
+	while (ret && n_readers > 0)
+	{
+		RunReader *next = heap[0];
+
+		if (!remove_duplicates ||
+		    last_line == NULL ||
+		    strcmp (last_line, next->line) != 0)
+		{
+			g_string_append (chunk, next->line);
+			g_string_append_c (chunk, '\n');
+
+			if (remove_duplicates)
+			{
+				g_free (last_line);
+				last_line = g_strdup (next->line);
+			}
+		}
+
+		if (chunk->len >= CHUNK_SIZE)
+		{
+			output_func (chunk->str, chunk->len, user_data);
+			g_string_truncate (chunk, 0);
+		}
+
+		ret = run_reader_next (next, options, error);
+
+		/* The end of the run. */
+		if (ret && next->line == NULL)
+		{
+			heap[0] = heap[--n_readers];
+		}
+
+		heap_sift_down (heap, n_readers, 0, options);
+	}
+
+	if (ret && chunk->len > 0)
+	{
+		output_func (chunk->str, chunk->len, user_data);
+	}
+
+	for (i = 0; i < n_files; i++)
+	{
+		g_clear_object (&readers[i].stream);
+		g_free (readers[i].line);
+		g_free (readers[i].key);
+	}
+
+	g_string_free (chunk, TRUE);
+	g_free (last_line);
+	g_free (heap);
+	g_free (readers);
+
+	return ret;
+}
+
+static void
+run_writer_write (const gchar *text,
+		  gsize        length,
+		  RunWriter   *writer)
+{
+	if (writer->error == NULL)
+	{
+		g_output_stream_write_all (writer->stream,
+					   text,
+					   length,
+					   NULL,
+					   NULL,
+					   &writer->error);
+	}
+}
+
+/* Merges the runs by groups of MAX_MERGE_RUNS, into fewer and bigger runs.
+ * The runs of a group are deleted once merged, so the pass doesn't need twice
+ * the disk space.
+ */
+static gboolean
+merge_pass (GeditSortRuns  *runs,
+	    GError        **error)
+{
+	GPtrArray *merged;
+	gboolean ret = TRUE;
+	guint first;
+	guint i;
+
+	merged = g_ptr_array_new_with_free_func (g_object_unref);
+
+	for (first = 0; first < runs->files->len && ret; first += MAX_MERGE_RUNS)
+	{
+		guint n_files = MIN (MAX_MERGE_RUNS, runs->files->len - first);
+		GFile *file;
+		GFileIOStream *iostream;
+		RunWriter writer;
+
+		file = g_file_new_tmp ("gedit-sort-XXXXXX", &iostream, error);
+
+		if (file == NULL)
+		{
+			ret = FALSE;
+			break;
+		}
+
+		/* Added right away, so that the file is deleted on error too. */
+		g_ptr_array_add (merged, file);
+
+		writer.stream = g_io_stream_get_output_stream (G_IO_STREAM (iostream));
+		writer.error = NULL;
+
+		/* The duplicates are only removed by the last merge, where
+		 * the lines that compare equal are next to each other.
+		 */
+		ret = merge_files (runs->files,
+				   first,
+				   n_files,
+				   &runs->options,
+				   FALSE,
+				   (GeditSortOutputFunc) run_writer_write,
+				   &writer,
+				   error);
+
+		if (ret && writer.error != NULL)
+		{
+			g_propagate_error (error, writer.error);
+			writer.error = NULL;
+			ret = FALSE;
+		}
+
+		g_clear_error (&writer.error);
+
+		if (ret)
+		{
+			ret = g_io_stream_close (G_IO_STREAM (iostream), NULL, error);
+		}
+
+		g_object_unref (iostream);
+
+		if (ret)
+		{
+			for (i = first; i < first + n_files; i++)
+			{
+				g_file_delete (g_ptr_array_index (runs->files, i), NULL, NULL);
+			}
+		}
+	}
+
+	if (!ret)
+	{
+		for (i = 0; i < merged->len; i++)
+		{
+			g_file_delete (g_ptr_array_index (merged, i), NULL, NULL);
+		}
+
+		g_ptr_array_unref (merged);
+		return FALSE;
+	}
+
+	g_ptr_array_unref (runs->files);
+	runs->files = merged;
+
+	return TRUE;
+}
+
+/**
+ * gedit_sort_runs_merge:
+ * @runs: a #GeditSortRuns.
+ * @remove_duplicates: whether to skip the lines equal to the previous one.
+ * @output_func: the function receiving the sorted text, chunk by chunk.
+ * @user_data: the data passed to @output_func.
+ * @error: a #GError, or %NULL.
+ *
+ * Merges the runs of @runs. The sorted lines are passed to @output_func in
+ * order, each followed by a line feed. The merge is stable: between equal
+ * lines, the ones of the runs added first come first.
+ *
+ * Returns: %TRUE on success. On error, @output_func may already have been
+ * called.
+ */
+gboolean
+gedit_sort_runs_merge (GeditSortRuns           *runs,
+		       gboolean                 remove_duplicates,
+		       GeditSortOutputFunc      output_func,
+		       gpointer                 user_data,
+		       GError                 **error)
+{
+	gboolean ret = TRUE;
+	GTimer *timer;
+	guint n_runs;
+	guint n_passes = 0;
+
+	g_return_val_if_fail (runs != NULL, FALSE);
+	g_return_val_if_fail (output_func != NULL, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	timer = g_timer_new ();
+
+	n_runs = runs->files->len;
+
+	while (ret && runs->files->len > MAX_MERGE_RUNS)
+	{
+		ret = merge_pass (runs, error);
+		n_passes++;
+	}
+
+	if (ret)
+	{
+		ret = merge_files (runs->files,
+				   0,
+				   runs->files->len,
+				   &runs->options,
+				   remove_duplicates,
+				   output_func,
+				   user_data,
+				   error);
+	}
+
+	gedit_debug_message (DEBUG_PLUGINS,
+			     "%u runs merged in %u passes and %f seconds",
+			     n_runs,
+			     n_passes + 1,
+			     g_timer_elapsed (timer, NULL));
+
+	g_timer_destroy (timer);
+
+	return ret;
+}
+
+/* ex:set ts=8 noet: */
@@ -0,0 +1,66 @@
+/*
+ * gedit-sort-engine.h
+ *
+ * Copyright (C) 2015 - The gedit Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GEDIT_SORT_ENGINE_H__
+#define __GEDIT_SORT_ENGINE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GeditSortOptions GeditSortOptions;
+typedef struct _GeditSortRuns GeditSortRuns;
+
+struct _GeditSortOptions
+{
+	/* In characters, starting at 0. */
+	gint starting_column;
+
+	guint ignore_case : 1;
+	guint reverse_order : 1;
+};
+
+typedef void (* GeditSortOutputFunc) (const gchar *text,
+				      gsize        length,
+				      gpointer     user_data);
+
+void		gedit_sort_lines	(gchar                  **lines,
+					 guint                    n_lines,
+					 const GeditSortOptions  *options);
+
+GeditSortRuns  *gedit_sort_runs_new	(const GeditSortOptions  *options);
+
+void		gedit_sort_runs_free	(GeditSortRuns           *runs);
+
+gboolean	gedit_sort_runs_add	(GeditSortRuns           *runs,
+					 gchar                  **lines,
+					 guint                    n_lines,
+					 GError                 **error);
+
+gboolean	gedit_sort_runs_merge	(GeditSortRuns           *runs,
+					 gboolean                 remove_duplicates,
+					 GeditSortOutputFunc      output_func,
+					 gpointer                 user_data,
+					 GError                 **error);
+
+G_END_DECLS
+
+#endif /* __GEDIT_SORT_ENGINE_H__ */
+
+/* ex:set ts=8 noet: */
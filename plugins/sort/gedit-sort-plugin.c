@@ -34,6 +34,18 @@
 #include <gedit/gedit-app-activatable.h>
 #include <gedit/gedit-window-activatable.h>
 
+#include "gedit-sort-engine.h"
+
+#define SORT_BASE_SETTINGS	"org.gnome.gedit.plugins.sort"
+
+/* The memory used to sort a line, with its collation key and the sort
+ * entries, relative to the length of the line.
+ */
+#define SORT_MEMORY_FACTOR	4
+
+/* The unique lines are read from the buffer by blocks of this many lines. */
+#define UNIQUE_LINES_BLOCK	1024
+
 static void gedit_app_activatable_iface_init (GeditAppActivatableInterface *iface);
 static void gedit_window_activatable_iface_init (GeditWindowActivatableInterface *iface);
 
@@ -47,6 +59,9 @@ struct _GeditSortPluginPrivate
 	GtkWidget *reverse_order_checkbutton;
 	GtkWidget *ignore_case_checkbutton;
 	GtkWidget *remove_dups_checkbutton;
+	GtkWidget *unique_lines_checkbutton;
+
+	GSettings *settings;
 
 	GeditApp *app;
 	GeditMenuExtension *menu_ext;
@@ -56,10 +71,8 @@ struct _GeditSortPluginPrivate
 
 typedef struct
 {
-	gint starting_column;
+	GeditSortOptions options;
 
-	guint ignore_case : 1;
-	guint reverse_order : 1;
 	guint remove_duplicates : 1;
 } SortInfo;
 
@@ -81,6 +94,8 @@ G_DEFINE_DYNAMIC_TYPE_EXTENDED (GeditSortPlugin,
 				G_ADD_PRIVATE_DYNAMIC (GeditSortPlugin))
 
 static void sort_real (GeditSortPlugin *plugin);
+static void unique_lines_toggled_cb (GtkToggleButton *button,
+				     GeditSortPlugin *plugin);
 
 static void
 sort_dialog_response_handler (GtkDialog       *dlg,
@@ -152,6 +167,7 @@ create_sort_dialog (GeditSortPlugin *plugin)
 	priv->col_num_spinbutton = GTK_WIDGET (gtk_builder_get_object (builder, "col_num_spinbutton"));
 	priv->ignore_case_checkbutton = GTK_WIDGET (gtk_builder_get_object (builder, "ignore_case_checkbutton"));
 	priv->remove_dups_checkbutton = GTK_WIDGET (gtk_builder_get_object (builder, "remove_dups_checkbutton"));
+	priv->unique_lines_checkbutton = GTK_WIDGET (gtk_builder_get_object (builder, "unique_lines_checkbutton"));
 	g_object_unref (builder);
 
 	gtk_dialog_set_default_response (GTK_DIALOG (priv->dialog),
@@ -167,6 +183,11 @@ create_sort_dialog (GeditSortPlugin *plugin)
 			  G_CALLBACK (sort_dialog_response_handler),
 			  plugin);
 
+	g_signal_connect (priv->unique_lines_checkbutton,
+			  "toggled",
+			  G_CALLBACK (unique_lines_toggled_cb),
+			  plugin);
+
 	get_current_selection (plugin);
 }
 
@@ -197,110 +218,377 @@ sort_cb (GAction         *action,
 	gtk_widget_show (GTK_WIDGET (priv->dialog));
 }
 
-/* Compares two strings for the sorting algorithm. Uses the UTF-8 processing
- * functions in GLib to be as correct as possible.*/
-static gint
-compare_algorithm (gconstpointer s1,
-		   gconstpointer s2,
-		   gpointer      data)
-{
-	gint length1, length2;
-	gint ret;
-	gchar *string1, *string2;
-	gchar *substring1, *substring2;
-	gchar *key1, *key2;
-	SortInfo *sort_info;
+static gchar *
+get_line_slice (GtkTextBuffer *buf,
+		gint           line)
+{
+	GtkTextIter start, end;
+	char *ret;
 
-	gedit_debug (DEBUG_PLUGINS);
+	gtk_text_buffer_get_iter_at_line (buf, &start, line);
+	end = start;
+
+	if (!gtk_text_iter_ends_line (&start))
+		gtk_text_iter_forward_to_line_end (&end);
 
-	sort_info = (SortInfo *) data;
-	g_return_val_if_fail (sort_info != NULL, -1);
+	ret= gtk_text_buffer_get_slice (buf,
+					&start,
+					&end,
+					TRUE);
 
-	if (!sort_info->ignore_case)
+	g_assert (ret != NULL);
+
+	return ret;
+}
+
+/* The set of the lines seen by get_unique_lines() is an open addressing hash
+ * table of offsets into the returned text, so each unique line is in memory
+ * only once. A slot is empty when its offset is 0, the offsets are stored
+ * plus one.
+ */
+typedef struct
+{
+	gsize offset;
+	guint hash;
+} UniqueSlot;
+
+typedef struct
+{
+	UniqueSlot *slots;
+	gsize mask;
+	gsize n_used;
+} UniqueSet;
+
+static guint
+hash_line (const gchar *line,
+	   gsize        length)
+{
+	guint hash = 5381;
+	gsize i;
+
+	/* Same as g_str_hash(), with a length. */
+	for (i = 0; i < length; i++)
 	{
-		string1 = *((gchar **) s1);
-		string2 = *((gchar **) s2);
+		hash = (hash << 5) + hash + (guchar) line[i];
 	}
-	else
+
+	return hash;
+}
+
+static void
+unique_set_grow (UniqueSet *set)
+{
+	UniqueSlot *old_slots = set->slots;
+	gsize old_size = set->mask + 1;
+	gsize i;
+
+	set->mask = old_size * 2 - 1;
+	set->slots = g_new0 (UniqueSlot, old_size * 2);
+
+	for (i = 0; i < old_size; i++)
 	{
-		string1 = g_utf8_casefold (*((gchar **) s1), -1);
-		string2 = g_utf8_casefold (*((gchar **) s2), -1);
+		gsize pos;
+
+		if (old_slots[i].offset == 0)
+		{
+			continue;
+		}
+
+		pos = old_slots[i].hash & set->mask;
+
+		while (set->slots[pos].offset != 0)
+		{
+			pos = (pos + 1) & set->mask;
+		}
+
+		set->slots[pos] = old_slots[i];
 	}
 
-	length1 = g_utf8_strlen (string1, -1);
-	length2 = g_utf8_strlen (string2, -1);
+	g_free (old_slots);
+}
+
+/* Returns TRUE if @line is already in @text, otherwise appends it and adds it
+ * to @set.
+ */
+static gboolean
+unique_set_check_and_add (UniqueSet   *set,
+			  GString     *text,
+			  const gchar *line,
+			  gsize        length)
+{
+	guint hash = hash_line (line, length);
+	gsize pos;
 
-	if ((length1 < sort_info->starting_column) &&
-	    (length2 < sort_info->starting_column))
+	for (pos = hash & set->mask;
+	     set->slots[pos].offset != 0;
+	     pos = (pos + 1) & set->mask)
 	{
-		ret = 0;
+		const gchar *seen;
+
+		if (set->slots[pos].hash != hash)
+		{
+			continue;
+		}
+
+		/* The lines of the text all end with a line feed. */
+		seen = text->str + set->slots[pos].offset - 1;
+
+		if (memcmp (seen, line, length) == 0 && seen[length] == '\n')
+		{
+			return TRUE;
+		}
 	}
-	else if (length1 < sort_info->starting_column)
+
+	set->slots[pos].offset = text->len + 1;
+	set->slots[pos].hash = hash;
+
+	g_string_append_len (text, line, length);
+	g_string_append_c (text, '\n');
+
+	/* At most half full, for short probes. */
+	if (++set->n_used * 2 > set->mask + 1)
 	{
-		ret = -1;
+		unique_set_grow (set);
 	}
-	else if (length2 < sort_info->starting_column)
+
+	return FALSE;
+}
+
+/* Keeps the first occurrence of each line, in the original order. This does
+ * not follow the memory budget, but the unique lines are only kept in the
+ * returned text, and the buffer is read by blocks of lines instead of line by
+ * line.
+ */
+static GString *
+get_unique_lines (GtkTextBuffer *buffer,
+		  gint           start_line,
+		  gint           num_lines,
+		  gsize          size)
+{
+	UniqueSet set;
+	GString *text;
+	gint block;
+
+	set.mask = 1023;
+	set.slots = g_new0 (UniqueSlot, set.mask + 1);
+	set.n_used = 0;
+
+	text = g_string_sized_new (size);
+
+	for (block = 0; block < num_lines; block += UNIQUE_LINES_BLOCK)
 	{
-		ret = 1;
+		gint block_lines = MIN (UNIQUE_LINES_BLOCK, num_lines - block);
+		GtkTextIter block_start;
+		GtkTextIter block_end;
+		GtkTextIter line_start;
+		gchar *slice;
+		gsize pos = 0;
+		gint i;
+
+		gtk_text_buffer_get_iter_at_line (buffer, &block_start, start_line + block);
+		gtk_text_buffer_get_iter_at_line (buffer, &block_end, start_line + block + block_lines - 1);
+
+		if (!gtk_text_iter_ends_line (&block_end))
+		{
+			gtk_text_iter_forward_to_line_end (&block_end);
+		}
+
+		slice = gtk_text_buffer_get_slice (buffer, &block_start, &block_end, TRUE);
+
+		line_start = block_start;
+
+		/* The line terminators can be "\n", "\r\n", "\r" or U+2029,
+		 * so the lines are split with the iters, as in
+		 * get_line_slice().
+		 */
+		for (i = 0; i < block_lines; i++)
+		{
+			GtkTextIter line_end = line_start;
+			gsize length;
+
+			if (!gtk_text_iter_ends_line (&line_end))
+			{
+				gtk_text_iter_forward_to_line_end (&line_end);
+			}
+
+			length = gtk_text_iter_get_line_index (&line_end);
+
+			unique_set_check_and_add (&set, text, slice + pos, length);
+
+			pos += gtk_text_iter_get_bytes_in_line (&line_start);
+			gtk_text_iter_forward_line (&line_start);
+		}
+
+		g_free (slice);
 	}
-	else if (sort_info->starting_column < 1)
-	{
-		key1 = g_utf8_collate_key (string1, -1);
-		key2 = g_utf8_collate_key (string2, -1);
-		ret = strcmp (key1, key2);
 
-		g_free (key1);
-		g_free (key2);
+	gedit_debug_message (DEBUG_PLUGINS,
+			     "%" G_GSIZE_FORMAT " unique lines",
+			     set.n_used);
+
+	g_free (set.slots);
+
+	return text;
+}
+
+static GString *
+get_sorted_lines (GtkTextBuffer *buffer,
+		  gint           start_line,
+		  gint           num_lines,
+		  gsize          size,
+		  SortInfo      *sort_info)
+{
+	gchar **lines;
+	gchar *last_row = NULL;
+	GString *text;
+	gint i;
+
+	lines = g_new0 (gchar *, num_lines + 1);
+
+	gedit_debug_message (DEBUG_PLUGINS, "Building list...");
+
+	for (i = 0; i < num_lines; i++)
+	{
+		lines[i] = get_line_slice (buffer, start_line + i);
 	}
-	else
+
+	lines[num_lines] = NULL;
+
+	gedit_debug_message (DEBUG_PLUGINS, "Sort list...");
+
+	gedit_sort_lines (lines, num_lines, &sort_info->options);
+
+	text = g_string_sized_new (size);
+
+	for (i = 0; i < num_lines; i++)
 	{
-		/* A character column offset is required, so figure out
-		 * the correct offset into the UTF-8 string. */
-		substring1 = g_utf8_offset_to_pointer (string1, sort_info->starting_column);
-		substring2 = g_utf8_offset_to_pointer (string2, sort_info->starting_column);
+		if (sort_info->remove_duplicates &&
+		    last_row != NULL &&
+		    (strcmp (last_row, lines[i]) == 0))
+			continue;
 
-		key1 = g_utf8_collate_key (substring1, -1);
-		key2 = g_utf8_collate_key (substring2, -1);
-		ret = strcmp (key1, key2);
+		g_string_append (text, lines[i]);
+		g_string_append_c (text, '\n');
 
-		g_free (key1);
-		g_free (key2);
+		last_row = lines[i];
 	}
 
-	/* Do the necessary cleanup. */
-	if (sort_info->ignore_case)
+	g_strfreev (lines);
+
+	return text;
+}
+
+typedef struct
+{
+	GtkTextBuffer *buffer;
+	GtkTextIter iter;
+} MergeOutput;
+
+static void
+insert_merged_text (const gchar *text,
+		    gsize        length,
+		    gpointer     user_data)
+{
+	MergeOutput *output = user_data;
+
+	gtk_text_buffer_insert (output->buffer, &output->iter, text, length);
+}
+
+/* Sorts the lines in batches that fit in the memory budget, written to
+ * temporary files, then merges the batches directly into the buffer, after
+ * the selection. The selection is only deleted once the merge succeeded, so
+ * that nothing is lost on error, even without undo.
+ */
+static gboolean
+external_sort (GtkTextBuffer  *buffer,
+	       GtkTextIter    *start,
+	       GtkTextIter    *end,
+	       gint            start_line,
+	       gint            num_lines,
+	       gsize           batch_size,
+	       SortInfo       *sort_info,
+	       GError        **error)
+{
+	GeditSortRuns *runs;
+	GPtrArray *batch;
+	gsize size = 0;
+	MergeOutput output;
+	GtkTextMark *selection_start;
+	GtkTextMark *sorted_start;
+	GtkTextIter iter;
+	gboolean ret = TRUE;
+	gint i;
+
+	runs = gedit_sort_runs_new (&sort_info->options);
+	batch = g_ptr_array_new_with_free_func (g_free);
+
+	gedit_debug_message (DEBUG_PLUGINS, "Writing sorted runs...");
+
+	for (i = 0; i < num_lines && ret; i++)
 	{
-		g_free (string1);
-		g_free (string2);
+		gchar *line = get_line_slice (buffer, start_line + i);
+
+		size += strlen (line) + 1;
+		g_ptr_array_add (batch, line);
+
+		if (size >= batch_size || i == num_lines - 1)
+		{
+			ret = gedit_sort_runs_add (runs,
+						   (gchar **) batch->pdata,
+						   batch->len,
+						   error);
+
+			g_ptr_array_set_size (batch, 0);
+			size = 0;
+		}
 	}
 
-	if (sort_info->reverse_order)
+	g_ptr_array_unref (batch);
+
+	if (!ret)
 	{
-		ret = -1 * ret;
+		/* The buffer has not been touched yet. */
+		gedit_sort_runs_free (runs);
+		return FALSE;
 	}
 
-	return ret;
-}
+	gedit_debug_message (DEBUG_PLUGINS, "Merging runs...");
 
-static gchar *
-get_line_slice (GtkTextBuffer *buf,
-		gint           line)
-{
-	GtkTextIter start, end;
-	char *ret;
+	gtk_text_buffer_begin_user_action (buffer);
 
-	gtk_text_buffer_get_iter_at_line (buf, &start, line);
-	end = start;
+	/* With left gravity, both marks stay before the merged text. */
+	selection_start = gtk_text_buffer_create_mark (buffer, NULL, start, TRUE);
+	sorted_start = gtk_text_buffer_create_mark (buffer, NULL, end, TRUE);
 
-	if (!gtk_text_iter_ends_line (&start))
-		gtk_text_iter_forward_to_line_end (&end);
+	output.buffer = buffer;
+	output.iter = *end;
 
-	ret= gtk_text_buffer_get_slice (buf,
-					&start,
-					&end,
-					TRUE);
+	ret = gedit_sort_runs_merge (runs,
+				     sort_info->remove_duplicates,
+				     insert_merged_text,
+				     &output,
+				     error);
 
-	g_assert (ret != NULL);
+	gtk_text_buffer_get_iter_at_mark (buffer, &iter, sorted_start);
+
+	if (ret)
+	{
+		/* Delete the unsorted lines. */
+		gtk_text_buffer_get_iter_at_mark (buffer, start, selection_start);
+		gtk_text_buffer_delete (buffer, start, &iter);
+	}
+	else
+	{
+		/* Delete what has been merged so far. */
+		gtk_text_buffer_delete (buffer, &iter, &output.iter);
+	}
+
+	gtk_text_buffer_delete_mark (buffer, selection_start);
+	gtk_text_buffer_delete_mark (buffer, sorted_start);
+
+	gtk_text_buffer_end_user_action (buffer);
+
+	gedit_sort_runs_free (runs);
 
 	return ret;
 }
@@ -312,11 +600,11 @@ sort_real (GeditSortPlugin *plugin)
 	GeditDocument *doc;
 	GtkTextIter start, end;
 	gint start_line, end_line;
-	gint i;
 	gint num_lines;
-	gchar **lines;
+	gsize size;
+	gsize budget;
 	SortInfo *sort_info;
-	gchar *last_row = NULL;
+	GString *text;
 
 	gedit_debug (DEBUG_PLUGINS);
 
@@ -326,10 +614,10 @@ sort_real (GeditSortPlugin *plugin)
 	g_return_if_fail (doc != NULL);
 
 	sort_info = g_slice_new (SortInfo);
-	sort_info->ignore_case = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (priv->ignore_case_checkbutton));
-	sort_info->reverse_order = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (priv->reverse_order_checkbutton));
+	sort_info->options.ignore_case = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (priv->ignore_case_checkbutton));
+	sort_info->options.reverse_order = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (priv->reverse_order_checkbutton));
 	sort_info->remove_duplicates = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (priv->remove_dups_checkbutton));
-	sort_info->starting_column = gtk_spin_button_get_value_as_int (GTK_SPIN_BUTTON (priv->col_num_spinbutton)) - 1;
+	sort_info->options.starting_column = gtk_spin_button_get_value_as_int (GTK_SPIN_BUTTON (priv->col_num_spinbutton)) - 1;
 
 	start = priv->start;
 	end = priv->end;
@@ -349,60 +637,89 @@ sort_real (GeditSortPlugin *plugin)
 	}
 
 	num_lines = end_line - start_line + 1;
-	lines = g_new0 (gchar *, num_lines + 1);
-
-	gedit_debug_message (DEBUG_PLUGINS, "Building list...");
 
-	for (i = 0; i < num_lines; i++)
-	{
-		lines[i] = get_line_slice (GTK_TEXT_BUFFER (doc), start_line + i);
-	}
+	/* In characters, which is a lower bound of the size in bytes. */
+	size = gtk_text_iter_get_offset (&end) - gtk_text_iter_get_offset (&start) + 1;
 
-	lines[num_lines] = NULL;
+	budget = (gsize) g_settings_get_uint (priv->settings, "memory-budget") * 1024 * 1024;
 
-	gedit_debug_message (DEBUG_PLUGINS, "Sort list...");
+	if (gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (priv->unique_lines_checkbutton)))
+	{
+		gedit_debug_message (DEBUG_PLUGINS, "Keeping unique lines...");
 
-	g_qsort_with_data (lines,
-			   num_lines,
-			   sizeof (gpointer),
-			   compare_algorithm,
-			   sort_info);
+		text = get_unique_lines (GTK_TEXT_BUFFER (doc), start_line, num_lines, size);
+	}
+	else if (size * SORT_MEMORY_FACTOR > budget)
+	{
+		GError *error = NULL;
+
+		if (!external_sort (GTK_TEXT_BUFFER (doc),
+				    &start,
+				    &end,
+				    start_line,
+				    num_lines,
+				    budget / SORT_MEMORY_FACTOR,
+				    sort_info,
+				    &error))
+		{
+			gedit_warning (GTK_WINDOW (priv->window),
+				       _("Could not sort the lines: %s"),
+				       error->message);
+			g_error_free (error);
+		}
+
+		g_slice_free (SortInfo, sort_info);
+
+		gedit_debug_message (DEBUG_PLUGINS, "Done.");
+		return;
+	}
+	else
+	{
+		text = get_sorted_lines (GTK_TEXT_BUFFER (doc), start_line, num_lines, size, sort_info);
+	}
 
 	gedit_debug_message (DEBUG_PLUGINS, "Rebuilding document...");
 
-	gtk_source_buffer_begin_not_undoable_action (GTK_SOURCE_BUFFER (doc));
+	/* The result is inserted at once, so the insert-text handlers run only
+	 * once, and the sort can be undone in one step.
+	 */
+	gtk_text_buffer_begin_user_action (GTK_TEXT_BUFFER (doc));
 
 	gtk_text_buffer_delete (GTK_TEXT_BUFFER (doc),
 				&start,
 				&end);
 
-	for (i = 0; i < num_lines; i++)
-	{
-		if (sort_info->remove_duplicates &&
-		    last_row != NULL &&
-		    (strcmp (last_row, lines[i]) == 0))
-			continue;
-
-		gtk_text_buffer_insert (GTK_TEXT_BUFFER (doc),
-					&start,
-					lines[i],
-					-1);
-		gtk_text_buffer_insert (GTK_TEXT_BUFFER (doc),
-					&start,
-					"\n",
-					-1);
-
-		last_row = lines[i];
-	}
+	gtk_text_buffer_insert (GTK_TEXT_BUFFER (doc),
+				&start,
+				text->str,
+				text->len);
 
-	gtk_source_buffer_end_not_undoable_action (GTK_SOURCE_BUFFER (doc));
+	gtk_text_buffer_end_user_action (GTK_TEXT_BUFFER (doc));
 
-	g_strfreev (lines);
+	g_string_free (text, TRUE);
 	g_slice_free (SortInfo, sort_info);
 
 	gedit_debug_message (DEBUG_PLUGINS, "Done.");
 }
 
+static void
+unique_lines_toggled_cb (GtkToggleButton *button,
+			 GeditSortPlugin *plugin)
+{
+	GeditSortPluginPrivate *priv = plugin->priv;
+	gboolean sort;
+
+	/* The unique lines keep their order, so the sort options do not
+	 * apply.
+	 */
+	sort = !gtk_toggle_button_get_active (button);
+
+	gtk_widget_set_sensitive (priv->reverse_order_checkbutton, sort);
+	gtk_widget_set_sensitive (priv->remove_dups_checkbutton, sort);
+	gtk_widget_set_sensitive (priv->ignore_case_checkbutton, sort);
+	gtk_widget_set_sensitive (priv->col_num_spinbutton, sort);
+}
+
 static void
 update_ui (GeditSortPlugin *plugin)
 {
@@ -488,6 +805,7 @@ gedit_sort_plugin_init (GeditSortPlugin *plugin)
 	gedit_debug_message (DEBUG_PLUGINS, "GeditSortPlugin initializing");
 
 	plugin->priv = gedit_sort_plugin_get_instance_private (plugin);
+	plugin->priv->settings = g_settings_new (SORT_BASE_SETTINGS);
 }
 
 static void
@@ -501,6 +819,7 @@ gedit_sort_plugin_dispose (GObject *object)
 	g_clear_object (&plugin->priv->window);
 	g_clear_object (&plugin->priv->menu_ext);
 	g_clear_object (&plugin->priv->app);
+	g_clear_object (&plugin->priv->settings);
 
 	G_OBJECT_CLASS (gedit_sort_plugin_parent_class)->dispose (object);
 }
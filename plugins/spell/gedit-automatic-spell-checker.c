@@ -35,6 +35,15 @@
 #include "gedit-automatic-spell-checker.h"
 #include "gedit-spell-utils.h"
 
+/* A full recheck is done in idle chunks of at most RECHECK_CHUNK_LINES lines,
+ * for at most RECHECK_TIME_SLICE seconds per idle, the visible text first.
+ * The words of a chunk are checked by the worker thread of the spell
+ * checker, with at most MAX_PENDING_BATCHES chunks waiting for it.
+ */
+#define RECHECK_CHUNK_LINES	32
+#define RECHECK_TIME_SLICE	0.005
+#define MAX_PENDING_BATCHES	4
+
 struct _GeditAutomaticSpellChecker {
 	GeditDocument		*doc;
 	GSList 			*views;
@@ -46,13 +55,66 @@ struct _GeditAutomaticSpellChecker {
 	GtkTextTag 		*tag_highlight;
 	GtkTextMark		*mark_click;
 
+	/* The text still to be checked by the recheck is covered by
+	 * tag_unchecked, which has no effect on the display. Being a tag,
+	 * it follows the edits of the buffer: deleted text is not checked,
+	 * and inserted text, which is checked right away, is not covered.
+	 * mark_recheck is where the walk through the rest of the buffer is.
+	 */
+	GtkTextTag		*tag_unchecked;
+	GtkTextMark		*mark_recheck;
+	guint			 recheck_idle_id;
+
+	/* Incremented at each change of the text or of the language, to
+	 * discard the results of the batches sent before.
+	 */
+	guint			 generation;
+	guint			 n_pending_batches;
+	GCancellable		*cancellable;
+
        	GeditSpellChecker	*spell_checker;
 };
 
+/* The words of a chunk of text sent to the worker thread. */
+typedef struct
+{
+	GeditAutomaticSpellChecker *spell;
+	GeditDocument *doc;
+	GCancellable *cancellable;
+	guint generation;
+
+	/* The bounds of the chunk, extended to whole words. */
+	GtkTextMark *start;
+	GtkTextMark *end;
+
+	/* WordSpan */
+	GArray *spans;
+} CheckBatch;
+
+typedef struct
+{
+	gint start;
+	gint end;
+} WordSpan;
+
+/* The suggestions being computed for a context menu. */
+typedef struct
+{
+	GeditAutomaticSpellChecker *spell;
+	GtkWidget *menu;
+	GtkWidget *placeholder;
+
+	/* Cancelled when the menu is destroyed. */
+	GCancellable *cancellable;
+	GCancellable *spell_cancellable;
+} SuggestionsRequest;
+
 static GQuark automatic_spell_checker_id = 0;
 static GQuark suggestion_id = 0;
 
 static void gedit_automatic_spell_checker_free_internal (GeditAutomaticSpellChecker *spell);
+static gboolean recheck_idle_cb (GeditAutomaticSpellChecker *spell);
+static void start_recheck (GeditAutomaticSpellChecker *spell);
 
 static void
 view_destroy (GeditView *view, GeditAutomaticSpellChecker *spell)
@@ -87,6 +149,32 @@ check_word (GeditAutomaticSpellChecker *spell, GtkTextIter *start, GtkTextIter *
 	g_free (word);
 }
 
+static void
+extend_to_words (GtkTextIter *start,
+		 GtkTextIter *end)
+{
+	if (gtk_text_iter_inside_word (end))
+		gtk_text_iter_forward_word_end (end);
+
+	if (!gtk_text_iter_starts_word (start))
+	{
+		if (gtk_text_iter_inside_word (start) ||
+		    gtk_text_iter_ends_word (start))
+		{
+			gtk_text_iter_backward_word_start (start);
+		}
+		else
+		{
+			/* if we're neither at the beginning nor inside a word,
+			 * me must be in some spaces.
+			 * skip forward to the beginning of the next word. */
+
+			if (gtk_text_iter_forward_word_end (start))
+				gtk_text_iter_backward_word_start (start);
+		}
+	}
+}
+
 static void
 check_range (GeditAutomaticSpellChecker *spell,
 	     GtkTextIter                 start,
@@ -108,26 +196,7 @@ check_range (GeditAutomaticSpellChecker *spell,
 						gtk_text_iter_get_offset (&end));
 	*/
 
-	if (gtk_text_iter_inside_word (&end))
-		gtk_text_iter_forward_word_end (&end);
-
-	if (!gtk_text_iter_starts_word (&start))
-	{
-		if (gtk_text_iter_inside_word (&start) ||
-		    gtk_text_iter_ends_word (&start))
-		{
-			gtk_text_iter_backward_word_start (&start);
-		}
-		else
-		{
-			/* if we're neither at the beginning nor inside a word,
-			 * me must be in some spaces.
-			 * skip forward to the beginning of the next word. */
-
-			if (gtk_text_iter_forward_word_end (&start))
-				gtk_text_iter_backward_word_start (&start);
-		}
-	}
+	extend_to_words (&start, &end);
 
 	gtk_text_buffer_get_iter_at_mark (GTK_TEXT_BUFFER (spell->doc),
 					  &cursor,
@@ -226,6 +295,8 @@ static void
 insert_text_before (GtkTextBuffer *buffer, GtkTextIter *iter,
 		gchar *text, gint len, GeditAutomaticSpellChecker *spell)
 {
+	spell->generation++;
+
 	gtk_text_buffer_move_mark (buffer, spell->mark_insert_start, iter);
 }
 
@@ -254,6 +325,8 @@ static void
 delete_range_after (GtkTextBuffer *buffer, GtkTextIter *start, GtkTextIter *end,
 		GeditAutomaticSpellChecker *spell)
 {
+	spell->generation++;
+
 	check_range (spell, *start, *end, FALSE);
 }
 
@@ -389,19 +462,19 @@ replace_word (GtkWidget *menuitem, GeditAutomaticSpellChecker *spell)
 	g_free (oldword);
 }
 
-static GtkWidget *
-build_suggestion_menu (GeditAutomaticSpellChecker *spell, const gchar *word)
+/* Fills the suggestions in @topmenu, before the other items. */
+static void
+add_suggestions (GeditAutomaticSpellChecker *spell,
+		 GtkWidget                  *topmenu,
+		 GSList                     *suggestions)
 {
-	GtkWidget *topmenu, *menu;
+	GtkWidget *menu;
 	GtkWidget *mi;
-	GSList *suggestions;
 	GSList *list;
 	gchar *label_text;
+	gint position = 0;
 
-	topmenu = menu = gtk_menu_new();
-
-	suggestions = gedit_spell_checker_get_suggestions (spell->spell_checker, word, -1);
-
+	menu = topmenu;
 	list = suggestions;
 
 	if (suggestions == NULL)
@@ -431,11 +504,11 @@ build_suggestion_menu (GeditAutomaticSpellChecker *spell, const gchar *word)
 				/* Separator */
 				mi = gtk_separator_menu_item_new ();
 				gtk_widget_show (mi);
-				gtk_menu_shell_append (GTK_MENU_SHELL (menu), mi);
+				gtk_menu_shell_insert (GTK_MENU_SHELL (menu), mi, position++);
 
 				mi = gtk_menu_item_new_with_mnemonic (_("_More..."));
 				gtk_widget_show (mi);
-				gtk_menu_shell_append (GTK_MENU_SHELL (menu), mi);
+				gtk_menu_shell_insert (GTK_MENU_SHELL (menu), mi, position++);
 
 				menu = gtk_menu_new ();
 				gtk_menu_item_set_submenu (GTK_MENU_ITEM (mi), menu);
@@ -452,7 +525,11 @@ build_suggestion_menu (GeditAutomaticSpellChecker *spell, const gchar *word)
 			gtk_container_add (GTK_CONTAINER(mi), label);
 
 			gtk_widget_show_all (mi);
-			gtk_menu_shell_append (GTK_MENU_SHELL (menu), mi);
+
+			if (menu == topmenu)
+				gtk_menu_shell_insert (GTK_MENU_SHELL (menu), mi, position++);
+			else
+				gtk_menu_shell_append (GTK_MENU_SHELL (menu), mi);
 
 			g_object_set_qdata_full (G_OBJECT (mi),
 				 suggestion_id,
@@ -481,6 +558,104 @@ build_suggestion_menu (GeditAutomaticSpellChecker *spell, const gchar *word)
 	}
 
 	g_slist_free (suggestions);
+}
+
+static void
+suggestion_menu_destroyed (GtkWidget          *menu,
+			   SuggestionsRequest *request);
+
+static void
+suggestions_request_free (SuggestionsRequest *request)
+{
+	g_signal_handlers_disconnect_by_func (request->menu,
+					      suggestion_menu_destroyed,
+					      request);
+
+	g_object_unref (request->menu);
+	g_object_unref (request->placeholder);
+	g_object_unref (request->cancellable);
+	g_object_unref (request->spell_cancellable);
+	g_slice_free (SuggestionsRequest, request);
+}
+
+static void
+get_suggestions_cb (GeditSpellChecker  *checker,
+		    GAsyncResult       *result,
+		    SuggestionsRequest *request)
+{
+	GSList *suggestions;
+	GError *error = NULL;
+
+	suggestions = gedit_spell_checker_get_suggestions_finish (checker, result, &error);
+
+	/* The menu has been closed, or the automatic spell checker freed. */
+	if (g_cancellable_is_cancelled (request->cancellable) ||
+	    g_cancellable_is_cancelled (request->spell_cancellable))
+	{
+		g_slist_free_full (suggestions, g_free);
+		g_clear_error (&error);
+		suggestions_request_free (request);
+		return;
+	}
+
+	if (error != NULL)
+	{
+		g_warning ("Spell checker plugin: %s", error->message);
+		g_error_free (error);
+	}
+
+	gtk_widget_destroy (request->placeholder);
+
+	add_suggestions (request->spell, request->menu, suggestions);
+
+	suggestions_request_free (request);
+}
+
+static void
+suggestion_menu_destroyed (GtkWidget          *menu,
+			   SuggestionsRequest *request)
+{
+	g_cancellable_cancel (request->cancellable);
+}
+
+/* The menu is shown right away, and the suggestions, which can take a while
+ * to compute with big dictionaries, are added when they are ready.
+ */
+static GtkWidget *
+build_suggestion_menu (GeditAutomaticSpellChecker *spell, const gchar *word)
+{
+	GtkWidget *topmenu;
+	GtkWidget *mi;
+	GtkWidget *label;
+	SuggestionsRequest *request;
+
+	topmenu = gtk_menu_new();
+
+	label = gtk_label_new (_("(looking for suggestions...)"));
+
+	mi = gtk_menu_item_new ();
+	gtk_widget_set_sensitive (mi, FALSE);
+	gtk_container_add (GTK_CONTAINER(mi), label);
+	gtk_widget_show_all (mi);
+	gtk_menu_shell_append (GTK_MENU_SHELL (topmenu), mi);
+
+	request = g_slice_new (SuggestionsRequest);
+	request->spell = spell;
+	request->menu = g_object_ref (topmenu);
+	request->placeholder = g_object_ref (mi);
+	request->cancellable = g_cancellable_new ();
+	request->spell_cancellable = g_object_ref (spell->cancellable);
+
+	g_signal_connect (topmenu,
+			  "destroy",
+			  G_CALLBACK (suggestion_menu_destroyed),
+			  request);
+
+	gedit_spell_checker_get_suggestions_async (spell->spell_checker,
+						   word,
+						   request->cancellable,
+						   (GAsyncReadyCallback) get_suggestions_cb,
+						   request);
 
 	/* Separator */
 	mi = gtk_separator_menu_item_new ();
@@ -561,9 +736,329 @@ gedit_automatic_spell_checker_recheck_all (GeditAutomaticSpellChecker *spell)
 
 	g_return_if_fail (spell != NULL);
 
+	/* The check of a big document would block for a long time, so the
+	 * text is only marked as unchecked here. Work left from a previous
+	 * recheck is simply restarted.
+	 */
 	gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (spell->doc), &start, &end);
 
-	check_range (spell, start, end, TRUE);
+	gtk_text_buffer_apply_tag (GTK_TEXT_BUFFER (spell->doc),
+				   spell->tag_unchecked,
+				   &start,
+				   &end);
+
+	gtk_text_buffer_move_mark (GTK_TEXT_BUFFER (spell->doc),
+				   spell->mark_recheck,
+				   &start);
+
+	/* The batches being checked may use the previous language. */
+	spell->generation++;
+
+	start_recheck (spell);
+}
+
+/* Finds the first chunk of unchecked text between @start and @limit. */
+static gboolean
+get_unchecked_chunk (GeditAutomaticSpellChecker *spell,
+		     GtkTextIter                *start,
+		     GtkTextIter                *end,
+		     const GtkTextIter          *limit)
+{
+	GtkTextIter chunk_end;
+
+	if (!gtk_text_iter_has_tag (start, spell->tag_unchecked))
+	{
+		gtk_text_iter_forward_to_tag_toggle (start, spell->tag_unchecked);
+	}
+
+	if (gtk_text_iter_compare (start, limit) >= 0)
+	{
+		return FALSE;
+	}
+
+	*end = *start;
+	gtk_text_iter_forward_to_tag_toggle (end, spell->tag_unchecked);
+
+	if (gtk_text_iter_compare (end, limit) > 0)
+	{
+		*end = *limit;
+	}
+
+	/* Whole lines, so that the words are not split. */
+	chunk_end = *start;
+	gtk_text_iter_forward_lines (&chunk_end, RECHECK_CHUNK_LINES);
+
+	if (gtk_text_iter_compare (&chunk_end, end) < 0)
+	{
+		*end = chunk_end;
+	}
+
+	return TRUE;
+}
+
+static void
+check_batch_free (CheckBatch *batch)
+{
+	gtk_text_buffer_delete_mark (GTK_TEXT_BUFFER (batch->doc), batch->start);
+	gtk_text_buffer_delete_mark (GTK_TEXT_BUFFER (batch->doc), batch->end);
+
+	g_array_unref (batch->spans);
+	g_object_unref (batch->cancellable);
+	g_object_unref (batch->doc);
+	g_slice_free (CheckBatch, batch);
+}
+
+static void
+check_words_cb (GeditSpellChecker *checker,
+		GAsyncResult      *result,
+		CheckBatch        *batch)
+{
+	GeditAutomaticSpellChecker *spell;
+	GtkTextBuffer *buffer;
+	GtkTextIter start, end;
+	GArray *misspelled;
+	GError *error = NULL;
+	guint i;
+
+	misspelled = gedit_spell_checker_check_words_finish (checker, result, &error);
+
+	/* The automatic spell checker has been freed. */
+	if (g_cancellable_is_cancelled (batch->cancellable))
+	{
+		g_clear_error (&error);
+		g_clear_pointer (&misspelled, g_array_unref);
+		check_batch_free (batch);
+		return;
+	}
+
+	spell = batch->spell;
+	buffer = GTK_TEXT_BUFFER (spell->doc);
+	spell->n_pending_batches--;
+
+	gtk_text_buffer_get_iter_at_mark (buffer, &start, batch->start);
+	gtk_text_buffer_get_iter_at_mark (buffer, &end, batch->end);
+
+	if (error != NULL)
+	{
+		g_warning ("Spell checker plugin: %s", error->message);
+		g_error_free (error);
+	}
+	else if (batch->generation != spell->generation)
+	{
+		/* The offsets of the words are no longer valid, the chunk
+		 * has to be checked again.
+		 */
+		gtk_text_buffer_apply_tag (buffer, spell->tag_unchecked, &start, &end);
+
+		gtk_text_buffer_get_iter_at_mark (buffer, &end, spell->mark_recheck);
+
+		if (gtk_text_iter_compare (&start, &end) < 0)
+		{
+			gtk_text_buffer_move_mark (buffer, spell->mark_recheck, &start);
+		}
+	}
+	else
+	{
+		gtk_text_buffer_remove_tag (buffer, spell->tag_highlight, &start, &end);
+
+		for (i = 0; i < misspelled->len; i++)
+		{
+			guint index = g_array_index (misspelled, guint, i);
+			WordSpan *span = &g_array_index (batch->spans, WordSpan, index);
+			GtkTextIter wstart, wend;
+
+			gtk_text_buffer_get_iter_at_offset (buffer, &wstart, span->start);
+			gtk_text_buffer_get_iter_at_offset (buffer, &wend, span->end);
+
+			/* Confirmed here, for the words of the session. */
+			check_word (spell, &wstart, &wend);
+		}
+	}
+
+	g_clear_pointer (&misspelled, g_array_unref);
+	check_batch_free (batch);
+
+	start_recheck (spell);
+}
+
+/* Sends the words from @start to @end to the worker thread. */
+static void
+send_batch (GeditAutomaticSpellChecker *spell,
+	    GtkTextIter                 start,
+	    GtkTextIter                 end)
+{
+	GtkTextBuffer *buffer = GTK_TEXT_BUFFER (spell->doc);
+	CheckBatch *batch;
+	GPtrArray *words;
+	GtkTextIter wstart;
+	GtkTextIter wend;
+
+	extend_to_words (&start, &end);
+
+	/* See check_range(). */
+	if (gtk_text_iter_get_offset (&start) == 0)
+	{
+		gtk_text_iter_forward_word_end (&start);
+		gtk_text_iter_backward_word_start (&start);
+	}
+
+	batch = g_slice_new (CheckBatch);
+	batch->spell = spell;
+	batch->doc = g_object_ref (spell->doc);
+	batch->cancellable = g_object_ref (spell->cancellable);
+	batch->generation = spell->generation;
+	batch->start = gtk_text_buffer_create_mark (buffer, NULL, &start, TRUE);
+	batch->end = gtk_text_buffer_create_mark (buffer, NULL, &end, FALSE);
+	batch->spans = g_array_new (FALSE, FALSE, sizeof (WordSpan));
+
+	words = g_ptr_array_new ();
+
+	wstart = start;
+
+	while (gedit_spell_utils_skip_no_spell_check (&wstart, &end) &&
+	       gtk_text_iter_compare (&wstart, &end) < 0)
+	{
+		WordSpan span;
+
+		wend = wstart;
+		gtk_text_iter_forward_word_end (&wend);
+
+		span.start = gtk_text_iter_get_offset (&wstart);
+		span.end = gtk_text_iter_get_offset (&wend);
+		g_array_append_val (batch->spans, span);
+
+		g_ptr_array_add (words, gtk_text_buffer_get_text (buffer, &wstart, &wend, FALSE));
+
+		gtk_text_iter_forward_word_end (&wend);
+		gtk_text_iter_backward_word_start (&wend);
+
+		if (gtk_text_iter_equal (&wstart, &wend))
+			break;
+
+		wstart = wend;
+	}
+
+	g_ptr_array_add (words, NULL);
+
+	spell->n_pending_batches++;
+
+	gedit_spell_checker_check_words_async (spell->spell_checker,
+					       (gchar **) g_ptr_array_free (words, FALSE),
+					       spell->cancellable,
+					       (GAsyncReadyCallback) check_words_cb,
+					       batch);
+}
+
+/* Sends the unchecked text from @iter to @limit to the worker thread, until
+ * the time slice is over or enough batches are pending. Returns FALSE if
+ * everything was sent, otherwise @iter is where to continue.
+ */
+static gboolean
+send_unchecked_text (GeditAutomaticSpellChecker *spell,
+		     GtkTextIter                *iter,
+		     const GtkTextIter          *limit,
+		     GTimer                     *timer)
+{
+	while (g_timer_elapsed (timer, NULL) < RECHECK_TIME_SLICE &&
+	       spell->n_pending_batches < MAX_PENDING_BATCHES)
+	{
+		GtkTextIter start = *iter;
+		GtkTextIter end;
+
+		if (!get_unchecked_chunk (spell, &start, &end, limit))
+		{
+			*iter = *limit;
+			return FALSE;
+		}
+
+		gtk_text_buffer_remove_tag (GTK_TEXT_BUFFER (spell->doc),
+					    spell->tag_unchecked,
+					    &start,
+					    &end);
+
+		send_batch (spell, start, end);
+
+		*iter = end;
+	}
+
+	return TRUE;
+}
+
+static void
+get_visible_bounds (GtkTextView *view,
+		    GtkTextIter *start,
+		    GtkTextIter *end)
+{
+	GdkRectangle visible_rect;
+
+	gtk_text_view_get_visible_rect (view, &visible_rect);
+
+	gtk_text_view_get_line_at_y (view, start, visible_rect.y, NULL);
+	gtk_text_view_get_line_at_y (view,
+				     end,
+				     visible_rect.y + visible_rect.height,
+				     NULL);
+
+	gtk_text_iter_forward_line (end);
+}
+
+static gboolean
+recheck_idle_cb (GeditAutomaticSpellChecker *spell)
+{
+	GtkTextBuffer *buffer = GTK_TEXT_BUFFER (spell->doc);
+	GtkTextIter iter, end;
+	GTimer *timer;
+	GSList *l;
+	gboolean more = FALSE;
+
+	timer = g_timer_new ();
+
+	/* The visible text is looked up at each idle, so what the user
+	 * scrolls to is checked next.
+	 */
+	for (l = spell->views; l != NULL; l = g_slist_next (l))
+	{
+		get_visible_bounds (GTK_TEXT_VIEW (l->data), &iter, &end);
+
+		more = send_unchecked_text (spell, &iter, &end, timer);
+
+		if (more)
+		{
+			break;
+		}
+	}
+
+	if (!more)
+	{
+		gtk_text_buffer_get_iter_at_mark (buffer, &iter, spell->mark_recheck);
+		gtk_text_buffer_get_end_iter (buffer, &end);
+
+		more = send_unchecked_text (spell, &iter, &end, timer);
+
+		gtk_text_buffer_move_mark (buffer, spell->mark_recheck, &iter);
+	}
+
+	g_timer_destroy (timer);
+
+	/* When the worker is busy, the idle is started again by the
+	 * callback of the batches.
+	 */
+	if (more && spell->n_pending_batches < MAX_PENDING_BATCHES)
+	{
+		return G_SOURCE_CONTINUE;
+	}
+
+	spell->recheck_idle_id = 0;
+	return G_SOURCE_REMOVE;
+}
+
+static void
+start_recheck (GeditAutomaticSpellChecker *spell)
+{
+	if (spell->recheck_idle_id == 0)
+	{
+		spell->recheck_idle_id = g_idle_add ((GSourceFunc) recheck_idle_cb, spell);
+	}
 }
 
 static void
@@ -689,6 +1184,11 @@ highlight_updated (GtkSourceBuffer            *buffer,
                    GeditAutomaticSpellChecker *spell)
 {
 	check_range (spell, *start, *end, FALSE);
+
+	gtk_text_buffer_remove_tag (GTK_TEXT_BUFFER (buffer),
+				    spell->tag_unchecked,
+				    start,
+				    end);
 }
 
 static void
@@ -698,6 +1198,13 @@ spell_tag_destroyed (GeditAutomaticSpellChecker *spell,
 	spell->tag_highlight = NULL;
 }
 
+static void
+unchecked_tag_destroyed (GeditAutomaticSpellChecker *spell,
+			 GObject                    *where_the_object_was)
+{
+	spell->tag_unchecked = NULL;
+}
+
 GeditAutomaticSpellChecker *
 gedit_automatic_spell_checker_new (GeditDocument     *doc,
 				   GeditSpellChecker *checker)
@@ -716,6 +1223,7 @@ gedit_automatic_spell_checker_new (GeditDocument     *doc,
 
 	spell->doc = doc;
 	spell->spell_checker = g_object_ref (checker);
+	spell->cancellable = g_cancellable_new ();
 
 	if (automatic_spell_checker_id == 0)
 	{
@@ -771,6 +1279,15 @@ gedit_automatic_spell_checker_new (GeditDocument     *doc,
 			  G_CALLBACK (set_language_cb),
 			  spell);
 
+	/* Created first, so that the highlight has the highest priority. */
+	spell->tag_unchecked = gtk_text_buffer_create_tag (GTK_TEXT_BUFFER (doc),
+							   NULL,
+							   NULL);
+
+	g_object_weak_ref (G_OBJECT (spell->tag_unchecked),
+			   (GWeakNotify)unchecked_tag_destroyed,
+			   spell);
+
 	spell->tag_highlight = gtk_text_buffer_create_tag (
 				GTK_TEXT_BUFFER (doc),
 				"gtkspell-misspelled",
@@ -857,6 +1374,24 @@ gedit_automatic_spell_checker_new (GeditDocument     *doc,
 					   &start);
 	}
 
+	spell->mark_recheck = gtk_text_buffer_get_mark (GTK_TEXT_BUFFER (doc),
+					"gedit-automatic-spell-checker-recheck");
+
+	if (spell->mark_recheck == NULL)
+	{
+		spell->mark_recheck =
+			gtk_text_buffer_create_mark (GTK_TEXT_BUFFER (doc),
+						     "gedit-automatic-spell-checker-recheck",
+						     &start,
+						     TRUE);
+	}
+	else
+	{
+		gtk_text_buffer_move_mark (GTK_TEXT_BUFFER (doc),
+					   spell->mark_recheck,
+					   &start);
+	}
+
 	spell->deferred_check = FALSE;
 
 	return spell;
@@ -894,8 +1429,22 @@ gedit_automatic_spell_checker_free_internal (GeditAutomaticSpellChecker *spell)
 
 	g_return_if_fail (spell != NULL);
 
+	if (spell->recheck_idle_id != 0)
+	{
+		g_source_remove (spell->recheck_idle_id);
+	}
+
+	/* The pending batches are freed by their callback. */
+	g_cancellable_cancel (spell->cancellable);
+	g_object_unref (spell->cancellable);
+
 	table = gtk_text_buffer_get_tag_table (GTK_TEXT_BUFFER (spell->doc));
 
+	if (table != NULL && spell->tag_unchecked != NULL)
+	{
+		gtk_text_tag_table_remove (table, spell->tag_unchecked);
+	}
+
 	if (table != NULL && spell->tag_highlight != NULL)
 	{
 		gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (spell->doc),
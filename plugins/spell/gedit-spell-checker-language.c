@@ -32,11 +32,13 @@
 #include "gedit-spell-osx.h"
 #endif
 
+#include <errno.h>
 #include <string.h>
 
 #include <enchant.h>
 
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 #include <libxml/xmlreader.h>
 
 #include "gedit-spell-checker-language.h"
@@ -46,6 +48,24 @@
 #define ISO_639_DOMAIN	"iso_639"
 #define ISO_3166_DOMAIN	"iso_3166"
 
+/* The list of languages is cached, since building it means parsing the
+ * iso-codes files and loading every enchant provider. The cache file starts
+ * with a magic string including the version of the format, then come the
+ * language names used for the translations, the modification times of the
+ * files and directories the list depends on, and the languages, sorted.
+ * The numbers are in host byte order, the file is not shared between
+ * machines.
+ */
+#define LANGUAGES_CACHE_FILE		"spell-languages.cache"
+#define LANGUAGES_CACHE_MAGIC		"GEDITSL1"
+#define LANGUAGES_CACHE_MAGIC_LENGTH	8
+
+typedef struct
+{
+	const gchar *pos;
+	const gchar *end;
+} CacheReader;
+
 struct _GeditSpellCheckerLanguage
 {
 	gchar *abrev;
@@ -53,6 +73,7 @@ struct _GeditSpellCheckerLanguage
 };
 
 static gboolean available_languages_initialized = FALSE;
+static gboolean available_languages_from_cache = FALSE;
 static GSList *available_languages = NULL;
 
 static GHashTable *iso_639_table = NULL;
@@ -420,38 +441,364 @@ lang_cmp (const GeditSpellCheckerLanguage *a,
 }
 
 static gboolean
-build_langs_list (const gchar *key,
-		  const gchar *value,
-		  gpointer     data)
+build_langs_list (const gchar  *key,
+		  const gchar  *value,
+		  GSList      **languages)
 {
 	GeditSpellCheckerLanguage *lang = g_new (GeditSpellCheckerLanguage, 1);
 
 	lang->abrev = g_strdup (key);
 	lang->name = g_strdup (value);
 
-	available_languages = g_slist_insert_sorted (available_languages,
-						     lang,
-						     (GCompareFunc)lang_cmp);
+	*languages = g_slist_insert_sorted (*languages,
+					    lang,
+					    (GCompareFunc)lang_cmp);
 
 	return FALSE;
 }
 
-const GSList *
-gedit_spell_checker_get_available_languages (void)
+static gchar *
+get_languages_cache_filename (void)
 {
-	EnchantBroker *broker;
-	GTree *dicts;
+	return g_build_filename (g_get_user_cache_dir (),
+				 "gedit",
+				 LANGUAGES_CACHE_FILE,
+				 NULL);
+}
 
-	if (available_languages_initialized)
-		return available_languages;
+/* The files and directories whose changes invalidate the cache: the
+ * iso-codes files, the enchant providers, and the usual directories of the
+ * dictionaries. A dictionary installed elsewhere is found by
+ * gedit_spell_checker_language_from_key().
+ */
+static GPtrArray *
+get_stamp_paths (void)
+{
+	const gchar * const *data_dirs;
+	const gchar *lib_dirs[] = { ENCHANT_LIBDIR, "/usr/lib" };
+	GPtrArray *paths;
+	gint i;
 
-	g_return_val_if_fail (available_languages == NULL, NULL);
+	paths = g_ptr_array_new_with_free_func (g_free);
 
-	available_languages_initialized = TRUE;
+	g_ptr_array_add (paths, get_iso_codes_xml_name (639));
+	g_ptr_array_add (paths, get_iso_codes_xml_name (3166));
+
+	g_ptr_array_add (paths, g_build_filename (g_get_user_config_dir (), "enchant", NULL));
+	g_ptr_array_add (paths, g_build_filename (g_get_home_dir (), ".enchant", NULL));
+
+	/* The enchant modules, and the aspell dictionaries, which are in the
+	 * library directory, or in /usr/lib on multiarch systems.
+	 */
+	g_ptr_array_add (paths, g_build_filename (ENCHANT_LIBDIR, "enchant", NULL));
+
+	for (i = 0; i < (gint) G_N_ELEMENTS (lib_dirs); i++)
+	{
+		if (i > 0 && g_strcmp0 (lib_dirs[i], lib_dirs[0]) == 0)
+		{
+			continue;
+		}
+
+		g_ptr_array_add (paths, g_build_filename (lib_dirs[i], "aspell", NULL));
+		g_ptr_array_add (paths, g_build_filename (lib_dirs[i], "aspell-0.60", NULL));
+	}
+
+	data_dirs = g_get_system_data_dirs ();
+
+	for (i = 0; data_dirs[i] != NULL; i++)
+	{
+		g_ptr_array_add (paths, g_build_filename (data_dirs[i], "enchant", NULL));
+		g_ptr_array_add (paths, g_build_filename (data_dirs[i], "hunspell", NULL));
+		g_ptr_array_add (paths, g_build_filename (data_dirs[i], "myspell", NULL));
+		g_ptr_array_add (paths, g_build_filename (data_dirs[i], "myspell", "dicts", NULL));
+	}
+
+	return paths;
+}
+
+/* -1 if the file doesn't exist. */
+static gint64
+get_mtime (const gchar *path)
+{
+	GStatBuf buf;
+
+	if (g_stat (path, &buf) != 0)
+	{
+		return -1;
+	}
+
+	return buf.st_mtime;
+}
+
+/* The names of the languages depend on the translations in use. */
+static gchar *
+get_translations_key (void)
+{
+	return g_strjoinv (":", (gchar **) g_get_language_names ());
+}
+
+static void
+append_uint32 (GString *contents,
+	       guint32  value)
+{
+	g_string_append_len (contents, (const gchar *)&value, sizeof (guint32));
+}
+
+static void
+append_string (GString     *contents,
+	       const gchar *str)
+{
+	guint32 length = strlen (str);
+
+	append_uint32 (contents, length);
+	g_string_append_len (contents, str, length);
+}
+
+static gboolean
+read_bytes (CacheReader *reader,
+	    gpointer     dest,
+	    gsize        length)
+{
+	if ((gsize) (reader->end - reader->pos) < length)
+	{
+		return FALSE;
+	}
+
+	memcpy (dest, reader->pos, length);
+	reader->pos += length;
+
+	return TRUE;
+}
+
+/* Returns TRUE if the next string of @reader is @str. */
+static gboolean
+read_string_equal (CacheReader *reader,
+		   const gchar *str)
+{
+	guint32 length;
+
+	if (!read_bytes (reader, &length, sizeof (guint32)) ||
+	    (gsize) (reader->end - reader->pos) < length)
+	{
+		return FALSE;
+	}
+
+	reader->pos += length;
+
+	return length == strlen (str) && memcmp (reader->pos - length, str, length) == 0;
+}
+
+static gboolean
+read_string (CacheReader  *reader,
+	     gchar       **str)
+{
+	guint32 length;
+
+	if (!read_bytes (reader, &length, sizeof (guint32)) ||
+	    (gsize) (reader->end - reader->pos) < length)
+	{
+		return FALSE;
+	}
+
+	*str = g_strndup (reader->pos, length);
+	reader->pos += length;
+
+	return TRUE;
+}
+
+static const GeditSpellCheckerLanguage *
+find_language (const GSList *languages,
+	       const gchar  *key)
+{
+	const GSList *l;
+
+	for (l = languages; l != NULL; l = g_slist_next (l))
+	{
+		const GeditSpellCheckerLanguage *lang = l->data;
+
+		if (g_ascii_strcasecmp (key, lang->abrev) == 0)
+			return lang;
+	}
+
+	return NULL;
+}
+
+static void
+free_languages (GSList *languages)
+{
+	GSList *l;
+
+	for (l = languages; l != NULL; l = g_slist_next (l))
+	{
+		GeditSpellCheckerLanguage *lang = l->data;
+
+		g_free (lang->abrev);
+		g_free (lang->name);
+		g_free (lang);
+	}
+
+	g_slist_free (languages);
+}
+
+static gboolean
+read_languages_cache (GPtrArray  *stamp_paths,
+		      GSList    **languages)
+{
+	GMappedFile *mapped_file;
+	CacheReader reader;
+	gchar *filename;
+	gchar *translations_key;
+	guint32 n_stamps;
+	guint32 n_languages;
+	GSList *list = NULL;
+	gboolean valid;
+	guint i;
+
+	filename = get_languages_cache_filename ();
+	mapped_file = g_mapped_file_new (filename, FALSE, NULL);
+	g_free (filename);
+
+	if (mapped_file == NULL)
+	{
+		return FALSE;
+	}
+
+	reader.pos = g_mapped_file_get_contents (mapped_file);
+	reader.end = reader.pos + g_mapped_file_get_length (mapped_file);
+
+	translations_key = get_translations_key ();
+
+	valid = (gsize) (reader.end - reader.pos) >= LANGUAGES_CACHE_MAGIC_LENGTH &&
+		memcmp (reader.pos, LANGUAGES_CACHE_MAGIC, LANGUAGES_CACHE_MAGIC_LENGTH) == 0;
+
+	if (valid)
+	{
+		reader.pos += LANGUAGES_CACHE_MAGIC_LENGTH;
+
+		valid = read_string_equal (&reader, translations_key) &&
+			read_bytes (&reader, &n_stamps, sizeof (guint32)) &&
+			n_stamps == stamp_paths->len;
+	}
+
+	g_free (translations_key);
+
+	for (i = 0; valid && i < stamp_paths->len; i++)
+	{
+		const gchar *path = g_ptr_array_index (stamp_paths, i);
+		gint64 mtime;
+
+		valid = read_string_equal (&reader, path) &&
+			read_bytes (&reader, &mtime, sizeof (gint64)) &&
+			mtime == get_mtime (path);
+	}
+
+	valid = valid && read_bytes (&reader, &n_languages, sizeof (guint32));
+
+	for (i = 0; valid && i < n_languages; i++)
+	{
+		GeditSpellCheckerLanguage *lang = g_new0 (GeditSpellCheckerLanguage, 1);
+
+		list = g_slist_prepend (list, lang);
+
+		valid = read_string (&reader, &lang->abrev) &&
+			read_string (&reader, &lang->name);
+	}
+
+	g_mapped_file_unref (mapped_file);
+
+	if (!valid)
+	{
+		free_languages (list);
+		return FALSE;
+	}
+
+	*languages = g_slist_reverse (list);
+
+	return TRUE;
+}
+
+/* @mtimes are the modification times of @stamp_paths before the languages
+ * were listed, so that a change during the listing invalidates the cache.
+ */
+static void
+write_languages_cache (GPtrArray    *stamp_paths,
+		       const gint64 *mtimes,
+		       const GSList *languages)
+{
+	GString *contents;
+	gchar *filename;
+	gchar *dirname;
+	gchar *translations_key;
+	GError *error = NULL;
+	const GSList *l;
+	guint i;
+
+	contents = g_string_new (LANGUAGES_CACHE_MAGIC);
+
+	translations_key = get_translations_key ();
+	append_string (contents, translations_key);
+	g_free (translations_key);
+
+	append_uint32 (contents, stamp_paths->len);
+
+	for (i = 0; i < stamp_paths->len; i++)
+	{
+		append_string (contents, g_ptr_array_index (stamp_paths, i));
+		g_string_append_len (contents, (const gchar *)&mtimes[i], sizeof (gint64));
+	}
+
+	append_uint32 (contents, g_slist_length ((GSList *) languages));
+
+	for (l = languages; l != NULL; l = g_slist_next (l))
+	{
+		const GeditSpellCheckerLanguage *lang = l->data;
+
+		append_string (contents, lang->abrev);
+		append_string (contents, lang->name);
+	}
+
+	filename = get_languages_cache_filename ();
+	dirname = g_path_get_dirname (filename);
+
+	if (g_mkdir_with_parents (dirname, 0755) != 0 ||
+	    !g_file_set_contents (filename, contents->str, contents->len, &error))
+	{
+		gedit_debug_message (DEBUG_PLUGINS,
+				     "Could not write the languages cache '%s': %s",
+				     filename,
+				     error != NULL ? error->message : g_strerror (errno));
+
+		g_clear_error (&error);
+	}
+
+	g_free (dirname);
+	g_free (filename);
+	g_string_free (contents, TRUE);
+}
+
+/* Lists the languages of the installed dictionaries, and updates the
+ * cache.
+ */
+static GSList *
+list_languages (GPtrArray *stamp_paths)
+{
+	EnchantBroker *broker;
+	GTree *dicts;
+	GSList *languages = NULL;
+	gint64 *mtimes;
+	guint i;
 
 	broker = enchant_broker_init ();
+
 	g_return_val_if_fail (broker != NULL, NULL);
 
+	mtimes = g_new (gint64, stamp_paths->len);
+
+	for (i = 0; i < stamp_paths->len; i++)
+	{
+		mtimes[i] = get_mtime (g_ptr_array_index (stamp_paths, i));
+	}
+
 	/* Use a GTree to efficiently remove duplicates while building the list */
 	dicts = g_tree_new_full (key_cmp,
 				 NULL,
@@ -471,13 +818,77 @@ gedit_spell_checker_get_available_languages (void)
 	iso_639_table = NULL;
 	iso_3166_table = NULL;
 
-	g_tree_foreach (dicts, (GTraverseFunc)build_langs_list, NULL);
+	g_tree_foreach (dicts, (GTraverseFunc)build_langs_list, &languages);
 
 	g_tree_destroy (dicts);
 
+	write_languages_cache (stamp_paths, mtimes, languages);
+	g_free (mtimes);
+
+	return languages;
+}
+
+const GSList *
+gedit_spell_checker_get_available_languages (void)
+{
+	GPtrArray *stamp_paths;
+
+	if (available_languages_initialized)
+		return available_languages;
+
+	g_return_val_if_fail (available_languages == NULL, NULL);
+
+	available_languages_initialized = TRUE;
+
+	stamp_paths = get_stamp_paths ();
+
+	if (read_languages_cache (stamp_paths, &available_languages))
+	{
+		gedit_debug_message (DEBUG_PLUGINS, "Languages read from the cache");
+
+		available_languages_from_cache = TRUE;
+	}
+	else
+	{
+		available_languages = list_languages (stamp_paths);
+	}
+
+	g_ptr_array_unref (stamp_paths);
+
 	return available_languages;
 }
 
+/* Lists the languages again, without the cache. The languages already known
+ * are kept, since they may be in use, and the new ones are added.
+ */
+static void
+reload_available_languages (void)
+{
+	GPtrArray *stamp_paths;
+	GSList *languages;
+	GSList *l;
+
+	stamp_paths = get_stamp_paths ();
+	languages = list_languages (stamp_paths);
+	g_ptr_array_unref (stamp_paths);
+
+	for (l = languages; l != NULL; l = g_slist_next (l))
+	{
+		GeditSpellCheckerLanguage *lang = l->data;
+
+		if (find_language (available_languages, lang->abrev) == NULL)
+		{
+			available_languages = g_slist_insert_sorted (available_languages,
+								     lang,
+								     (GCompareFunc)lang_cmp);
+			l->data = NULL;
+		}
+	}
+
+	languages = g_slist_remove_all (languages, NULL);
+	free_languages (languages);
+}
+
 const gchar *
 gedit_spell_checker_language_to_string (const GeditSpellCheckerLanguage *lang)
 {
@@ -501,22 +912,28 @@ gedit_spell_checker_language_to_key (const GeditSpellCheckerLanguage *lang)
 const GeditSpellCheckerLanguage *
 gedit_spell_checker_language_from_key (const gchar *key)
 {
-	const GSList *langs;
+	const GeditSpellCheckerLanguage *lang;
 
 	g_return_val_if_fail (key != NULL, NULL);
 
-	langs = gedit_spell_checker_get_available_languages ();
+	lang = find_language (gedit_spell_checker_get_available_languages (), key);
 
-	while (langs != NULL)
+	/* The dictionary may have been installed in a directory that the cache
+	 * doesn't watch, so the cache can't be trusted for a missing language.
+	 * The languages are listed again only once, though.
+	 */
+	if (lang == NULL && available_languages_from_cache)
 	{
-		const GeditSpellCheckerLanguage *l = (const GeditSpellCheckerLanguage *)langs->data;
+		gedit_debug_message (DEBUG_PLUGINS,
+				     "Language '%s' not in the cache, listing the languages again",
+				     key);
 
-		if (g_ascii_strcasecmp (key, l->abrev) == 0)
-			return l;
+		available_languages_from_cache = FALSE;
+		reload_available_languages ();
 
-		langs = g_slist_next (langs);
+		lang = find_language (available_languages, key);
 	}
 
-	return NULL;
+	return lang;
 }
 /* ex:set ts=8 noet: */
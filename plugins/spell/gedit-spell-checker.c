@@ -29,6 +29,7 @@
 
 #include <glib/gi18n.h>
 #include <glib.h>
+#include <gio/gio.h>
 
 #include "gedit-spell-checker.h"
 #include "gedit-spell-utils.h"
@@ -38,6 +39,23 @@
 #include "gedit-spell-osx.h"
 #endif
 
+/* The number of words whose result is kept. It is enough for the
+ * vocabulary of most documents.
+ */
+#define WORD_CACHE_SIZE 8192
+
+/* The number of words whose suggestions are kept. */
+#define SUGGESTIONS_CACHE_SIZE 16
+
+typedef struct
+{
+	gchar *word;
+	gboolean correct;
+
+	/* Link in the LRU list, its data is the entry itself. */
+	GList lru_link;
+} CacheEntry;
+
 struct _GeditSpellChecker
 {
 	GObject parent_instance;
@@ -45,8 +63,57 @@ struct _GeditSpellChecker
 	EnchantDict                     *dict;
 	EnchantBroker                   *broker;
 	const GeditSpellCheckerLanguage *active_lang;
+
+	/* The results of enchant_dict_check() for the current dictionary.
+	 * word -> CacheEntry, the keys are owned by the entries.
+	 */
+	GHashTable                      *word_cache;
+
+	/* The most recently checked words first. */
+	GQueue                           lru;
+
+	guint                            cache_hits;
+	guint                            cache_misses;
+
+	/* SuggestionsEntry, the most recently requested words first. */
+	GQueue                           suggestions_cache;
+
+	/* Incremented each time the caches are cleared, to not cache the
+	 * results of the jobs started before.
+	 */
+	guint                            cache_serial;
+
+	/* The jobs of the async functions are run by a single thread, with
+	 * its own broker and dictionary, which are only used by this thread.
+	 */
+	GThreadPool                     *worker_pool;
+	EnchantBroker                   *worker_broker;
+	EnchantDict                     *worker_dict;
+	gchar                           *worker_language_key;
 };
 
+typedef struct
+{
+	gchar *word;
+	gchar **suggestions;
+} SuggestionsEntry;
+
+typedef void (* WorkerFunc) (GTask       *task,
+			     EnchantDict *dict);
+
+typedef struct
+{
+	GTask *task;
+	WorkerFunc func;
+	gchar *language_key;
+} WorkerJob;
+
+typedef struct
+{
+	gchar *word;
+	guint cache_serial;
+} SuggestionsData;
+
 /* GObject properties */
 enum {
 	PROP_0 = 0,
@@ -67,6 +134,85 @@ static guint signals[LAST_SIGNAL] = { 0 };
 
 G_DEFINE_TYPE(GeditSpellChecker, gedit_spell_checker, G_TYPE_OBJECT)
 
+static void
+cache_entry_free (CacheEntry *entry)
+{
+	g_free (entry->word);
+	g_slice_free (CacheEntry, entry);
+}
+
+static void
+suggestions_entry_free (SuggestionsEntry *entry)
+{
+	g_free (entry->word);
+	g_strfreev (entry->suggestions);
+	g_slice_free (SuggestionsEntry, entry);
+}
+
+/* Must be called each time the answers of the dictionary can change. */
+static void
+clear_caches (GeditSpellChecker *spell)
+{
+	g_hash_table_remove_all (spell->word_cache);
+	g_queue_init (&spell->lru);
+
+	g_queue_foreach (&spell->suggestions_cache, (GFunc) suggestions_entry_free, NULL);
+	g_queue_clear (&spell->suggestions_cache);
+
+	spell->cache_serial++;
+}
+
+static CacheEntry *
+lookup_word (GeditSpellChecker *spell,
+	     const gchar       *word)
+{
+	CacheEntry *entry;
+
+	entry = g_hash_table_lookup (spell->word_cache, word);
+
+	if (entry == NULL)
+	{
+		spell->cache_misses++;
+		return NULL;
+	}
+
+	spell->cache_hits++;
+
+	if (spell->lru.head != &entry->lru_link)
+	{
+		g_queue_unlink (&spell->lru, &entry->lru_link);
+		g_queue_push_head_link (&spell->lru, &entry->lru_link);
+	}
+
+	return entry;
+}
+
+static void
+cache_word (GeditSpellChecker *spell,
+	    const gchar       *word,
+	    gboolean           correct)
+{
+	CacheEntry *entry;
+
+	if (spell->lru.length >= WORD_CACHE_SIZE)
+	{
+		GList *last = g_queue_pop_tail_link (&spell->lru);
+
+		entry = last->data;
+		g_hash_table_remove (spell->word_cache, entry->word);
+	}
+
+	entry = g_slice_new (CacheEntry);
+	entry->word = g_strdup (word);
+	entry->correct = correct;
+	entry->lru_link.data = entry;
+	entry->lru_link.prev = NULL;
+	entry->lru_link.next = NULL;
+
+	g_hash_table_insert (spell->word_cache, entry->word, entry);
+	g_queue_push_head_link (&spell->lru, &entry->lru_link);
+}
+
 static void
 gedit_spell_checker_set_property (GObject *object,
 			   guint prop_id,
@@ -115,12 +261,29 @@ gedit_spell_checker_finalize (GObject *object)
 
 	spell_checker = GEDIT_SPELL_CHECKER (object);
 
+	/* Each pending job holds a reference, so the thread is idle. */
+	if (spell_checker->worker_pool != NULL)
+		g_thread_pool_free (spell_checker->worker_pool, FALSE, TRUE);
+
+	if (spell_checker->worker_dict != NULL)
+		enchant_broker_free_dict (spell_checker->worker_broker, spell_checker->worker_dict);
+
+	if (spell_checker->worker_broker != NULL)
+		enchant_broker_free (spell_checker->worker_broker);
+
+	g_free (spell_checker->worker_language_key);
+
+	g_queue_foreach (&spell_checker->suggestions_cache, (GFunc) suggestions_entry_free, NULL);
+	g_queue_clear (&spell_checker->suggestions_cache);
+
 	if (spell_checker->dict != NULL)
 		enchant_broker_free_dict (spell_checker->broker, spell_checker->dict);
 
 	if (spell_checker->broker != NULL)
 		enchant_broker_free (spell_checker->broker);
 
+	g_hash_table_destroy (spell_checker->word_cache);
+
 	G_OBJECT_CLASS (gedit_spell_checker_parent_class)->finalize (object);
 }
 
@@ -195,6 +358,13 @@ gedit_spell_checker_init (GeditSpellChecker *spell_checker)
 	spell_checker->broker = enchant_broker_init ();
 	spell_checker->dict = NULL;
 	spell_checker->active_lang = NULL;
+
+	spell_checker->word_cache = g_hash_table_new_full (g_str_hash,
+							   g_str_equal,
+							   NULL,
+							   (GDestroyNotify) cache_entry_free);
+	g_queue_init (&spell_checker->lru);
+	g_queue_init (&spell_checker->suggestions_cache);
 }
 
 GeditSpellChecker *
@@ -312,6 +482,8 @@ gedit_spell_checker_set_language (GeditSpellChecker               *spell,
 		spell->dict = NULL;
 	}
 
+	clear_caches (spell);
+
 	ret = lazy_init (spell, language);
 
 	if (ret)
@@ -341,6 +513,8 @@ gedit_spell_checker_check_word (GeditSpellChecker *spell,
 {
 	gint enchant_result;
 	gboolean res = FALSE;
+	gchar *nul_terminated = NULL;
+	CacheEntry *entry;
 
 	g_return_val_if_fail (GEDIT_IS_SPELL_CHECKER (spell), FALSE);
 	g_return_val_if_fail (word != NULL, FALSE);
@@ -358,6 +532,22 @@ gedit_spell_checker_check_word (GeditSpellChecker *spell,
 		return TRUE;
 
 	g_return_val_if_fail (spell->dict != NULL, FALSE);
+
+	/* The cache is keyed by nul-terminated strings. */
+	if (word[len] != '\0')
+	{
+		nul_terminated = g_strndup (word, len);
+		word = nul_terminated;
+	}
+
+	entry = lookup_word (spell, word);
+
+	if (entry != NULL)
+	{
+		g_free (nul_terminated);
+		return entry->correct;
+	}
+
 	enchant_result = enchant_dict_check (spell->dict, word, len);
 
 	switch (enchant_result)
@@ -373,18 +563,373 @@ gedit_spell_checker_check_word (GeditSpellChecker *spell,
 		case 1:
 			/* it is not in the directory */
 			res = FALSE;
+			cache_word (spell, word, res);
 			break;
 		case 0:
 			/* is is in the directory */
 			res = TRUE;
+			cache_word (spell, word, res);
 			break;
 		default:
+			g_free (nul_terminated);
 			g_return_val_if_reached (FALSE);
 	}
 
+	g_free (nul_terminated);
+
 	return res;
 }
 
+/**
+ * gedit_spell_checker_get_cache_stats:
+ * @spell: a #GeditSpellChecker.
+ * @hits: (out) (optional): the number of words found in the cache.
+ * @misses: (out) (optional): the number of words checked by the dictionary.
+ *
+ * Gets the counters of the cache of gedit_spell_checker_check_word(), since
+ * the creation of @spell.
+ */
+void
+gedit_spell_checker_get_cache_stats (GeditSpellChecker *spell,
+				     guint             *hits,
+				     guint             *misses)
+{
+	g_return_if_fail (GEDIT_IS_SPELL_CHECKER (spell));
+
+	if (hits != NULL)
+		*hits = spell->cache_hits;
+
+	if (misses != NULL)
+		*misses = spell->cache_misses;
+}
+
+/* Runs in the worker thread. */
+static void
+worker_thread (WorkerJob         *job,
+	       GeditSpellChecker *spell)
+{
+	if (g_task_return_error_if_cancelled (job->task))
+	{
+		goto out;
+	}
+
+	if (g_strcmp0 (spell->worker_language_key, job->language_key) != 0)
+	{
+		if (spell->worker_dict != NULL)
+		{
+			enchant_broker_free_dict (spell->worker_broker, spell->worker_dict);
+		}
+
+		if (spell->worker_broker == NULL)
+		{
+			spell->worker_broker = enchant_broker_init ();
+		}
+
+		spell->worker_dict = enchant_broker_request_dict (spell->worker_broker,
+								  job->language_key);
+
+		g_free (spell->worker_language_key);
+		spell->worker_language_key = g_strdup (job->language_key);
+	}
+
+	if (spell->worker_dict == NULL)
+	{
+		g_task_return_new_error (job->task,
+					 G_IO_ERROR,
+					 G_IO_ERROR_NOT_FOUND,
+					 "Cannot load the dictionary '%s'",
+					 job->language_key);
+		goto out;
+	}
+
+	job->func (job->task, spell->worker_dict);
+
+out:
+	g_object_unref (job->task);
+	g_free (job->language_key);
+	g_slice_free (WorkerJob, job);
+}
+
+/* Takes the reference of @task. */
+static void
+push_job (GeditSpellChecker *spell,
+	  GTask             *task,
+	  WorkerFunc         func)
+{
+	WorkerJob *job;
+
+	if (!lazy_init (spell, spell->active_lang))
+	{
+		g_task_return_new_error (task,
+					 G_IO_ERROR,
+					 G_IO_ERROR_NOT_FOUND,
+					 "No dictionary available");
+		g_object_unref (task);
+		return;
+	}
+
+	if (spell->worker_pool == NULL)
+	{
+		spell->worker_pool = g_thread_pool_new ((GFunc) worker_thread,
+							spell,
+							1,
+							FALSE,
+							NULL);
+	}
+
+	job = g_slice_new (WorkerJob);
+	job->task = task;
+	job->func = func;
+	job->language_key = g_strdup (gedit_spell_checker_language_to_key (spell->active_lang));
+
+	g_thread_pool_push (spell->worker_pool, job, NULL);
+}
+
+static void
+check_words_func (GTask       *task,
+		  EnchantDict *dict)
+{
+	gchar **words = g_task_get_task_data (task);
+	GArray *misspelled;
+	guint i;
+
+	misspelled = g_array_new (FALSE, FALSE, sizeof (guint));
+
+	for (i = 0; words[i] != NULL; i++)
+	{
+		/* Errors are reported as misspellings, they are confirmed by
+		 * the caller anyway.
+		 */
+		if (enchant_dict_check (dict, words[i], -1) != 0)
+		{
+			g_array_append_val (misspelled, i);
+		}
+	}
+
+	g_task_return_pointer (task, misspelled, (GDestroyNotify) g_array_unref);
+}
+
+/**
+ * gedit_spell_checker_check_words_async:
+ * @spell: a #GeditSpellChecker.
+ * @words: (transfer full): a %NULL-terminated array of words.
+ * @cancellable: a #GCancellable, or %NULL.
+ * @callback: the callback to call when the words are checked.
+ * @user_data: the data to pass to @callback.
+ *
+ * Checks @words with the dictionary of the current language, in a worker
+ * thread. The jobs are run one at a time, in order.
+ *
+ * The worker does not know the words added to the session, and the
+ * special cases of gedit_spell_checker_check_word(), so the words found
+ * misspelled should be confirmed with gedit_spell_checker_check_word(). As
+ * misspelled words are rare, this is cheap.
+ */
+void
+gedit_spell_checker_check_words_async (GeditSpellChecker   *spell,
+				       gchar              **words,
+				       GCancellable        *cancellable,
+				       GAsyncReadyCallback  callback,
+				       gpointer             user_data)
+{
+	GTask *task;
+
+	g_return_if_fail (GEDIT_IS_SPELL_CHECKER (spell));
+	g_return_if_fail (words != NULL);
+	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+	task = g_task_new (spell, cancellable, callback, user_data);
+	g_task_set_task_data (task, words, (GDestroyNotify) g_strfreev);
+
+	push_job (spell, task, check_words_func);
+}
+
+/**
+ * gedit_spell_checker_check_words_finish:
+ * @spell: a #GeditSpellChecker.
+ * @result: a #GAsyncResult.
+ * @error: a #GError, or %NULL.
+ *
+ * Returns: (transfer full): the indexes, as #guint, of the words not found
+ * in the dictionary, or %NULL on error.
+ */
+GArray *
+gedit_spell_checker_check_words_finish (GeditSpellChecker  *spell,
+					GAsyncResult       *result,
+					GError            **error)
+{
+	g_return_val_if_fail (g_task_is_valid (result, spell), NULL);
+
+	return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+static GSList *
+suggestions_to_list (gchar **suggestions)
+{
+	GSList *list = NULL;
+	gint i;
+
+	for (i = 0; suggestions[i] != NULL; i++)
+	{
+		list = g_slist_prepend (list, g_strdup (suggestions[i]));
+	}
+
+	return g_slist_reverse (list);
+}
+
+static void
+suggestions_data_free (SuggestionsData *data)
+{
+	g_free (data->word);
+	g_slice_free (SuggestionsData, data);
+}
+
+static void
+get_suggestions_func (GTask       *task,
+		      EnchantDict *dict)
+{
+	SuggestionsData *data = g_task_get_task_data (task);
+	gchar **suggestions;
+	gchar **ret;
+	size_t n_suggestions = 0;
+	size_t i;
+
+	suggestions = enchant_dict_suggest (dict, data->word, -1, &n_suggestions);
+
+	ret = g_new (gchar *, n_suggestions + 1);
+
+	for (i = 0; i < n_suggestions; i++)
+	{
+		ret[i] = suggestions[i];
+	}
+
+	ret[n_suggestions] = NULL;
+
+	/* The single suggestions are now owned by ret */
+	g_free (suggestions);
+
+	g_task_return_pointer (task, ret, (GDestroyNotify) g_strfreev);
+}
+
+/**
+ * gedit_spell_checker_get_suggestions_async:
+ * @spell: a #GeditSpellChecker.
+ * @word: the misspelled word.
+ * @cancellable: a #GCancellable, or %NULL.
+ * @callback: the callback to call when the suggestions are ready.
+ * @user_data: the data to pass to @callback.
+ *
+ * Asks the dictionary of the current language for the suggestions for
+ * @word, in the worker thread of @spell. The suggestions of the last words
+ * are cached.
+ */
+void
+gedit_spell_checker_get_suggestions_async (GeditSpellChecker   *spell,
+					   const gchar         *word,
+					   GCancellable        *cancellable,
+					   GAsyncReadyCallback  callback,
+					   gpointer             user_data)
+{
+	GTask *task;
+	SuggestionsData *data;
+	GList *l;
+
+	g_return_if_fail (GEDIT_IS_SPELL_CHECKER (spell));
+	g_return_if_fail (word != NULL);
+	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+	task = g_task_new (spell, cancellable, callback, user_data);
+
+	data = g_slice_new (SuggestionsData);
+	data->word = g_strdup (word);
+	data->cache_serial = spell->cache_serial;
+	g_task_set_task_data (task, data, (GDestroyNotify) suggestions_data_free);
+
+	for (l = spell->suggestions_cache.head; l != NULL; l = l->next)
+	{
+		SuggestionsEntry *entry = l->data;
+
+		if (strcmp (entry->word, word) == 0)
+		{
+			/* The callback is still called from an idle. */
+			g_task_return_pointer (task,
+					       g_strdupv (entry->suggestions),
+					       (GDestroyNotify) g_strfreev);
+			g_object_unref (task);
+			return;
+		}
+	}
+
+	push_job (spell, task, get_suggestions_func);
+}
+
+/**
+ * gedit_spell_checker_get_suggestions_finish:
+ * @spell: a #GeditSpellChecker.
+ * @result: a #GAsyncResult.
+ * @error: a #GError, or %NULL.
+ *
+ * Returns: the suggestions, to free like the ones of
+ * gedit_spell_checker_get_suggestions(). %NULL on error or if there is no
+ * suggestion.
+ */
+GSList *
+gedit_spell_checker_get_suggestions_finish (GeditSpellChecker  *spell,
+					    GAsyncResult       *result,
+					    GError            **error)
+{
+	SuggestionsData *data;
+	SuggestionsEntry *entry;
+	gchar **suggestions;
+	GSList *ret;
+	GList *l;
+
+	g_return_val_if_fail (g_task_is_valid (result, spell), NULL);
+
+	suggestions = g_task_propagate_pointer (G_TASK (result), error);
+
+	if (suggestions == NULL)
+	{
+		return NULL;
+	}
+
+	ret = suggestions_to_list (suggestions);
+
+	/* The suggestions can be stale if the dictionary changed since the
+	 * request.
+	 */
+	data = g_task_get_task_data (G_TASK (result));
+
+	if (data->cache_serial != spell->cache_serial)
+	{
+		g_strfreev (suggestions);
+		return ret;
+	}
+
+	for (l = spell->suggestions_cache.head; l != NULL; l = l->next)
+	{
+		entry = l->data;
+
+		if (strcmp (entry->word, data->word) == 0)
+		{
+			g_queue_delete_link (&spell->suggestions_cache, l);
+			suggestions_entry_free (entry);
+			break;
+		}
+	}
+
+	if (spell->suggestions_cache.length >= SUGGESTIONS_CACHE_SIZE)
+	{
+		suggestions_entry_free (g_queue_pop_tail (&spell->suggestions_cache));
+	}
+
+	entry = g_slice_new (SuggestionsEntry);
+	entry->word = g_strdup (data->word);
+	entry->suggestions = suggestions;
+	g_queue_push_head (&spell->suggestions_cache, entry);
+
+	return ret;
+}
 
 /* return NULL on error or if no suggestions are found */
 GSList *
@@ -447,6 +992,11 @@ gedit_spell_checker_add_word_to_personal (GeditSpellChecker *spell,
 
 	enchant_dict_add_to_pwl (spell->dict, word, len);
 
+	/* Other forms of the word, like its capitalized form, can be accepted
+	 * too now.
+	 */
+	clear_caches (spell);
+
 	g_signal_emit (G_OBJECT (spell), signals[ADD_WORD_TO_PERSONAL], 0, word, len);
 
 	return TRUE;
@@ -470,6 +1020,8 @@ gedit_spell_checker_add_word_to_session (GeditSpellChecker *spell,
 
 	enchant_dict_add_to_session (spell->dict, word, len);
 
+	clear_caches (spell);
+
 	g_signal_emit (G_OBJECT (spell), signals[ADD_WORD_TO_SESSION], 0, word, len);
 
 	return TRUE;
@@ -487,6 +1039,8 @@ gedit_spell_checker_clear_session (GeditSpellChecker *spell)
 		spell->dict = NULL;
 	}
 
+	clear_caches (spell);
+
 	if (!lazy_init (spell, spell->active_lang))
 		return FALSE;
 
@@ -24,6 +24,7 @@
 
 #include <glib.h>
 #include <glib-object.h>
+#include <gio/gio.h>
 
 #include "gedit-spell-checker-language.h"
 
@@ -74,10 +75,36 @@ gboolean		 gedit_spell_checker_check_word 	(GeditSpellChecker               *spe
 								 const gchar                     *word,
 								 gssize                           len);
 
+void			 gedit_spell_checker_check_words_async	(GeditSpellChecker               *spell,
+								 gchar                          **words,
+								 GCancellable                    *cancellable,
+								 GAsyncReadyCallback              callback,
+								 gpointer                         user_data);
+
+GArray			*gedit_spell_checker_check_words_finish	(GeditSpellChecker               *spell,
+								 GAsyncResult                    *result,
+								 GError                         **error);
+
+void			 gedit_spell_checker_get_cache_stats	(GeditSpellChecker               *spell,
+								 guint                           *hits,
+								 guint                           *misses);
+
 GSList 			*gedit_spell_checker_get_suggestions 	(GeditSpellChecker               *spell,
 								 const gchar                     *word,
 								 gssize                           len);
 
+void			 gedit_spell_checker_get_suggestions_async
+								(GeditSpellChecker               *spell,
+								 const gchar                     *word,
+								 GCancellable                    *cancellable,
+								 GAsyncReadyCallback              callback,
+								 gpointer                         user_data);
+
+GSList			*gedit_spell_checker_get_suggestions_finish
+								(GeditSpellChecker               *spell,
+								 GAsyncResult                    *result,
+								 GError                         **error);
+
 gboolean		 gedit_spell_checker_add_word_to_personal
 								(GeditSpellChecker               *spell,
 								 const gchar                     *word,
@@ -0,0 +1,157 @@
+/*
+ * docinfo-stats.c
+ * This file is part of gedit
+ *
+ * Copyright (C) 2015 - The gedit Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "gedit-docinfo-stats.h"
+
+/* The worker counts the ASCII lines with its own state machine, and the
+ * changes are counted line by line the same way. The totals are only right
+ * if the state machine agrees with pango_get_log_attrs(), which
+ * gedit_docinfo_count_text() uses.
+ */
+
+static const gchar *corpus[] =
+{
+	"",
+	"hello",
+	"hello world\n",
+	"foo_bar baz_ __init__ _\n",
+	"abc123 123abc a1b2c3 3.14 1,000,000\n",
+	"don't can't rock'n'roll 'quoted'\n",
+	"e.g. U.S.A. i.e.\n",
+	"x=y+z; if (a->b) { return c[0]; }\n",
+	"mail@example.com http://example.com/path?q=1&r=2#frag\n",
+	"  \t leading and trailing white \t  \n",
+	"tabs\there\fform feed\vvertical tab\r\n",
+	"\r\n",
+	"CamelCase snake_case kebab-case SCREAMING_CASE\n",
+	"#include <stdio.h> /* comment */ // other\n",
+	"0x1F 0b1010 1e-10 -42 +7\n",
+	"!!!??? ... --- ***\n",
+	"no newline at the end"
+};
+
+static void
+count_async_cb (GObject            *source_object,
+		GAsyncResult       *result,
+		GeditDocinfoCounts *counts)
+{
+	gboolean ok;
+
+	ok = gedit_docinfo_count_text_finish (result, counts, NULL);
+	g_assert (ok);
+}
+
+static void
+check_agree (const gchar *text)
+{
+	GeditDocinfoCounts expected = { 0 };
+	GeditDocinfoCounts counts = { 0 };
+
+	counts.lines = -1;
+
+	gedit_docinfo_count_text (text, -1, &expected);
+
+	gedit_docinfo_count_text_async (g_strdup (text),
+					strlen (text),
+					NULL,
+					NULL,
+					NULL,
+					(GAsyncReadyCallback) count_async_cb,
+					&counts);
+
+	while (counts.lines == -1)
+	{
+		g_main_context_iteration (NULL, TRUE);
+	}
+
+	if (g_test_verbose ())
+	{
+		g_print ("%s: %d words\n", text, expected.words);
+	}
+
+	g_assert_cmpint (counts.words, ==, expected.words);
+	g_assert_cmpint (counts.white_chars, ==, expected.white_chars);
+	g_assert_cmpint (counts.chars, ==, expected.chars);
+	g_assert_cmpint (counts.bytes, ==, expected.bytes);
+}
+
+static void
+test_ascii_lines (void)
+{
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS (corpus); i++)
+	{
+		check_agree (corpus[i]);
+	}
+}
+
+static void
+test_ascii_text (void)
+{
+	GString *text;
+	guint i;
+
+	text = g_string_new (NULL);
+
+	for (i = 0; i < G_N_ELEMENTS (corpus); i++)
+	{
+		g_string_append (text, corpus[i]);
+	}
+
+	check_agree (text->str);
+
+	g_string_free (text, TRUE);
+}
+
+/* The whole ASCII range, one char between letters and digits. */
+static void
+test_ascii_chars (void)
+{
+	gint c;
+
+	for (c = 1; c < 0x80; c++)
+	{
+		gchar *text;
+
+		text = g_strdup_printf ("a%cb 1%c2 a%c1 1%ca %c", c, c, c, c, c);
+		check_agree (text);
+		g_free (text);
+	}
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/docinfo-stats/ascii-lines", test_ascii_lines);
+	g_test_add_func ("/docinfo-stats/ascii-text", test_ascii_text);
+	g_test_add_func ("/docinfo-stats/ascii-chars", test_ascii_chars);
+
+	return g_test_run ();
+}
+
+/* ex:set ts=8 noet: */
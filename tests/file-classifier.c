@@ -0,0 +1,139 @@
+/*
+ * file-classifier.c
+ * This file is part of gedit
+ *
+ * Copyright (C) 2015 - The gedit Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "gedit-file-classifier.h"
+
+static GeditFileClass
+classify (const gchar *data,
+	  gsize        length,
+	  gboolean     complete)
+{
+	GeditFileClassification classification;
+
+	_gedit_file_classify_buffer (data, length, complete, &classification);
+
+	g_assert_cmpuint (classification.n_bytes, ==, length);
+	g_assert_cmpint (classification.complete, ==, complete);
+
+	return classification.file_class;
+}
+
+static GeditFileClass
+classify_str (const gchar *str)
+{
+	return classify (str, strlen (str), TRUE);
+}
+
+static void
+test_ascii (void)
+{
+	g_assert_cmpint (classify_str (""), ==, GEDIT_FILE_CLASS_ASCII);
+	g_assert_cmpint (classify_str ("a"), ==, GEDIT_FILE_CLASS_ASCII);
+	g_assert_cmpint (classify_str ("Hello, world!\n"), ==, GEDIT_FILE_CLASS_ASCII);
+	g_assert_cmpint (classify_str ("dos\r\nmac\runix\n"), ==, GEDIT_FILE_CLASS_ASCII);
+	g_assert_cmpint (classify_str ("\t\f\v\x7f"), ==, GEDIT_FILE_CLASS_ASCII);
+}
+
+static void
+test_utf8 (void)
+{
+	g_assert_cmpint (classify_str ("caf\xc3\xa9"), ==, GEDIT_FILE_CLASS_UTF8);
+	g_assert_cmpint (classify_str ("\xe2\x82\xac 10"), ==, GEDIT_FILE_CLASS_UTF8);
+	g_assert_cmpint (classify_str ("emoji \xf0\x9f\x98\x80\n"), ==, GEDIT_FILE_CLASS_UTF8);
+	g_assert_cmpint (classify_str ("\xef\xbb\xbf" "bom"), ==, GEDIT_FILE_CLASS_UTF8);
+}
+
+static void
+test_needs_trial (void)
+{
+	/* ISO-8859-1 "café". */
+	g_assert_cmpint (classify_str ("caf\xe9"), ==, GEDIT_FILE_CLASS_NEEDS_TRIAL);
+
+	/* Overlong encoding and lone continuation byte. */
+	g_assert_cmpint (classify_str ("\xc0\xaf"), ==, GEDIT_FILE_CLASS_NEEDS_TRIAL);
+	g_assert_cmpint (classify_str ("a\x80" "b"), ==, GEDIT_FILE_CLASS_NEEDS_TRIAL);
+
+	/* UTF-16LE "ab", with NUL bytes. */
+	g_assert_cmpint (classify ("a\0b\0", 4, TRUE), ==, GEDIT_FILE_CLASS_NEEDS_TRIAL);
+}
+
+/* A multi-byte char cut by the end of the classified range. */
+static void
+test_truncated (void)
+{
+	const gchar *euro = "abc\xe2\x82\xac";
+	gsize i;
+
+	for (i = 4; i < strlen (euro); i++)
+	{
+		g_assert_cmpint (classify (euro, i, FALSE), ==, GEDIT_FILE_CLASS_UTF8);
+		g_assert_cmpint (classify (euro, i, TRUE), ==, GEDIT_FILE_CLASS_NEEDS_TRIAL);
+	}
+}
+
+/* The non-ASCII or NUL byte at every position of a long buffer, to go
+ * through the word at a time scan and the bytes after it.
+ */
+static void
+test_positions (void)
+{
+	gchar buffer[67];
+	gsize i;
+
+	for (i = 0; i < sizeof (buffer); i++)
+	{
+		memset (buffer, 'x', sizeof (buffer));
+		g_assert_cmpint (classify (buffer, sizeof (buffer), TRUE), ==, GEDIT_FILE_CLASS_ASCII);
+
+		buffer[i] = '\0';
+		g_assert_cmpint (classify (buffer, sizeof (buffer), TRUE), ==, GEDIT_FILE_CLASS_NEEDS_TRIAL);
+
+		buffer[i] = '\xe9';
+		g_assert_cmpint (classify (buffer, sizeof (buffer), TRUE), ==, GEDIT_FILE_CLASS_NEEDS_TRIAL);
+
+		if (i + 1 < sizeof (buffer))
+		{
+			buffer[i] = '\xc3';
+			buffer[i + 1] = '\xa9';
+			g_assert_cmpint (classify (buffer, sizeof (buffer), TRUE), ==, GEDIT_FILE_CLASS_UTF8);
+		}
+	}
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/file-classifier/ascii", test_ascii);
+	g_test_add_func ("/file-classifier/utf8", test_utf8);
+	g_test_add_func ("/file-classifier/needs-trial", test_needs_trial);
+	g_test_add_func ("/file-classifier/truncated", test_truncated);
+	g_test_add_func ("/file-classifier/positions", test_positions);
+
+	return g_test_run ();
+}
+
+/* ex:set ts=8 noet: */
@@ -0,0 +1,237 @@
+/*
+ * filebrowser-fill-benchmark.c
+ * This file is part of gedit
+ *
+ * Copyright (C) 2015 - The gedit Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+
+#include "gedit-file-browser-store.h"
+#include "gedit-file-browser-enum-types.h"
+
+/* Fills a directory of the file browser store with
+ * _gedit_file_browser_store_add_files(), which goes through
+ * model_add_nodes_batch() by batches like a directory load does, and
+ * checks that the rows come out sorted.
+ *
+ * Needs a display, for the icons of the root.
+ *
+ * Usage: filebrowser-fill-benchmark [N_FILES]
+ */
+
+#define DEFAULT_N_FILES	20000
+
+/* The store is a dynamic type, registered on a module which does nothing. */
+typedef GTypeModule      BenchmarkModule;
+typedef GTypeModuleClass BenchmarkModuleClass;
+
+G_DEFINE_TYPE (BenchmarkModule, benchmark_module, G_TYPE_TYPE_MODULE)
+
+static gboolean
+benchmark_module_load (GTypeModule *module)
+{
+	return TRUE;
+}
+
+static void
+benchmark_module_unload (GTypeModule *module)
+{
+}
+
+static void
+benchmark_module_class_init (BenchmarkModuleClass *klass)
+{
+	GTypeModuleClass *module_class = G_TYPE_MODULE_CLASS (klass);
+
+	module_class->load = benchmark_module_load;
+	module_class->unload = benchmark_module_unload;
+}
+
+static void
+benchmark_module_init (BenchmarkModule *module)
+{
+}
+
+static gchar **
+generate_names (guint n_files)
+{
+	GRand *rand;
+	gchar **names;
+	guint i;
+
+	rand = g_rand_new_with_seed (42);
+	names = g_new (gchar *, n_files + 1);
+
+	/* The index keeps the names unique, like in a real directory. */
+	for (i = 0; i < n_files; i++)
+	{
+		switch (g_rand_int_range (rand, 0, 4))
+		{
+			case 0:
+				names[i] = g_strdup_printf ("IMG_%04d-%u.JPG", g_rand_int_range (rand, 0, 10000), i);
+				break;
+			case 1:
+				names[i] = g_strdup_printf ("file-%u.txt", i);
+				break;
+			case 2:
+				names[i] = g_strdup_printf ("Report (%d) - Été %u.pdf", g_rand_int_range (rand, 0, 1000), i);
+				break;
+			default:
+				names[i] = g_strdup_printf (".cache-%08x-%u", g_rand_int (rand), i);
+				break;
+		}
+	}
+
+	names[n_files] = NULL;
+
+	g_rand_free (rand);
+
+	return names;
+}
+
+static void
+end_loading_cb (GeditFileBrowserStore *store,
+		GtkTreeIter           *iter,
+		gboolean              *loaded)
+{
+	*loaded = TRUE;
+}
+
+/* Returns the number of files in the directory at @parent. */
+static guint
+check_sorted (GtkTreeModel *model,
+	      GtkTreeIter  *parent)
+{
+	GtkTreeIter iter;
+	gchar *prev_key = NULL;
+	guint n_files = 0;
+
+	if (!gtk_tree_model_iter_children (model, &iter, parent))
+		return 0;
+
+	do
+	{
+		gchar *name;
+		gchar *key;
+		guint flags;
+
+		gtk_tree_model_get (model, &iter,
+				    GEDIT_FILE_BROWSER_STORE_COLUMN_NAME, &name,
+				    GEDIT_FILE_BROWSER_STORE_COLUMN_FLAGS, &flags,
+				    -1);
+
+		if (FILE_IS_DUMMY (flags))
+		{
+			g_free (name);
+			continue;
+		}
+
+		key = g_utf8_collate_key_for_filename (name, -1);
+
+		if (prev_key != NULL && strcmp (prev_key, key) > 0)
+		{
+			g_error ("The directory is not sorted at %s", name);
+		}
+
+		g_free (prev_key);
+		prev_key = key;
+		g_free (name);
+		n_files++;
+	}
+	while (gtk_tree_model_iter_next (model, &iter));
+
+	g_free (prev_key);
+
+	return n_files;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+	GTypeModule *module;
+	GeditFileBrowserStore *store;
+	GtkTreeIter root;
+	GFile *dir;
+	GTimer *timer;
+	gchar *path;
+	gchar **names;
+	guint n_files = DEFAULT_N_FILES;
+	gboolean loaded = FALSE;
+	gdouble elapsed;
+
+	gtk_init (&argc, &argv);
+
+	if (argc > 1)
+	{
+		n_files = strtoul (argv[1], NULL, 10);
+	}
+
+	module = g_object_new (benchmark_module_get_type (), NULL);
+	g_type_module_use (module);
+	gedit_file_browser_enum_and_flag_register_type (module);
+	_gedit_file_browser_store_register_type (module);
+
+	/* An empty directory, so that the files are only the generated ones. */
+	path = g_dir_make_tmp ("gedit-filebrowser-fill-XXXXXX", NULL);
+	g_assert (path != NULL);
+
+	dir = g_file_new_for_path (path);
+	store = gedit_file_browser_store_new (dir);
+	gedit_file_browser_store_set_filter_mode (store, GEDIT_FILE_BROWSER_STORE_FILTER_MODE_NONE);
+
+	g_signal_connect (store, "end-loading", G_CALLBACK (end_loading_cb), &loaded);
+
+	while (!loaded)
+	{
+		g_main_context_iteration (NULL, TRUE);
+	}
+
+	if (!gedit_file_browser_store_get_iter_virtual_root (store, &root))
+	{
+		g_error ("No virtual root");
+	}
+
+	names = generate_names (n_files);
+	timer = g_timer_new ();
+
+	_gedit_file_browser_store_add_files (store, &root, (const gchar * const *) names);
+
+	elapsed = g_timer_elapsed (timer, NULL);
+
+	if (check_sorted (GTK_TREE_MODEL (store), &root) != n_files)
+	{
+		g_error ("Files are missing from the directory");
+	}
+
+	g_print ("%u files, by batches like a directory load: %8.3f s\n", n_files, elapsed);
+
+	g_timer_destroy (timer);
+	g_strfreev (names);
+	g_object_unref (store);
+	g_object_unref (dir);
+	g_rmdir (path);
+	g_free (path);
+
+	return 0;
+}
+
+/* ex:set ts=8 noet: */
@@ -0,0 +1,212 @@
+/*
+ * metadata-manager-stress.c
+ * This file is part of gedit
+ *
+ * Copyright (C) 2015 - The gedit Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "gedit-dirs.h"
+#include "gedit-metadata-manager.h"
+
+/* Several processes share the metadata log, like several gedit instances.
+ * Each one sets its own key on the same files, and saves after every round,
+ * so that the saves interleave and the log gets compacted in the middle of
+ * the run. In the end every key must have the value of the last round.
+ */
+
+#define N_PROCESSES	8
+#define N_ROUNDS	10
+#define N_FILES		50
+
+static GFile *
+get_location (gint file)
+{
+	GFile *location;
+	gchar *path;
+
+	path = g_strdup_printf ("/gedit-metadata-stress/file-%d", file);
+	location = g_file_new_for_path (path);
+	g_free (path);
+
+	return location;
+}
+
+static void
+run_process (gint process)
+{
+	gchar *key;
+	gint round;
+
+	key = g_strdup_printf ("process-%d", process);
+
+	for (round = 0; round < N_ROUNDS; round++)
+	{
+		gchar *value;
+		gint file;
+
+		gedit_metadata_manager_init ();
+
+		value = g_strdup_printf ("%d", round);
+
+		for (file = 0; file < N_FILES; file++)
+		{
+			GFile *location = get_location (file);
+
+			gedit_metadata_manager_set (location, key, value);
+			g_object_unref (location);
+		}
+
+		g_free (value);
+
+		/* Saves the records of the round. */
+		gedit_metadata_manager_shutdown ();
+	}
+
+	g_free (key);
+}
+
+static void
+test_concurrent_set (void)
+{
+	gchar *last_value;
+	pid_t pids[N_PROCESSES];
+	gint process;
+	gint file;
+
+	for (process = 0; process < N_PROCESSES; process++)
+	{
+		pids[process] = fork ();
+		g_assert_cmpint (pids[process], !=, -1);
+
+		if (pids[process] == 0)
+		{
+			run_process (process);
+			_exit (0);
+		}
+	}
+
+	for (process = 0; process < N_PROCESSES; process++)
+	{
+		gint status;
+
+		g_assert_cmpint (waitpid (pids[process], &status, 0), ==, pids[process]);
+		g_assert (WIFEXITED (status));
+		g_assert_cmpint (WEXITSTATUS (status), ==, 0);
+	}
+
+	last_value = g_strdup_printf ("%d", N_ROUNDS - 1);
+
+	gedit_metadata_manager_init ();
+
+	for (process = 0; process < N_PROCESSES; process++)
+	{
+		gchar *key = g_strdup_printf ("process-%d", process);
+
+		for (file = 0; file < N_FILES; file++)
+		{
+			GFile *location = get_location (file);
+			gchar *value;
+
+			value = gedit_metadata_manager_get (location, key);
+			g_assert_cmpstr (value, ==, last_value);
+
+			g_free (value);
+			g_object_unref (location);
+		}
+
+		g_free (key);
+	}
+
+	gedit_metadata_manager_shutdown ();
+
+	g_free (last_value);
+}
+
+static void
+remove_dir (const gchar *path)
+{
+	GDir *dir;
+	const gchar *name;
+
+	dir = g_dir_open (path, 0, NULL);
+
+	if (dir != NULL)
+	{
+		while ((name = g_dir_read_name (dir)) != NULL)
+		{
+			gchar *child = g_build_filename (path, name, NULL);
+
+			if (g_file_test (child, G_FILE_TEST_IS_DIR))
+			{
+				remove_dir (child);
+			}
+			else
+			{
+				g_remove (child);
+			}
+
+			g_free (child);
+		}
+
+		g_dir_close (dir);
+	}
+
+	g_rmdir (path);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+	gchar *cache_dir;
+	gchar *metadata_dir;
+	gint ret;
+
+	g_test_init (&argc, &argv, NULL);
+
+	/* Must be set before anything asks GLib for the cache directory. */
+	cache_dir = g_dir_make_tmp ("gedit-metadata-stress-XXXXXX", NULL);
+	g_assert (cache_dir != NULL);
+	g_setenv ("XDG_CACHE_HOME", cache_dir, TRUE);
+
+	gedit_dirs_init ();
+
+	metadata_dir = g_build_filename (cache_dir, "gedit", NULL);
+	g_assert_cmpint (g_mkdir_with_parents (metadata_dir, 0700), ==, 0);
+
+	g_test_add_func ("/metadata-manager/concurrent-set", test_concurrent_set);
+
+	ret = g_test_run ();
+
+	gedit_dirs_shutdown ();
+
+	remove_dir (cache_dir);
+
+	g_free (metadata_dir);
+	g_free (cache_dir);
+
+	return ret;
+}
+
+/* ex:set ts=8 noet: */
@@ -0,0 +1,213 @@
+/*
+ * sort-benchmark.c
+ * This file is part of gedit
+ *
+ * Copyright (C) 2015 - The gedit Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+
+#include <glib.h>
+
+#include "gedit-sort-engine.h"
+
+/* Sorts generated lines with the comparison function that the sort plugin
+ * used before gedit_sort_lines(), which casefolds the lines and computes
+ * their collation keys at each comparison, then with gedit_sort_lines().
+ *
+ * Usage: sort-benchmark [N_LINES]
+ */
+
+#define DEFAULT_N_LINES	1000000
+#define SEED		42
+
+static const gchar *words[] =
+{
+	"apple", "Banana", "cherry", "Date", "élan", "Éclair", "fig", "grape",
+	"Straße", "strasse", "zebra", "Zoë", "ångström", "Angle", "10", "9"
+};
+
+/* The comparison function of the sort plugin before gedit_sort_lines(). */
+static gint
+old_compare (gconstpointer s1,
+	     gconstpointer s2,
+	     gpointer      data)
+{
+	const GeditSortOptions *options = data;
+	gint length1, length2;
+	gint ret;
+	gchar *string1, *string2;
+	gchar *key1, *key2;
+
+	if (!options->ignore_case)
+	{
+		string1 = *((gchar **) s1);
+		string2 = *((gchar **) s2);
+	}
+	else
+	{
+		string1 = g_utf8_casefold (*((gchar **) s1), -1);
+		string2 = g_utf8_casefold (*((gchar **) s2), -1);
+	}
+
+	length1 = g_utf8_strlen (string1, -1);
+	length2 = g_utf8_strlen (string2, -1);
+
+	if ((length1 < options->starting_column) &&
+	    (length2 < options->starting_column))
+	{
+		ret = 0;
+	}
+	else if (length1 < options->starting_column)
+	{
+		ret = -1;
+	}
+	else if (length2 < options->starting_column)
+	{
+		ret = 1;
+	}
+	else
+	{
+		key1 = g_utf8_collate_key (g_utf8_offset_to_pointer (string1, options->starting_column), -1);
+		key2 = g_utf8_collate_key (g_utf8_offset_to_pointer (string2, options->starting_column), -1);
+		ret = strcmp (key1, key2);
+
+		g_free (key1);
+		g_free (key2);
+	}
+
+	if (options->ignore_case)
+	{
+		g_free (string1);
+		g_free (string2);
+	}
+
+	if (options->reverse_order)
+	{
+		ret = -1 * ret;
+	}
+
+	return ret;
+}
+
+static gchar **
+generate_lines (guint n_lines)
+{
+	GRand *rand;
+	gchar **lines;
+	guint i;
+
+	rand = g_rand_new_with_seed (SEED);
+	lines = g_new (gchar *, n_lines + 1);
+
+	for (i = 0; i < n_lines; i++)
+	{
+		lines[i] = g_strdup_printf ("%s %s %u",
+					    words[g_rand_int_range (rand, 0, G_N_ELEMENTS (words))],
+					    words[g_rand_int_range (rand, 0, G_N_ELEMENTS (words))],
+					    g_rand_int_range (rand, 0, 100000));
+	}
+
+	lines[n_lines] = NULL;
+
+	g_rand_free (rand);
+
+	return lines;
+}
+
+static void
+run (guint                   n_lines,
+     const GeditSortOptions *options)
+{
+	gchar **old_lines;
+	gchar **new_lines;
+	GTimer *timer;
+	gdouble old_time;
+	gdouble new_time;
+	guint i;
+
+	old_lines = generate_lines (n_lines);
+	new_lines = generate_lines (n_lines);
+
+	timer = g_timer_new ();
+
+	g_qsort_with_data (old_lines,
+			   n_lines,
+			   sizeof (gpointer),
+			   old_compare,
+			   (gpointer) options);
+
+	old_time = g_timer_elapsed (timer, NULL);
+
+	g_timer_start (timer);
+
+	gedit_sort_lines (new_lines, n_lines, options);
+
+	new_time = g_timer_elapsed (timer, NULL);
+
+	/* Ties may be ordered differently, but the order must be the same. */
+	for (i = 1; i < n_lines; i++)
+	{
+		if (old_compare (&new_lines[i - 1], &new_lines[i], (gpointer) options) > 0)
+		{
+			g_error ("gedit_sort_lines() put \"%s\" before \"%s\"",
+				 new_lines[i - 1],
+				 new_lines[i]);
+		}
+	}
+
+	g_print ("%u lines, ignore case: %s, starting column: %d\n",
+		 n_lines,
+		 options->ignore_case ? "yes" : "no",
+		 options->starting_column);
+	g_print ("  per-comparison keys: %8.3f s\n", old_time);
+	g_print ("  gedit_sort_lines():  %8.3f s (%.1fx)\n",
+		 new_time,
+		 new_time > 0 ? old_time / new_time : 0);
+
+	g_timer_destroy (timer);
+	g_strfreev (old_lines);
+	g_strfreev (new_lines);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+	GeditSortOptions options = { 0 };
+	guint n_lines = DEFAULT_N_LINES;
+
+	setlocale (LC_ALL, "");
+
+	if (argc > 1)
+	{
+		n_lines = strtoul (argv[1], NULL, 10);
+	}
+
+	run (n_lines, &options);
+
+	options.ignore_case = TRUE;
+	run (n_lines, &options);
+
+	options.starting_column = 6;
+	run (n_lines, &options);
+
+	return 0;
+}
+
+/* ex:set ts=8 noet: */